@@ -2,15 +2,35 @@
 #define CONFIG_H
 
 #include <Arduino.h>
+#include "fixed_string.h"
 
 // ============================================
 // STORAGE NAMESPACE (customize this!)
 // ============================================
 #define PREF_NAMESPACE "esp32cfg"  // TEMPLATE: Change to your project name
 
+// ============================================
+// PACKED CONFIG RECORD (single NVS blob)
+// ============================================
+// All DeviceConfig fields are stored together in one CRC-checked blob so a
+// boot costs a single NVS read instead of one lookup per setting.
+// The per-setting PREF_* keys below are only read once to migrate devices
+// configured by older firmware.
+#define PREF_CONFIG_RECORD "cfg_record"
+#define CONFIG_RECORD_MAGIC 0x47464344UL  // "DCFG" (little endian)
+#define CONFIG_RECORD_VERSION 1
+#define CONFIG_RECORD_MAX_SIZE 1024       // Upper bound for the encoded record
+#define CONFIG_SNAPSHOT_RECORD_SIZE 512   // RTC memory reserved for the timer-wake snapshot
+
+// Heap fragmentation check: uncomment to run this many in-RAM load/save
+// cycles at boot and log free heap / largest free block before and after
+// (no flash writes). DeviceConfig is heap-free, so both should not move.
+// #define CONFIG_HEAP_CHECK_CYCLES 10000
+
 // ============================================
 // CORE WIFI SETTINGS (always needed)
 // ============================================
+// Legacy per-setting keys (migrated into PREF_CONFIG_RECORD on first boot)
 #define PREF_CONFIGURED "configured"
 #define PREF_WIFI_SSID "wifi_ssid"
 #define PREF_WIFI_PASS "wifi_pass"
@@ -22,6 +42,7 @@
 #define PREF_SECONDARY_DNS "dns2"
 
 // WiFi channel locking (for fast reconnection)
+// Kept as separate keys: rewritten far more often than the config record
 #define PREF_WIFI_CHANNEL "wifi_ch"
 #define PREF_WIFI_BSSID "wifi_bssid"
 
@@ -29,6 +50,7 @@
 // OPTIONAL COMMON SETTINGS
 // ============================================
 #define PREF_FRIENDLY_NAME "friendly_name"
+#define FRIENDLY_NAME_MAX_LENGTH 24  // Must match the friendlyName row below
 #define PREF_DEBUG_MODE "debug_mode"
 
 // ============================================
@@ -39,59 +61,71 @@
 #define PREF_MQTT_PASS "mqtt_pass"
 
 // ============================================
-// CUSTOM SETTINGS (add yours here)
+// CONFIG FIELD TABLE (single source of truth)
 // ============================================
-// #define PREF_MY_SETTING "my_setting"
+// Every persisted setting is one row. The table generates the DeviceConfig
+// members, the NVS record (de)serialization, the portal form fields and the
+// JSON export - adding a setting needs no other code.
+//
+// X(type, member, legacyKey, name, label, section, maxLength, flags, placeholder)
+//   type       STRING or BOOL
+//   legacyKey  per-setting NVS key used by older firmware (nullptr for new fields)
+//   name       form field / JSON key
+//   section    CONFIG_SECTION_* the portal renders the field in
+//   maxLength  capacity of the inline FixedString (STRING only)
+//   flags      CONFIG_FIELD_* bits
+//
+// Rows are stored in table order: only APPEND new rows (at most 8 BOOL rows,
+// 32 rows in total). The portal renders rows grouped by section.
+#define DEVICE_CONFIG_FIELDS(X) \
+    X(BOOL,   isConfigured, PREF_CONFIGURED,    "configured",   "Configured",      CONFIG_SECTION_NONE,     0,   CONFIG_FIELD_HIDDEN,  "") \
+    X(STRING, wifiSSID,     PREF_WIFI_SSID,     "ssid",         "WiFi SSID",       CONFIG_SECTION_WIFI,     32,  CONFIG_FIELD_REQUIRED, "") \
+    X(STRING, wifiPassword, PREF_WIFI_PASS,     "password",     "WiFi Password",   CONFIG_SECTION_WIFI,     64,  CONFIG_FIELD_SECRET, "") \
+    X(BOOL,   useStaticIP,  PREF_USE_STATIC_IP, "useStaticIP",  "Use Static IP",   CONFIG_SECTION_NETWORK,  0,   CONFIG_FIELD_TOGGLE,  "") \
+    X(STRING, staticIP,     PREF_STATIC_IP,     "staticIP",     "Static IP",       CONFIG_SECTION_NETWORK,  15,  CONFIG_FIELD_IPV4 | CONFIG_FIELD_REQUIRED, "192.168.1.100") \
+    X(STRING, gateway,      PREF_GATEWAY,       "gateway",      "Gateway",         CONFIG_SECTION_NETWORK,  15,  CONFIG_FIELD_IPV4 | CONFIG_FIELD_REQUIRED, "192.168.1.1") \
+    X(STRING, subnet,       PREF_SUBNET,        "subnet",       "Subnet Mask",     CONFIG_SECTION_NETWORK,  15,  CONFIG_FIELD_IPV4 | CONFIG_FIELD_REQUIRED, "255.255.255.0") \
+    X(STRING, primaryDNS,   PREF_PRIMARY_DNS,   "primaryDNS",   "Primary DNS",     CONFIG_SECTION_NETWORK,  15,  CONFIG_FIELD_IPV4 | CONFIG_FIELD_REQUIRED, "8.8.8.8") \
+    X(STRING, secondaryDNS, PREF_SECONDARY_DNS, "secondaryDNS", "Secondary DNS",   CONFIG_SECTION_NETWORK,  15,  CONFIG_FIELD_IPV4,    "8.8.4.4") \
+    X(STRING, friendlyName, PREF_FRIENDLY_NAME, "friendlyName", "Friendly Name",   CONFIG_SECTION_DEVICE,   24,  0,                    "my-device") \
+    X(STRING, mqttBroker,   PREF_MQTT_BROKER,   "mqttBroker",   "MQTT Broker",     CONFIG_SECTION_MQTT,     128, 0,                    "mqtt://192.168.1.10:1883") \
+    X(STRING, mqttUsername, PREF_MQTT_USER,     "mqttUsername", "MQTT Username",   CONFIG_SECTION_MQTT,     64,  0,                    "") \
+    X(STRING, mqttPassword, PREF_MQTT_PASS,     "mqttPassword", "MQTT Password",   CONFIG_SECTION_MQTT,     64,  CONFIG_FIELD_SECRET, "") \
+    X(BOOL,   debugMode,    PREF_DEBUG_MODE,    "debugMode",    "Enable Debug Logging", CONFIG_SECTION_ADVANCED, 0, 0,                 "") \
+    /* TEMPLATE: Append your custom fields here, e.g.                                                                 */ \
+    /* X(STRING, customApiKey, nullptr, "customApiKey", "API Key", CONFIG_SECTION_ADVANCED, 64, CONFIG_FIELD_SECRET, "") */
+
+// Portal sections (rendered in this order)
+enum ConfigSection : uint8_t {
+    CONFIG_SECTION_NONE = 0,  // Not shown in the portal
+    CONFIG_SECTION_WIFI,
+    CONFIG_SECTION_DEVICE,
+    CONFIG_SECTION_NETWORK,
+    CONFIG_SECTION_MQTT,
+    CONFIG_SECTION_ADVANCED,
+    CONFIG_SECTION_COUNT
+};
+
+// Field flags
+#define CONFIG_FIELD_REQUIRED 0x01  // Must not be empty (inside a toggle group: only when enabled)
+#define CONFIG_FIELD_SECRET   0x02  // Password input; omitted from redacted JSON
+#define CONFIG_FIELD_HIDDEN   0x04  // Not rendered in the portal form
+#define CONFIG_FIELD_IPV4     0x08  // Must be a dotted IPv4 address when set
+#define CONFIG_FIELD_TOGGLE   0x10  // BOOL that shows/enables the remaining fields of its section
 
 // ============================================
 // DEVICE CONFIGURATION STRUCTURE
 // ============================================
+#define CONFIG_FIELD_CTYPE_STRING(maxLength) FixedString<maxLength>
+#define CONFIG_FIELD_CTYPE_BOOL(maxLength) bool
+#define CONFIG_FIELD_MEMBER(type, member, legacyKey, name, label, section, maxLength, ...) \
+    CONFIG_FIELD_CTYPE_##type(maxLength) member{};
+
+// Members are generated from DEVICE_CONFIG_FIELDS (strings default to "",
+// bools to false). Strings are stored inline, so copying a DeviceConfig
+// never touches the heap.
 struct DeviceConfig {
-    // WiFi credentials
-    String wifiSSID;
-    String wifiPassword;
-    
-    // Static IP configuration
-    bool useStaticIP;
-    String staticIP;
-    String gateway;
-    String subnet;
-    String primaryDNS;
-    String secondaryDNS;
-    
-    // Device info
-    String friendlyName;
-    bool isConfigured;
-    bool debugMode;
-    
-    // MQTT settings (core template feature - optional to use)
-    String mqttBroker;    // e.g., "mqtt://192.168.1.100:1883"
-    String mqttUsername;  // Optional
-    String mqttPassword;  // Optional
-    
-    // TEMPLATE: Add your custom fields here
-    // Example:
-    // int refreshInterval;
-    // String customApiKey;
-    
-    // Constructor with defaults
-    DeviceConfig() : 
-        wifiSSID(""),
-        wifiPassword(""),
-        useStaticIP(false),
-        staticIP(""),
-        gateway(""),
-        subnet(""),
-        primaryDNS(""),
-        secondaryDNS(""),
-        friendlyName(""),
-        isConfigured(false),
-        debugMode(false),
-        mqttBroker(""),
-        mqttUsername(""),
-        mqttPassword("")
-        // TEMPLATE: Initialize your custom fields
-    {}
+    DEVICE_CONFIG_FIELDS(CONFIG_FIELD_MEMBER)
 };
 
 #endif // CONFIG_H
@@ -1,35 +1,169 @@
 #include "config_manager.h"
+#include "config_schema.h"
 #include "logger.h"
+#include <esp_rom_crc.h>
+#include <stddef.h>
+
+// ============================================
+// CONFIG RECORD LAYOUT
+// ============================================
+// Header (12 bytes, little endian):
+//   [0..3]  magic        CONFIG_RECORD_MAGIC
+//   [4]     version      CONFIG_RECORD_VERSION
+//   [5]     field count  number of string fields that follow the flags byte
+//   [6..7]  payload size bytes after the header
+//   [8..11] CRC32        over the payload
+// Payload:
+//   flags byte (one bit per BOOL row of DEVICE_CONFIG_FIELDS, in table
+//   order), then each STRING row as [length u8][bytes]
+//
+// New fields must be APPENDED to DEVICE_CONFIG_FIELDS. Older records simply
+// carry fewer fields (missing ones keep their defaults), newer records carry
+// extra fields that older firmware ignores.
+static const size_t RECORD_HEADER_SIZE = 12;
+
+static_assert(decltype(DeviceConfig::friendlyName)::capacity() == FRIENDLY_NAME_MAX_LENGTH,
+              "friendlyName row must match FRIENDLY_NAME_MAX_LENGTH");
+
+static uint8_t countBits(uint32_t mask) {
+    uint8_t count = 0;
+    for (; mask != 0; mask &= mask - 1) {
+        count++;
+    }
+    return count;
+}
+
+// Shared encode/decode buffer (ConfigManager is only used from the main task)
+static uint8_t s_recordBuffer[CONFIG_RECORD_MAX_SIZE];
+
+// Channel lock cache states
+static const uint8_t CHANNEL_LOCK_UNKNOWN = 0;  // Not read from NVS yet
+static const uint8_t CHANNEL_LOCK_NONE = 1;
+static const uint8_t CHANNEL_LOCK_SET = 2;
+
+// ============================================
+// RTC SNAPSHOT
+// ============================================
+// Copy of the encoded config record (plus channel lock) kept in RTC memory,
+// which survives deep sleep. Timer wakes restore from it without touching
+// NVS. Filled whenever the record is loaded from NVS, invalidated by any
+// setter or factory reset so the next non-timer boot re-reads flash.
+#define CONFIG_SNAPSHOT_MAGIC 0x50414E53UL  // "SNAP"
+
+struct ConfigSnapshot {
+    uint32_t magic;
+    uint16_t recordLength;
+    uint8_t channelLockState;
+    uint8_t wifiChannel;
+    uint8_t wifiBSSID[6];
+    uint8_t record[CONFIG_SNAPSHOT_RECORD_SIZE];
+    uint32_t crc;  // Over all fields above
+};
+
+static RTC_DATA_ATTR ConfigSnapshot rtc_configSnapshot;
+
+static uint32_t snapshotCRC(const ConfigSnapshot& snapshot) {
+    return esp_rom_crc32_le(0, (const uint8_t*)&snapshot, offsetof(ConfigSnapshot, crc));
+}
+
+static void writeLE16(uint8_t* p, uint16_t v) {
+    p[0] = v & 0xFF;
+    p[1] = (v >> 8) & 0xFF;
+}
+
+static void writeLE32(uint8_t* p, uint32_t v) {
+    for (int i = 0; i < 4; i++) {
+        p[i] = (v >> (8 * i)) & 0xFF;
+    }
+}
+
+static uint16_t readLE16(const uint8_t* p) {
+    return (uint16_t)p[0] | ((uint16_t)p[1] << 8);
+}
+
+static uint32_t readLE32(const uint8_t* p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
 
-ConfigManager::ConfigManager() : _initialized(false) {
+ConfigManager::ConfigManager()
+    : _initialized(false), _storageOpen(false),
+      _inTransaction(false), _dirtyMask(0), _txStartMicros(0),
+      _storedRecordLength(0), _storedRecordCRC(0),
+      _channelLockState(CHANNEL_LOCK_UNKNOWN), _wifiChannel(0), _wifiBSSID{0} {
 }
 
 ConfigManager::~ConfigManager() {
-    if (_initialized) {
-        _preferences.end();
+    if (_storageOpen) {
+        _store.end();
     }
 }
 
-bool ConfigManager::begin() {
+bool ConfigManager::begin(bool useRtcSnapshot) {
     if (_initialized) {
         return true;
     }
     
-    _initialized = _preferences.begin(PREF_NAMESPACE, false);
-    if (!_initialized) {
-        LogBox::message("ConfigManager Error", "Failed to initialize Preferences");
+    unsigned long startMicros = micros();
+    _stats = ConfigStats();
+    NvsOpCounters start = _store.getCounters();
+    
+    if (useRtcSnapshot && restoreSnapshot()) {
+        _initialized = true;
+        _stats.fromSnapshot = true;
+        _stats.loadMicros = micros() - startMicros;
+        logCost("load (RTC snapshot)", start, startMicros);
+        return true;
+    }
+    
+    if (!openStorage()) {
         return false;
     }
+    _initialized = true;
+    
+    loadRecord();
+    loadChannelLock();  // Part of the snapshot, so timer wakes never open NVS for it
+    storeSnapshot();
+    
+    _stats.loadMicros = micros() - startMicros;
+    if (_stats.migrated) {
+        logCost("load (migrated legacy keys)", start, startMicros);
+    } else {
+        logCost(_storedRecordLength > 0 ? "load (NVS)" : "load (no record)", start, startMicros);
+    }
     
     return _initialized;
 }
 
+void ConfigManager::logCost(const char* operation, const NvsOpCounters& start, unsigned long startMicros) const {
+    const NvsOpCounters& now = _store.getCounters();
+    LogBox::linef("Config %s: %u read(s)/%lu B, %u write(s)/%u entries/%lu B, %u erase(s), %u skipped, %lu us",
+                  operation,
+                  (unsigned)(now.reads - start.reads), (unsigned long)(now.bytesRead - start.bytesRead),
+                  (unsigned)(now.writes - start.writes), (unsigned)(now.entriesWritten - start.entriesWritten),
+                  (unsigned long)(now.bytesWritten - start.bytesWritten),
+                  (unsigned)(now.erases - start.erases), (unsigned)(now.skippedWrites - start.skippedWrites),
+                  (unsigned long)(micros() - startMicros));
+}
+
+bool ConfigManager::openStorage() {
+    if (_storageOpen) {
+        return true;
+    }
+    
+    _storageOpen = _store.begin(PREF_NAMESPACE, false);
+    if (!_storageOpen) {
+        LogBox::message("ConfigManager Error", "Failed to initialize Preferences");
+    }
+    
+    return _storageOpen;
+}
+
 bool ConfigManager::isConfigured() {
     if (!_initialized && !begin()) {
         return false;
     }
     
-    return _preferences.getBool(PREF_CONFIGURED, false);
+    return _config.isConfigured;
 }
 
 bool ConfigManager::hasWiFiConfig() {
@@ -37,8 +171,12 @@ bool ConfigManager::hasWiFiConfig() {
         return false;
     }
     
-    String ssid = _preferences.getString(PREF_WIFI_SSID, "");
-    return ssid.length() > 0;
+    return _config.wifiSSID.length() > 0;
+}
+
+const DeviceConfig& ConfigManager::getConfig() {
+    if (!_initialized) begin();
+    return _config;
 }
 
 bool ConfigManager::loadConfig(DeviceConfig& config) {
@@ -47,32 +185,14 @@ bool ConfigManager::loadConfig(DeviceConfig& config) {
         return false;
     }
     
-    // Load all configuration values
-    config.isConfigured = _preferences.getBool(PREF_CONFIGURED, false);
+    // Served from the record cached by begin()
+    config = _config;
     
     if (!config.isConfigured) {
         LogBox::message("Config Status", "Device not configured yet");
         return false;
     }
     
-    config.wifiSSID = _preferences.getString(PREF_WIFI_SSID, "");
-    config.wifiPassword = _preferences.getString(PREF_WIFI_PASS, "");
-    config.friendlyName = _preferences.getString(PREF_FRIENDLY_NAME, "");
-    config.debugMode = _preferences.getBool(PREF_DEBUG_MODE, false);
-    
-    // Load static IP configuration
-    config.useStaticIP = _preferences.getBool(PREF_USE_STATIC_IP, false);
-    config.staticIP = _preferences.getString(PREF_STATIC_IP, "");
-    config.gateway = _preferences.getString(PREF_GATEWAY, "");
-    config.subnet = _preferences.getString(PREF_SUBNET, "");
-    config.primaryDNS = _preferences.getString(PREF_PRIMARY_DNS, "");
-    config.secondaryDNS = _preferences.getString(PREF_SECONDARY_DNS, "");
-    
-    // Load MQTT configuration
-    config.mqttBroker = _preferences.getString(PREF_MQTT_BROKER, "");
-    config.mqttUsername = _preferences.getString(PREF_MQTT_USER, "");
-    config.mqttPassword = _preferences.getString(PREF_MQTT_PASS, "");
-    
     // Validate configuration
     if (config.wifiSSID.length() == 0) {
         LogBox::message("Config Error", "Invalid configuration: missing SSID");
@@ -80,16 +200,16 @@ bool ConfigManager::loadConfig(DeviceConfig& config) {
     }
     
     LogBox::begin("Configuration Loaded");
-    LogBox::line("WiFi SSID: " + config.wifiSSID);
-    LogBox::line("Friendly Name: " + (config.friendlyName.length() > 0 ? config.friendlyName : "(not set)"));
+    LogBox::linef("WiFi SSID: %s", config.wifiSSID.c_str());
+    LogBox::linef("Friendly Name: %s", config.friendlyName.isEmpty() ? "(not set)" : config.friendlyName.c_str());
     if (config.useStaticIP) {
-        LogBox::line("Static IP: " + config.staticIP);
+        LogBox::linef("Static IP: %s", config.staticIP.c_str());
     } else {
         LogBox::line("IP Mode: DHCP");
     }
-    if (config.mqttBroker.length() > 0) {
-        LogBox::line("MQTT Broker: " + config.mqttBroker);
-        LogBox::line("MQTT Username: " + (config.mqttUsername.length() > 0 ? config.mqttUsername : "(none)"));
+    if (!config.mqttBroker.isEmpty()) {
+        LogBox::linef("MQTT Broker: %s", config.mqttBroker.c_str());
+        LogBox::linef("MQTT Username: %s", config.mqttUsername.isEmpty() ? "(none)" : config.mqttUsername.c_str());
     } else {
         LogBox::line("MQTT: Not configured");
     }
@@ -110,25 +230,19 @@ bool ConfigManager::saveConfig(const DeviceConfig& config) {
         return false;
     }
     
-    // Save all configuration values
-    _preferences.putString(PREF_WIFI_SSID, config.wifiSSID);
-    _preferences.putString(PREF_WIFI_PASS, config.wifiPassword);
-    _preferences.putString(PREF_FRIENDLY_NAME, config.friendlyName);
-    _preferences.putBool(PREF_DEBUG_MODE, config.debugMode);
-    _preferences.putBool(PREF_CONFIGURED, true);
-    
-    // Save static IP configuration
-    _preferences.putBool(PREF_USE_STATIC_IP, config.useStaticIP);
-    _preferences.putString(PREF_STATIC_IP, config.staticIP);
-    _preferences.putString(PREF_GATEWAY, config.gateway);
-    _preferences.putString(PREF_SUBNET, config.subnet);
-    _preferences.putString(PREF_PRIMARY_DNS, config.primaryDNS);
-    _preferences.putString(PREF_SECONDARY_DNS, config.secondaryDNS);
+    for (uint8_t i = 0; i < CONFIG_FIELD_COUNT; i++) {
+        const ConfigFieldInfo& field = kConfigFields[i];
+        if (field.type == CONFIG_TYPE_BOOL) {
+            stageBool((ConfigFieldId)i, config.*(field.boolMember));
+        } else {
+            stageString((ConfigFieldId)i, field.readString(config));
+        }
+    }
+    stageBool(CONFIG_ID_isConfigured, true);
     
-    // Save MQTT configuration
-    _preferences.putString(PREF_MQTT_BROKER, config.mqttBroker);
-    _preferences.putString(PREF_MQTT_USER, config.mqttUsername);
-    _preferences.putString(PREF_MQTT_PASS, config.mqttPassword);
+    if (!autoCommit()) {
+        return false;
+    }
     
     LogBox::message("Config Saved", "Configuration saved successfully");
     
@@ -143,192 +257,698 @@ void ConfigManager::clearConfig() {
     LogBox::begin("Factory Reset");
     LogBox::line("Clearing all configuration...");
     
-    _preferences.clear();
+    unsigned long startMicros = micros();
+    NvsOpCounters start = _store.getCounters();
+    invalidateSnapshot();
+    if (openStorage()) {
+        _store.clear();
+    }
+    _config = DeviceConfig();
+    _channelLockState = CHANNEL_LOCK_NONE;
+    _dirtyMask = 0;
+    _inTransaction = false;
+    _storedRecordLength = 0;
+    _storedRecordCRC = 0;
+    logCost("factory reset", start, startMicros);
     
     LogBox::end("Configuration cleared successfully");
 }
 
 // Individual getters
-String ConfigManager::getWiFiSSID() {
+const char* ConfigManager::getWiFiSSID() {
     if (!_initialized && !begin()) return "";
-    return _preferences.getString(PREF_WIFI_SSID, "");
+    return _config.wifiSSID.c_str();
 }
 
-String ConfigManager::getWiFiPassword() {
+const char* ConfigManager::getWiFiPassword() {
     if (!_initialized && !begin()) return "";
-    return _preferences.getString(PREF_WIFI_PASS, "");
+    return _config.wifiPassword.c_str();
 }
 
-String ConfigManager::getFriendlyName() {
+const char* ConfigManager::getFriendlyName() {
     if (!_initialized && !begin()) return "";
-    return _preferences.getString(PREF_FRIENDLY_NAME, "");
+    return _config.friendlyName.c_str();
 }
 
-String ConfigManager::getMQTTBroker() {
+const char* ConfigManager::getMQTTBroker() {
     if (!_initialized && !begin()) return "";
-    return _preferences.getString(PREF_MQTT_BROKER, "");
+    return _config.mqttBroker.c_str();
 }
 
-String ConfigManager::getMQTTUsername() {
+const char* ConfigManager::getMQTTUsername() {
     if (!_initialized && !begin()) return "";
-    return _preferences.getString(PREF_MQTT_USER, "");
+    return _config.mqttUsername.c_str();
 }
 
-String ConfigManager::getMQTTPassword() {
+const char* ConfigManager::getMQTTPassword() {
     if (!_initialized && !begin()) return "";
-    return _preferences.getString(PREF_MQTT_PASS, "");
+    return _config.mqttPassword.c_str();
 }
 
 bool ConfigManager::getDebugMode() {
     if (!_initialized && !begin()) return false;
-    return _preferences.getBool(PREF_DEBUG_MODE, false);
+    return _config.debugMode;
 }
 
 // Static IP getters
 bool ConfigManager::getUseStaticIP() {
     if (!_initialized && !begin()) return false;
-    return _preferences.getBool(PREF_USE_STATIC_IP, false);
+    return _config.useStaticIP;
 }
 
-String ConfigManager::getStaticIP() {
+const char* ConfigManager::getStaticIP() {
     if (!_initialized && !begin()) return "";
-    return _preferences.getString(PREF_STATIC_IP, "");
+    return _config.staticIP.c_str();
 }
 
-String ConfigManager::getGateway() {
+const char* ConfigManager::getGateway() {
     if (!_initialized && !begin()) return "";
-    return _preferences.getString(PREF_GATEWAY, "");
+    return _config.gateway.c_str();
 }
 
-String ConfigManager::getSubnet() {
+const char* ConfigManager::getSubnet() {
     if (!_initialized && !begin()) return "";
-    return _preferences.getString(PREF_SUBNET, "");
+    return _config.subnet.c_str();
 }
 
-String ConfigManager::getPrimaryDNS() {
+const char* ConfigManager::getPrimaryDNS() {
     if (!_initialized && !begin()) return "";
-    return _preferences.getString(PREF_PRIMARY_DNS, "");
+    return _config.primaryDNS.c_str();
 }
 
-String ConfigManager::getSecondaryDNS() {
+const char* ConfigManager::getSecondaryDNS() {
     if (!_initialized && !begin()) return "";
-    return _preferences.getString(PREF_SECONDARY_DNS, "");
+    return _config.secondaryDNS.c_str();
 }
 
 // Individual setters
-void ConfigManager::setWiFiCredentials(const String& ssid, const String& password) {
+void ConfigManager::setWiFiCredentials(const char* ssid, const char* password) {
     if (!_initialized && !begin()) return;
-    _preferences.putString(PREF_WIFI_SSID, ssid);
-    _preferences.putString(PREF_WIFI_PASS, password);
+    stageString(CONFIG_ID_wifiSSID, ssid);
+    stageString(CONFIG_ID_wifiPassword, password);
+    autoCommit();
 }
 
-void ConfigManager::setFriendlyName(const String& name) {
+void ConfigManager::setFriendlyName(const char* name) {
     if (!_initialized && !begin()) return;
-    _preferences.putString(PREF_FRIENDLY_NAME, name);
+    stageString(CONFIG_ID_friendlyName, name);
+    autoCommit();
 }
 
-void ConfigManager::setMQTTConfig(const String& broker, const String& username, const String& password) {
+void ConfigManager::setMQTTConfig(const char* broker, const char* username, const char* password) {
     if (!_initialized && !begin()) return;
-    _preferences.putString(PREF_MQTT_BROKER, broker);
-    _preferences.putString(PREF_MQTT_USER, username);
-    _preferences.putString(PREF_MQTT_PASS, password);
+    stageString(CONFIG_ID_mqttBroker, broker);
+    stageString(CONFIG_ID_mqttUsername, username);
+    stageString(CONFIG_ID_mqttPassword, password);
+    autoCommit();
 }
 
 void ConfigManager::setDebugMode(bool enabled) {
     if (!_initialized && !begin()) return;
-    _preferences.putBool(PREF_DEBUG_MODE, enabled);
+    stageBool(CONFIG_ID_debugMode, enabled);
+    autoCommit();
+}
+
+bool ConfigManager::setField(ConfigFieldId id, const char* value) {
+    if (!_initialized && !begin()) return false;
+    if (id >= CONFIG_FIELD_COUNT || kConfigFields[id].type != CONFIG_TYPE_STRING) {
+        return false;
+    }
+    bool accepted = stageString(id, value);
+    return autoCommit() && accepted;
+}
+
+bool ConfigManager::setField(ConfigFieldId id, bool value) {
+    if (!_initialized && !begin()) return false;
+    if (id >= CONFIG_FIELD_COUNT || kConfigFields[id].type != CONFIG_TYPE_BOOL) {
+        return false;
+    }
+    stageBool(id, value);
+    return autoCommit();
 }
 
 // WiFi channel locking
 bool ConfigManager::hasWiFiChannelLock() {
     if (!_initialized && !begin()) return false;
-    return _preferences.isKey(PREF_WIFI_CHANNEL);
+    loadChannelLock();
+    return _channelLockState == CHANNEL_LOCK_SET;
 }
 
 uint8_t ConfigManager::getWiFiChannel() {
     if (!_initialized && !begin()) return 0;
-    return _preferences.getUChar(PREF_WIFI_CHANNEL, 0);
+    loadChannelLock();
+    return _wifiChannel;
 }
 
 void ConfigManager::getWiFiBSSID(uint8_t* bssid) {
     if (!_initialized && !begin()) return;
-    _preferences.getBytes(PREF_WIFI_BSSID, bssid, 6);
+    loadChannelLock();
+    memcpy(bssid, _wifiBSSID, 6);
 }
 
 void ConfigManager::setWiFiChannelLock(uint8_t channel, const uint8_t* bssid) {
     if (!_initialized && !begin()) return;
-    _preferences.putUChar(PREF_WIFI_CHANNEL, channel);
-    _preferences.putBytes(PREF_WIFI_BSSID, bssid, 6);
+    
+    // Re-locking to the same AP after every successful connect is the common
+    // case - skip it without touching NVS
+    loadChannelLock();
+    if (_channelLockState == CHANNEL_LOCK_SET && _wifiChannel == channel &&
+        memcmp(_wifiBSSID, bssid, 6) == 0) {
+        return;
+    }
+    
+    if (openStorage()) {
+        unsigned long startMicros = micros();
+        NvsOpCounters start = _store.getCounters();
+        _store.putUChar(PREF_WIFI_CHANNEL, channel);
+        _store.putBytes(PREF_WIFI_BSSID, bssid, 6);
+        logCost("channel lock", start, startMicros);
+    }
+    _wifiChannel = channel;
+    memcpy(_wifiBSSID, bssid, 6);
+    _channelLockState = CHANNEL_LOCK_SET;
+    storeSnapshotChannelLock();
 }
 
 void ConfigManager::clearWiFiChannelLock() {
     if (!_initialized && !begin()) return;
-    _preferences.remove(PREF_WIFI_CHANNEL);
-    _preferences.remove(PREF_WIFI_BSSID);
+    
+    loadChannelLock();
+    if (_channelLockState == CHANNEL_LOCK_NONE) {
+        return;
+    }
+    
+    if (openStorage()) {
+        unsigned long startMicros = micros();
+        NvsOpCounters start = _store.getCounters();
+        _store.remove(PREF_WIFI_CHANNEL);
+        _store.remove(PREF_WIFI_BSSID);
+        logCost("channel unlock", start, startMicros);
+    }
+    _wifiChannel = 0;
+    memset(_wifiBSSID, 0, sizeof(_wifiBSSID));
+    _channelLockState = CHANNEL_LOCK_NONE;
+    storeSnapshotChannelLock();
+}
+
+void ConfigManager::loadChannelLock() {
+    if (_channelLockState != CHANNEL_LOCK_UNKNOWN || !openStorage()) {
+        return;
+    }
+    
+    if (_store.isKey(PREF_WIFI_CHANNEL)) {
+        _wifiChannel = _store.getUChar(PREF_WIFI_CHANNEL, 0);
+        _store.getBytes(PREF_WIFI_BSSID, _wifiBSSID, 6);
+        _channelLockState = CHANNEL_LOCK_SET;
+    } else {
+        _channelLockState = CHANNEL_LOCK_NONE;
+    }
+    
+    // A snapshot taken before the lock was known would send every later
+    // timer wake back to NVS for it
+    storeSnapshotChannelLock();
 }
 
 bool ConfigManager::sanitizeFriendlyName(const String& input, String& output) {
-    output = "";
+    char buffer[FRIENDLY_NAME_MAX_LENGTH + 1];
+    bool valid = sanitizeFriendlyName(input.c_str(), buffer, sizeof(buffer));
+    output = valid ? buffer : "";
+    return valid;
+}
+
+bool ConfigManager::sanitizeFriendlyName(const char* input, char* output, size_t outputSize) {
+    if (outputSize == 0) {
+        return false;
+    }
+    output[0] = '\0';
     
-    if (input.length() == 0 || input.length() > 24) {
+    size_t inputLength = strlen(input);
+    if (inputLength == 0 || inputLength > FRIENDLY_NAME_MAX_LENGTH || outputSize <= inputLength) {
         return false;
     }
     
-    // Convert to lowercase and filter invalid characters
-    for (size_t i = 0; i < input.length(); i++) {
+    // Single pass: lowercase, drop invalid characters and leading hyphens
+    size_t length = 0;
+    for (size_t i = 0; i < inputLength; i++) {
         char c = input[i];
         
         if (c >= 'A' && c <= 'Z') {
-            output += (char)(c + 32);  // Convert to lowercase
-        } else if ((c >= 'a' && c <= 'z') || (c >= '0' && c <= '9') || c == '-') {
-            output += c;
+            c = (char)(c + 32);  // Convert to lowercase
+        } else if (!((c >= 'a' && c <= 'z') || (c >= '0' && c <= '9') || c == '-')) {
+            continue;  // Skip all other characters
         }
-        // Skip all other characters
-    }
-    
-    // Remove leading/trailing hyphens
-    while (output.length() > 0 && output[0] == '-') {
-        output = output.substring(1);
-    }
-    while (output.length() > 0 && output[output.length() - 1] == '-') {
-        output = output.substring(0, output.length() - 1);
+        if (c == '-' && length == 0) {
+            continue;
+        }
+        output[length++] = c;
     }
     
-    // Check if result is valid
-    if (output.length() == 0) {
-        return false;
+    // Remove trailing hyphens
+    while (length > 0 && output[length - 1] == '-') {
+        length--;
     }
+    output[length] = '\0';
     
-    return true;
+    return length > 0;
 }
 
 void ConfigManager::markAsConfigured() {
     if (!_initialized && !begin()) return;
-    _preferences.putBool(PREF_CONFIGURED, true);
+    stageBool(CONFIG_ID_isConfigured, true);
+    autoCommit();
 }
 
 void ConfigManager::setConfigured(bool configured) {
     if (!_initialized && !begin()) return;
-    _preferences.putBool(PREF_CONFIGURED, configured);
+    stageBool(CONFIG_ID_isConfigured, configured);
+    autoCommit();
 }
 
 void ConfigManager::setUseStaticIP(bool enabled) {
     if (!_initialized && !begin()) return;
-    _preferences.putBool(PREF_USE_STATIC_IP, enabled);
+    stageBool(CONFIG_ID_useStaticIP, enabled);
+    autoCommit();
 }
 
-void ConfigManager::setStaticIPConfig(const String& ip, const String& gw, 
-                                     const String& sn, const String& dns1, const String& dns2) {
+void ConfigManager::setStaticIPConfig(const char* ip, const char* gw,
+                                     const char* sn, const char* dns1, const char* dns2) {
     if (!_initialized && !begin()) return;
-    _preferences.putString(PREF_STATIC_IP, ip);
-    _preferences.putString(PREF_GATEWAY, gw);
-    _preferences.putString(PREF_SUBNET, sn);
-    _preferences.putString(PREF_PRIMARY_DNS, dns1);
-    _preferences.putString(PREF_SECONDARY_DNS, dns2);
+    stageString(CONFIG_ID_staticIP, ip);
+    stageString(CONFIG_ID_gateway, gw);
+    stageString(CONFIG_ID_subnet, sn);
+    stageString(CONFIG_ID_primaryDNS, dns1);
+    stageString(CONFIG_ID_secondaryDNS, dns2);
+    autoCommit();
 }
 
 bool ConfigManager::saveConfig() {
-    // This method is a no-op since individual setters already write to NVS
-    // Kept for API compatibility with portal
+    if (!_inTransaction) {
+        return true;  // Setters outside a transaction are already committed
+    }
+    return commitTransaction();
+}
+
+// ============================================
+// TRANSACTIONS
+// ============================================
+
+void ConfigManager::beginTransaction() {
+    if (!_initialized && !begin()) return;
+    _inTransaction = true;
+    _txStartMicros = micros();
+}
+
+bool ConfigManager::commitTransaction() {
+    if (!_initialized && !begin()) return false;
+    _inTransaction = false;
+    return commitPending();
+}
+
+void ConfigManager::abortTransaction() {
+    if (!_initialized && !begin()) return;
+    _inTransaction = false;
+    if (_dirtyMask != 0) {
+        _dirtyMask = 0;
+        loadRecord();  // Restore the committed values
+    }
+}
+
+void ConfigManager::runHeapCheck(uint32_t cycles) {
+    if (!_initialized && !begin()) return;
+    
+    uint8_t buffer[CONFIG_RECORD_MAX_SIZE];
+    uint32_t freeBefore = ESP.getFreeHeap();
+    uint32_t largestBefore = ESP.getMaxAllocHeap();
+    unsigned long start = micros();
+    uint32_t failures = 0;
+    
+    for (uint32_t i = 0; i < cycles; i++) {
+        DeviceConfig copy = _config;                                      // loadConfig()
+        size_t length = encodeRecord(copy, buffer, sizeof(buffer));       // saveConfig()
+        if (length == 0 || !decodeRecord(buffer, length, copy)) {         // next boot
+            failures++;
+        }
+    }
+    
+    unsigned long elapsed = micros() - start;
+    uint32_t freeAfter = ESP.getFreeHeap();
+    uint32_t largestAfter = ESP.getMaxAllocHeap();
+    
+    LogBox::begin("Config Heap Check");
+    LogBox::linef("Cycles: %lu (%lu us, %lu failed)", (unsigned long)cycles,
+                  (unsigned long)elapsed, (unsigned long)failures);
+    LogBox::linef("DeviceConfig: %u bytes inline", (unsigned)sizeof(DeviceConfig));
+    LogBox::linef("Free heap: %lu -> %lu bytes", (unsigned long)freeBefore, (unsigned long)freeAfter);
+    LogBox::linef("Largest free block: %lu -> %lu bytes", (unsigned long)largestBefore, (unsigned long)largestAfter);
+    LogBox::end();
+}
+
+bool ConfigManager::inTransaction() const {
+    return _inTransaction;
+}
+
+const ConfigTransactionStats& ConfigManager::getLastTransactionStats() const {
+    return _lastTransaction;
+}
+
+bool ConfigManager::stageString(ConfigFieldId id, const char* value) {
+    const ConfigFieldInfo& field = kConfigFields[id];
+    if (value == nullptr) {
+        value = "";
+    }
+    if (strcmp(field.readString(_config), value) == 0) {
+        return true;
+    }
+    if (!field.writeString(_config, value, strlen(value))) {
+        LogBox::messagef("Config Error", "%s exceeds %u characters - not changed",
+                         field.name, (unsigned)field.maxLength);
+        return false;
+    }
+    markDirty(id);
+    return true;
+}
+
+void ConfigManager::stageBool(ConfigFieldId id, bool value) {
+    bool& current = _config.*(kConfigFields[id].boolMember);
+    if (current == value) {
+        return;
+    }
+    current = value;
+    markDirty(id);
+}
+
+void ConfigManager::markDirty(ConfigFieldId id) {
+    _dirtyMask |= 1UL << id;
+}
+
+bool ConfigManager::autoCommit() {
+    if (_inTransaction) {
+        return true;  // Written by commitTransaction()
+    }
+    _txStartMicros = micros();
+    return commitPending();
+}
+
+bool ConfigManager::commitPending() {
+    ConfigTransactionStats stats;
+    stats.fieldsChanged = countBits(_dirtyMask);
+    
+    bool success = true;
+    if (_dirtyMask != 0) {
+        NvsOpCounters start = _store.getCounters();
+        success = writeRecord(&stats);
+        if (success) {
+            _dirtyMask = 0;
+        }
+        logCost("commit", start, _txStartMicros);
+        if (stats.keysWritten > 0) {
+            NvsStore::flushWearCounters();
+        }
+    }
+    
+    stats.elapsedMicros = micros() - _txStartMicros;
+    _lastTransaction = stats;
+    return success;
+}
+
+ConfigStats ConfigManager::getStats() const {
+    ConfigStats stats = _stats;
+    const NvsOpCounters& counters = _store.getCounters();
+    stats.nvsReads = counters.reads;
+    stats.nvsWrites = counters.writes;
+    stats.nvsSkippedWrites = counters.skippedWrites;
+    stats.nvsErases = counters.erases;
+    stats.nvsEntriesWritten = counters.entriesWritten;
+    stats.nvsBytesRead = counters.bytesRead;
+    stats.nvsBytesWritten = counters.bytesWritten;
+    return stats;
+}
+
+// ============================================
+// CONFIG RECORD STORAGE
+// ============================================
+
+bool ConfigManager::loadRecord() {
+    _config = DeviceConfig();
+    
+    if (!openStorage()) {
+        return false;
+    }
+    
+    uint8_t* buffer = s_recordBuffer;
+    size_t length = _store.getBytesLength(PREF_CONFIG_RECORD);
+    
+    if (length == 0) {
+        // No record yet - either a fresh device or one configured by older firmware
+        return migrateLegacyKeys();
+    }
+    
+    if (length > sizeof(s_recordBuffer)) {
+        LogBox::linef("Config record too large (%u bytes) - ignoring", (unsigned)length);
+        return false;
+    }
+    
+    if (_store.getBytes(PREF_CONFIG_RECORD, buffer, length) != length ||
+        !decodeRecord(buffer, length, _config)) {
+        LogBox::line("Config record corrupt (CRC/format mismatch) - using defaults");
+        _config = DeviceConfig();
+        return false;
+    }
+    
+    _storedRecordLength = (uint16_t)length;
+    _storedRecordCRC = readLE32(buffer + 8);
+    return true;
+}
+
+bool ConfigManager::writeRecord(ConfigTransactionStats* txStats) {
+    uint8_t* buffer = s_recordBuffer;
+    size_t length = encodeRecord(_config, buffer, sizeof(s_recordBuffer));
+    if (length == 0) {
+        LogBox::message("Config Error", "Configuration too large to store");
+        return false;
+    }
+    
+    // Identical to what is already in flash (e.g. a value changed and changed back)
+    uint32_t crc = readLE32(buffer + 8);
+    if (length == _storedRecordLength && crc == _storedRecordCRC) {
+        return true;
+    }
+    
+    // Any change makes the RTC copy stale; the next NVS load refreshes it
+    invalidateSnapshot();
+    
+    if (!openStorage()) {
+        return false;
+    }
+    
+    if (_store.putBytes(PREF_CONFIG_RECORD, buffer, length) != length) {
+        LogBox::message("Config Error", "Failed to write configuration record");
+        return false;
+    }
+    
+    _storedRecordLength = (uint16_t)length;
+    _storedRecordCRC = crc;
+    if (txStats) {
+        txStats->keysWritten++;
+        txStats->bytesWritten += length;
+    }
+    
+    return true;
+}
+
+bool ConfigManager::migrateLegacyKeys() {
+    if (!_store.isKey(PREF_CONFIGURED) && !_store.isKey(PREF_WIFI_SSID)) {
+        return false;  // Fresh device - nothing to migrate
+    }
+    
+    for (uint8_t i = 0; i < CONFIG_FIELD_COUNT; i++) {
+        const ConfigFieldInfo& field = kConfigFields[i];
+        if (field.legacyKey == nullptr) {
+            continue;  // Added after the record format - never stored per key
+        }
+        if (field.type == CONFIG_TYPE_BOOL) {
+            _config.*(field.boolMember) = _store.getBool(field.legacyKey, false);
+        } else {
+            String value = _store.getString(field.legacyKey, "");
+            if (!field.writeString(_config, value.c_str(), value.length())) {
+                LogBox::messagef("Config Migration", "Dropped %s: longer than %u characters",
+                                 field.name, (unsigned)field.maxLength);
+            }
+        }
+    }
+    
+    // Only drop the old keys once the record is safely stored, so a power
+    // loss during migration simply repeats it on the next boot
+    if (!writeRecord()) {
+        return true;  // Config is usable from RAM; retry migration next boot
+    }
+    
+    for (uint8_t i = 0; i < CONFIG_FIELD_COUNT; i++) {
+        if (kConfigFields[i].legacyKey != nullptr) {
+            _store.remove(kConfigFields[i].legacyKey);
+        }
+    }
+    _stats.migrated = true;
+    
+    return true;
+}
+
+// ============================================
+// RTC SNAPSHOT
+// ============================================
+
+bool ConfigManager::restoreSnapshot() {
+    const ConfigSnapshot& snapshot = rtc_configSnapshot;
+    if (snapshot.magic != CONFIG_SNAPSHOT_MAGIC ||
+        snapshot.recordLength > sizeof(snapshot.record) ||
+        snapshot.crc != snapshotCRC(snapshot)) {
+        return false;
+    }
+    
+    DeviceConfig config;
+    if (!decodeRecord(snapshot.record, snapshot.recordLength, config)) {
+        return false;
+    }
+    
+    _config = config;
+    _storedRecordLength = snapshot.recordLength;
+    _storedRecordCRC = readLE32(snapshot.record + 8);
+    _channelLockState = snapshot.channelLockState;
+    _wifiChannel = snapshot.wifiChannel;
+    memcpy(_wifiBSSID, snapshot.wifiBSSID, sizeof(_wifiBSSID));
+    
+    return true;
+}
+
+void ConfigManager::storeSnapshot() {
+    ConfigSnapshot& snapshot = rtc_configSnapshot;
+    size_t length = encodeRecord(_config, snapshot.record, sizeof(snapshot.record));
+    if (length == 0) {
+        // Record larger than the RTC reserve - timer wakes keep using NVS
+        invalidateSnapshot();
+        return;
+    }
+    
+    snapshot.magic = CONFIG_SNAPSHOT_MAGIC;
+    snapshot.recordLength = (uint16_t)length;
+    snapshot.channelLockState = _channelLockState;
+    snapshot.wifiChannel = _wifiChannel;
+    memcpy(snapshot.wifiBSSID, _wifiBSSID, sizeof(snapshot.wifiBSSID));
+    snapshot.crc = snapshotCRC(snapshot);
+}
+
+void ConfigManager::storeSnapshotChannelLock() {
+    ConfigSnapshot& snapshot = rtc_configSnapshot;
+    if (snapshot.magic != CONFIG_SNAPSHOT_MAGIC || snapshot.crc != snapshotCRC(snapshot)) {
+        return;  // No valid snapshot to update
+    }
+    
+    snapshot.channelLockState = _channelLockState;
+    snapshot.wifiChannel = _wifiChannel;
+    memcpy(snapshot.wifiBSSID, _wifiBSSID, sizeof(snapshot.wifiBSSID));
+    snapshot.crc = snapshotCRC(snapshot);
+}
+
+void ConfigManager::invalidateSnapshot() {
+    rtc_configSnapshot.magic = 0;
+}
+
+size_t ConfigManager::encodeRecord(const DeviceConfig& config, uint8_t* buffer, size_t bufferSize) {
+    if (bufferSize < RECORD_HEADER_SIZE + 1) {
+        return 0;
+    }
+    
+    // Single pass over the field table: BOOL rows set flag bits, STRING rows
+    // are appended after the flags byte
+    size_t flagsPos = RECORD_HEADER_SIZE;
+    size_t pos = flagsPos + 1;
+    uint8_t flags = 0;
+    uint8_t flagBit = 0;
+    
+    for (uint8_t i = 0; i < CONFIG_FIELD_COUNT; i++) {
+        const ConfigFieldInfo& field = kConfigFields[i];
+        if (field.type == CONFIG_TYPE_BOOL) {
+            if (config.*(field.boolMember)) {
+                flags |= 1 << flagBit;
+            }
+            flagBit++;
+            continue;
+        }
+        
+        const char* value = field.readString(config);
+        size_t len = strlen(value);
+        if (len > 255 || pos + 1 + len > bufferSize) {
+            return 0;
+        }
+        buffer[pos++] = (uint8_t)len;
+        memcpy(buffer + pos, value, len);
+        pos += len;
+    }
+    
+    buffer[flagsPos] = flags;
+    size_t payloadSize = pos - RECORD_HEADER_SIZE;
+    writeLE32(buffer, CONFIG_RECORD_MAGIC);
+    buffer[4] = CONFIG_RECORD_VERSION;
+    buffer[5] = CONFIG_STRING_FIELD_COUNT;
+    writeLE16(buffer + 6, (uint16_t)payloadSize);
+    writeLE32(buffer + 8, esp_rom_crc32_le(0, buffer + RECORD_HEADER_SIZE, payloadSize));
+    
+    return pos;
+}
+
+bool ConfigManager::decodeRecord(const uint8_t* buffer, size_t length, DeviceConfig& config) {
+    if (length < RECORD_HEADER_SIZE + 1 || readLE32(buffer) != CONFIG_RECORD_MAGIC) {
+        return false;
+    }
+    
+    // Version 1 is the only layout so far; future versions convert here
+    if (buffer[4] != CONFIG_RECORD_VERSION) {
+        return false;
+    }
+    
+    uint8_t fieldCount = buffer[5];
+    size_t payloadSize = readLE16(buffer + 6);
+    if (RECORD_HEADER_SIZE + payloadSize != length) {
+        return false;
+    }
+    
+    const uint8_t* payload = buffer + RECORD_HEADER_SIZE;
+    if (esp_rom_crc32_le(0, payload, payloadSize) != readLE32(buffer + 8)) {
+        return false;
+    }
+    
+    size_t pos = 0;
+    uint8_t flags = payload[pos++];
+    uint8_t flagBit = 0;
+    uint8_t stringIndex = 0;
+    
+    // Records written by older firmware carry fewer strings - newer fields
+    // keep their defaults. Extra strings written by newer firmware are ignored.
+    for (uint8_t i = 0; i < CONFIG_FIELD_COUNT; i++) {
+        const ConfigFieldInfo& field = kConfigFields[i];
+        if (field.type == CONFIG_TYPE_BOOL) {
+            config.*(field.boolMember) = (flags & (1 << flagBit)) != 0;
+            flagBit++;
+            continue;
+        }
+        
+        if (stringIndex++ >= fieldCount) {
+            continue;
+        }
+        if (pos >= payloadSize) {
+            return false;
+        }
+        size_t len = payload[pos++];
+        if (pos + len > payloadSize) {
+            return false;
+        }
+        // A value beyond the field's capacity can only come from a record
+        // written with a larger maxLength - reject it like a corrupt record
+        if (!field.writeString(config, (const char*)(payload + pos), len)) {
+            return false;
+        }
+        pos += len;
+    }
+    
     return true;
 }
@@ -2,8 +2,39 @@
 #define CONFIG_MANAGER_H
 
 #include <Arduino.h>
-#include <Preferences.h>
 #include "config.h"
+#include "config_schema.h"
+#include "nvs_store.h"
+
+// NVS access statistics for the configuration path. The nvs* counters
+// are running totals of the manager's NvsStore since it was constructed
+// (the whole boot for the global instance; not reset by begin()); the
+// load fields describe the last begin()
+struct ConfigStats {
+    uint16_t nvsReads;       // NVS get/isKey calls
+    uint16_t nvsWrites;      // NVS put/remove/clear calls that reached flash
+    uint16_t nvsSkippedWrites;  // Writes skipped because the stored value was identical
+    uint16_t nvsErases;      // remove/clear calls that reached flash
+    uint16_t nvsEntriesWritten;  // 32-byte NVS entries appended (flash wear)
+    uint32_t nvsBytesRead;
+    uint32_t nvsBytesWritten;
+    uint32_t loadMicros;     // Time spent in begin() loading the record
+    bool migrated;           // Legacy per-key settings were converted this boot
+    bool fromSnapshot;       // Config was restored from the RTC snapshot (no NVS access)
+    
+    ConfigStats() : nvsReads(0), nvsWrites(0), nvsSkippedWrites(0), nvsErases(0), nvsEntriesWritten(0),
+                    nvsBytesRead(0), nvsBytesWritten(0), loadMicros(0), migrated(false), fromSnapshot(false) {}
+};
+
+// Result of the most recent config commit (transaction or single setter)
+struct ConfigTransactionStats {
+    uint8_t fieldsChanged;   // Settings whose value actually changed
+    uint8_t keysWritten;     // NVS keys written (0 when nothing changed)
+    uint16_t bytesWritten;   // Bytes written to NVS
+    uint32_t elapsedMicros;  // From beginTransaction() (or the setter) to commit
+    
+    ConfigTransactionStats() : fieldsChanged(0), keysWritten(0), bytesWritten(0), elapsedMicros(0) {}
+};
 
 class ConfigManager {
 public:
@@ -11,7 +42,9 @@ public:
     ~ConfigManager();
     
     // Initialize the configuration manager
-    bool begin();
+    // useRtcSnapshot: serve config from the RTC memory snapshot taken on an
+    // earlier boot (pass true for timer wakes); falls back to NVS if invalid
+    bool begin(bool useRtcSnapshot = false);
     
     // Check if device has been configured
     bool isConfigured();
@@ -22,42 +55,63 @@ public:
     // Load configuration from storage
     bool loadConfig(DeviceConfig& config);
     
+    // Cached configuration (no copy) - use for fields without a dedicated getter
+    const DeviceConfig& getConfig();
+    
     // Save configuration to storage
     bool saveConfig(const DeviceConfig& config);
     
     // Clear all configuration (factory reset)
     void clearConfig();
     
-    // Individual getters
-    String getWiFiSSID();
-    String getWiFiPassword();
-    String getFriendlyName();
-    String getMQTTBroker();
-    String getMQTTUsername();
-    String getMQTTPassword();
+    // Individual getters (point into the cached config - valid until the
+    // next setter call; copy into a String if you need to keep it)
+    const char* getWiFiSSID();
+    const char* getWiFiPassword();
+    const char* getFriendlyName();
+    const char* getMQTTBroker();
+    const char* getMQTTUsername();
+    const char* getMQTTPassword();
     bool getDebugMode();
     
     // Static IP getters
     bool getUseStaticIP();
-    String getStaticIP();
-    String getGateway();
-    String getSubnet();
-    String getPrimaryDNS();
-    String getSecondaryDNS();
+    const char* getStaticIP();
+    const char* getGateway();
+    const char* getSubnet();
+    const char* getPrimaryDNS();
+    const char* getSecondaryDNS();
     
     // Individual setters
-    void setWiFiCredentials(const String& ssid, const String& password);
-    void setFriendlyName(const String& name);
-    void setMQTTConfig(const String& broker, const String& username, const String& password);
+    // String values longer than the field's maxLength are rejected (logged,
+    // stored value kept) - setField() reports this by returning false
+    void setWiFiCredentials(const char* ssid, const char* password);
+    void setFriendlyName(const char* name);
+    void setMQTTConfig(const char* broker, const char* username, const char* password);
     void setDebugMode(bool enabled);
     void setConfigured(bool configured);  // Mark device as configured
     
     // Static IP setters
     void setUseStaticIP(bool enabled);
-    void setStaticIPConfig(const String& ip, const String& gw, 
-                          const String& sn, const String& dns1, const String& dns2);
+    void setStaticIPConfig(const char* ip, const char* gw, 
+                          const char* sn, const char* dns1, const char* dns2);
+    
+    // Generic setters for any DEVICE_CONFIG_FIELDS row (custom fields need no
+    // dedicated setter), e.g. setField(CONFIG_ID_myField, value)
+    bool setField(ConfigFieldId id, const char* value);
+    bool setField(ConfigFieldId id, bool value);
+    
+    // Transactions: setters called between beginTransaction() and
+    // commitTransaction() are staged in RAM and written with a single NVS
+    // commit. Outside a transaction every setter commits immediately.
+    // Unchanged values are never written.
+    void beginTransaction();
+    bool commitTransaction();
+    void abortTransaction();  // Discard staged changes (reloads stored record)
+    bool inTransaction() const;
+    const ConfigTransactionStats& getLastTransactionStats() const;
     
-    // Simplified save method (saves current state)
+    // Commit pending changes (ends an open transaction, no-op otherwise)
     bool saveConfig();
     
     // WiFi channel locking (for fast reconnection)
@@ -71,13 +125,76 @@ public:
     // Returns true if sanitization successful, false if input completely invalid
     // Rules: lowercase a-z, digits 0-9, hyphens; max 24 chars; no leading/trailing hyphens
     static bool sanitizeFriendlyName(const String& input, String& output);
+    // Heap-free variant; output needs room for FRIENDLY_NAME_MAX_LENGTH + 1
+    static bool sanitizeFriendlyName(const char* input, char* output, size_t outputSize);
     
     // Mark device as configured
     void markAsConfigured();
     
+    // NVS access totals of this instance and the last load
+    ConfigStats getStats() const;
+    
+    // Diagnostic: run `cycles` simulated load/save round trips (config copy,
+    // record encode + decode - RAM only) and log free heap and largest free
+    // block before and after. Enabled at boot by CONFIG_HEAP_CHECK_CYCLES.
+    void runHeapCheck(uint32_t cycles);
+    
 private:
-    Preferences _preferences;
+    NvsStore _store;
     bool _initialized;
+    bool _storageOpen;     // NVS opened lazily (snapshot boots may never need it)
+    DeviceConfig _config;  // Cached copy of the stored record (getters never touch NVS)
+    ConfigStats _stats;
+    
+    // Write coalescing / dirty tracking
+    bool _inTransaction;
+    uint32_t _dirtyMask;          // Bit per field changed since last commit
+    unsigned long _txStartMicros;
+    uint16_t _storedRecordLength; // Identity of the record currently in NVS
+    uint32_t _storedRecordCRC;
+    ConfigTransactionStats _lastTransaction;
+    
+    // Cached WiFi channel lock (mirrored in the RTC snapshot)
+    uint8_t _channelLockState;  // CHANNEL_LOCK_* in config_manager.cpp
+    uint8_t _wifiChannel;
+    uint8_t _wifiBSSID[6];
+    
+    // Open the NVS namespace on first use
+    bool openStorage();
+    
+    // Log the NVS cost of a config operation since `start`/`startMicros`
+    void logCost(const char* operation, const NvsOpCounters& start, unsigned long startMicros) const;
+    
+    // Read channel lock keys into the cache if not known yet
+    void loadChannelLock();
+    
+    // RTC snapshot of _config + channel lock for timer wakes
+    bool restoreSnapshot();
+    void storeSnapshot();
+    void storeSnapshotChannelLock();
+    static void invalidateSnapshot();
+    
+    // Read the config record into _config (migrates legacy keys if needed)
+    bool loadRecord();
+    
+    // Write _config to NVS as a single blob (skipped if identical to stored)
+    bool writeRecord(ConfigTransactionStats* txStats = nullptr);
+    
+    // Stage a field change (marks it dirty only if the value differs)
+    bool stageString(ConfigFieldId id, const char* value);
+    void stageBool(ConfigFieldId id, bool value);
+    void markDirty(ConfigFieldId id);
+    
+    // Commit staged changes unless a transaction is open
+    bool autoCommit();
+    bool commitPending();
+    
+    // Convert per-key settings written by older firmware into a record
+    bool migrateLegacyKeys();
+    
+    // Record (de)serialization
+    static size_t encodeRecord(const DeviceConfig& config, uint8_t* buffer, size_t bufferSize);
+    static bool decodeRecord(const uint8_t* buffer, size_t length, DeviceConfig& config);
 };
 
 #endif // CONFIG_MANAGER_H
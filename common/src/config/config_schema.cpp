@@ -0,0 +1,396 @@
+#include "config_schema.h"
+#include <IPAddress.h>
+
+// ============================================
+// GENERATED FIELD TABLE
+// ============================================
+// Captureless lambdas give each STRING row a typed accessor for its own
+// FixedString<N>; they decay to plain function pointers in the flash table
+#define CONFIG_FIELD_READ_STRING(member) [](const DeviceConfig& c) { return c.member.c_str(); }
+#define CONFIG_FIELD_READ_BOOL(member) nullptr
+#define CONFIG_FIELD_WRITE_STRING(member) [](DeviceConfig& c, const char* v, size_t n) { return c.member.assign(v, n); }
+#define CONFIG_FIELD_WRITE_BOOL(member) nullptr
+#define CONFIG_FIELD_BOOL_PTR_STRING(member) nullptr
+#define CONFIG_FIELD_BOOL_PTR_BOOL(member) &DeviceConfig::member
+
+#define CONFIG_FIELD_INFO(type, member, legacyKey, name, label, section, maxLength, flags, placeholder) \
+    { CONFIG_TYPE_##type, CONFIG_FIELD_READ_##type(member), CONFIG_FIELD_WRITE_##type(member), \
+      CONFIG_FIELD_BOOL_PTR_##type(member), legacyKey, name, label, section, maxLength, flags, placeholder },
+
+const ConfigFieldInfo kConfigFields[CONFIG_FIELD_COUNT] = {
+    DEVICE_CONFIG_FIELDS(CONFIG_FIELD_INFO)
+};
+
+static const char* const kSectionTitles[CONFIG_SECTION_COUNT] = {
+    "",
+    "WiFi Settings",
+    "Device Settings",
+    "Network Settings",
+    "MQTT Settings (Optional)",
+    "Advanced"
+};
+
+const char* configSectionTitle(uint8_t section) {
+    return section < CONFIG_SECTION_COUNT ? kSectionTitles[section] : "";
+}
+
+int configFieldIndex(const char* name) {
+    for (uint8_t i = 0; i < CONFIG_FIELD_COUNT; i++) {
+        if (strcmp(kConfigFields[i].name, name) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+// ============================================
+// JSON SERIALIZATION
+// ============================================
+
+// Bounded appender - sets overflow instead of writing past the end
+struct JsonWriter {
+    char* buffer;
+    size_t size;
+    size_t pos;
+    bool overflow;
+    
+    void put(char c) {
+        if (pos + 1 < size) {
+            buffer[pos++] = c;
+        } else {
+            overflow = true;
+        }
+    }
+    
+    void puts(const char* s) {
+        while (*s) {
+            put(*s++);
+        }
+    }
+    
+    void putEscaped(const char* s, size_t len) {
+        static const char hex[] = "0123456789abcdef";
+        for (size_t i = 0; i < len; i++) {
+            char c = s[i];
+            if (c == '"' || c == '\\') {
+                put('\\');
+                put(c);
+            } else if ((uint8_t)c < 0x20) {
+                puts("\\u00");
+                put(hex[(c >> 4) & 0x0F]);
+                put(hex[c & 0x0F]);
+            } else {
+                put(c);
+            }
+        }
+    }
+};
+
+size_t configToJSON(const DeviceConfig& config, char* buffer, size_t bufferSize, bool includeSecrets) {
+    if (bufferSize == 0) {
+        return 0;
+    }
+    
+    JsonWriter out = { buffer, bufferSize, 0, false };
+    out.put('{');
+    
+    bool first = true;
+    for (uint8_t i = 0; i < CONFIG_FIELD_COUNT; i++) {
+        const ConfigFieldInfo& field = kConfigFields[i];
+        if ((field.flags & CONFIG_FIELD_SECRET) && !includeSecrets) {
+            continue;
+        }
+        
+        if (!first) {
+            out.put(',');
+        }
+        first = false;
+        
+        out.put('"');
+        out.puts(field.name);
+        out.puts("\":");
+        if (field.type == CONFIG_TYPE_BOOL) {
+            out.puts(config.*(field.boolMember) ? "true" : "false");
+        } else {
+            const char* value = field.readString(config);
+            out.put('"');
+            out.putEscaped(value, strlen(value));
+            out.put('"');
+        }
+    }
+    
+    out.put('}');
+    buffer[out.pos] = '\0';
+    
+    return out.overflow ? 0 : out.pos;
+}
+
+size_t configJSONMaxSize() {
+    size_t size = 3;  // Braces + terminator
+    for (uint8_t i = 0; i < CONFIG_FIELD_COUNT; i++) {
+        const ConfigFieldInfo& field = kConfigFields[i];
+        size += strlen(field.name) + 4;  // "name": plus comma
+        size += (field.type == CONFIG_TYPE_BOOL) ? 5 : 2 + 6 * (size_t)field.maxLength;
+    }
+    return size;
+}
+
+// ============================================
+// JSON IMPORT
+// ============================================
+
+// Cursor over a JSON document - only what configToJSON produces is needed:
+// one flat object of string and boolean values
+struct JsonReader {
+    const char* p;
+    const char* end;
+    
+    void skipSpace() {
+        while (p < end && (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n')) {
+            p++;
+        }
+    }
+    
+    bool consume(char c) {
+        skipSpace();
+        if (p < end && *p == c) {
+            p++;
+            return true;
+        }
+        return false;
+    }
+    
+    bool consumeLiteral(const char* literal) {
+        size_t len = strlen(literal);
+        if ((size_t)(end - p) < len || strncmp(p, literal, len) != 0) {
+            return false;
+        }
+        p += len;
+        return true;
+    }
+    
+    static int hexValue(char c) {
+        if (c >= '0' && c <= '9') return c - '0';
+        if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+        if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+        return -1;
+    }
+    
+    bool readHex4(uint32_t& value) {
+        if (end - p < 4) {
+            return false;
+        }
+        value = 0;
+        for (int i = 0; i < 4; i++) {
+            int digit = hexValue(*p++);
+            if (digit < 0) {
+                return false;
+            }
+            value = (value << 4) | digit;
+        }
+        return true;
+    }
+    
+    // Decode a string into out (UTF-8, NUL terminated). Returns the decoded
+    // length, or -1 on a syntax error / -2 if it does not fit in capacity.
+    int readString(char* out, size_t capacity) {
+        skipSpace();
+        if (p >= end || *p != '"') {
+            return -1;
+        }
+        p++;
+        
+        size_t len = 0;
+        while (p < end && *p != '"') {
+            uint32_t cp = (uint8_t)*p++;
+            if (cp < 0x20) {
+                return -1;  // Raw control characters are not valid JSON
+            }
+            if (cp == '\\') {
+                if (p >= end) {
+                    return -1;
+                }
+                char esc = *p++;
+                switch (esc) {
+                    case '"': case '\\': case '/': cp = esc; break;
+                    case 'b': cp = '\b'; break;
+                    case 'f': cp = '\f'; break;
+                    case 'n': cp = '\n'; break;
+                    case 'r': cp = '\r'; break;
+                    case 't': cp = '\t'; break;
+                    case 'u': {
+                        if (!readHex4(cp)) {
+                            return -1;
+                        }
+                        if (cp >= 0xD800 && cp <= 0xDBFF) {
+                            uint32_t low;
+                            if (!consumeLiteral("\\u") || !readHex4(low) || low < 0xDC00 || low > 0xDFFF) {
+                                return -1;
+                            }
+                            cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+                        }
+                        break;
+                    }
+                    default:
+                        return -1;
+                }
+                
+                // Re-encode escaped code points as UTF-8
+                uint8_t bytes[4];
+                size_t count;
+                if (cp < 0x80) {
+                    bytes[0] = cp;
+                    count = 1;
+                } else if (cp < 0x800) {
+                    bytes[0] = 0xC0 | (cp >> 6);
+                    bytes[1] = 0x80 | (cp & 0x3F);
+                    count = 2;
+                } else if (cp < 0x10000) {
+                    bytes[0] = 0xE0 | (cp >> 12);
+                    bytes[1] = 0x80 | ((cp >> 6) & 0x3F);
+                    bytes[2] = 0x80 | (cp & 0x3F);
+                    count = 3;
+                } else {
+                    bytes[0] = 0xF0 | (cp >> 18);
+                    bytes[1] = 0x80 | ((cp >> 12) & 0x3F);
+                    bytes[2] = 0x80 | ((cp >> 6) & 0x3F);
+                    bytes[3] = 0x80 | (cp & 0x3F);
+                    count = 4;
+                }
+                if (len + count > capacity) {
+                    return -2;
+                }
+                memcpy(out + len, bytes, count);
+                len += count;
+                continue;
+            }
+            
+            if (len + 1 > capacity) {
+                return -2;
+            }
+            out[len++] = (char)cp;
+        }
+        
+        if (p >= end) {
+            return -1;  // Unterminated string
+        }
+        p++;
+        out[len] = '\0';
+        return (int)len;
+    }
+};
+
+bool configFromJSON(const char* json, size_t length, DeviceConfig& config,
+                    uint32_t& presentMask, String& error) {
+    JsonReader in = { json, json + length };
+    presentMask = 0;
+    
+    if (!in.consume('{')) {
+        error = "Expected a JSON object";
+        return false;
+    }
+    if (in.consume('}')) {
+        in.skipSpace();
+        if (in.p != in.end) {
+            error = "Unexpected data after JSON object";
+            return false;
+        }
+        return true;
+    }
+    
+    char key[32];
+    char value[256];  // Longest possible maxLength
+    do {
+        int keyLength = in.readString(key, sizeof(key) - 1);
+        if (keyLength < 0) {
+            error = keyLength == -2 ? "Unknown field" : "Expected a field name";
+            return false;
+        }
+        int index = configFieldIndex(key);
+        if (index < 0) {
+            error = "Unknown field: " + String(key);
+            return false;
+        }
+        if (!in.consume(':')) {
+            error = "Expected ':' after " + String(key);
+            return false;
+        }
+        
+        const ConfigFieldInfo& field = kConfigFields[index];
+        in.skipSpace();
+        if (field.type == CONFIG_TYPE_BOOL) {
+            if (in.consumeLiteral("true")) {
+                config.*(field.boolMember) = true;
+            } else if (in.consumeLiteral("false")) {
+                config.*(field.boolMember) = false;
+            } else {
+                error = String(field.name) + " must be true or false";
+                return false;
+            }
+        } else {
+            int valueLength = in.readString(value, field.maxLength);
+            if (valueLength == -2) {
+                error = String(field.label) + " is too long (max " + String(field.maxLength) + " characters)";
+                return false;
+            }
+            if (valueLength < 0) {
+                error = String(field.name) + " must be a string";
+                return false;
+            }
+            field.writeString(config, value, valueLength);
+        }
+        presentMask |= 1UL << index;
+    } while (in.consume(','));
+    
+    if (!in.consume('}')) {
+        error = "Expected ',' or '}'";
+        return false;
+    }
+    in.skipSpace();
+    if (in.p != in.end) {
+        error = "Unexpected data after JSON object";
+        return false;
+    }
+    
+    return true;
+}
+
+// ============================================
+// VALIDATION
+// ============================================
+
+bool configValidateField(const ConfigFieldInfo& field, const char* value, String& error) {
+    size_t length = strlen(value);
+    if (length == 0) {
+        if (field.flags & CONFIG_FIELD_REQUIRED) {
+            error = String(field.label) + " is required";
+            return false;
+        }
+        return true;
+    }
+    
+    if (length > field.maxLength) {
+        error = String(field.label) + " is too long (max " + String(field.maxLength) + " characters)";
+        return false;
+    }
+    
+    IPAddress addr;
+    if ((field.flags & CONFIG_FIELD_IPV4) && !addr.fromString(value)) {
+        error = "Invalid " + String(field.label);
+        return false;
+    }
+    
+    return true;
+}
+
+bool configFieldEnabled(const DeviceConfig& config, uint8_t index) {
+    // A TOGGLE row earlier in the same section controls the rest of it
+    uint8_t section = kConfigFields[index].section;
+    for (uint8_t i = 0; i < index; i++) {
+        const ConfigFieldInfo& field = kConfigFields[i];
+        if (field.section == section && (field.flags & CONFIG_FIELD_TOGGLE)) {
+            return config.*(field.boolMember);
+        }
+    }
+    return true;
+}
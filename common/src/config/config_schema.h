@@ -0,0 +1,79 @@
+#ifndef CONFIG_SCHEMA_H
+#define CONFIG_SCHEMA_H
+
+#include <Arduino.h>
+#include "config.h"
+
+// Field type (column 1 of DEVICE_CONFIG_FIELDS)
+enum ConfigFieldType : uint8_t {
+    CONFIG_TYPE_STRING,
+    CONFIG_TYPE_BOOL
+};
+
+// One row of DEVICE_CONFIG_FIELDS
+struct ConfigFieldInfo {
+    ConfigFieldType type;
+    // STRING accessors (each row has its own FixedString capacity)
+    const char* (*readString)(const DeviceConfig& config);
+    bool (*writeString)(DeviceConfig& config, const char* value, size_t length);  // false if too long
+    bool DeviceConfig::* boolMember;  // Set for CONFIG_TYPE_BOOL
+    const char* legacyKey;
+    const char* name;
+    const char* label;
+    uint8_t section;
+    uint8_t maxLength;
+    uint8_t flags;
+    const char* placeholder;
+};
+
+// Compile-time field indices: CONFIG_ID_<member>
+#define CONFIG_FIELD_ID(type, member, ...) CONFIG_ID_##member,
+enum ConfigFieldId : uint8_t {
+    DEVICE_CONFIG_FIELDS(CONFIG_FIELD_ID)
+    CONFIG_ID_COUNT
+};
+
+static constexpr uint8_t CONFIG_FIELD_COUNT = CONFIG_ID_COUNT;
+
+#define CONFIG_FIELD_COUNT_BOOL_STRING 0
+#define CONFIG_FIELD_COUNT_BOOL_BOOL 1
+#define CONFIG_FIELD_COUNT_BOOL_ROW(type, ...) + CONFIG_FIELD_COUNT_BOOL_##type
+static constexpr uint8_t CONFIG_BOOL_FIELD_COUNT = 0 DEVICE_CONFIG_FIELDS(CONFIG_FIELD_COUNT_BOOL_ROW);
+
+static constexpr uint8_t CONFIG_STRING_FIELD_COUNT = CONFIG_FIELD_COUNT - CONFIG_BOOL_FIELD_COUNT;
+
+static_assert(CONFIG_FIELD_COUNT <= 32, "Config field table exceeds the 32-bit dirty mask");
+static_assert(CONFIG_BOOL_FIELD_COUNT <= 8, "Config record packs BOOL fields into one flags byte");
+
+// The generated table, in storage order
+extern const ConfigFieldInfo kConfigFields[CONFIG_FIELD_COUNT];
+
+// Portal heading for a CONFIG_SECTION_* value
+const char* configSectionTitle(uint8_t section);
+
+// Index of a field in kConfigFields by form/JSON name (-1 if not found)
+int configFieldIndex(const char* name);
+
+// Write config as a flat JSON object ({"ssid":"...","useStaticIP":true,...})
+// into buffer without heap allocation. SECRET fields are omitted unless
+// includeSecrets. Returns the length written, or 0 if the buffer is too small.
+size_t configToJSON(const DeviceConfig& config, char* buffer, size_t bufferSize, bool includeSecrets);
+
+// Upper bound for configToJSON output with every field at maxLength
+// (each character escaped) - size buffers with this
+size_t configJSONMaxSize();
+
+// Parse a flat JSON object in configToJSON format into config. Only keys
+// present in the document are changed, and their kConfigFields bits are set
+// in presentMask. Unknown keys, wrong value types and values longer than
+// maxLength are errors (config may then be partially updated).
+bool configFromJSON(const char* json, size_t length, DeviceConfig& config,
+                    uint32_t& presentMask, String& error);
+
+// Check a STRING value against its row (required, maxLength, IPv4)
+bool configValidateField(const ConfigFieldInfo& field, const char* value, String& error);
+
+// False for fields in a section whose TOGGLE row is off in config
+bool configFieldEnabled(const DeviceConfig& config, uint8_t index);
+
+#endif // CONFIG_SCHEMA_H
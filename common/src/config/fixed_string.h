@@ -0,0 +1,58 @@
+#ifndef FIXED_STRING_H
+#define FIXED_STRING_H
+
+#include <Arduino.h>
+
+/**
+ * FixedString<N> - Inline, fixed-capacity string (no heap)
+ *
+ * Holds up to N characters plus terminator directly in the object, so a
+ * DeviceConfig copy is a plain memcpy instead of one allocation per field.
+ * Values longer than N are rejected (assign() returns false and leaves the
+ * current value untouched) rather than silently truncated - a cut-off
+ * password or broker URL is worse than a clear error.
+ */
+template <size_t N>
+class FixedString {
+public:
+    static_assert(N > 0 && N <= 255, "FixedString capacity must fit the u8 record length");
+    
+    FixedString() : _length(0) {
+        _data[0] = '\0';
+    }
+    
+    bool assign(const char* value, size_t length) {
+        if (length > N) {
+            return false;
+        }
+        memcpy(_data, value, length);
+        _data[length] = '\0';
+        _length = (uint8_t)length;
+        return true;
+    }
+    
+    bool assign(const char* value) {
+        return assign(value, strlen(value));
+    }
+    
+    void clear() {
+        _length = 0;
+        _data[0] = '\0';
+    }
+    
+    bool equals(const char* value) const {
+        return strcmp(_data, value) == 0;
+    }
+    
+    const char* c_str() const { return _data; }
+    operator const char*() const { return _data; }
+    size_t length() const { return _length; }
+    bool isEmpty() const { return _length == 0; }
+    static constexpr size_t capacity() { return N; }
+
+private:
+    uint8_t _length;
+    char _data[N + 1];
+};
+
+#endif // FIXED_STRING_H
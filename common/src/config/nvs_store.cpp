@@ -0,0 +1,302 @@
+#include "nvs_store.h"
+#include "logger.h"
+#include <esp_rom_crc.h>
+#include <stddef.h>
+
+// ============================================
+// WEAR COUNTER TABLE
+// ============================================
+#define NVS_WEAR_MAGIC 0x32414557UL  // "WEA2" (u16 counters)
+
+struct WearEntry {
+    char key[16];     // NVS keys are at most 15 characters
+    uint16_t writes;  // Saturates at 65535
+};
+
+struct WearTable {
+    uint32_t magic;
+    uint16_t count;
+    uint16_t unflushed;    // Writes counted since the last NVS flush
+    uint32_t otherWrites;  // Writes of keys evicted from the table
+    WearEntry entries[NVS_WEAR_MAX_KEYS];
+    uint32_t crc;          // Over all fields above
+};
+
+static RTC_DATA_ATTR WearTable rtc_wearTable;
+static bool s_wearTableReady = false;
+
+static uint32_t wearTableCRC(const WearTable& table) {
+    return esp_rom_crc32_le(0, (const uint8_t*)&table, offsetof(WearTable, crc));
+}
+
+static bool wearTableValid(const WearTable& table) {
+    return table.magic == NVS_WEAR_MAGIC && table.count <= NVS_WEAR_MAX_KEYS &&
+           table.crc == wearTableCRC(table);
+}
+
+// RTC copy survives deep sleep; after a cold boot reload the persisted copy
+static WearTable& wearTable() {
+    if (s_wearTableReady) {
+        return rtc_wearTable;
+    }
+    s_wearTableReady = true;
+    
+    if (wearTableValid(rtc_wearTable)) {
+        return rtc_wearTable;
+    }
+    
+    memset(&rtc_wearTable, 0, sizeof(rtc_wearTable));
+    Preferences prefs;
+    if (prefs.begin(NVS_WEAR_NAMESPACE, true)) {
+        WearTable stored;
+        if (prefs.getBytes(NVS_WEAR_KEY, &stored, sizeof(stored)) == sizeof(stored) &&
+            wearTableValid(stored)) {
+            rtc_wearTable = stored;
+        }
+        prefs.end();
+    }
+    
+    rtc_wearTable.magic = NVS_WEAR_MAGIC;
+    rtc_wearTable.unflushed = 0;
+    rtc_wearTable.crc = wearTableCRC(rtc_wearTable);
+    return rtc_wearTable;
+}
+
+static void countWrite(WearEntry& entry) {
+    if (entry.writes < UINT16_MAX) {
+        entry.writes++;
+    }
+}
+
+static WearEntry* findOrAddEntry(WearTable& table, const char* key) {
+    for (uint16_t i = 0; i < table.count; i++) {
+        if (strncmp(table.entries[i].key, key, sizeof(table.entries[i].key)) == 0) {
+            return &table.entries[i];
+        }
+    }
+    
+    WearEntry* entry;
+    if (table.count < NVS_WEAR_MAX_KEYS) {
+        entry = &table.entries[table.count++];
+    } else {
+        // Table full - one-off writes (e.g. removing migrated keys) make
+        // room for keys that keep being written
+        entry = &table.entries[0];
+        for (uint16_t i = 1; i < table.count; i++) {
+            if (table.entries[i].writes < entry->writes) {
+                entry = &table.entries[i];
+            }
+        }
+        table.otherWrites += entry->writes;
+    }
+    strncpy(entry->key, key, sizeof(entry->key) - 1);
+    entry->key[sizeof(entry->key) - 1] = '\0';
+    entry->writes = 0;
+    return entry;
+}
+
+NvsStore::NvsStore() : _open(false) {
+}
+
+bool NvsStore::begin(const char* name, bool readOnly) {
+    if (_open) {
+        _preferences.end();
+    }
+    _open = _preferences.begin(name, readOnly);
+    return _open;
+}
+
+void NvsStore::end() {
+    if (_open) {
+        _preferences.end();
+        _open = false;
+    }
+}
+
+bool NvsStore::isOpen() const {
+    return _open;
+}
+
+// Reads
+
+bool NvsStore::isKey(const char* key) {
+    _counters.reads++;
+    return _preferences.isKey(key);
+}
+
+uint8_t NvsStore::getUChar(const char* key, uint8_t defaultValue) {
+    _counters.reads++;
+    _counters.bytesRead += sizeof(uint8_t);
+    return _preferences.getUChar(key, defaultValue);
+}
+
+bool NvsStore::getBool(const char* key, bool defaultValue) {
+    _counters.reads++;
+    _counters.bytesRead += sizeof(uint8_t);
+    return _preferences.getBool(key, defaultValue);
+}
+
+String NvsStore::getString(const char* key, const String& defaultValue) {
+    _counters.reads++;
+    String value = _preferences.getString(key, defaultValue);
+    _counters.bytesRead += value.length();
+    return value;
+}
+
+size_t NvsStore::getBytesLength(const char* key) {
+    _counters.reads++;
+    return _preferences.getBytesLength(key);
+}
+
+size_t NvsStore::getBytes(const char* key, void* buffer, size_t maxLength) {
+    _counters.reads++;
+    size_t length = _preferences.getBytes(key, buffer, maxLength);
+    _counters.bytesRead += length;
+    return length;
+}
+
+// Writes
+
+size_t NvsStore::putUChar(const char* key, uint8_t value) {
+    if (isKey(key) && getUChar(key, (uint8_t)~value) == value) {
+        _counters.skippedWrites++;
+        return sizeof(value);
+    }
+    
+    size_t written = _preferences.putUChar(key, value);
+    recordWrite(key, written, entrySpan(0));
+    return written;
+}
+
+size_t NvsStore::putBool(const char* key, bool value) {
+    if (isKey(key) && getBool(key, !value) == value) {
+        _counters.skippedWrites++;
+        return sizeof(value);
+    }
+    
+    size_t written = _preferences.putBool(key, value);
+    recordWrite(key, written, entrySpan(0));
+    return written;
+}
+
+size_t NvsStore::putBytes(const char* key, const void* value, size_t length) {
+    if (length <= NVS_COMPARE_MAX_BYTES && getBytesLength(key) == length) {
+        uint8_t stored[NVS_COMPARE_MAX_BYTES];
+        if (getBytes(key, stored, length) == length && memcmp(stored, value, length) == 0) {
+            _counters.skippedWrites++;
+            return length;
+        }
+    }
+    
+    size_t written = _preferences.putBytes(key, value, length);
+    recordWrite(key, written, entrySpan(length));
+    return written;
+}
+
+bool NvsStore::remove(const char* key) {
+    if (!isKey(key)) {
+        _counters.skippedWrites++;
+        return true;
+    }
+    
+    bool removed = _preferences.remove(key);
+    recordErase(key);
+    return removed;
+}
+
+bool NvsStore::clear() {
+    _counters.writes++;
+    _counters.erases++;
+    return _preferences.clear();
+}
+
+const NvsOpCounters& NvsStore::getCounters() const {
+    return _counters;
+}
+
+uint16_t NvsStore::entrySpan(size_t length) {
+    if (length == 0) {
+        return 1;
+    }
+    return 2 + (length + NVS_ENTRY_SIZE - 1) / NVS_ENTRY_SIZE;
+}
+
+void NvsStore::recordWrite(const char* key, size_t bytes, uint16_t entries) {
+    _counters.bytesWritten += bytes;
+    _counters.entriesWritten += entries;
+    countFlashWrite(key);
+}
+
+// Erasing an entry appends nothing, but flipping its state bits is still a
+// flash write
+void NvsStore::recordErase(const char* key) {
+    _counters.erases++;
+    countFlashWrite(key);
+}
+
+void NvsStore::countFlashWrite(const char* key) {
+    _counters.writes++;
+    
+    WearTable& table = wearTable();
+    countWrite(*findOrAddEntry(table, key));
+    if (table.unflushed < UINT16_MAX) {
+        table.unflushed++;
+    }
+    table.crc = wearTableCRC(table);
+}
+
+// Wear counters
+
+uint32_t NvsStore::getTotalWrites() {
+    const WearTable& table = wearTable();
+    uint32_t total = table.otherWrites;
+    for (uint16_t i = 0; i < table.count; i++) {
+        total += table.entries[i].writes;
+    }
+    return total;
+}
+
+size_t NvsStore::getWearJSON(char* buffer, size_t bufferSize) {
+    const WearTable& table = wearTable();
+    if (bufferSize < 3) {
+        return 0;
+    }
+    size_t length = 0;
+    buffer[length++] = '{';
+    for (uint16_t i = 0; i <= table.count; i++) {
+        bool other = i == table.count;
+        if (other && table.otherWrites == 0) {
+            break;
+        }
+        int n = snprintf(buffer + length, bufferSize - length, "%s\"%.15s\":%lu", length > 1 ? "," : "",
+                         other ? "other" : table.entries[i].key,
+                         (unsigned long)(other ? table.otherWrites : table.entries[i].writes));
+        if (n < 0 || (size_t)n + 2 > bufferSize - length) {
+            return 0;  // No room for the value and the closing brace
+        }
+        length += n;
+    }
+    buffer[length++] = '}';
+    buffer[length] = '\0';
+    return length;
+}
+
+void NvsStore::flushWearCounters() {
+    WearTable& table = wearTable();
+    if (table.unflushed == 0) {
+        return;
+    }
+    
+    // The flush is itself a flash write - count it before persisting
+    countWrite(*findOrAddEntry(table, NVS_WEAR_KEY));
+    table.unflushed = 0;
+    table.crc = wearTableCRC(table);
+    
+    Preferences prefs;
+    if (!prefs.begin(NVS_WEAR_NAMESPACE, false)) {
+        LogBox::line("NVS wear counters: failed to open namespace");
+        return;
+    }
+    prefs.putBytes(NVS_WEAR_KEY, &table, sizeof(table));
+    prefs.end();
+}
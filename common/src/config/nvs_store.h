@@ -0,0 +1,104 @@
+#ifndef NVS_STORE_H
+#define NVS_STORE_H
+
+#include <Arduino.h>
+#include <Preferences.h>
+
+// ============================================
+// WEAR COUNTER SETTINGS
+// ============================================
+#define NVS_WEAR_NAMESPACE "nvs_wear"
+#define NVS_WEAR_KEY "counters"
+#define NVS_WEAR_MAX_KEYS 8           // Distinct keys tracked (least written key is evicted)
+#define NVS_WEAR_JSON_MAX_SIZE (2 + (NVS_WEAR_MAX_KEYS + 1) * 30)  // getWearJSON() output incl. NUL
+#define NVS_COMPARE_MAX_BYTES 64      // Larger blobs are not read back before writing
+
+// ============================================
+// NVS COST MODEL
+// ============================================
+// ESP-IDF NVS stores 32-byte entries in 4 KB pages (126 entries each).
+// A u8/bool takes one entry; a string takes one header entry plus its
+// data rounded up to whole entries, a blob one more for its index entry. Entries are append-only - a page
+// is erased only after it fills up - so entries written is the wear metric.
+#define NVS_ENTRY_SIZE 32
+#define NVS_PAGE_ENTRIES 126
+
+// Per-instance NVS operation counters
+struct NvsOpCounters {
+    uint16_t reads;           // get/isKey calls (including compare-before-write reads)
+    uint16_t writes;          // put/remove/clear calls that reached flash
+    uint16_t skippedWrites;   // puts skipped because the stored value was identical
+    uint16_t erases;          // remove/clear calls that reached flash
+    uint16_t entriesWritten;  // NVS entries appended by writes (see cost model)
+    uint32_t bytesRead;       // Value bytes returned by reads
+    uint32_t bytesWritten;    // Value bytes passed to writes that reached flash
+    
+    NvsOpCounters() : reads(0), writes(0), skippedWrites(0), erases(0),
+                      entriesWritten(0), bytesRead(0), bytesWritten(0) {}
+};
+
+/**
+ * NvsStore - Wear-aware wrapper around Preferences
+ *
+ * Drop-in for the Preferences calls used by ConfigManager and PowerManager:
+ * - put*() compares with the stored value first and skips identical writes
+ * - Every write that reaches flash bumps a per-key counter
+ *
+ * Wear counters live in RTC memory (survive deep sleep and restarts) and
+ * are persisted to NVS only by flushWearCounters(): after a config commit
+ * and before deep sleep, and only if something was counted. A flush
+ * rewrites the whole table, a 160-byte blob (7 NVS entries), so a wake
+ * that writes nothing adds no wear; a power loss drops the counts since
+ * the last flush. When all NVS_WEAR_MAX_KEYS slots are taken, the least
+ * written key is folded into "other". Counters are keyed by NVS key name
+ * and survive factory reset (separate namespace).
+ */
+class NvsStore {
+public:
+    NvsStore();
+    
+    bool begin(const char* name, bool readOnly = false);
+    void end();
+    bool isOpen() const;
+    
+    // Reads
+    bool isKey(const char* key);
+    uint8_t getUChar(const char* key, uint8_t defaultValue = 0);
+    bool getBool(const char* key, bool defaultValue = false);
+    String getString(const char* key, const String& defaultValue = String());
+    size_t getBytesLength(const char* key);
+    size_t getBytes(const char* key, void* buffer, size_t maxLength);
+    
+    // Writes (skipped when the stored value is identical)
+    // Return the number of bytes stored, like Preferences
+    size_t putUChar(const char* key, uint8_t value);
+    size_t putBool(const char* key, bool value);
+    size_t putBytes(const char* key, const void* value, size_t length);
+    bool remove(const char* key);
+    bool clear();
+    
+    // Operation counters for this instance
+    const NvsOpCounters& getCounters() const;
+    
+    // NVS entries used by a blob of `length` bytes: header, data and the
+    // blob index entry (u8/bool: pass 0 for the single entry)
+    static uint16_t entrySpan(size_t length);
+    
+    // Wear counters (shared by all instances)
+    static uint32_t getTotalWrites();
+    // {"key":writes,...,"other":writes} in first-write order into buffer
+    // (NVS_WEAR_JSON_MAX_SIZE always fits). Returns the length, 0 if too small.
+    static size_t getWearJSON(char* buffer, size_t bufferSize);
+    static void flushWearCounters();  // Persist counts taken since the last flush
+
+private:
+    Preferences _preferences;
+    bool _open;
+    NvsOpCounters _counters;
+    
+    void recordWrite(const char* key, size_t bytes, uint16_t entries);
+    void recordErase(const char* key);
+    void countFlashWrite(const char* key);  // Op counter + per-key wear counter
+};
+
+#endif // NVS_STORE_H
@@ -0,0 +1,499 @@
+#include "mqtt5_client.h"
+#include "logger.h"
+
+// MQTT control packet types (upper nibble of the fixed header)
+#define MQTT_PACKET_CONNECT 1
+#define MQTT_PACKET_CONNACK 2
+#define MQTT_PACKET_PUBLISH 3
+#define MQTT_PACKET_SUBSCRIBE 8
+#define MQTT_PACKET_PINGREQ 12
+#define MQTT_PACKET_PINGRESP 13
+#define MQTT_PACKET_DISCONNECT 14
+
+// MQTT 5 property identifiers used here
+#define MQTT5_PROP_SESSION_EXPIRY 0x11
+#define MQTT5_PROP_SERVER_KEEP_ALIVE 0x13
+#define MQTT5_PROP_TOPIC_ALIAS_MAX 0x22
+#define MQTT5_PROP_TOPIC_ALIAS 0x23
+
+static size_t encodeLength(uint8_t* out, uint32_t length) {
+    size_t pos = 0;
+    do {
+        uint8_t digit = length % 128;
+        length /= 128;
+        out[pos++] = length > 0 ? (digit | 0x80) : digit;
+    } while (length > 0);
+    return pos;
+}
+
+static size_t packetSize(uint32_t remaining) {
+    uint8_t scratch[4];
+    return 1 + encodeLength(scratch, remaining) + remaining;
+}
+
+static size_t putString(uint8_t* out, const char* text, size_t length) {
+    out[0] = length >> 8;
+    out[1] = length & 0xFF;
+    memcpy(out + 2, text, length);
+    return 2 + length;
+}
+
+static bool readLength(const uint8_t* buf, size_t end, size_t& pos, uint32_t& value) {
+    value = 0;
+    for (uint8_t shift = 0; shift <= 21 && pos < end; shift += 7) {
+        uint8_t b = buf[pos++];
+        value |= (uint32_t)(b & 0x7F) << shift;
+        if ((b & 0x80) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Bytes a property value takes after its identifier, 0 if unknown/truncated
+static size_t propertySize(uint8_t id, const uint8_t* buf, size_t pos, size_t end) {
+    size_t size = 0;
+    switch (id) {
+        case 0x01: case 0x17: case 0x19: case 0x24: case 0x25: case 0x28: case 0x29: case 0x2A:
+            size = 1;
+            break;
+        case 0x13: case 0x21: case 0x22: case 0x23:
+            size = 2;
+            break;
+        case 0x02: case 0x11: case 0x18: case 0x27:
+            size = 4;
+            break;
+        case 0x0B: {
+            size_t start = pos;
+            uint32_t value;
+            size = readLength(buf, end, pos, value) ? pos - start : 0;
+            break;
+        }
+        case 0x03: case 0x08: case 0x09: case 0x12: case 0x15: case 0x16: case 0x1A: case 0x1C: case 0x1F:
+            size = pos + 2 <= end ? 2 + (((size_t)buf[pos] << 8) | buf[pos + 1]) : 0;
+            break;
+        case 0x26:  // User property: two strings
+            if (pos + 2 <= end) {
+                size_t first = 2 + (((size_t)buf[pos] << 8) | buf[pos + 1]);
+                if (pos + first + 2 <= end) {
+                    size = first + 2 + (((size_t)buf[pos + first] << 8) | buf[pos + first + 1]);
+                }
+            }
+            break;
+    }
+    return pos + size <= end ? size : 0;
+}
+
+Mqtt5Client::Mqtt5Client(Client& client)
+    : _client(client), _requestedKeepAliveSeconds(15), _keepAliveSeconds(15), _sessionExpirySeconds(0),
+      _hadSession(false), _connected(false),
+      _state(MQTT5_DISCONNECTED), _connackReceived(false), _pingPending(false), _nextPacketId(1),
+      _lastOutboundMs(0), _pingSentMs(0), _publishCounter(0),
+      _rxState(RX_HEADER), _rxHeader(0), _rxLength(0), _rxShift(0), _rxPos(0) {
+    for (uint8_t i = 0; i < MQTT5_TOPIC_ALIAS_MAX; i++) {
+        _aliases[i].lastUsed = 0;
+    }
+}
+
+bool Mqtt5Client::connect(IPAddress ip, uint16_t port, const char* clientId, const char* username,
+                          const char* password) {
+    // Aliases and counters belong to one network connection
+    _connected = false;
+    _pingPending = false;
+    _publishCounter = 0;
+    _rxState = RX_HEADER;
+    _stats = Mqtt5Stats();
+    _keepAliveSeconds = _requestedKeepAliveSeconds;
+    _stats.keepAlive = _keepAliveSeconds;
+    for (uint8_t i = 0; i < MQTT5_TOPIC_ALIAS_MAX; i++) {
+        _aliases[i].lastUsed = 0;
+    }
+    
+    if (!_client.connect(ip, port)) {
+        _state = MQTT5_CONNECT_FAILED;
+        return false;
+    }
+    
+    bool auth = username != nullptr && username[0] != '\0';
+    size_t idLength = strlen(clientId);
+    size_t userLength = auth ? strlen(username) : 0;
+    size_t passLength = auth && password != nullptr ? strlen(password) : 0;
+    
+    // Properties: Session Expiry Interval (absent = session ends with the connection)
+    uint8_t properties[5];
+    size_t propertiesLength = 0;
+    if (_sessionExpirySeconds > 0) {
+        properties[propertiesLength++] = MQTT5_PROP_SESSION_EXPIRY;
+        properties[propertiesLength++] = _sessionExpirySeconds >> 24;
+        properties[propertiesLength++] = (_sessionExpirySeconds >> 16) & 0xFF;
+        properties[propertiesLength++] = (_sessionExpirySeconds >> 8) & 0xFF;
+        properties[propertiesLength++] = _sessionExpirySeconds & 0xFF;
+    }
+    
+    size_t payloadLength = 2 + idLength + (auth ? 2 + userLength : 0) + (auth && password != nullptr ? 2 + passLength : 0);
+    size_t remaining = 10 + 1 + propertiesLength + payloadLength;
+    uint8_t packet[MQTT5_CONNECT_BUFFER_SIZE];
+    if (remaining + 5 > sizeof(packet)) {
+        _client.stop();
+        _state = MQTT5_CONNECT_FAILED;
+        return false;
+    }
+    
+    // Resume the broker-side session on reconnects when one was requested
+    bool cleanStart = !(_hadSession && _sessionExpirySeconds > 0);
+    uint8_t flags = cleanStart ? 0x02 : 0x00;
+    if (auth) {
+        flags |= 0x80;
+        if (password != nullptr) {
+            flags |= 0x40;
+        }
+    }
+    
+    size_t pos = 0;
+    packet[pos++] = MQTT_PACKET_CONNECT << 4;
+    pos += encodeLength(packet + pos, remaining);
+    static const uint8_t protocol[] = { 0, 4, 'M', 'Q', 'T', 'T', 5 };
+    memcpy(packet + pos, protocol, sizeof(protocol));
+    pos += sizeof(protocol);
+    packet[pos++] = flags;
+    packet[pos++] = _requestedKeepAliveSeconds >> 8;
+    packet[pos++] = _requestedKeepAliveSeconds & 0xFF;
+    packet[pos++] = propertiesLength;
+    memcpy(packet + pos, properties, propertiesLength);
+    pos += propertiesLength;
+    pos += putString(packet + pos, clientId, idLength);
+    if (auth) {
+        pos += putString(packet + pos, username, userLength);
+        if (password != nullptr) {
+            pos += putString(packet + pos, password, passLength);
+        }
+    }
+    
+    _connackReceived = false;
+    if (!send(packet, pos, nullptr, 0)) {
+        _client.stop();
+        _state = MQTT5_CONNECTION_LOST;
+        return false;
+    }
+    _stats.v311Bytes += packetSize(remaining - 1 - propertiesLength);
+    
+    unsigned long start = millis();
+    while (!_connackReceived && millis() - start < MQTT5_CONNECT_TIMEOUT_MS && _client.connected()) {
+        delay(1);
+        poll();
+    }
+    if (!_connackReceived || _state != MQTT5_CONNECTED) {
+        if (!_connackReceived) {
+            _state = _client.connected() ? MQTT5_CONNECTION_TIMEOUT : MQTT5_CONNECTION_LOST;
+        }
+        _client.stop();
+        return false;
+    }
+    
+    _connected = true;
+    _hadSession = true;
+    _lastOutboundMs = millis();
+    return true;
+}
+
+bool Mqtt5Client::connected() {
+    if (_connected && !_client.connected()) {
+        _connected = false;
+        _state = MQTT5_CONNECTION_LOST;
+    }
+    return _connected;
+}
+
+void Mqtt5Client::disconnect() {
+    if (_connected) {
+        const uint8_t packet[2] = { MQTT_PACKET_DISCONNECT << 4, 0 };  // Reason 0: normal
+        send(packet, sizeof(packet), nullptr, 0);
+        _stats.v311Bytes += sizeof(packet);
+    }
+    _connected = false;
+    _state = MQTT5_DISCONNECTED;
+    _client.stop();
+}
+
+bool Mqtt5Client::send(const uint8_t* header, size_t headerLength, const uint8_t* payload, size_t payloadLength) {
+    if (_client.write(header, headerLength) != headerLength ||
+        (payloadLength > 0 && _client.write(payload, payloadLength) != payloadLength)) {
+        return false;
+    }
+    _stats.txBytes += headerLength + payloadLength;
+    _lastOutboundMs = millis();
+    return true;
+}
+
+uint16_t Mqtt5Client::lookupAlias(const char* topic, size_t topicLength, bool& isNew) {
+    uint16_t slots = _stats.aliasMax < MQTT5_TOPIC_ALIAS_MAX ? _stats.aliasMax : MQTT5_TOPIC_ALIAS_MAX;
+    if (slots == 0 || topicLength >= MQTT5_ALIAS_TOPIC_SIZE) {
+        return 0;
+    }
+    
+    _publishCounter++;
+    uint16_t oldest = 0;
+    for (uint16_t i = 0; i < slots; i++) {
+        if (_aliases[i].lastUsed != 0 && strcmp(_aliases[i].topic, topic) == 0) {
+            _aliases[i].lastUsed = _publishCounter;
+            isNew = false;
+            return i + 1;
+        }
+        if (_aliases[i].lastUsed < _aliases[oldest].lastUsed) {
+            oldest = i;
+        }
+    }
+    
+    // Free slot, or remap the least recently used one
+    memcpy(_aliases[oldest].topic, topic, topicLength + 1);
+    _aliases[oldest].lastUsed = _publishCounter;
+    isNew = true;
+    return oldest + 1;
+}
+
+bool Mqtt5Client::publish(const char* topic, const uint8_t* payload, size_t length, bool retained) {
+    if (!connected()) {
+        return false;
+    }
+    
+    size_t topicLength = strlen(topic);
+    bool isNew = false;
+    uint16_t alias = lookupAlias(topic, topicLength, isNew);
+    size_t sentTopicLength = alias != 0 && !isNew ? 0 : topicLength;
+    size_t propertiesLength = alias != 0 ? 3 : 0;
+    size_t remaining = 2 + sentTopicLength + 1 + propertiesLength + length;
+    
+    uint8_t header[MQTT5_HEADER_BUFFER_SIZE];
+    if (sentTopicLength + 12 > sizeof(header) || remaining > 268435455UL) {
+        return false;
+    }
+    
+    size_t pos = 0;
+    header[pos++] = (MQTT_PACKET_PUBLISH << 4) | (retained ? 1 : 0);  // QoS 0
+    pos += encodeLength(header + pos, remaining);
+    pos += putString(header + pos, topic, sentTopicLength);
+    header[pos++] = propertiesLength;
+    if (alias != 0) {
+        header[pos++] = MQTT5_PROP_TOPIC_ALIAS;
+        header[pos++] = alias >> 8;
+        header[pos++] = alias & 0xFF;
+    }
+    
+    if (!send(header, pos, payload, length)) {
+        if (isNew) {
+            _aliases[alias - 1].lastUsed = 0;  // The broker never saw the mapping
+        }
+        return false;
+    }
+    _stats.publishes++;
+    if (sentTopicLength == 0) {
+        _stats.aliasHits++;
+    }
+    _stats.v311Bytes += packetSize(2 + topicLength + length);
+    return true;
+}
+
+bool Mqtt5Client::subscribe(const char* topic) {
+    if (!connected()) {
+        return false;
+    }
+    
+    size_t topicLength = strlen(topic);
+    uint8_t packet[MQTT5_HEADER_BUFFER_SIZE];
+    size_t remaining = 2 + 1 + 2 + topicLength + 1;
+    if (topicLength + 12 > sizeof(packet)) {
+        return false;
+    }
+    
+    uint16_t packetId = _nextPacketId;
+    _nextPacketId = _nextPacketId == 0xFFFF ? 1 : _nextPacketId + 1;
+    
+    size_t pos = 0;
+    packet[pos++] = (MQTT_PACKET_SUBSCRIBE << 4) | 0x02;
+    pos += encodeLength(packet + pos, remaining);
+    packet[pos++] = packetId >> 8;
+    packet[pos++] = packetId & 0xFF;
+    packet[pos++] = 0;  // No properties
+    pos += putString(packet + pos, topic, topicLength);
+    packet[pos++] = 0;  // Subscription options: QoS 0
+    _stats.v311Bytes += packetSize(remaining - 1);
+    return send(packet, pos, nullptr, 0);  // SUBACK is not waited for
+}
+
+bool Mqtt5Client::loop() {
+    if (!connected()) {
+        return false;
+    }
+    poll();
+    if (!connected()) {
+        return false;  // Broker sent DISCONNECT
+    }
+    
+    // Keepalive: ping after a quiet interval, give up if the answer never came
+    unsigned long keepAliveMs = _keepAliveSeconds * 1000UL;
+    if (keepAliveMs > 0) {
+        unsigned long now = millis();
+        if (_pingPending && now - _pingSentMs >= keepAliveMs) {
+            _client.stop();
+            _connected = false;
+            _state = MQTT5_CONNECTION_TIMEOUT;
+            return false;
+        }
+        if (!_pingPending && now - _lastOutboundMs >= keepAliveMs) {
+            const uint8_t pingreq[2] = { MQTT_PACKET_PINGREQ << 4, 0 };
+            if (send(pingreq, sizeof(pingreq), nullptr, 0)) {
+                _pingPending = true;
+                _pingSentMs = now;
+                _stats.v311Bytes += sizeof(pingreq);
+            }
+        }
+    }
+    return true;
+}
+
+bool Mqtt5Client::flush(uint32_t timeoutMs) {
+    if (!connected()) {
+        return false;
+    }
+    
+    unsigned long start = millis();
+    const uint8_t pingreq[2] = { MQTT_PACKET_PINGREQ << 4, 0 };
+    if (!send(pingreq, sizeof(pingreq), nullptr, 0)) {
+        return false;
+    }
+    _stats.v311Bytes += sizeof(pingreq);
+    _pingPending = true;
+    _pingSentMs = start;
+    
+    poll();
+    while (_pingPending && millis() - start < timeoutMs && _client.connected()) {
+        delay(1);
+        poll();
+    }
+    return !_pingPending;
+}
+
+void Mqtt5Client::poll() {
+    while (_client.available() > 0) {
+        int b = _client.read();
+        if (b < 0) {
+            break;
+        }
+        feed((uint8_t)b);
+    }
+}
+
+void Mqtt5Client::feed(uint8_t b) {
+    switch (_rxState) {
+        case RX_HEADER:
+            _rxHeader = b;
+            _rxLength = 0;
+            _rxShift = 0;
+            _rxState = RX_LENGTH;
+            break;
+        
+        case RX_LENGTH:
+            _rxLength |= (uint32_t)(b & 0x7F) << _rxShift;
+            _rxShift += 7;
+            if ((b & 0x80) == 0) {
+                _rxPos = 0;
+                if (_rxLength == 0) {
+                    handlePacket();
+                    _rxState = RX_HEADER;
+                } else {
+                    _rxState = RX_BODY;
+                }
+            } else if (_rxShift > 21) {
+                _rxState = RX_HEADER;  // Malformed length - resynchronize
+            }
+            break;
+        
+        case RX_BODY:
+            if (_rxPos < sizeof(_rx)) {
+                _rx[_rxPos] = b;
+            }
+            _rxPos++;
+            if (_rxPos == _rxLength) {
+                handlePacket();
+                _rxState = RX_HEADER;
+            }
+            break;
+    }
+}
+
+void Mqtt5Client::handlePacket() {
+    switch (_rxHeader >> 4) {
+        case MQTT_PACKET_CONNACK:
+            handleConnack();
+            break;
+        case MQTT_PACKET_PUBLISH:
+            handlePublish();
+            break;
+        case MQTT_PACKET_PINGRESP:
+            _pingPending = false;
+            break;
+        case MQTT_PACKET_DISCONNECT:
+            LogBox::messagef("MQTT", "Broker closed the connection (reason 0x%02X)", _rxLength > 0 ? _rx[0] : 0);
+            _connected = false;
+            _state = MQTT5_CONNECTION_LOST;
+            _client.stop();
+            break;
+        default:
+            break;  // SUBACK etc.
+    }
+}
+
+void Mqtt5Client::handleConnack() {
+    _connackReceived = true;
+    if (_rxLength < 2) {
+        _state = MQTT5_CONNECT_FAILED;
+        return;
+    }
+    _stats.sessionPresent = (_rx[0] & 0x01) != 0;
+    _state = _rx[1];  // Reason code, 0 = success
+    
+    // Properties (only what fit in the receive buffer is looked at)
+    size_t end = _rxLength < sizeof(_rx) ? _rxLength : sizeof(_rx);
+    size_t pos = 2;
+    uint32_t propertiesLength;
+    if (!readLength(_rx, end, pos, propertiesLength)) {
+        return;
+    }
+    if (pos + propertiesLength < end) {
+        end = pos + propertiesLength;
+    }
+    while (pos < end) {
+        uint8_t id = _rx[pos++];
+        size_t size = propertySize(id, _rx, pos, end);
+        if (size == 0) {
+            break;
+        }
+        if (id == MQTT5_PROP_TOPIC_ALIAS_MAX) {
+            _stats.aliasMax = ((uint16_t)_rx[pos] << 8) | _rx[pos + 1];
+        } else if (id == MQTT5_PROP_SERVER_KEEP_ALIVE) {
+            // The broker's value replaces ours for this connection
+            _keepAliveSeconds = ((uint16_t)_rx[pos] << 8) | _rx[pos + 1];
+            _stats.keepAlive = _keepAliveSeconds;
+        }
+        pos += size;
+    }
+}
+
+void Mqtt5Client::handlePublish() {
+    // Subscriptions are QoS 0 - a QoS 1/2 PUBLISH would carry a packet ID after the topic
+    if (!_handler || _rxLength > sizeof(_rx) || _rxLength < 2) {
+        return;
+    }
+    uint16_t topicLength = ((uint16_t)_rx[0] << 8) | _rx[1];
+    size_t pos = 2 + topicLength + (((_rxHeader >> 1) & 0x03) > 0 ? 2 : 0);
+    uint32_t propertiesLength;
+    if (pos > _rxLength || !readLength(_rx, _rxLength, pos, propertiesLength) || pos + propertiesLength > _rxLength) {
+        return;
+    }
+    pos += propertiesLength;
+    
+    char topic[MQTT5_RX_BUFFER_SIZE];
+    memcpy(topic, _rx + 2, topicLength);
+    topic[topicLength] = '\0';
+    _handler(topic, _rx + pos, _rxLength - pos);
+}
@@ -0,0 +1,131 @@
+#ifndef MQTT5_CLIENT_H
+#define MQTT5_CLIENT_H
+
+#include <Arduino.h>
+#include <Client.h>
+#include <functional>
+
+// ============================================
+// MQTT 5 CLIENT SETTINGS
+// ============================================
+#define MQTT5_TOPIC_ALIAS_MAX 16           // Aliases we use (capped by the broker's CONNACK)
+#define MQTT5_ALIAS_TOPIC_SIZE 96          // Longer topics are always sent in full
+#define MQTT5_SESSION_EXPIRY_SECONDS 300   // Broker keeps a persistent session this long after a drop
+#define MQTT5_CONNECT_TIMEOUT_MS 2000      // Wait for CONNACK
+#define MQTT5_HEADER_BUFFER_SIZE 160       // PUBLISH fixed header + topic + properties
+#define MQTT5_CONNECT_BUFFER_SIZE 256      // CONNECT incl. client ID and credentials
+#define MQTT5_RX_BUFFER_SIZE 128           // Incoming packets kept (larger ones are skipped)
+
+// Connection states (PubSubClient values; > 0 is the CONNACK reason code)
+#define MQTT5_CONNECTION_TIMEOUT -4
+#define MQTT5_CONNECTION_LOST -3
+#define MQTT5_CONNECT_FAILED -2
+#define MQTT5_DISCONNECTED -1
+#define MQTT5_CONNECTED 0
+
+// Wire counters since the last connect. v311Bytes is what the same
+// packets would have cost as MQTT 3.1.1 (no properties, full topics).
+struct Mqtt5Stats {
+    uint32_t txBytes;
+    uint32_t v311Bytes;
+    uint16_t publishes;
+    uint16_t aliasHits;       // PUBLISH sent with an empty topic
+    uint16_t aliasMax;        // Topic Alias Maximum granted by the broker
+    uint16_t keepAlive;       // Seconds in effect: ours, or the broker's Server Keep Alive
+    bool sessionPresent;      // Broker resumed the previous session
+    
+    Mqtt5Stats() : txBytes(0), v311Bytes(0), publishes(0), aliasHits(0), aliasMax(0), keepAlive(0),
+                   sessionPresent(false) {}
+};
+
+/**
+ * Mqtt5Client - Minimal MQTT 5 client (QoS 0) with topic aliases
+ *
+ * Home Assistant topics are long ("homeassistant/sensor/<deviceId>/
+ * loop_time_wifi/state") and for short numeric payloads the topic is most
+ * of the packet. MQTT 5 lets a connection map a topic to a 2-byte alias:
+ * the first PUBLISH carries the topic plus the alias, later ones only the
+ * alias. Up to MQTT5_TOPIC_ALIAS_MAX aliases (or fewer if the broker's
+ * CONNACK says so) are handed out first come; when they run out the least
+ * recently used one is remapped. Aliases only live as long as the TCP
+ * connection, so they pay off on persistent sessions and repeated topics
+ * (backlog), not on a single publish per wake.
+ *
+ * With setSessionExpiry() > 0 reconnects use Clean Start = 0: the broker
+ * keeps the session (subscriptions) for that long after a drop and the
+ * CONNACK reports it as present, so there is nothing to subscribe again.
+ * A Server Keep Alive in the CONNACK replaces the requested keepalive for
+ * that connection.
+ *
+ * The method names follow PubSubClient so MQTTManager can use either.
+ */
+class Mqtt5Client {
+public:
+    typedef std::function<void(char* topic, uint8_t* payload, unsigned int length)> MessageHandler;
+    
+    Mqtt5Client(Client& client);
+    
+    void setKeepAlive(uint16_t seconds) { _requestedKeepAliveSeconds = seconds; }
+    void setSessionExpiry(uint32_t seconds) { _sessionExpirySeconds = seconds; }
+    void setCallback(MessageHandler handler) { _handler = handler; }
+    
+    bool connect(IPAddress ip, uint16_t port, const char* clientId, const char* username, const char* password);
+    bool connected();
+    void disconnect();
+    int state() { return _state; }
+    
+    // QoS 0 PUBLISH, topic sent as an alias when possible
+    bool publish(const char* topic, const uint8_t* payload, size_t length, bool retained);
+    bool subscribe(const char* topic);
+    
+    // Read incoming packets and send keepalive pings; false once disconnected
+    bool loop();
+    
+    // PINGREQ/PINGRESP barrier (see MqttQos1Publisher::flush)
+    bool flush(uint32_t timeoutMs);
+    
+    const Mqtt5Stats& getStats() { return _stats; }
+
+private:
+    struct TopicAlias {
+        uint32_t lastUsed;  // Publish counter, 0 = free
+        char topic[MQTT5_ALIAS_TOPIC_SIZE];
+    };
+    
+    enum RxState { RX_HEADER, RX_LENGTH, RX_BODY };
+    
+    Client& _client;
+    MessageHandler _handler;
+    uint16_t _requestedKeepAliveSeconds;  // Sent in the CONNECT
+    uint16_t _keepAliveSeconds;           // In effect on this connection
+    uint32_t _sessionExpirySeconds;
+    bool _hadSession;           // Connected before (Clean Start = 0 on reconnect)
+    bool _connected;
+    int _state;
+    bool _connackReceived;
+    bool _pingPending;
+    uint16_t _nextPacketId;
+    unsigned long _lastOutboundMs;
+    unsigned long _pingSentMs;
+    uint32_t _publishCounter;
+    TopicAlias _aliases[MQTT5_TOPIC_ALIAS_MAX];
+    Mqtt5Stats _stats;
+    
+    // Incoming packet parser (bytes may arrive split across polls)
+    RxState _rxState;
+    uint8_t _rxHeader;
+    uint32_t _rxLength;
+    uint8_t _rxShift;
+    uint32_t _rxPos;
+    uint8_t _rx[MQTT5_RX_BUFFER_SIZE];
+    
+    bool send(const uint8_t* header, size_t headerLength, const uint8_t* payload, size_t payloadLength);
+    uint16_t lookupAlias(const char* topic, size_t topicLength, bool& isNew);
+    void poll();
+    void feed(uint8_t b);
+    void handlePacket();
+    void handleConnack();
+    void handlePublish();
+};
+
+#endif // MQTT5_CLIENT_H
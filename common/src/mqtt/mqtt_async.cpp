@@ -0,0 +1,231 @@
+#include "mqtt_async.h"
+#include "logger.h"
+
+MqttAsync::MqttAsync(MQTTManager* manager)
+    : _manager(manager), _task(nullptr), _identitySet(false), _head(0), _tail(0), _completed(0), _failed(0),
+      _lastQueueMs(0), _lastLatencyMs(0), _maxLatencyMs(0), _stackFreeBytes(MQTT_ASYNC_STACK_SIZE),
+      _persistent(false), _reconnects(0), _lastFlushMs(0), _rejected(0), _maxDepth(0) {
+}
+
+bool MqttAsync::begin(BaseType_t core) {
+    if (_task != nullptr) {
+        return true;
+    }
+    
+    snapshot();  // The task does not run yet
+    if (xTaskCreatePinnedToCore(taskEntry, "mqtt", MQTT_ASYNC_STACK_SIZE, this, MQTT_ASYNC_PRIORITY,
+                                &_task, core) != pdPASS) {
+        _task = nullptr;
+        LogBox::message("MQTT", "ERROR: Could not start the async MQTT task");
+        return false;
+    }
+    LogBox::messagef("MQTT", "Async MQTT task started on core %d", (int)core);
+    return true;
+}
+
+MqttAsync::Slot* MqttAsync::reserve() {
+    uint32_t tail = _tail.load(std::memory_order_relaxed);
+    if (_task == nullptr || tail - _head.load(std::memory_order_acquire) >= MQTT_ASYNC_QUEUE_DEPTH) {
+        _rejected++;
+        return nullptr;
+    }
+    return &_slots[tail % MQTT_ASYNC_QUEUE_DEPTH];
+}
+
+uint32_t MqttAsync::commit(Slot* slot, MqttAsyncCallback callback, void* context) {
+    slot->callback = callback;
+    slot->context = context;
+    slot->enqueuedMs = millis();
+    
+    // Release: the slot contents are visible to the task before the new tail
+    uint32_t tail = _tail.load(std::memory_order_relaxed) + 1;
+    _tail.store(tail, std::memory_order_release);
+    
+    uint32_t depth = tail - _head.load(std::memory_order_acquire);
+    if (depth > _maxDepth) {
+        _maxDepth = depth;
+    }
+    xTaskNotifyGive(_task);
+    return tail;  // Ticket = position in the queue (never 0)
+}
+
+uint32_t MqttAsync::publish(const char* topic, const char* payload, bool retained,
+                            MqttAsyncCallback callback, void* context) {
+    if (strlen(topic) >= MQTT_TOPIC_BUFFER_SIZE || strlen(payload) >= MQTT_ASYNC_PAYLOAD_SIZE) {
+        _rejected++;
+        return 0;
+    }
+    Slot* slot = reserve();
+    if (slot == nullptr) {
+        return 0;
+    }
+    slot->kind = KIND_PUBLISH;
+    slot->retained = retained;
+    strcpy(slot->message.topic, topic);
+    strcpy(slot->message.payload, payload);
+    return commit(slot, callback, context);
+}
+
+uint32_t MqttAsync::publishTelemetry(const TelemetryData& data, MqttAsyncCallback callback, void* context) {
+    Slot* slot = reserve();
+    if (slot == nullptr) {
+        return 0;
+    }
+    if (!packTelemetry(data, slot->record)) {
+        _rejected++;
+        return 0;
+    }
+    if (!_identitySet) {
+        // No telemetry slot was committed yet, so the task is not reading these
+        _telemetry.deviceId = data.deviceId;
+        _telemetry.deviceName = data.deviceName;
+        _telemetry.modelName = data.modelName;
+        _identitySet = true;
+    }
+    slot->kind = KIND_TELEMETRY;
+    slot->wakeReason = (uint8_t)data.wakeReason;
+    return commit(slot, callback, context);
+}
+
+bool MqttAsync::packTelemetry(const TelemetryData& data, char* record) {
+    size_t used = 0;
+    for (int id = 0; id < SensorRegistry::count(); id++) {
+        if (!data.values.has(id)) {
+            continue;
+        }
+        size_t length = strlen(data.values.get(id));
+        if (used + 1 + length + 1 > MQTT_ASYNC_RECORD_SIZE) {
+            return false;
+        }
+        record[used++] = (char)id;
+        memcpy(record + used, data.values.get(id), length + 1);
+        used += length + 1;
+    }
+    size_t wearLength = data.nvsWearJson.length();
+    if (used + 1 + wearLength + 1 > MQTT_ASYNC_RECORD_SIZE) {
+        return false;
+    }
+    record[used++] = (char)SENSOR_REGISTRY_SIZE;  // End of the values
+    memcpy(record + used, data.nvsWearJson.c_str(), wearLength + 1);
+    return true;
+}
+
+void MqttAsync::unpackTelemetry(const Slot& slot) {
+    _telemetry.wakeReason = (WakeupReason)slot.wakeReason;
+    _telemetry.values.clear();
+    const char* p = slot.record;
+    while ((uint8_t)*p < SENSOR_REGISTRY_SIZE) {
+        int id = (uint8_t)*p++;
+        _telemetry.values.setText(id, p);  // Already formatted
+        p += strlen(p) + 1;
+    }
+    _telemetry.nvsWearJson = p + 1;
+}
+
+bool MqttAsync::isComplete(uint32_t ticket) {
+    // Messages complete in order, so everything up to _head is done
+    return ticket != 0 && (int32_t)(_head.load(std::memory_order_acquire) - ticket) >= 0;
+}
+
+bool MqttAsync::waitIdle(uint32_t timeoutMs) {
+    unsigned long start = millis();
+    while (_head.load(std::memory_order_acquire) != _tail.load(std::memory_order_relaxed)) {
+        if (millis() - start >= timeoutMs) {
+            return false;
+        }
+        delay(10);
+    }
+    return true;
+}
+
+MqttAsyncStats MqttAsync::getStats() {
+    MqttAsyncStats stats;
+    uint32_t tail = _tail.load(std::memory_order_relaxed);
+    stats.enqueued = tail;
+    stats.depth = tail - _head.load(std::memory_order_acquire);
+    stats.maxDepth = _maxDepth;
+    stats.rejected = _rejected;
+    stats.completed = _completed.load(std::memory_order_relaxed);
+    stats.failed = _failed.load(std::memory_order_relaxed);
+    stats.lastQueueMs = _lastQueueMs.load(std::memory_order_relaxed);
+    stats.lastLatencyMs = _lastLatencyMs.load(std::memory_order_relaxed);
+    stats.maxLatencyMs = _maxLatencyMs.load(std::memory_order_relaxed);
+    stats.stackFreeBytes = _stackFreeBytes.load(std::memory_order_relaxed);
+    stats.persistentSession = _persistent.load(std::memory_order_relaxed);
+    stats.reconnects = _reconnects.load(std::memory_order_relaxed);
+    stats.lastFlushMs = _lastFlushMs.load(std::memory_order_relaxed);
+    return stats;
+}
+
+void MqttAsync::snapshot() {
+    _persistent.store(_manager->isPersistentSession(), std::memory_order_relaxed);
+    _reconnects.store(_manager->getSessionStats().reconnects, std::memory_order_relaxed);
+    _lastFlushMs.store(_manager->getLastFlushMs(), std::memory_order_relaxed);
+}
+
+void MqttAsync::taskEntry(void* arg) {
+    static_cast<MqttAsync*>(arg)->run();
+}
+
+void MqttAsync::run() {
+    for (;;) {
+        // Woken by commit(), or every MQTT_ASYNC_SERVICE_MS for keepalives
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(MQTT_ASYNC_SERVICE_MS));
+        
+        uint32_t head = _head.load(std::memory_order_relaxed);
+        while (head != _tail.load(std::memory_order_acquire)) {
+            process(_slots[head % MQTT_ASYNC_QUEUE_DEPTH]);
+            head++;
+            // Release: the slot may be reused once the producer sees this
+            _head.store(head, std::memory_order_release);
+        }
+        
+        if (_manager->isPersistentSession()) {
+            _manager->loop();
+        } else if (_manager->isConnected()) {
+            _manager->disconnect();  // Batch done
+        }
+        snapshot();
+        
+        // ESP-IDF reports the high water mark in bytes
+        uint32_t stackFree = uxTaskGetStackHighWaterMark(nullptr);
+        if (stackFree < _stackFreeBytes.load(std::memory_order_relaxed)) {
+            _stackFreeBytes.store(stackFree, std::memory_order_relaxed);
+        }
+    }
+}
+
+void MqttAsync::process(Slot& slot) {
+    uint32_t startMs = millis();
+    _lastQueueMs.store(startMs - slot.enqueuedMs, std::memory_order_relaxed);
+    
+    bool success;
+    if (slot.kind == KIND_TELEMETRY) {
+        unpackTelemetry(slot);
+        success = _manager->publishAllTelemetry(_telemetry);
+        if (!_manager->isPersistentSession()) {
+            _manager->disconnect();
+        }
+    } else {
+        // Without a persistent session, wait for the broker before reporting success
+        success = _manager->connect() &&
+                  _manager->publish(slot.message.topic, slot.message.payload, strlen(slot.message.payload),
+                                    slot.retained) &&
+                  (_manager->isPersistentSession() || _manager->flush());
+    }
+    
+    uint32_t latencyMs = millis() - slot.enqueuedMs;
+    _lastLatencyMs.store(latencyMs, std::memory_order_relaxed);
+    if (latencyMs > _maxLatencyMs.load(std::memory_order_relaxed)) {
+        _maxLatencyMs.store(latencyMs, std::memory_order_relaxed);
+    }
+    if (!success) {
+        _failed.fetch_add(1, std::memory_order_relaxed);
+    }
+    _completed.fetch_add(1, std::memory_order_relaxed);
+    snapshot();  // Before the callback, which may read getStats()
+    
+    if (slot.callback != nullptr) {
+        slot.callback(_head.load(std::memory_order_relaxed) + 1, success, latencyMs, slot.context);
+    }
+}
@@ -0,0 +1,185 @@
+#ifndef MQTT_ASYNC_H
+#define MQTT_ASYNC_H
+
+#include <Arduino.h>
+#include <atomic>
+#include "mqtt_manager.h"
+#include "nvs_store.h"
+
+// ============================================
+// ASYNC MQTT SETTINGS
+// ============================================
+// Set to true in board_config.h to run MQTT in its own task (see MqttAsync)
+#ifndef MQTT_ASYNC
+#define MQTT_ASYNC false
+#endif
+
+#define MQTT_ASYNC_QUEUE_DEPTH 8           // Messages waiting for the MQTT task
+#define MQTT_ASYNC_PAYLOAD_SIZE 256        // Largest publish() payload
+// Packed telemetry: every registry sensor as ID + value, the end marker
+// and the wear JSON - whatever a TelemetryData can hold fits
+#define MQTT_ASYNC_RECORD_SIZE (SENSOR_REGISTRY_SIZE * (1 + SENSOR_VALUE_SIZE) + 1 + NVS_WEAR_JSON_MAX_SIZE)
+#define MQTT_ASYNC_PRIORITY 1              // Same as the Arduino loop task
+#define MQTT_ASYNC_SERVICE_MS 100          // Persistent session service interval
+#define MQTT_ASYNC_IDLE_TIMEOUT_MS 15000   // Longest waitIdle() before deep sleep
+
+// MQTT task stack (bytes). The telemetry cycle's large buffers live in the
+// MQTTManager, not on this stack; with TLS compiled in the mbedtls
+// handshake runs here as well and gets the larger default. Size it from
+// getStats().stackFreeBytes (least free stack seen, logged with every
+// async telemetry) after TLS connects, reconnects and discovery have run
+// on the board, keeping some headroom.
+#ifndef MQTT_ASYNC_STACK_SIZE
+#if defined(MQTT_TLS_CA_CERT) || MQTT_TLS_INSECURE
+#define MQTT_ASYNC_STACK_SIZE 16384
+#else
+#define MQTT_ASYNC_STACK_SIZE 8192
+#endif
+#endif
+
+// Network core: WiFi/lwIP run on core 0, the Arduino loop on core 1
+#ifndef MQTT_ASYNC_CORE
+#define MQTT_ASYNC_CORE 0
+#endif
+
+// Called from the MQTT task when a queued message is done. latencyMs runs
+// from publish() to completion (queue wait + connect + send).
+typedef void (*MqttAsyncCallback)(uint32_t ticket, bool success, uint32_t latencyMs, void* context);
+
+struct MqttAsyncStats {
+    uint32_t enqueued;
+    uint32_t completed;      // Includes failed
+    uint32_t failed;
+    uint32_t rejected;       // Queue full or payload too large
+    uint8_t depth;           // Waiting right now
+    uint8_t maxDepth;
+    uint32_t lastQueueMs;    // Time the last message waited before the task took it
+    uint32_t lastLatencyMs;  // publish() to completion of the last message
+    uint32_t maxLatencyMs;
+    uint32_t stackFreeBytes; // Least free MQTT task stack seen (uxTaskGetStackHighWaterMark)
+    
+    // MQTTManager snapshot, updated by the task after every message and
+    // service pass - read these instead of the manager's getters
+    bool persistentSession;
+    uint32_t reconnects;     // MQTTSessionStats::reconnects
+    int32_t lastFlushMs;     // MQTTManager::getLastFlushMs()
+    
+    MqttAsyncStats() : enqueued(0), completed(0), failed(0), rejected(0), depth(0), maxDepth(0),
+                       lastQueueMs(0), lastLatencyMs(0), maxLatencyMs(0), stackFreeBytes(0),
+                       persistentSession(false), reconnects(0), lastFlushMs(0) {}
+};
+
+/**
+ * MqttAsync - Runs an MQTTManager in its own FreeRTOS task
+ *
+ * connect() can block for seconds (socket timeout, retries) and
+ * publishAllTelemetry() waits for the flush on top of that. With MqttAsync
+ * a task pinned to the network core owns the MQTTManager: the application
+ * hands it messages through a single-producer/single-consumer ring (atomic
+ * head/tail, no locks) and carries on immediately.
+ *
+ * publish()/publishTelemetry() return a ticket (0 if the queue was full or
+ * the message too large). Telemetry is queued as a record - the set values
+ * and the wear JSON, sized for a full registry and wear table - and
+ * rebuilt on the task; the device
+ * identity is taken from the first publishTelemetry() (a renamed device
+ * restarts from the config portal).
+ * Completion is reported through the optional callback (runs on the MQTT
+ * task) or polled with isComplete(ticket); messages finish in order.
+ *
+ * Rules:
+ * - Once begin() ran, only the MQTT task touches the MQTTManager - call
+ *   mqttManager.begin()/setPersistentSession() before it and read its
+ *   state from getStats()
+ * - Enqueue from one task only (the Arduino loop)
+ * - Call waitIdle() before deep sleep so queued messages are not lost
+ * - Persistent sessions are serviced by the task; no loop() calls needed
+ */
+class MqttAsync {
+public:
+    MqttAsync(MQTTManager* manager);
+    
+    // Start the MQTT task, false if it could not be created
+    bool begin(BaseType_t core = MQTT_ASYNC_CORE);
+    bool isRunning() { return _task != nullptr; }
+    
+    // Non-blocking publish of one message (copied into the queue)
+    uint32_t publish(const char* topic, const char* payload, bool retained,
+                     MqttAsyncCallback callback = nullptr, void* context = nullptr);
+    
+    // Non-blocking MQTTManager::publishAllTelemetry() (+ disconnect unless persistent)
+    uint32_t publishTelemetry(const TelemetryData& data,
+                              MqttAsyncCallback callback = nullptr, void* context = nullptr);
+    
+    bool isComplete(uint32_t ticket);
+    
+    // Block until the queue is empty and the task idle (or timeout)
+    bool waitIdle(uint32_t timeoutMs = MQTT_ASYNC_IDLE_TIMEOUT_MS);
+    
+    MqttAsyncStats getStats();
+
+private:
+    enum Kind : uint8_t { KIND_PUBLISH, KIND_TELEMETRY };
+    
+    struct Slot {
+        Kind kind;
+        bool retained;
+        uint8_t wakeReason;      // KIND_TELEMETRY
+        uint32_t enqueuedMs;
+        MqttAsyncCallback callback;
+        void* context;
+        union {
+            struct {
+                char topic[MQTT_TOPIC_BUFFER_SIZE];
+                char payload[MQTT_ASYNC_PAYLOAD_SIZE];
+            } message;                           // KIND_PUBLISH
+            char record[MQTT_ASYNC_RECORD_SIZE];  // KIND_TELEMETRY, see packTelemetry()
+        };
+    };
+    
+    MQTTManager* _manager;
+    TaskHandle_t _task;
+    Slot _slots[MQTT_ASYNC_QUEUE_DEPTH];
+    
+    // The task's telemetry, rebuilt from each record. The identity strings
+    // are set by the producer once, before the first telemetry slot is
+    // committed, and only read by the task after that.
+    TelemetryData _telemetry;
+    bool _identitySet;
+    
+    // Free-running counters: the producer owns _tail, the task owns _head
+    std::atomic<uint32_t> _head;
+    std::atomic<uint32_t> _tail;
+    
+    // Written by the task, read by getStats()
+    std::atomic<uint32_t> _completed;
+    std::atomic<uint32_t> _failed;
+    std::atomic<uint32_t> _lastQueueMs;
+    std::atomic<uint32_t> _lastLatencyMs;
+    std::atomic<uint32_t> _maxLatencyMs;
+    std::atomic<uint32_t> _stackFreeBytes;
+    std::atomic<bool> _persistent;
+    std::atomic<uint32_t> _reconnects;
+    std::atomic<int32_t> _lastFlushMs;
+    
+    // Producer side
+    uint32_t _rejected;
+    uint8_t _maxDepth;
+    
+    Slot* reserve();
+    uint32_t commit(Slot* slot, MqttAsyncCallback callback, void* context);
+    
+    // Record: per set value its ID byte and NUL-terminated text, an
+    // end byte, then the wear JSON. Returns false if it does not fit.
+    static bool packTelemetry(const TelemetryData& data, char* record);
+    void unpackTelemetry(const Slot& slot);
+    
+    // Manager state for getStats() (only called where the manager is not shared)
+    void snapshot();
+    
+    static void taskEntry(void* arg);
+    void run();
+    void process(Slot& slot);
+};
+
+#endif // MQTT_ASYNC_H
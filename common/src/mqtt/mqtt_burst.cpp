@@ -0,0 +1,168 @@
+#include "mqtt_burst.h"
+
+// MQTT 3.1.1 control packet types (upper nibble of the fixed header)
+#define MQTT_PACKET_CONNECT 1
+#define MQTT_PACKET_CONNACK 2
+#define MQTT_PACKET_PUBLISH 3
+#define MQTT_PACKET_PINGREQ 12
+#define MQTT_PACKET_PINGRESP 13
+#define MQTT_PACKET_DISCONNECT 14
+
+MqttBurst::MqttBurst(Client& client)
+    : _client(client), _open(false), _failed(false), _firstWriteMs(0), _used(0) {
+}
+
+bool MqttBurst::append(const uint8_t* data, size_t length) {
+    while (length > 0) {
+        if (_used == sizeof(_buffer) && !writeOut()) {
+            return false;
+        }
+        size_t chunk = sizeof(_buffer) - _used;
+        if (chunk > length) {
+            chunk = length;
+        }
+        memcpy(_buffer + _used, data, chunk);
+        _used += chunk;
+        data += chunk;
+        length -= chunk;
+    }
+    return true;
+}
+
+bool MqttBurst::appendHeader(uint8_t type, size_t remaining) {
+    uint8_t header[5];
+    size_t pos = 0;
+    header[pos++] = type;
+    do {
+        uint8_t digit = remaining % 128;
+        remaining /= 128;
+        header[pos++] = remaining > 0 ? (digit | 0x80) : digit;
+    } while (remaining > 0);
+    return append(header, pos);
+}
+
+bool MqttBurst::appendString(const char* text, size_t length) {
+    const uint8_t prefix[2] = { (uint8_t)(length >> 8), (uint8_t)(length & 0xFF) };
+    return append(prefix, sizeof(prefix)) && append((const uint8_t*)text, length);
+}
+
+bool MqttBurst::writeOut() {
+    if (_used == 0) {
+        return true;
+    }
+    if (_stats.writes == 0) {
+        _firstWriteMs = millis();
+    }
+    bool written = _client.write(_buffer, _used) == _used;
+    _stats.writes++;
+    _stats.bytes += _used;
+    _used = 0;
+    if (!written) {
+        _failed = true;
+    }
+    return written;
+}
+
+bool MqttBurst::begin(const char* clientId, const char* username, const char* password, uint16_t keepAliveSeconds) {
+    _stats = MqttBurstStats();
+    _used = 0;
+    _failed = false;
+    _open = true;
+    
+    bool auth = username != nullptr && username[0] != '\0';
+    size_t idLength = strlen(clientId);
+    size_t userLength = auth ? strlen(username) : 0;
+    size_t passLength = auth && password != nullptr ? strlen(password) : 0;
+    
+    uint8_t flags = 0x02;  // Clean session
+    if (auth) {
+        flags |= 0x80;
+        if (password != nullptr) {
+            flags |= 0x40;
+        }
+    }
+    
+    const uint8_t variableHeader[10] = { 0, 4, 'M', 'Q', 'T', 'T', 4, flags,
+                                         (uint8_t)(keepAliveSeconds >> 8), (uint8_t)(keepAliveSeconds & 0xFF) };
+    size_t remaining = sizeof(variableHeader) + 2 + idLength + (auth ? 2 + userLength : 0) +
+                       (auth && password != nullptr ? 2 + passLength : 0);
+    bool ok = appendHeader(MQTT_PACKET_CONNECT << 4, remaining) &&
+              append(variableHeader, sizeof(variableHeader)) &&
+              appendString(clientId, idLength);
+    if (ok && auth) {
+        ok = appendString(username, userLength) && (password == nullptr || appendString(password, passLength));
+    }
+    _stats.packets++;
+    return ok;
+}
+
+bool MqttBurst::publish(const char* topic, const uint8_t* payload, size_t length, bool retained) {
+    if (!_open || _failed) {
+        return false;
+    }
+    size_t topicLength = strlen(topic);
+    size_t remaining = 2 + topicLength + length;
+    if (remaining > 268435455UL) {
+        return false;
+    }
+    if (!appendHeader((MQTT_PACKET_PUBLISH << 4) | (retained ? 1 : 0), remaining) ||
+        !appendString(topic, topicLength) ||
+        !append(payload, length)) {
+        return false;
+    }
+    _stats.packets++;
+    return true;
+}
+
+int MqttBurst::finish(uint32_t timeoutMs) {
+    if (!_open) {
+        return -3;
+    }
+    _open = false;
+    
+    const uint8_t tail[4] = { MQTT_PACKET_PINGREQ << 4, 0, MQTT_PACKET_DISCONNECT << 4, 0 };
+    if (!append(tail, sizeof(tail)) || !writeOut() || _failed) {
+        return -3;
+    }
+    _stats.packets += 2;
+    
+    // Expected back: CONNACK (4 bytes) then PINGRESP (2 bytes)
+    uint8_t response[6];
+    size_t received = 0;
+    int result = -4;
+    while (millis() - _firstWriteMs < timeoutMs) {
+        while (received < sizeof(response) && _client.available() > 0) {
+            int b = _client.read();
+            if (b < 0) {
+                break;
+            }
+            response[received++] = (uint8_t)b;
+        }
+        
+        if (received >= 4 && result == -4) {
+            if (response[0] != (MQTT_PACKET_CONNACK << 4) || response[1] != 2) {
+                return -3;  // Not a CONNACK - protocol error
+            }
+            _stats.connackMs = millis() - _firstWriteMs;
+            result = response[3];
+            if (result != 0) {
+                return result;  // Rejected - the broker ignored the rest
+            }
+        }
+        if (received == sizeof(response)) {
+            if (response[4] != (MQTT_PACKET_PINGRESP << 4)) {
+                return -3;  // Not a PINGRESP - protocol error
+            }
+            _stats.flushMs = millis() - _firstWriteMs;
+            return 0;
+        }
+        if (!_client.connected() && _client.available() == 0) {
+            return -3;  // Closed before the PINGRESP: the publishes are unconfirmed
+        }
+        delay(1);
+    }
+    if (result == 0) {
+        _stats.flushMs = timeoutMs;  // Accepted, PINGRESP not seen in time
+    }
+    return -4;
+}
@@ -0,0 +1,73 @@
+#ifndef MQTT_BURST_H
+#define MQTT_BURST_H
+
+#include <Arduino.h>
+#include <Client.h>
+
+// ============================================
+// BURST SETTINGS
+// ============================================
+#define MQTT_BURST_BUFFER_SIZE 2048   // Preallocated; a larger burst (discovery) goes out in chunks
+
+// Counters of the last burst
+struct MqttBurstStats {
+    uint16_t packets;
+    uint16_t writes;      // Socket writes
+    uint32_t bytes;
+    uint32_t connackMs;   // First write to CONNACK
+    uint32_t flushMs;     // First write to PINGRESP (everything processed)
+    
+    MqttBurstStats() : packets(0), writes(0), bytes(0), connackMs(0), flushMs(0) {}
+};
+
+/**
+ * MqttBurst - One-shot MQTT 3.1.1 session written in as few socket writes as possible
+ *
+ * A normal wake sends CONNECT, waits a round trip for the CONNACK, then
+ * writes every PUBLISH, the flush PINGREQ and the DISCONNECT separately -
+ * many small TCP segments and radio bursts. MqttBurst serializes the whole
+ * session (CONNECT, PUBLISH..., PINGREQ, DISCONNECT) into one buffer and
+ * writes it at once; the broker processes the packets in order, so a
+ * single round trip later the CONNACK confirms the credentials were
+ * accepted and the PINGRESP that every PUBLISH was handled.
+ *
+ * If the broker rejects the CONNECT it drops everything after it, and
+ * without the PINGRESP nothing says the publishes were processed, so the
+ * caller must treat a non-zero finish() as "nothing was delivered".
+ * QoS 0 only; nothing can be received before finish().
+ */
+class MqttBurst {
+public:
+    MqttBurst(Client& client);
+    
+    // Start a burst on an open socket with the CONNECT packet
+    bool begin(const char* clientId, const char* username, const char* password, uint16_t keepAliveSeconds);
+    bool isOpen() { return _open; }
+    
+    // Queue one QoS 0 PUBLISH (written out early only if the buffer fills)
+    bool publish(const char* topic, const uint8_t* payload, size_t length, bool retained);
+    
+    // Append PINGREQ + DISCONNECT, write the rest and wait for CONNACK and
+    // PINGRESP. Returns 0 once both arrived, the CONNACK return code if the
+    // CONNECT was rejected, -4 on timeout or -3 if the connection dropped -
+    // an accepted CONNACK without the PINGRESP is not a success.
+    int finish(uint32_t timeoutMs);
+    
+    const MqttBurstStats& getStats() { return _stats; }
+
+private:
+    Client& _client;
+    bool _open;
+    bool _failed;             // A write failed - finish() reports the connection lost
+    unsigned long _firstWriteMs;
+    size_t _used;
+    uint8_t _buffer[MQTT_BURST_BUFFER_SIZE];
+    MqttBurstStats _stats;
+    
+    bool append(const uint8_t* data, size_t length);
+    bool appendHeader(uint8_t type, size_t remaining);
+    bool appendString(const char* text, size_t length);
+    bool writeOut();
+};
+
+#endif // MQTT_BURST_H
@@ -1,9 +1,79 @@
 #include "mqtt_manager.h"
+#include "device_identity.h"
 #include "logger.h"
+#include "nvs_store.h"
+#include "telemetry_queue.h"
+#include "version.h"
 #include <WiFi.h>
+#include <esp_rom_crc.h>
+#include <memory>
+
+// Hash of the last discovery set Home Assistant received. The RTC copy
+// survives deep sleep; after a cold boot it is reloaded from NVS.
+#define MQTT_DISCOVERY_STATE_MAGIC 0x43534944UL  // "DISC"
+
+struct DiscoveryState {
+    uint32_t magic;
+    uint32_t hash;
+};
+
+static RTC_DATA_ATTR DiscoveryState rtc_discoveryState;
+
+// Resolved broker address, reused across deep sleep (see resolveBroker)
+#define MQTT_BROKER_CACHE_MAGIC 0x534E4442UL  // "BDNS"
+struct BrokerAddressCache {
+    uint32_t magic;
+    uint32_t hostHash;    // CRC32 of the host name it belongs to
+    uint32_t address;     // IPv4
+    uint32_t resolvedAt;  // time() seconds - keeps running through deep sleep
+};
+static RTC_DATA_ATTR BrokerAddressCache rtc_brokerAddress;
+
+// Report on change: the value and time each sensor was last sent. Slots
+// are found by a hash of the sensor key; the least recently sent one is
+// reused when a new sensor appears. Deadbands and heartbeats are in the
+// sensor descriptors (sensor_registry.cpp). 16 bytes of RTC slow memory
+// per registry slot (about 1 KB at SENSOR_REGISTRY_SIZE 64).
+#define MQTT_REPORT_STATE_MAGIC 0x54504552UL  // "REPT"
+struct ReportedValue {
+    uint32_t keyHash;     // CRC32 of the sensor key, 0 = free
+    uint32_t valueHash;   // CRC32 of the formatted value
+    float value;
+    uint32_t sentAt;      // time() seconds - keeps running through deep sleep
+};
+struct ReportState {
+    uint32_t magic;
+    ReportedValue values[SENSOR_REGISTRY_SIZE];
+};
+static RTC_DATA_ATTR ReportState rtc_reportState;
+
+static uint32_t hashText(const char* text) {
+    return esp_rom_crc32_le(0, (const uint8_t*)text, strlen(text));
+}
+
+static ReportedValue* findReported(uint32_t keyHash) {
+    for (ReportedValue& slot : rtc_reportState.values) {
+        if (slot.keyHash == keyHash) {
+            return &slot;
+        }
+    }
+    return nullptr;
+}
+
+// Flush time of the last cycle, reported with the next one (0 until the
+// first flush after a cold boot, so the sensor set stays stable)
+static RTC_DATA_ATTR uint32_t rtc_lastFlushMs = 0;
 
 MQTTManager::MQTTManager(ConfigManager* configManager)
-    : _configManager(configManager), _mqttClient(nullptr), _port(1883), _isConfigured(false) {
+    : _configManager(configManager), _netClient(_wifiClient), _mqttClient(nullptr), _port(1883), _isConfigured(false),
+      _initialized(false), _combinedState(MQTT_COMBINED_STATE), _deviceDiscovery(MQTT_DEVICE_DISCOVERY),
+      _discoveryRequested(false), _qos1(MQTT_QOS1), _qos1Publisher(_netClient),
+      _mqtt5(MQTT_PROTOCOL_V5), _mqtt5Client(_netClient),
+      _burstMode(MQTT_BURST), _burstActive(false), _burst(_netClient),
+      _reportOnChange(MQTT_REPORT_ON_CHANGE), _lastPacketId(0),
+      _persistent(false), _sessionUp(false), _nextAttemptMs(0), _dnsTimeMs(0),
+      _brokerResolved(false) {
+    _topicDeviceId[0] = '\0';
 }
 
 MQTTManager::~MQTTManager() {
@@ -15,6 +85,11 @@ MQTTManager::~MQTTManager() {
 }
 
 bool MQTTManager::begin() {
+    if (_initialized) {
+        return _isConfigured || _broker.length() == 0;
+    }
+    _initialized = true;
+    
     LogBox::begin("Initializing MQTT Manager");
     
     // Load MQTT configuration
@@ -31,8 +106,8 @@ bool MQTTManager::begin() {
     }
     
     // Parse broker URL
-    String host;
-    if (!parseBrokerURL(_broker, host, _port)) {
+    bool tls = false;
+    if (!parseBrokerURL(_broker, _host, _port, tls)) {
         _lastError = "Invalid broker URL format";
         LogBox::line("ERROR: " + _lastError);
         LogBox::end();
@@ -40,18 +115,45 @@ bool MQTTManager::begin() {
         return false;
     }
     
-    LogBox::line("Broker: " + host + ":" + String(_port));
+    LogBox::line("Broker: " + _host + ":" + String(_port) + (tls ? " (TLS)" : ""));
+    _netClient.setTls(tls, _host.c_str());
     LogBox::line("Username: " + (_username.length() > 0 ? _username : "(none)"));
+    if (_persistent) {
+        LogBox::line("Session: persistent");
+    }
+    if (_mqtt5) {
+        LogBox::line("Protocol: MQTT 5");
+        if (_qos1) {
+            LogBox::line("QoS 1 needs MQTT 3.1.1 - using QoS 0");
+            _qos1 = false;
+        }
+    }
     
     // Create MQTT client
     if (_mqttClient == nullptr) {
-        _mqttClient = new PubSubClient(_wifiClient);
+        _mqttClient = new PubSubClient(_netClient);
     }
     
     _mqttClient->setBufferSize(MQTT_MAX_PACKET_SIZE);
-    _mqttClient->setServer(host.c_str(), _port);
-    _mqttClient->setKeepAlive(5);
+    _mqttClient->setServer(_host.c_str(), _port);
+    _mqttClient->setKeepAlive(_persistent ? MQTT_PERSISTENT_KEEPALIVE_SECONDS : MQTT_KEEPALIVE_SECONDS);
     _mqttClient->setSocketTimeout(2);
+    if (_persistent) {
+        _mqttClient->setCallback([this](char* topic, uint8_t* payload, unsigned int length) {
+            handleMessage(topic, payload, length);
+        });
+        // Incoming messages read while waiting for PUBACKs
+        _qos1Publisher.setMessageHandler([this](const char* topic, const uint8_t* payload, unsigned int length) {
+            handleMessage(topic, payload, length);
+        });
+        _mqtt5Client.setCallback([this](char* topic, uint8_t* payload, unsigned int length) {
+            handleMessage(topic, payload, length);
+        });
+    }
+    
+    // MQTT 5: same keepalive; a persistent session outlives short drops
+    _mqtt5Client.setKeepAlive(_persistent ? MQTT_PERSISTENT_KEEPALIVE_SECONDS : MQTT_KEEPALIVE_SECONDS);
+    _mqtt5Client.setSessionExpiry(_persistent ? MQTT5_SESSION_EXPIRY_SECONDS : 0);
     
     _isConfigured = true;
     LogBox::end("MQTT Manager initialized successfully");
@@ -69,96 +171,358 @@ bool MQTTManager::connect() {
         return false;
     }
     
+    if (clientConnected()) {
+        return true;  // Session still up
+    }
+    
+    if (_persistent) {
+        return reconnect();
+    }
+    
     LogBox::begin("Connecting to MQTT broker");
     
-    String host;
-    int port;
-    if (!parseBrokerURL(_broker, host, port)) {
-        _lastError = "Failed to parse broker URL";
+    const int maxRetries = 3;
+    bool connected = false;
+    
+    for (int attempt = 1; attempt <= maxRetries && !connected; attempt++) {
+        LogBox::linef("Connection attempt %d/%d...", attempt, maxRetries);
+        connected = connectOnce();
+        if (!connected && attempt < maxRetries) {
+            delay(500);
+        }
+    }
+    
+    if (connected) {
+        LogBox::end("Connected to MQTT broker");
+        return true;
+    } else {
+        int finalState = clientState();
+        _lastError = "Connection failed after " + String(maxRetries) + " attempts (state: " + String(finalState) + ")";
         LogBox::line("ERROR: " + _lastError);
+        forgetBrokerAddress();  // The next connect resolves again
         LogBox::end();
         return false;
     }
+}
+
+bool MQTTManager::connectOnce() {
+    LogBox::linef("Broker: %s:%d", _host.c_str(), _port);
     
-    LogBox::line("Broker: " + host + ":" + String(port));
-    
-    String clientId = "esp32-" + String((uint32_t)ESP.getEfuseMac(), HEX);
-    LogBox::line("Client ID: " + clientId);
-    LogBox::line("Auth: " + String(_username.length() > 0 ? "using credentials" : "anonymous"));
+    const char* clientId = DeviceIdentity::getMqttClientId();
+    LogBox::linef("Client ID: %s", clientId);
+    LogBox::linef("Auth: %s", _username.length() > 0 ? "using credentials" : "anonymous");
     if (_username.length() > 0) {
-        LogBox::line("  User: " + _username);
-        LogBox::line("  Pass length: " + String(_password.length()));
+        LogBox::linef("  User: %s", _username.c_str());
+        LogBox::linef("  Pass length: %u", (unsigned)_password.length());
     }
     
-    const int maxRetries = 3;
+    // Try the cached broker address first; if that fails, resolve again
+    // and retry once right away
     bool connected = false;
-    
-    for (int attempt = 1; attempt <= maxRetries && !connected; attempt++) {
-        LogBox::linef("Connection attempt %d/%d...", attempt, maxRetries);
+    bool useCache = true;
+    for (int lookup = 0; lookup < 2 && !connected; lookup++) {
+        IPAddress address;
+        bool fromCache = false;
+        if (!resolveBroker(address, useCache, fromCache)) {
+            break;
+        }
         
-        // Force WiFiClient to stop any previous connection
-        _wifiClient.stop();
+        // Force the client to stop any previous connection
+        _netClient.stop();
         delay(100);  // Give time for socket to fully close
         
-        // Reconnect PubSubClient to server (refreshes internal state)
-        _mqttClient->setServer(host.c_str(), port);
-        
-        if (_username.length() > 0) {
-            connected = _mqttClient->connect(clientId.c_str(), _username.c_str(), _password.c_str());
+        // Connect by address - PubSubClient would resolve a host name every time
+        _mqttClient->setServer(address, _port);
+        if (_burstActive) {
+            // Only the socket now - the CONNECT goes out with the publishes
+            connected = _netClient.connect(address, _port) &&
+                        _burst.begin(clientId, _username.c_str(), _password.c_str(), MQTT_KEEPALIVE_SECONDS);
+        } else if (_mqtt5) {
+            connected = _mqtt5Client.connect(address, _port, clientId, _username.c_str(), _password.c_str());
+        } else if (_username.length() > 0) {
+            connected = _mqttClient->connect(clientId, _username.c_str(), _password.c_str());
         } else {
-            connected = _mqttClient->connect(clientId.c_str());
+            connected = _mqttClient->connect(clientId);
         }
         
-        if (!connected) {
-            int state = _mqttClient->state();
-            LogBox::line("  Failed with state: " + String(state));
-            switch(state) {
-                case -4: LogBox::line("  MQTT_CONNECTION_TIMEOUT"); break;
-                case -3: LogBox::line("  MQTT_CONNECTION_LOST"); break;
-                case -2: LogBox::line("  MQTT_CONNECT_FAILED"); break;
-                case -1: LogBox::line("  MQTT_DISCONNECTED"); break;
-                case 1: LogBox::line("  MQTT_CONNECT_BAD_PROTOCOL"); break;
-                case 2: LogBox::line("  MQTT_CONNECT_BAD_CLIENT_ID"); break;
-                case 3: LogBox::line("  MQTT_CONNECT_UNAVAILABLE"); break;
-                case 4: LogBox::line("  MQTT_CONNECT_BAD_CREDENTIALS"); break;
-                case 5: LogBox::line("  MQTT_CONNECT_UNAUTHORIZED"); break;
-            }
-            
-            if (attempt < maxRetries) {
-                delay(500);
-            }
+        if (connected || !fromCache || _brokerResolved) {
+            break;  // An address resolved during this wake is not looked up again
         }
+        LogBox::line("  Cached broker address failed - resolving again");
+        rtc_brokerAddress.magic = 0;
+        useCache = false;
     }
     
     if (connected) {
-        LogBox::end("Connected to MQTT broker");
+        _sessionStats.connects++;
+        _qos1Publisher.reset();  // Nothing from an earlier connection is in flight
+        if (_burstActive) {
+            LogBox::line("Burst: socket open, CONNECT goes out with the publishes");
+        }
+        if (_mqtt5) {
+            const Mqtt5Stats& stats = _mqtt5Client.getStats();
+            LogBox::linef("MQTT 5: %u topic aliases, keepalive %u s, session %s", stats.aliasMax, stats.keepAlive,
+                          stats.sessionPresent ? "resumed" : "new");
+        }
         return true;
-    } else {
-        int finalState = _mqttClient->state();
-        _lastError = "Connection failed after " + String(maxRetries) + " attempts (state: " + String(finalState) + ")";
-        LogBox::line("ERROR: " + _lastError);
+    }
+    
+    _sessionStats.failedAttempts++;
+    int state = clientState();
+    LogBox::linef("  Failed with state: %d", state);
+    if (_mqtt5 && state > 0) {
+        LogBox::linef("  CONNACK reason code 0x%02X", state);  // MQTT 5 codes (0x80+)
+    }
+    switch(state) {
+        case -4: LogBox::line("  MQTT_CONNECTION_TIMEOUT"); break;
+        case -3: LogBox::line("  MQTT_CONNECTION_LOST"); break;
+        case -2: LogBox::line("  MQTT_CONNECT_FAILED"); break;
+        case -1: LogBox::line("  MQTT_DISCONNECTED"); break;
+        case 1: LogBox::line("  MQTT_CONNECT_BAD_PROTOCOL"); break;
+        case 2: LogBox::line("  MQTT_CONNECT_BAD_CLIENT_ID"); break;
+        case 3: LogBox::line("  MQTT_CONNECT_UNAVAILABLE"); break;
+        case 4: LogBox::line("  MQTT_CONNECT_BAD_CREDENTIALS"); break;
+        case 5: LogBox::line("  MQTT_CONNECT_UNAUTHORIZED"); break;
+    }
+    return false;
+}
+
+void MQTTManager::setPersistentSession(bool persistent) {
+    _persistent = persistent;
+}
+
+bool MQTTManager::isPersistentSession() {
+    return _persistent;
+}
+
+void MQTTManager::setCombinedState(bool combined) {
+    _combinedState = combined;
+}
+
+bool MQTTManager::isCombinedState() {
+    return _combinedState;
+}
+
+void MQTTManager::setDeviceDiscovery(bool deviceDiscovery) {
+    _deviceDiscovery = deviceDiscovery;
+}
+
+bool MQTTManager::isDeviceDiscovery() {
+    return _deviceDiscovery;
+}
+
+void MQTTManager::setQoS1(bool qos1) {
+    _qos1 = qos1;
+}
+
+bool MQTTManager::isQoS1() {
+    return _qos1;
+}
+
+void MQTTManager::setProtocolV5(bool v5) {
+    _mqtt5 = v5;
+}
+
+bool MQTTManager::isProtocolV5() {
+    return _mqtt5;
+}
+
+const Mqtt5Stats& MQTTManager::getMqtt5Stats() {
+    return _mqtt5Client.getStats();
+}
+
+void MQTTManager::setBurst(bool burst) {
+    _burstMode = burst;
+}
+
+bool MQTTManager::isBurst() {
+    return _burstMode;
+}
+
+const MqttBurstStats& MQTTManager::getBurstStats() {
+    return _burst.getStats();
+}
+
+void MQTTManager::setReportOnChange(bool reportOnChange) {
+    _reportOnChange = reportOnChange;
+}
+
+bool MQTTManager::isReportOnChange() {
+    return _reportOnChange;
+}
+
+const MqttAckStats& MQTTManager::getAckStats() {
+    return _qos1Publisher.getStats();
+}
+
+const MqttTlsStats& MQTTManager::getTlsStats() {
+    return _netClient.getStats();
+}
+
+bool MQTTManager::isConnected() {
+    return _mqttClient != nullptr && clientConnected();
+}
+
+bool MQTTManager::clientConnected() {
+    return _mqtt5 ? _mqtt5Client.connected() : _mqttClient->connected();
+}
+
+bool MQTTManager::clientLoop() {
+    return _mqtt5 ? _mqtt5Client.loop() : _mqttClient->loop();
+}
+
+int MQTTManager::clientState() {
+    return _mqtt5 ? _mqtt5Client.state() : _mqttClient->state();
+}
+
+const MQTTSessionStats& MQTTManager::getSessionStats() {
+    return _sessionStats;
+}
+
+void MQTTManager::loop() {
+    if (!_persistent || !_isConfigured || _mqttClient == nullptr) {
+        return;
+    }
+    
+    if (clientLoop()) {
+        return;  // Connected - keepalive and incoming packets handled
+    }
+    
+    if (_sessionUp) {
+        _sessionUp = false;
+        _sessionStats.drops++;
+        _nextAttemptMs = millis();  // First reconnect right away
+        forgetBrokerAddress();      // The broker may have moved
+        LogBox::messagef("MQTT", "Connection lost (state: %d)", clientState());
+    }
+    
+    reconnect();
+}
+
+bool MQTTManager::reconnect() {
+    if (_nextAttemptMs != 0 && (long)(millis() - _nextAttemptMs) < 0) {
+        _lastError = "Waiting for reconnect backoff";
+        return false;
+    }
+    if (WiFi.status() != WL_CONNECTED) {
+        _lastError = "WiFi not connected";
+        return false;
+    }
+    
+    bool hadSession = _sessionStats.connects > 0;
+    
+    LogBox::begin(hadSession ? "Reconnecting to MQTT broker" : "Connecting to MQTT broker");
+    if (!connectOnce()) {
+        scheduleReconnect();
+        forgetBrokerAddress();
+        _lastError = "Connection failed (state: " + String(clientState()) + ")";
+        LogBox::linef("Next attempt in %lu ms", (unsigned long)_sessionStats.backoffMs);
         LogBox::end();
         return false;
     }
+    
+    if (hadSession) {
+        _sessionStats.reconnects++;
+    }
+    _sessionUp = true;
+    
+    // Clean session - subscribe again after every connect (an MQTT 5
+    // session the broker kept still has the subscription)
+    if (_mqtt5 && _mqtt5Client.getStats().sessionPresent) {
+        LogBox::line("Subscription kept by the broker session");
+    } else if (_mqtt5 ? _mqtt5Client.subscribe(MQTT_HA_STATUS_TOPIC) : _mqttClient->subscribe(MQTT_HA_STATUS_TOPIC)) {
+        LogBox::line("Subscribed to " MQTT_HA_STATUS_TOPIC);
+    }
+    _sessionStats.backoffMs = 0;
+    _nextAttemptMs = 0;
+    LogBox::linef("Session: %lu connect(s), %lu reconnect(s), %lu drop(s), %lu failed attempt(s)",
+                  (unsigned long)_sessionStats.connects, (unsigned long)_sessionStats.reconnects,
+                  (unsigned long)_sessionStats.drops, (unsigned long)_sessionStats.failedAttempts);
+    LogBox::end("Connected to MQTT broker");
+    return true;
+}
+
+void MQTTManager::scheduleReconnect() {
+    // Exponential backoff with jitter so a fleet does not reconnect in lockstep
+    // after a broker restart
+    uint32_t backoff = _sessionStats.backoffMs == 0 ? MQTT_RECONNECT_MIN_MS : _sessionStats.backoffMs * 2;
+    if (backoff > MQTT_RECONNECT_MAX_MS) {
+        backoff = MQTT_RECONNECT_MAX_MS;
+    }
+    _sessionStats.backoffMs = backoff;
+    _nextAttemptMs = millis() + backoff + random(backoff / 2 + 1);
+    if (_nextAttemptMs == 0) {
+        _nextAttemptMs = 1;  // 0 means "no backoff pending"
+    }
 }
 
 void MQTTManager::disconnect() {
-    if (_mqttClient != nullptr && _mqttClient->connected()) {
-        _mqttClient->disconnect();
+    _sessionUp = false;
+    if (_mqttClient != nullptr && clientConnected()) {
+        if (_mqtt5) {
+            _mqtt5Client.disconnect();
+        } else {
+            _mqttClient->disconnect();
+        }
         LogBox::message("MQTT", "Disconnected from broker");
     }
 }
 
-bool MQTTManager::parseBrokerURL(const String& url, String& host, int& port) {
-    // Expected formats: "mqtt://hostname:port" or "hostname:port" or "hostname"
+bool MQTTManager::resolveBroker(IPAddress& address, bool useCache, bool& fromCache) {
+    fromCache = false;
+    if (address.fromString(_host.c_str())) {
+        return true;  // IP literal - nothing to resolve
+    }
+    
+    uint32_t hostHash = esp_rom_crc32_le(0, (const uint8_t*)_host.c_str(), _host.length());
+    uint32_t now = (uint32_t)time(nullptr);
+    if (useCache && rtc_brokerAddress.magic == MQTT_BROKER_CACHE_MAGIC && rtc_brokerAddress.hostHash == hostHash &&
+        now - rtc_brokerAddress.resolvedAt < MQTT_DNS_CACHE_TTL_SECONDS) {
+        address = IPAddress(rtc_brokerAddress.address);
+        fromCache = true;
+        LogBox::linef("Broker address: %u.%u.%u.%u (cached %lu s ago)", address[0], address[1], address[2],
+                      address[3], (unsigned long)(now - rtc_brokerAddress.resolvedAt));
+        return true;
+    }
+    
+    unsigned long start = millis();
+    bool resolved = WiFi.hostByName(_host.c_str(), address) == 1;
+    uint32_t elapsed = millis() - start;
+    _dnsTimeMs += elapsed;
+    if (!resolved) {
+        _lastError = "DNS lookup failed for " + _host;
+        LogBox::linef("  DNS lookup for %s failed (%lu ms)", _host.c_str(), (unsigned long)elapsed);
+        return false;
+    }
+    LogBox::linef("Broker address: %u.%u.%u.%u (DNS %lu ms)", address[0], address[1], address[2], address[3],
+                  (unsigned long)elapsed);
+    
+    _brokerResolved = true;
+    rtc_brokerAddress.magic = MQTT_BROKER_CACHE_MAGIC;
+    rtc_brokerAddress.hostHash = hostHash;
+    rtc_brokerAddress.address = (uint32_t)address;
+    rtc_brokerAddress.resolvedAt = now;
+    return true;
+}
+
+void MQTTManager::forgetBrokerAddress() {
+    _brokerResolved = false;
+    rtc_brokerAddress.magic = 0;
+}
+
+bool MQTTManager::parseBrokerURL(const String& url, String& host, int& port, bool& tls) {
+    // Expected formats: "mqtt://hostname:port", "mqtts://hostname:port", "hostname:port" or "hostname"
     String workUrl = url;
     
     // Remove protocol prefix if present
+    tls = false;
     if (workUrl.startsWith("mqtt://")) {
         workUrl = workUrl.substring(7);
     } else if (workUrl.startsWith("mqtts://")) {
         workUrl = workUrl.substring(8);
+        tls = true;
     }
+    int defaultPort = tls ? MQTT_TLS_PORT : 1883;
     
     // Split host and port
     int colonPos = workUrl.lastIndexOf(':');
@@ -167,171 +531,334 @@ bool MQTTManager::parseBrokerURL(const String& url, String& host, int& port) {
         String portStr = workUrl.substring(colonPos + 1);
         port = portStr.toInt();
         if (port == 0) {
-            port = 1883;  // Default MQTT port
+            port = defaultPort;
         }
     } else {
         host = workUrl;
-        port = 1883;
+        port = defaultPort;
     }
     
     return host.length() > 0;
 }
 
-String MQTTManager::getDiscoveryTopic(const String& deviceId, const String& sensorType) {
-    return "homeassistant/sensor/" + deviceId + "/" + sensorType + "/config";
+const char* MQTTManager::topicPrefix(const String& deviceId) {
+    // Rebuilt only when the device ID changes (friendly name edits)
+    if (_topicPrefix.length() == 0 || strcmp(_topicDeviceId, deviceId.c_str()) != 0) {
+        strncpy(_topicDeviceId, deviceId.c_str(), sizeof(_topicDeviceId) - 1);
+        _topicDeviceId[sizeof(_topicDeviceId) - 1] = '\0';
+        _topicPrefix.clear();
+        _topicPrefix.append("homeassistant/sensor/");
+        _topicPrefix.append(deviceId);
+    }
+    return _topicPrefix.c_str();
 }
 
-String MQTTManager::getStateTopic(const String& deviceId, const String& sensorType) {
-    return "homeassistant/sensor/" + deviceId + "/" + sensorType + "/state";
+void MQTTManager::buildTopic(MqttWriter& topic, const String& deviceId, const char* sensorType, const char* suffix) {
+    // <prefix>/<sensorType>/<suffix>, or <prefix>/<suffix> without a sensor type
+    topic.clear();
+    topic.append(topicPrefix(deviceId));
+    topic.append('/');
+    if (sensorType != nullptr) {
+        topic.append(sensorType);
+        topic.append('/');
+    }
+    topic.append(suffix);
 }
 
-String MQTTManager::buildDeviceInfoJSON(const String& deviceId, const String& deviceName, const String& modelName, bool full) {
-    String json = "\"device\":{";
-    json += "\"identifiers\":[\"" + deviceId + "\"],";
-    json += "\"name\":\"" + deviceName + "\",";
-    json += "\"model\":\"" + modelName + "\",";
-    json += "\"manufacturer\":\"ESP32\"";
+void MQTTManager::appendDeviceInfo(MqttWriter& out, const TelemetryData& data, bool full) {
+    out.jsonKey("device");
+    out.beginObject();
+    out.jsonKey("identifiers");
+    out.append("[\"");
+    out.appendEscaped(data.deviceId.c_str());
+    out.append("\"]");
+    out.jsonString("name", data.deviceName.c_str());
+    out.jsonString("model", data.modelName.c_str());
+    out.jsonString("manufacturer", "ESP32");
     if (full) {
-        json += ",\"sw_version\":\"1.0.0\"";  // Update with actual version
+        out.jsonString("sw_version", FIRMWARE_VERSION);
     }
-    json += "}";
-    return json;
+    out.endObject();
 }
 
-bool MQTTManager::shouldPublishDiscovery(WakeupReason wakeReason) {
-    // Publish discovery on first boot, button press, or reset
-    return (wakeReason == WAKEUP_FIRST_BOOT || 
-            wakeReason == WAKEUP_BUTTON || 
-            wakeReason == WAKEUP_RESET_BUTTON);
+uint32_t MQTTManager::discoveryHash(const TelemetryData& data, const SensorValues& values) {
+    // Everything that ends up in the discovery payloads; the terminating
+    // NUL is hashed too so adjacent fields cannot run into each other
+    uint32_t hash = 0;
+    auto mix = [&hash](const char* value) {
+        hash = esp_rom_crc32_le(hash, (const uint8_t*)value, strlen(value) + 1);
+    };
+    
+    mix(data.deviceId.c_str());
+    mix(data.deviceName.c_str());
+    mix(data.modelName.c_str());
+    mix(FIRMWARE_VERSION);
+    mix(_combinedState ? "combined" : "per-sensor");
+    mix(_deviceDiscovery ? "device" : "sensor");
+    for (int id = 0; id < SensorRegistry::count(); id++) {
+        if (!values.has(id)) {
+            continue;
+        }
+        const SensorDescriptor& sensor = SensorRegistry::get(id);
+        mix(sensor.key);
+        mix(sensor.name);
+        mix(sensor.deviceClass);
+        mix(sensor.unit);
+        mix(sensor.withAttributes ? "attributes" : "");
+    }
+    return hash;
 }
 
-bool MQTTManager::publishSensorDiscovery(const String& discoveryTopic, const String& deviceId, const String& sensorType,
-                                        const String& name, const String& deviceClass, const String& unit,
-                                        const String& deviceName, const String& modelName, bool includeFullDevice) {
-    String payload = "{";
-    payload += "\"name\":\"" + name + "\",";
-    payload += "\"unique_id\":\"" + deviceId + "_" + sensorType + "\",";
-    payload += "\"state_topic\":\"" + getStateTopic(deviceId, sensorType) + "\"";
+bool MQTTManager::shouldPublishDiscovery(uint32_t hash) {
+    if (_discoveryRequested) {
+        LogBox::line("Discovery requested");
+        return true;
+    }
+    
+    if (rtc_discoveryState.magic != MQTT_DISCOVERY_STATE_MAGIC) {
+        // Cold boot - reload the last published hash
+        rtc_discoveryState.magic = MQTT_DISCOVERY_STATE_MAGIC;
+        rtc_discoveryState.hash = 0;
+        NvsStore store;
+        if (store.begin(MQTT_STATE_NAMESPACE, true)) {
+            store.getBytes(MQTT_DISCOVERY_HASH_KEY, &rtc_discoveryState.hash, sizeof(rtc_discoveryState.hash));
+            store.end();
+        }
+    }
     
-    if (deviceClass.length() > 0) {
-        payload += ",\"device_class\":\"" + deviceClass + "\"";
+    if (rtc_discoveryState.hash == hash) {
+        return false;
+    }
+    LogBox::linef("Discovery changed (hash %08lx -> %08lx)",
+                  (unsigned long)rtc_discoveryState.hash, (unsigned long)hash);
+    return true;
+}
+
+void MQTTManager::storeDiscoveryHash(uint32_t hash) {
+    _discoveryRequested = false;
+    if (rtc_discoveryState.magic == MQTT_DISCOVERY_STATE_MAGIC && rtc_discoveryState.hash == hash) {
+        return;
     }
+    rtc_discoveryState.magic = MQTT_DISCOVERY_STATE_MAGIC;
+    rtc_discoveryState.hash = hash;
     
-    if (unit.length() > 0) {
-        payload += ",\"unit_of_measurement\":\"" + unit + "\"";
+    // Written only when the discovery set changes (identical values are skipped)
+    NvsStore store;
+    if (store.begin(MQTT_STATE_NAMESPACE, false)) {
+        store.putBytes(MQTT_DISCOVERY_HASH_KEY, &hash, sizeof(hash));
+        store.end();
+    }
+}
+
+void MQTTManager::requestDiscovery() {
+    _discoveryRequested = true;
+}
+
+void MQTTManager::handleMessage(const char* topic, const uint8_t* payload, unsigned int length) {
+    // Home Assistant birth message: it lost the discovery configs on restart
+    if (strcmp(topic, MQTT_HA_STATUS_TOPIC) == 0 && length == 6 && memcmp(payload, "online", 6) == 0) {
+        LogBox::message("MQTT", "Home Assistant online - republishing discovery with next telemetry");
+        _discoveryRequested = true;
     }
+}
+
+void MQTTManager::collectSensors(const TelemetryData& data, SensorValues& values) {
+    values = data.values;
     
-    payload += "," + buildDeviceInfoJSON(deviceId, deviceName, modelName, includeFullDevice);
-    payload += "}";
+    // Broker lookups since the last telemetry - always present (0 when the
+    // cached address was used) so the sensor set stays stable
+    values.set(SENSOR_LOOP_TIME_DNS, _dnsTimeMs / 1000.0f);
+    
+    // Handshake of the current TLS connection (full or resumed, see the log)
+    if (_netClient.isTls()) {
+        values.set(SENSOR_MQTT_TLS_HANDSHAKE, _netClient.getStats().lastMs);
+    }
     
-    return _mqttClient->publish(discoveryTopic.c_str(), payload.c_str(), true);
+    // Readings waiting from broker outages (sent to <prefix>/backlog)
+    values.set(SENSOR_MQTT_BACKLOG, TelemetryQueue::depth());
 }
 
 bool MQTTManager::publishDiscovery(const TelemetryData& data) {
-    if (!_isConfigured || !_mqttClient->connected()) {
+    if (!_isConfigured || !clientConnected()) {
         return false;
     }
     
+    collectSensors(data, _values);
+    return publishDiscovery(data, _values);
+}
+
+bool MQTTManager::publishDiscovery(const TelemetryData& data, const SensorValues& values) {
+    if (_deviceDiscovery) {
+        return publishDeviceDiscovery(data, values);
+    }
+    
     LogBox::line("Publishing discovery messages...");
     
+    MqttBuffer<MQTT_TOPIC_BUFFER_SIZE> topic;
+    MqttWriter payload(_payload, MQTT_DISCOVERY_BUFFER_SIZE);
+    int sensorCount = 0;
     int publishCount = 0;
-    
-    // Battery voltage sensor
-    if (data.batteryVoltage > 0.0f) {
-        publishSensorDiscovery(getDiscoveryTopic(data.deviceId, "battery_voltage"), data.deviceId, "battery_voltage",
-                              "Battery Voltage", "voltage", "V", data.deviceName, data.modelName, true);
-        publishCount++;
-    }
-    
-    // Battery percentage sensor
-    if (data.batteryPercentage >= 0) {
-        publishSensorDiscovery(getDiscoveryTopic(data.deviceId, "battery_percentage"), data.deviceId, "battery_percentage",
-                              "Battery Percentage", "battery", "%", data.deviceName, data.modelName, false);
-        publishCount++;
+    for (int id = 0; id < SensorRegistry::count(); id++) {
+        if (!values.has(id)) {
+            continue;
+        }
+        const SensorDescriptor& sensor = SensorRegistry::get(id);
+        
+        payload.clear();
+        payload.beginObject();
+        appendSensorConfig(payload, data, sensor, true);
+        // First message carries the full device block (sw_version)
+        appendDeviceInfo(payload, data, sensorCount++ == 0);
+        payload.endObject();
+        
+        buildTopic(topic, data.deviceId, sensor.key, "config");
+        if (payload.overflow()) {
+            LogBox::linef("ERROR: %s discovery needs %u bytes", sensor.key, (unsigned)payload.requiredSize());
+            continue;
+        }
+        if (publishMessage(topic.c_str(), payload.c_str(), payload.length(), true)) {
+            publishCount++;
+        }
     }
     
-    // Loop time sensor
-    publishSensorDiscovery(getDiscoveryTopic(data.deviceId, "loop_time"), data.deviceId, "loop_time",
-                          "Loop Time", "duration", "s", data.deviceName, data.modelName, false);
-    publishCount++;
+    LogBox::linef("Published %d discovery messages", publishCount);
+    return publishCount == sensorCount;
+}
+
+void MQTTManager::appendSensorConfig(MqttWriter& out, const TelemetryData& data, const SensorDescriptor& sensor,
+                                     bool withStateTopic) {
+    MqttBuffer<MQTT_TOPIC_BUFFER_SIZE> topic;
     
-    // WiFi signal sensor
-    publishSensorDiscovery(getDiscoveryTopic(data.deviceId, "wifi_signal"), data.deviceId, "wifi_signal",
-                          "WiFi Signal", "signal_strength", "dBm", data.deviceName, data.modelName, false);
-    publishCount++;
+    out.jsonString("name", sensor.name);
+    out.jsonKey("unique_id");
+    out.append('"');
+    out.appendEscaped(data.deviceId.c_str());
+    out.append('_');
+    out.append(sensor.key);
+    out.append('"');
     
-    // WiFi BSSID sensor
-    if (data.wifiBSSID.length() > 0) {
-        publishSensorDiscovery(getDiscoveryTopic(data.deviceId, "wifi_bssid"), data.deviceId, "wifi_bssid",
-                              "WiFi BSSID", "", "", data.deviceName, data.modelName, false);
-        publishCount++;
+    if (_combinedState) {
+        // Every sensor reads its field from the shared state object
+        buildTopic(topic, data.deviceId, nullptr, "state");
+        if (withStateTopic) {
+            out.jsonString("state_topic", topic.c_str());
+        }
+        out.jsonKey("value_template");
+        out.append("\"{{value_json.");
+        out.append(sensor.key);
+        out.append("}}\"");
+        if (sensor.withAttributes) {
+            out.jsonString("json_attributes_topic", topic.c_str());
+            out.jsonKey("json_attributes_template");
+            out.append("\"{{value_json.");
+            out.append(sensor.key);
+            out.append("_attrs|tojson}}\"");
+        }
+    } else {
+        buildTopic(topic, data.deviceId, sensor.key, "state");
+        out.jsonString("state_topic", topic.c_str());
+        if (sensor.withAttributes) {
+            buildTopic(topic, data.deviceId, sensor.key, "attributes");
+            out.jsonString("json_attributes_topic", topic.c_str());
+        }
     }
     
-    // WiFi retry count
-    if (data.wifiRetryCount != 255) {
-        publishSensorDiscovery(getDiscoveryTopic(data.deviceId, "wifi_retries"), data.deviceId, "wifi_retries",
-                              "WiFi Retries", "", "", data.deviceName, data.modelName, false);
-        publishCount++;
+    if (sensor.deviceClass[0] != '\0') {
+        out.jsonString("device_class", sensor.deviceClass);
     }
-    
-    // Loop time breakdown
-    if (data.loopTimeWiFi > 0.0f) {
-        publishSensorDiscovery(getDiscoveryTopic(data.deviceId, "loop_time_wifi"), data.deviceId, "loop_time_wifi",
-                              "Loop Time - WiFi", "duration", "s", data.deviceName, data.modelName, false);
-        publishCount++;
+    if (sensor.unit[0] != '\0') {
+        out.jsonString("unit_of_measurement", sensor.unit);
     }
+}
+
+// Home Assistant device-based discovery: the device block and the shared
+// state topic are sent once, each sensor is an entry in "components"
+bool MQTTManager::publishDeviceDiscovery(const TelemetryData& data, const SensorValues& values) {
+    LogBox::line("Publishing device discovery message...");
     
-    if (data.loopTimeWork > 0.0f) {
-        publishSensorDiscovery(getDiscoveryTopic(data.deviceId, "loop_time_work"), data.deviceId, "loop_time_work",
-                              "Loop Time - Work", "duration", "s", data.deviceName, data.modelName, false);
-        publishCount++;
-    }
+    auto build = [&](MqttWriter& out) {
+        MqttBuffer<MQTT_TOPIC_BUFFER_SIZE> topic;
+        out.beginObject();
+        appendDeviceInfo(out, data, true);
+        out.jsonKey("origin");
+        out.beginObject();
+        out.jsonString("name", MQTT_DISCOVERY_ORIGIN);
+        out.endObject();
+        if (_combinedState) {
+            buildTopic(topic, data.deviceId, nullptr, "state");
+            out.jsonString("state_topic", topic.c_str());
+        }
+        out.jsonKey("components");
+        out.beginObject();
+        for (int id = 0; id < SensorRegistry::count(); id++) {
+            if (!values.has(id)) {
+                continue;
+            }
+            const SensorDescriptor& sensor = SensorRegistry::get(id);
+            topic.clear();
+            topic.append(data.deviceId);
+            topic.append('_');
+            topic.append(sensor.key);
+            out.jsonKey(topic.c_str());
+            out.beginObject();
+            out.jsonString("platform", "sensor");
+            appendSensorConfig(out, data, sensor, false);
+            out.endObject();
+        }
+        out.endObject();
+        out.endObject();
+    };
+    
+    // Sizing pass, then one exactly-sized buffer (discovery is rare - see
+    // shouldPublishDiscovery)
+    MqttWriter sizing(nullptr, 0);
+    build(sizing);
+    std::unique_ptr<char[]> buffer(new char[sizing.requiredSize()]);
+    MqttWriter payload(buffer.get(), sizing.requiredSize());
+    build(payload);
     
-    // Free heap sensor
-    if (data.freeHeap > 0) {
-        publishSensorDiscovery(getDiscoveryTopic(data.deviceId, "free_heap"), data.deviceId, "free_heap",
-                              "Free Heap", "", "bytes", data.deviceName, data.modelName, false);
-        publishCount++;
+    MqttBuffer<MQTT_TOPIC_BUFFER_SIZE> topic;
+    topic.append("homeassistant/device/");
+    topic.append(data.deviceId);
+    topic.append("/config");
+    if (!publishMessage(topic.c_str(), payload.c_str(), payload.length(), true)) {
+        LogBox::linef("ERROR: Device discovery (%u bytes) not sent", (unsigned)payload.length());
+        return false;
     }
     
-    LogBox::linef("Published %d discovery messages", publishCount);
+    LogBox::linef("Published %d sensors in 1 discovery message (%u bytes)", values.count(), (unsigned)payload.length());
     return true;
 }
 
-bool MQTTManager::publishBatteryVoltage(const String& deviceId, float voltage) {
-    if (!_isConfigured || !_mqttClient->connected()) return false;
-    String topic = getStateTopic(deviceId, "battery_voltage");
-    return _mqttClient->publish(topic.c_str(), String(voltage, 2).c_str());
-}
-
-bool MQTTManager::publishBatteryPercentage(const String& deviceId, int percentage) {
-    if (!_isConfigured || !_mqttClient->connected()) return false;
-    String topic = getStateTopic(deviceId, "battery_percentage");
-    return _mqttClient->publish(topic.c_str(), String(percentage).c_str());
-}
-
-bool MQTTManager::publishLoopTime(const String& deviceId, float loopTimeSeconds) {
-    if (!_isConfigured || !_mqttClient->connected()) return false;
-    String topic = getStateTopic(deviceId, "loop_time");
-    return _mqttClient->publish(topic.c_str(), String(loopTimeSeconds, 2).c_str());
-}
-
-bool MQTTManager::publishWiFiSignal(const String& deviceId, int rssi) {
-    if (!_isConfigured || !_mqttClient->connected()) return false;
-    String topic = getStateTopic(deviceId, "wifi_signal");
-    return _mqttClient->publish(topic.c_str(), String(rssi).c_str());
-}
-
-bool MQTTManager::publishWiFiBSSID(const String& deviceId, const String& bssid) {
-    if (!_isConfigured || !_mqttClient->connected()) return false;
-    String topic = getStateTopic(deviceId, "wifi_bssid");
-    return _mqttClient->publish(topic.c_str(), bssid.c_str());
+bool MQTTManager::publishMessage(const char* topic, const char* payload, size_t length, bool retained) {
+    if (_burstActive) {
+        return _burst.publish(topic, (const uint8_t*)payload, length, retained);
+    }
+    if (_qos1) {
+        // Written straight to the socket - the PubSubClient buffer is not used
+        _lastPacketId = _qos1Publisher.publish(topic, (const uint8_t*)payload, length, retained);
+        return _lastPacketId != 0;
+    }
+    if (_mqtt5) {
+        return _mqtt5Client.publish(topic, (const uint8_t*)payload, length, retained);
+    }
+    
+    // PubSubClient drops packets larger than its buffer - grow it to fit
+    // (2-byte topic length + up to MQTT_MAX_HEADER_SIZE fixed header)
+    size_t required = MQTT_MAX_HEADER_SIZE + 2 + strlen(topic) + length;
+    if (required > _mqttClient->getBufferSize()) {
+        if (required > UINT16_MAX || !_mqttClient->setBufferSize(required)) {
+            _lastError = "MQTT buffer too small";
+            return false;
+        }
+        LogBox::linef("MQTT buffer grown to %u bytes", (unsigned)required);
+    }
+    return _mqttClient->publish(topic, (const uint8_t*)payload, length, retained);
 }
 
-bool MQTTManager::publishFreeHeap(const String& deviceId, uint32_t freeHeap) {
-    if (!_isConfigured || !_mqttClient->connected()) return false;
-    String topic = getStateTopic(deviceId, "free_heap");
-    return _mqttClient->publish(topic.c_str(), String(freeHeap).c_str());
+bool MQTTManager::publish(const char* topic, const char* payload, size_t length, bool retained) {
+    if (!_isConfigured || !clientConnected()) return false;
+    return publishMessage(topic, payload, length, retained);
 }
 
 bool MQTTManager::publishAllTelemetry(const TelemetryData& data) {
@@ -341,125 +868,405 @@ bool MQTTManager::publishAllTelemetry(const TelemetryData& data) {
     }
     
     LogBox::begin("Publishing All Telemetry to MQTT");
-    LogBox::line("Connecting to MQTT broker...");
     
-    if (!connect()) {
+    // Burst: the cycle goes out in one write. Queued readings must stay
+    // queued until the broker confirms them, so a backlog takes the normal path.
+    bool burst = _burstMode && !_persistent && !_qos1 && !_mqtt5 && TelemetryQueue::depth() == 0;
+    _burstActive = burst;
+    
+    // Connect first so the sensors include this cycle's DNS time
+    bool connected = connect();
+    SensorValues& values = _values;
+    collectSensors(data, values);
+    _dnsTimeMs = 0;
+    
+    if (!connected) {
+        _burstActive = false;
         LogBox::line("ERROR: Failed to connect to MQTT broker");
         LogBox::line("Error: " + _lastError);
+        queueReading(values);
         LogBox::end();
         return false;
     }
+    _qos1Publisher.reset();
     
-    LogBox::line("Connected successfully");
+    // Publish discovery messages only when the sensor set changed
+    // (a burst stores the hash only once the broker accepted it)
+    uint32_t hash = discoveryHash(data, values);
+    bool discoveryDue = shouldPublishDiscovery(hash);
+    bool discoverySent = false;
+    if (discoveryDue) {
+        discoverySent = publishDiscovery(data, values);
+        if (discoverySent && !burst) {
+            storeDiscoveryHash(hash);
+        }
+    } else {
+        LogBox::line("Skipping discovery (unchanged)");
+    }
     
-    // Publish discovery messages (conditionally)
-    if (shouldPublishDiscovery(data.wakeReason)) {
-        publishDiscovery(data);
+    // Readings from earlier broker outages go out before the live state,
+    // so the retained state stays the newest one. They stay queued until
+    // the flush barrier confirms the broker has them.
+    int drained = drainQueue(data.deviceId);
+    
+    // Publish state - only what changed, everything after a discovery update
+    bool due[SENSOR_REGISTRY_SIZE];
+    int dueCount = selectChanged(values, discoveryDue, due);
+    bool queued = false;
+    uint16_t statePacketId = 0;
+    if (_combinedState) {
+        if (dueCount == 0) {
+            LogBox::line("State unchanged - not published");
+        } else {
+            // The retained object carries every value; the templates read all of them
+            for (int id = 0; id < SENSOR_REGISTRY_SIZE; id++) {
+                due[id] = true;
+            }
+            int valueCount = publishCombinedState(data, values);
+            LogBox::linef("Published %d values in 1 state message", valueCount);
+            if (valueCount == 0) {
+                queueReading(values);
+                queued = true;
+            }
+            statePacketId = _lastPacketId;
+        }
     } else {
-        LogBox::line("Skipping discovery (normal wake cycle)");
+        int stateCount = publishSensorStates(data, values, due);
+        LogBox::linef("Published %d of %d state messages", stateCount, values.count());
     }
     
-    // Publish state messages
+    // Persistent QoS 0 sessions keep sending in the background; otherwise
+    // wait until the broker has everything before going on
+    if (burst) {
+        if (!finishBurst()) {
+            queueReading(values);
+            LogBox::end();
+            return false;
+        }
+        if (discoverySent) {
+            storeDiscoveryHash(hash);
+        }
+        if (!queued) {
+            storeReported(values, due);
+        }
+        LogBox::end("MQTT telemetry published successfully");
+        return true;
+    }
+    if (_qos1 || !_persistent || drained > 0) {
+        bool flushed = flush();
+        if (drained > 0) {
+            popDrained(drained, flushed);
+        }
+        if (_qos1Publisher.isPending(statePacketId)) {
+            queueReading(values);
+            queued = true;
+        } else if (!flushed && !_qos1 && !_persistent && dueCount > 0 && !queued) {
+            // QoS 0: without the PINGRESP nothing says the state arrived
+            queueReading(values);
+            queued = true;
+        }
+    }
+    if (!queued) {
+        storeReported(values, due);
+    }
+    
+    if (_mqtt5) {
+        // Since the CONNECT - a persistent session keeps adding up
+        const Mqtt5Stats& stats = _mqtt5Client.getStats();
+        LogBox::linef("MQTT 5: %lu bytes on this connection (MQTT 3.1.1: %lu), %u/%u publishes by alias",
+                      (unsigned long)stats.txBytes, (unsigned long)stats.v311Bytes, stats.aliasHits, stats.publishes);
+    }
+    
+    if (_persistent) {
+        // Session stays open - loop() keeps servicing it
+        clientLoop();
+        LogBox::end("MQTT telemetry published successfully");
+        return true;
+    }
+    
+    // Disconnect
+    disconnect();
+    
+    LogBox::end("MQTT telemetry published successfully");
+    return true;
+}
+
+int MQTTManager::publishSensorStates(const TelemetryData& data, const SensorValues& values, bool* due) {
     LogBox::line("Publishing state messages...");
+    MqttBuffer<MQTT_TOPIC_BUFFER_SIZE> topic;
     int stateCount = 0;
     
-    // Publish battery voltage state
-    if (data.batteryVoltage > 0.0f) {
-        String topic = getStateTopic(data.deviceId, "battery_voltage");
-        String payload = String(data.batteryVoltage, 2);
-        _mqttClient->publish(topic.c_str(), payload.c_str(), true);
-        LogBox::line("Battery: " + payload + " V");
+    for (int id = 0; id < SensorRegistry::count(); id++) {
+        if (!values.has(id)) {
+            continue;
+        }
+        const SensorDescriptor& sensor = SensorRegistry::get(id);
+        if (!due[id]) {
+            LogBox::linef("%s: %s %s (unchanged)", sensor.name, values.get(id), sensor.unit);
+            continue;  // The retained value on the broker is still current
+        }
+        buildTopic(topic, data.deviceId, sensor.key, "state");
+        if (!publishMessage(topic.c_str(), values.get(id), strlen(values.get(id)), true)) {
+            LogBox::linef("ERROR: %s not published", sensor.name);
+            due[id] = false;  // Not recorded as sent - it goes out again next cycle
+            continue;
+        }
+        LogBox::linef("%s: %s %s", sensor.name, values.get(id), sensor.unit);
         stateCount++;
+        
+        // Per-key NVS wear breakdown
+        if (sensor.withAttributes && data.nvsWearJson.length() > 0) {
+            buildTopic(topic, data.deviceId, sensor.key, "attributes");
+            publishMessage(topic.c_str(), data.nvsWearJson.c_str(), data.nvsWearJson.length(), true);
+        }
     }
     
-    // Publish battery percentage state
-    if (data.batteryPercentage >= 0) {
-        String topic = getStateTopic(data.deviceId, "battery_percentage");
-        String payload = String(data.batteryPercentage);
-        _mqttClient->publish(topic.c_str(), payload.c_str(), true);
-        LogBox::line("Battery %: " + payload + " %");
-        stateCount++;
+    return stateCount;
+}
+
+void MQTTManager::appendStateFields(MqttWriter& out, const TelemetryData* data, const SensorValues& values) {
+    for (int id = 0; id < SensorRegistry::count(); id++) {
+        if (!values.has(id)) {
+            continue;
+        }
+        const SensorDescriptor& sensor = SensorRegistry::get(id);
+        if (sensor.format == SENSOR_TEXT) {
+            out.jsonString(sensor.key, values.get(id));
+        } else {
+            out.jsonKey(sensor.key);
+            out.append(values.get(id));
+        }
+        
+        // Attributes object, picked out by json_attributes_template
+        if (data != nullptr && sensor.withAttributes && data->nvsWearJson.length() > 0) {
+            MqttBuffer<MQTT_TOPIC_BUFFER_SIZE> key;
+            key.append(sensor.key);
+            key.append("_attrs");
+            out.jsonKey(key.c_str());
+            out.append(data->nvsWearJson);
+        }
     }
+}
+
+// One retained JSON object with the same values (and skip rules) as the
+// per-sensor topics, e.g.
+// {"battery_voltage":3.92,"loop_time":1.84,"wifi_signal":-61,"wifi_bssid":"..."}
+int MQTTManager::publishCombinedState(const TelemetryData& data, const SensorValues& values) {
+    LogBox::line("Publishing combined state message...");
+    MqttWriter payload(_payload, sizeof(_payload));
     
-    // Publish loop time state
-    {
-        String topic = getStateTopic(data.deviceId, "loop_time");
-        String payload = String(data.loopTimeTotal, 2);
-        _mqttClient->publish(topic.c_str(), payload.c_str(), true);
-        LogBox::line("Loop Time: " + payload + " s");
-        stateCount++;
+    payload.beginObject();
+    appendStateFields(payload, &data, values);
+    payload.endObject();
+    for (int id = 0; id < SensorRegistry::count(); id++) {
+        if (values.has(id)) {
+            const SensorDescriptor& sensor = SensorRegistry::get(id);
+            LogBox::linef("%s: %s %s", sensor.name, values.get(id), sensor.unit);
+        }
     }
     
-    // Publish WiFi signal state
-    {
-        String topic = getStateTopic(data.deviceId, "wifi_signal");
-        String payload = String(data.wifiRSSI);
-        _mqttClient->publish(topic.c_str(), payload.c_str(), true);
-        LogBox::line("WiFi Signal: " + payload + " dBm");
-        stateCount++;
+    if (payload.overflow()) {
+        LogBox::linef("ERROR: State message needs %u bytes (MQTT_STATE_BUFFER_SIZE)", (unsigned)payload.requiredSize());
+        return 0;
     }
     
-    // Publish WiFi BSSID state
-    if (data.wifiBSSID.length() > 0) {
-        String topic = getStateTopic(data.deviceId, "wifi_bssid");
-        _mqttClient->publish(topic.c_str(), data.wifiBSSID.c_str(), true);
-        LogBox::line("WiFi BSSID: " + data.wifiBSSID);
-        stateCount++;
+    MqttBuffer<MQTT_TOPIC_BUFFER_SIZE> topic;
+    buildTopic(topic, data.deviceId, nullptr, "state");
+    if (!publishMessage(topic.c_str(), payload.c_str(), payload.length(), true)) {
+        LogBox::linef("ERROR: State message (%u bytes) not sent", (unsigned)payload.length());
+        return 0;
+    }
+    LogBox::linef("State payload: %u bytes", (unsigned)payload.length());
+    return values.count();
+}
+
+int MQTTManager::selectChanged(const SensorValues& values, bool force, bool* due) {
+    if (rtc_reportState.magic != MQTT_REPORT_STATE_MAGIC) {
+        memset(&rtc_reportState, 0, sizeof(rtc_reportState));  // Cold boot - send everything
+        rtc_reportState.magic = MQTT_REPORT_STATE_MAGIC;
     }
     
-    // Publish WiFi retry count
-    if (data.wifiRetryCount != 255) {
-        String topic = getStateTopic(data.deviceId, "wifi_retries");
-        String payload = String(data.wifiRetryCount);
-        _mqttClient->publish(topic.c_str(), payload.c_str(), true);
-        LogBox::line("WiFi Retries: " + payload);
-        stateCount++;
+    uint32_t now = (uint32_t)time(nullptr);
+    int count = 0;
+    for (int id = 0; id < SensorRegistry::count(); id++) {
+        due[id] = false;
+        if (!values.has(id)) {
+            continue;
+        }
+        const SensorDescriptor& sensor = SensorRegistry::get(id);
+        const char* value = values.get(id);
+        const ReportedValue* last = findReported(hashText(sensor.key));
+        bool send = force || !_reportOnChange || last == nullptr;
+        if (!send) {
+            uint32_t maxSilence = sensor.maxSilenceSeconds > 0 ? sensor.maxSilenceSeconds : MQTT_MAX_SILENCE_SECONDS;
+            if (now - last->sentAt >= maxSilence) {
+                send = true;  // Heartbeat (also when the clock was set backwards)
+            } else if (hashText(value) != last->valueHash) {
+                send = sensor.format == SENSOR_TEXT || fabsf(strtof(value, nullptr) - last->value) > sensor.deadband;
+            }
+        }
+        due[id] = send;
+        if (send) {
+            count++;
+        }
     }
     
-    // Publish loop time WiFi
-    if (data.loopTimeWiFi > 0.0f) {
-        String topic = getStateTopic(data.deviceId, "loop_time_wifi");
-        String payload = String(data.loopTimeWiFi, 2);
-        _mqttClient->publish(topic.c_str(), payload.c_str(), true);
-        LogBox::line("Loop Time - WiFi: " + payload + " s");
-        stateCount++;
+    if (_reportOnChange && !force) {
+        LogBox::linef("Report on change: %d of %d values changed or due", count, values.count());
+    }
+    return count;
+}
+
+void MQTTManager::storeReported(const SensorValues& values, const bool* due) {
+    uint32_t now = (uint32_t)time(nullptr);
+    for (int id = 0; id < SensorRegistry::count(); id++) {
+        if (!values.has(id) || !due[id]) {
+            continue;
+        }
+        const SensorDescriptor& sensor = SensorRegistry::get(id);
+        uint32_t keyHash = hashText(sensor.key);
+        ReportedValue* slot = findReported(keyHash);
+        if (slot == nullptr) {
+            slot = findReported(0);
+        }
+        if (slot == nullptr) {
+            // Full - reuse the slot of the sensor sent longest ago
+            slot = &rtc_reportState.values[0];
+            for (ReportedValue& candidate : rtc_reportState.values) {
+                if (now - candidate.sentAt > now - slot->sentAt) {
+                    slot = &candidate;
+                }
+            }
+        }
+        slot->keyHash = keyHash;
+        slot->valueHash = hashText(values.get(id));
+        slot->value = sensor.format == SENSOR_TEXT ? 0.0f : strtof(values.get(id), nullptr);
+        slot->sentAt = now;
     }
+}
+
+// Queued reading: the state object without attributes, led by the time it
+// was taken, e.g. {"ts":1760601600,"battery_voltage":3.92,"loop_time":1.84}
+void MQTTManager::queueReading(const SensorValues& values) {
+    MqttWriter record(_payload, sizeof(_payload));
+    record.beginObject();
+    record.jsonKey("ts");
+    record.appendUInt((unsigned long)time(nullptr));
+    appendStateFields(record, nullptr, values);
+    record.endObject();
     
-    // Publish loop time work
-    if (data.loopTimeWork > 0.0f) {
-        String topic = getStateTopic(data.deviceId, "loop_time_work");
-        String payload = String(data.loopTimeWork, 2);
-        _mqttClient->publish(topic.c_str(), payload.c_str(), true);
-        LogBox::line("Loop Time - Work: " + payload + " s");
-        stateCount++;
+    if (record.overflow() || !TelemetryQueue::push(record.c_str(), record.length())) {
+        LogBox::linef("ERROR: Reading not queued (%u dropped)", TelemetryQueue::dropped());
+        return;
+    }
+    LogBox::linef("Reading queued for later (%u waiting)", TelemetryQueue::depth());
+}
+
+int MQTTManager::drainQueue(const String& deviceId) {
+    if (TelemetryQueue::depth() == 0) {
+        return 0;
     }
     
-    // Publish free heap state
-    if (data.freeHeap > 0) {
-        String topic = getStateTopic(data.deviceId, "free_heap");
-        String payload = String(data.freeHeap);
-        _mqttClient->publish(topic.c_str(), payload.c_str(), true);
-        LogBox::line("Free Heap: " + payload + " bytes");
-        stateCount++;
+    MqttBuffer<MQTT_TOPIC_BUFFER_SIZE> topic;
+    buildTopic(topic, deviceId, nullptr, "backlog");
+    uint16_t sent = 0;
+    size_t length;
+    while (sent < MQTT_BACKLOG_DRAIN_MAX && (length = TelemetryQueue::peek(sent, _payload, sizeof(_payload))) > 0) {
+        // Not retained - every queued reading is its own message
+        if (!publishMessage(topic.c_str(), _payload, length, false)) {
+            break;  // This one and the rest stay queued for the next connection
+        }
+        _drainPacketIds[sent++] = _qos1 ? _lastPacketId : 0;
+        if (_qos1) {
+            _qos1Publisher.poll();  // PubSubClient::loop() would swallow the PUBACKs
+        } else {
+            clientLoop();
+        }
+    }
+    if (sent == 0) {
+        TelemetryQueue::pop(0);  // Nothing to confirm - ends the peek pass
+    }
+    LogBox::linef("Sent %u of %u queued reading(s)", sent, TelemetryQueue::depth());
+    return sent;
+}
+
+void MQTTManager::popDrained(int drained, bool flushed) {
+    // Queue order is kept: an unacknowledged reading keeps every later one
+    // queued as well (those are sent again - at least once, not exactly once)
+    int confirmed = flushed ? drained : 0;
+    while (!flushed && _qos1 && confirmed < drained && !_qos1Publisher.isPending(_drainPacketIds[confirmed])) {
+        confirmed++;
+    }
+    TelemetryQueue::pop(confirmed);
+    if (confirmed == drained) {
+        LogBox::linef("%d queued reading(s) confirmed, %u left", confirmed, TelemetryQueue::depth());
+    } else {
+        LogBox::linef("ERROR: %d of %d queued reading(s) not confirmed - kept", drained - confirmed, drained);
+    }
+}
+
+bool MQTTManager::flush() {
+    if (_mqtt5) {
+        unsigned long start = millis();
+        bool complete = _mqtt5Client.flush(MQTT_FLUSH_TIMEOUT_MS);
+        rtc_lastFlushMs = millis() - start;
+        if (!complete) {
+            LogBox::linef("ERROR: Flush not confirmed within %u ms", (unsigned)MQTT_FLUSH_TIMEOUT_MS);
+            return false;
+        }
+        LogBox::linef("Flushed in %lu ms", (unsigned long)rtc_lastFlushMs);
+        return true;
     }
     
-    LogBox::linef("Published %d state messages", stateCount);
+    bool complete = _qos1Publisher.flush(MQTT_FLUSH_TIMEOUT_MS);
+    const MqttAckStats& stats = _qos1Publisher.getStats();
+    rtc_lastFlushMs = stats.waitMs;  // The deadline if it timed out
     
-    // Give MQTT client time to transmit all queued messages
-    // PubSubClient needs loop() calls to actually send queued data
-    // 20-30ms is typically sufficient for transmission
-    for (int i = 0; i < 3; i++) {
-        _mqttClient->loop();
-        delay(10);
+    if (stats.acked > 0) {
+        LogBox::linef("QoS 1: %u/%u acked (ack min/avg/max %.1f/%.1f/%.1f ms)",
+                      stats.acked, stats.sent, stats.minAckUs / 1000.0f,
+                      stats.totalAckUs / 1000.0f / stats.acked, stats.maxAckUs / 1000.0f);
     }
+    if (!complete) {
+        LogBox::linef("ERROR: Flush not confirmed within %u ms (%u message(s) unacknowledged)",
+                      (unsigned)MQTT_FLUSH_TIMEOUT_MS, stats.unacked);
+        return false;
+    }
+    LogBox::linef("Flushed in %lu ms", (unsigned long)stats.waitMs);
+    return true;
+}
+
+bool MQTTManager::finishBurst() {
+    _burstActive = false;
+    int result = _burst.finish(MQTT_BURST_TIMEOUT_MS);
+    _netClient.stop();  // The broker closes its end after the DISCONNECT
     
-    // Disconnect
-    disconnect();
-    
-    LogBox::end("MQTT telemetry published successfully");
+    const MqttBurstStats& stats = _burst.getStats();
+    LogBox::linef("Burst: %u packets, %lu bytes in %u write(s)",
+                  stats.packets, (unsigned long)stats.bytes, stats.writes);
+    if (result != 0) {
+        // A rejected CONNECT means the broker dropped every PUBLISH after it;
+        // without the PINGRESP they are not confirmed either
+        _lastError = "Burst not confirmed (state: " + String(result) + ")";
+        LogBox::line("ERROR: " + _lastError);
+        if (result == -4) {
+            rtc_lastFlushMs = MQTT_BURST_TIMEOUT_MS;
+        }
+        return false;
+    }
+    rtc_lastFlushMs = stats.flushMs;
+    LogBox::linef("CONNACK after %lu ms, flushed in %lu ms",
+                  (unsigned long)stats.connackMs, (unsigned long)stats.flushMs);
     return true;
 }
 
+int32_t MQTTManager::getLastFlushMs() {
+    if (_persistent && !_qos1) {
+        return -1;  // Not flushed - the session keeps sending in the background
+    }
+    return (int32_t)rtc_lastFlushMs;
+}
+
 bool MQTTManager::isConfigured() {
     return _isConfigured;
 }
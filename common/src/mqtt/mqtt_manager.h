@@ -6,10 +6,130 @@
 #include <WiFiClient.h>
 #include "config_manager.h"
 #include "power_manager.h"
+#include "device_identity.h"
+#include "mqtt_writer.h"
+#include "mqtt_qos1_publisher.h"
+#include "mqtt_tls_client.h"
+#include "mqtt5_client.h"
+#include "mqtt_burst.h"
+#include "nvs_store.h"
+#include "sensor_registry.h"
+#include "telemetry_queue.h"
 
-// Increase MQTT buffer size for Home Assistant discovery messages
+// Initial MQTT buffer size. publishMessage() grows it to fit larger
+// payloads (the device discovery message) instead of dropping them.
 #define MQTT_MAX_PACKET_SIZE 512
 
+// Buffers for building topics and payloads (no heap on the publish path).
+// Topics are built on the stack; a discovery config, the combined state
+// and a queued reading share one manager-owned buffer of
+// MQTT_STATE_BUFFER_SIZE, sized for a full registry: every sensor as
+// "key":"value", with the longest key and value, plus the NVS wear
+// attributes. Text that needs escaping can still overflow it (logged).
+#define MQTT_TOPIC_BUFFER_SIZE 96        // "homeassistant/sensor/<deviceId>/<sensor>/attributes"
+#define MQTT_DISCOVERY_BUFFER_SIZE 640   // One per-sensor discovery config
+#define MQTT_STATE_FIELD_MAX_SIZE (SENSOR_KEY_SIZE + SENSOR_VALUE_SIZE + 4)
+#define MQTT_STATE_BUFFER_SIZE (2 + SENSOR_REGISTRY_SIZE * MQTT_STATE_FIELD_MAX_SIZE + SENSOR_KEY_SIZE + 10 + NVS_WEAR_JSON_MAX_SIZE)
+static_assert(MQTT_DISCOVERY_BUFFER_SIZE <= MQTT_STATE_BUFFER_SIZE, "Discovery configs are built in the state buffer");
+static_assert(MQTT_STATE_BUFFER_SIZE <= TELEMETRY_QUEUE_MAX_RECORD, "A queued reading must fit the queue");
+
+// Keepalive: short for connect-publish-disconnect cycles, long enough in a
+// persistent session to cover the always-on loop interval between loop() calls
+#define MQTT_KEEPALIVE_SECONDS 5
+#define MQTT_PERSISTENT_KEEPALIVE_SECONDS 60
+
+// State publishing: one retained JSON object per cycle on
+// homeassistant/sensor/<deviceId>/state (sensors pick their field with a
+// value_template) instead of one retained message per sensor.
+// Set to false to keep the per-sensor state topics.
+#ifndef MQTT_COMBINED_STATE
+#define MQTT_COMBINED_STATE true
+#endif
+
+// Discovery: one retained config per sensor, or a single Home Assistant
+// device-based discovery message on homeassistant/device/<deviceId>/config
+// listing every sensor (requires Home Assistant 2024.11 or newer)
+#ifndef MQTT_DEVICE_DISCOVERY
+#define MQTT_DEVICE_DISCOVERY false
+#endif
+#define MQTT_DISCOVERY_ORIGIN "esp32-multiboard-template"
+
+// Discovery change detection: a hash of the sensor set, device info and
+// firmware version is kept in RTC memory and NVS, and discovery is only
+// republished when it changes. Persistent sessions also subscribe to the
+// Home Assistant birth topic and republish after HA restarts.
+#define MQTT_STATE_NAMESPACE "mqtt_state"
+#define MQTT_DISCOVERY_HASH_KEY "disc_hash"
+#define MQTT_HA_STATUS_TOPIC "homeassistant/status"
+
+// Delivery: QoS 0 (fire and forget), or pipelined QoS 1 where every
+// message is sent back-to-back and the session closes as soon as the last
+// PUBACK arrives (see mqtt_qos1_publisher.h)
+#ifndef MQTT_QOS1
+#define MQTT_QOS1 false
+#endif
+
+// Protocol: MQTT 3.1.1 through PubSubClient, or MQTT 5 (Mqtt5Client) with
+// topic aliases and, for persistent sessions, a session expiry so the
+// broker keeps subscriptions across reconnects. QoS 1 needs 3.1.1.
+#ifndef MQTT_PROTOCOL_V5
+#define MQTT_PROTOCOL_V5 false
+#endif
+
+// Burst mode (battery wakes): CONNECT, every PUBLISH, PINGREQ and
+// DISCONNECT go out in one socket write and a single round trip confirms
+// them (see mqtt_burst.h). Only used for QoS 0, MQTT 3.1.1, non-persistent
+// cycles with no queued backlog - otherwise the normal path runs.
+#ifndef MQTT_BURST
+#define MQTT_BURST false
+#endif
+#define MQTT_BURST_TIMEOUT_MS 2000   // Wait for CONNACK + PINGRESP after the write
+
+// Report on change: a value is only republished when it moved beyond its
+// deadband since it was last sent, or when it has not been sent for its
+// maximum silence (heartbeat). The last sent values are kept in RTC
+// memory; per-sensor deadbands are in the table in mqtt_manager.cpp.
+#ifndef MQTT_REPORT_ON_CHANGE
+#define MQTT_REPORT_ON_CHANGE true
+#endif
+#ifndef MQTT_MAX_SILENCE_SECONDS
+#define MQTT_MAX_SILENCE_SECONDS 1800   // Default heartbeat
+#endif
+
+// Queued readings sent per connection (the rest follow on the next one).
+// With QoS 1 each one's packet ID is kept so only acknowledged readings
+// are removed from the queue.
+#ifndef MQTT_BACKLOG_DRAIN_MAX
+#define MQTT_BACKLOG_DRAIN_MAX 32
+#endif
+
+// Flush barrier deadline: how long publishAllTelemetry() waits for the
+// PINGRESP (and QoS 1 PUBACKs) confirming the broker has every message
+#ifndef MQTT_FLUSH_TIMEOUT_MS
+#define MQTT_FLUSH_TIMEOUT_MS 1000
+#endif
+
+// Broker address cache: the resolved IP is kept in RTC memory and reused
+// across deep sleep for this long; a failed connect to it resolves again
+#ifndef MQTT_DNS_CACHE_TTL_SECONDS
+#define MQTT_DNS_CACHE_TTL_SECONDS 3600
+#endif
+
+// Persistent session reconnect backoff (doubles per failure, +0-50% jitter)
+#define MQTT_RECONNECT_MIN_MS 1000
+#define MQTT_RECONNECT_MAX_MS 60000
+
+// Persistent session counters (since boot)
+struct MQTTSessionStats {
+    uint32_t connects;        // Successful CONNECTs
+    uint32_t reconnects;      // Successful CONNECTs after a dropped session
+    uint32_t failedAttempts;  // CONNECT attempts that failed
+    uint32_t drops;           // Established sessions that were lost
+    uint32_t backoffMs;       // Current reconnect delay (0 while connected)
+    
+    MQTTSessionStats() : connects(0), reconnects(0), failedAttempts(0), drops(0), backoffMs(0) {}
+};
+
 // Telemetry data structure for batch publishing
 struct TelemetryData {
     // Device info
@@ -17,37 +137,18 @@ struct TelemetryData {
     String deviceName;
     String modelName;
     
-    // Wake/power state
+    // Wake/power state (informational - discovery is driven by change detection)
     WakeupReason wakeReason;
     
-    // Battery metrics (0.0 to skip voltage, -1 to skip percentage)
-    float batteryVoltage;
-    int batteryPercentage;
-    
-    // WiFi metrics
-    int wifiRSSI;
-    String wifiBSSID;  // Empty to skip
-    uint8_t wifiRetryCount;  // 255 to skip
-    
-    // Loop timing
-    float loopTimeTotal;      // Total loop time in seconds
-    float loopTimeWiFi;       // WiFi connection time (0.0 to skip)
-    float loopTimeWork;       // Work/processing time (0.0 to skip)
+    // Sensor values by ID: the SENSOR_* built-ins, then application sensors
+    // from SensorRegistry::add(). Sensors without a value are not published.
+    SensorValues values;
     
-    // Free heap memory in bytes (0 to skip)
-    uint32_t freeHeap;
+    // NVS wear per-key counts (JSON), attributes of the nvs_writes sensor
+    String nvsWearJson;
     
     // Constructor with defaults
-    TelemetryData() : 
-        wakeReason(WAKEUP_FIRST_BOOT),
-        batteryVoltage(0.0f),
-        batteryPercentage(-1),
-        wifiRSSI(0),
-        wifiRetryCount(255),
-        loopTimeTotal(0.0f),
-        loopTimeWiFi(0.0f),
-        loopTimeWork(0.0f),
-        freeHeap(0) {}
+    TelemetryData() : wakeReason(WAKEUP_FIRST_BOOT) {}
 };
 
 class MQTTManager {
@@ -56,27 +157,88 @@ public:
     ~MQTTManager();
     
     // Initialize MQTT manager (loads config, sets up client)
+    // Only the first call does work - later calls return the cached result
     bool begin();
     
-    // Connect to MQTT broker
+    // Keep the broker connection open between publishes (always-on mode).
+    // connect() then returns immediately while the session is up, makes a
+    // single attempt when it is down (rate limited by the reconnect backoff)
+    // and publishAllTelemetry() no longer disconnects. Call before begin().
+    void setPersistentSession(bool persistent);
+    bool isPersistentSession();
+    
+    // Service a persistent session: keepalive/incoming packets via
+    // PubSubClient::loop(), drop detection and backoff-paced reconnects.
+    // Call often (at least every few seconds) while idle.
+    void loop();
+    
+    // Connect to MQTT broker (no-op if already connected)
     bool connect();
+    bool isConnected();
     
     // Disconnect from MQTT broker
     void disconnect();
     
+    const MQTTSessionStats& getSessionStats();
+    
+    // Combined (one JSON state message) or per-sensor state topics.
+    // Defaults to MQTT_COMBINED_STATE. Discovery must be republished after
+    // switching so Home Assistant follows the new topics.
+    void setCombinedState(bool combined);
+    bool isCombinedState();
+    
+    // Device-based (one message) or per-sensor discovery configs.
+    // Defaults to MQTT_DEVICE_DISCOVERY.
+    void setDeviceDiscovery(bool deviceDiscovery);
+    bool isDeviceDiscovery();
+    
+    // QoS 1 with PUBACK tracking instead of QoS 0. Defaults to MQTT_QOS1.
+    void setQoS1(bool qos1);
+    bool isQoS1();
+    
+    // MQTT 5 instead of 3.1.1 (call before begin()). Defaults to MQTT_PROTOCOL_V5.
+    void setProtocolV5(bool v5);
+    bool isProtocolV5();
+    
+    // MQTT 5 wire counters of the current connection (bytes vs. 3.1.1, alias use)
+    const Mqtt5Stats& getMqtt5Stats();
+    
+    // Single-write connect-publish-disconnect cycles. Defaults to MQTT_BURST.
+    void setBurst(bool burst);
+    bool isBurst();
+    const MqttBurstStats& getBurstStats();
+    
+    // Only publish values that changed beyond their deadband or are due for
+    // a heartbeat. Defaults to MQTT_REPORT_ON_CHANGE.
+    void setReportOnChange(bool reportOnChange);
+    bool isReportOnChange();
+    
+    // PUBACK counters (QoS 1) and flush time of the last publishAllTelemetry()
+    const MqttAckStats& getAckStats();
+    
+    // Time the last flush barrier took in ms, kept across deep sleep
+    // (MQTT_FLUSH_TIMEOUT_MS if it timed out, -1 for persistent QoS 0
+    // sessions, which do not flush)
+    int32_t getLastFlushMs();
+    
+    // TLS handshake counters and full/resumed times (mqtts:// brokers)
+    const MqttTlsStats& getTlsStats();
+    
     // Publish Home Assistant auto-discovery configuration
     bool publishDiscovery(const TelemetryData& data);
     
-    // Publish individual metrics
-    bool publishBatteryVoltage(const String& deviceId, float voltage);
-    bool publishBatteryPercentage(const String& deviceId, int percentage);
-    bool publishLoopTime(const String& deviceId, float loopTimeSeconds);
-    bool publishWiFiSignal(const String& deviceId, int rssi);
-    bool publishWiFiBSSID(const String& deviceId, const String& bssid);
-    bool publishFreeHeap(const String& deviceId, uint32_t freeHeap);
+    // Republish discovery with the next publishAllTelemetry() even if unchanged
+    void requestDiscovery();
+    
+    // Publish one message on the open connection (QoS 1 when enabled)
+    bool publish(const char* topic, const char* payload, size_t length, bool retained);
+    
+    // Wait for the PINGRESP barrier (and QoS 1 PUBACKs) up to MQTT_FLUSH_TIMEOUT_MS
+    bool flush();
     
     // Publish all telemetry in a single MQTT session (optimized for battery-powered devices)
-    // Connects, publishes discovery (conditionally) + all state messages, then disconnects
+    // Connects, publishes discovery (if changed), queued readings + state, flushes, then disconnects.
+    // A reading that cannot be sent (broker unreachable) is queued in TelemetryQueue.
     bool publishAllTelemetry(const TelemetryData& data);
     
     // Check if MQTT is configured
@@ -88,31 +250,118 @@ public:
 private:
     ConfigManager* _configManager;
     WiFiClient _wifiClient;
+    MqttTlsClient _netClient;  // TLS for mqtts:// brokers, pass-through otherwise
     PubSubClient* _mqttClient;
     String _broker;
+    String _host;
     String _username;
     String _password;
     int _port;
     String _lastError;
     bool _isConfigured;
+    bool _initialized;     // begin() already ran
+    bool _combinedState;
+    bool _deviceDiscovery;
+    bool _discoveryRequested;  // requestDiscovery() or Home Assistant came online
+    bool _qos1;
+    MqttQos1Publisher _qos1Publisher;
+    bool _mqtt5;
+    Mqtt5Client _mqtt5Client;  // Used instead of _mqttClient when _mqtt5
+    bool _burstMode;
+    bool _burstActive;         // Connecting/publishing into _burst this cycle
+    MqttBurst _burst;
+    bool _reportOnChange;
+    uint16_t _lastPacketId;    // QoS 1 packet ID of the last publishMessage()
+    
+    // Working buffers of a telemetry cycle, kept here instead of on the
+    // stack (the MqttAsync task runs the cycle, and the TLS handshake, on a
+    // fixed-size stack). One message at a time: _payload holds a discovery
+    // config, the combined state or a queued reading
+    SensorValues _values;
+    char _payload[MQTT_STATE_BUFFER_SIZE];
+    
+    // Persistent session state
+    bool _persistent;
+    bool _sessionUp;       // Connected at the last check (for drop detection)
+    unsigned long _nextAttemptMs;
+    MQTTSessionStats _sessionStats;
+    
+    // One CONNECT attempt (closes any stale socket first)
+    bool connectOnce();
+    
+    // PubSubClient or Mqtt5Client, whichever the protocol uses
+    bool clientConnected();
+    bool clientLoop();
+    int clientState();
+    
+    // Write the burst and wait for CONNACK + PINGRESP; false if not accepted
+    bool finishBurst();
+    
+    // Persistent mode: single attempt if the backoff has elapsed
+    bool reconnect();
+    void scheduleReconnect();
+    
+    // Parse broker URL to extract host, port and scheme (mqtts:// = TLS)
+    bool parseBrokerURL(const String& url, String& host, int& port, bool& tls);
+    
+    // Broker IP: literal, cached (fromCache) or resolved now
+    bool resolveBroker(IPAddress& address, bool useCache, bool& fromCache);
+    uint32_t _dnsTimeMs;   // Spent resolving since the last telemetry
+    bool _brokerResolved;  // Looked up since boot/wake or the last failure (no fallback lookup needed)
+    // Drop the cached address after a failed connect or a lost session
+    void forgetBrokerAddress();
+    
+    // Topics: "homeassistant/sensor/<deviceId>" is cached and only rebuilt
+    // when the device ID changes
+    char _topicDeviceId[DEVICE_ID_MAX_SIZE];
+    MqttBuffer<MQTT_TOPIC_BUFFER_SIZE> _topicPrefix;
+    const char* topicPrefix(const String& deviceId);
+    void buildTopic(MqttWriter& topic, const String& deviceId, const char* sensorType, const char* suffix);
+    
+    // Publish at the configured QoS, growing the client buffer if a QoS 0
+    // packet needs it
+    bool publishMessage(const char* topic, const char* payload, size_t length, bool retained);
+    
+    // "device":{...} member
+    void appendDeviceInfo(MqttWriter& out, const TelemetryData& data, bool full);
+    
+    
+    // The telemetry's values plus the ones the manager measures itself
+    // (DNS time, TLS handshake, backlog depth). Discovery, both state modes,
+    // the backlog and report-on-change iterate the registry over this table.
+    void collectSensors(const TelemetryData& data, SensorValues& values);
+    bool publishDiscovery(const TelemetryData& data, const SensorValues& values);
+    bool publishDeviceDiscovery(const TelemetryData& data, const SensorValues& values);
+    void appendSensorConfig(MqttWriter& out, const TelemetryData& data, const SensorDescriptor& sensor,
+                            bool withStateTopic);
     
-    // Parse broker URL to extract host and port
-    bool parseBrokerURL(const String& url, String& host, int& port);
+    // Report on change: mark the sensors to send this cycle (all when
+    // forced), returns how many; store them as sent once delivered
+    int selectChanged(const SensorValues& values, bool force, bool* due);
+    void storeReported(const SensorValues& values, const bool* due);
     
-    // Generate MQTT topics
-    String getDiscoveryTopic(const String& deviceId, const String& sensorType);
-    String getStateTopic(const String& deviceId, const String& sensorType);
+    // Publish state messages (per-sensor: only the ones marked due), returns
+    // the number of values published; a failed one is unmarked
+    int publishSensorStates(const TelemetryData& data, const SensorValues& values, bool* due);
+    int publishCombinedState(const TelemetryData& data, const SensorValues& values);
+    // State object members; data is only needed for attributes (nullptr to leave them out)
+    void appendStateFields(MqttWriter& out, const TelemetryData* data, const SensorValues& values);
     
-    // Build device info JSON
-    String buildDeviceInfoJSON(const String& deviceId, const String& deviceName, const String& modelName, bool full);
+    // Store-and-forward: queue an unsent reading, send queued ones to
+    // <prefix>/backlog (returns how many). After the flush, pop the ones
+    // the broker confirmed (all of them, or the acknowledged QoS 1 prefix).
+    void queueReading(const SensorValues& values);
+    int drainQueue(const String& deviceId);
+    void popDrained(int drained, bool flushed);
+    uint16_t _drainPacketIds[MQTT_BACKLOG_DRAIN_MAX];
     
-    // Determine if discovery should be published based on wake reason
-    bool shouldPublishDiscovery(WakeupReason wakeReason);
+    // Discovery change detection
+    uint32_t discoveryHash(const TelemetryData& data, const SensorValues& values);
+    bool shouldPublishDiscovery(uint32_t hash);
+    void storeDiscoveryHash(uint32_t hash);
     
-    // Helper to publish sensor discovery
-    bool publishSensorDiscovery(const String& discoveryTopic, const String& deviceId, const String& sensorType,
-                                const String& name, const String& deviceClass, const String& unit,
-                                const String& deviceName, const String& modelName, bool includeFullDevice);
+    // Incoming messages (persistent sessions)
+    void handleMessage(const char* topic, const uint8_t* payload, unsigned int length);
 };
 
 #endif // MQTT_MANAGER_H
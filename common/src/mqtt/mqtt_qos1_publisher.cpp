@@ -0,0 +1,205 @@
+#include "mqtt_qos1_publisher.h"
+#include "logger.h"
+
+// MQTT 3.1.1 control packet types (upper nibble of the fixed header)
+#define MQTT_PACKET_PUBLISH 3
+#define MQTT_PACKET_PUBACK 4
+#define MQTT_PACKET_PINGREQ 12
+#define MQTT_PACKET_PINGRESP 13
+
+MqttQos1Publisher::MqttQos1Publisher(Client& client)
+    : _client(client), _nextPacketId(1), _inFlight(0), _pingPending(false),
+      _rxState(RX_HEADER), _rxHeader(0), _rxLength(0), _rxShift(0), _rxPos(0) {
+    reset();
+}
+
+void MqttQos1Publisher::reset() {
+    for (uint8_t i = 0; i < MQTT_QOS1_WINDOW; i++) {
+        _window[i].packetId = 0;
+    }
+    _inFlight = 0;
+    _pingPending = false;
+    _stats = MqttAckStats();
+    _rxState = RX_HEADER;
+}
+
+void MqttQos1Publisher::setMessageHandler(MessageHandler handler) {
+    _handler = handler;
+}
+
+uint16_t MqttQos1Publisher::publish(const char* topic, const uint8_t* payload, size_t length, bool retained) {
+    // Window full: keep reading acks until a slot frees up
+    unsigned long start = millis();
+    while (_inFlight >= MQTT_QOS1_WINDOW) {
+        poll();
+        if (millis() - start >= MQTT_QOS1_ACK_TIMEOUT_MS || !_client.connected()) {
+            LogBox::line("ERROR: QoS 1 window stalled (no PUBACK)");
+            return 0;
+        }
+        delay(1);
+    }
+    
+    // Fixed header, topic and packet ID go out in one write, the payload in a second
+    size_t topicLength = strlen(topic);
+    size_t remaining = 2 + topicLength + 2 + length;
+    uint8_t header[MQTT_QOS1_HEADER_BUFFER_SIZE];
+    if (topicLength + 9 > sizeof(header) || remaining > 268435455UL) {
+        return 0;
+    }
+    
+    size_t pos = 0;
+    header[pos++] = (MQTT_PACKET_PUBLISH << 4) | (1 << 1) | (retained ? 1 : 0);  // QoS 1
+    do {
+        uint8_t digit = remaining % 128;
+        remaining /= 128;
+        header[pos++] = remaining > 0 ? (digit | 0x80) : digit;
+    } while (remaining > 0);
+    header[pos++] = topicLength >> 8;
+    header[pos++] = topicLength & 0xFF;
+    memcpy(header + pos, topic, topicLength);
+    pos += topicLength;
+    
+    uint16_t packetId = _nextPacketId;
+    _nextPacketId = _nextPacketId == 0xFFFF ? 1 : _nextPacketId + 1;
+    header[pos++] = packetId >> 8;
+    header[pos++] = packetId & 0xFF;
+    
+    if (_client.write(header, pos) != pos || (length > 0 && _client.write(payload, length) != length)) {
+        return 0;
+    }
+    
+    for (uint8_t i = 0; i < MQTT_QOS1_WINDOW; i++) {
+        if (_window[i].packetId == 0) {
+            _window[i].packetId = packetId;
+            _window[i].sentUs = micros();
+            break;
+        }
+    }
+    _inFlight++;
+    _stats.sent++;
+    return packetId;
+}
+
+void MqttQos1Publisher::poll() {
+    while (_client.available() > 0) {
+        int b = _client.read();
+        if (b < 0) {
+            break;
+        }
+        feed((uint8_t)b);
+    }
+}
+
+bool MqttQos1Publisher::flush(uint32_t timeoutMs) {
+    unsigned long start = millis();
+    const uint8_t pingreq[2] = { MQTT_PACKET_PINGREQ << 4, 0 };
+    _pingPending = _client.write(pingreq, sizeof(pingreq)) == sizeof(pingreq);
+    
+    poll();
+    while ((_pingPending || _inFlight > 0) && millis() - start < timeoutMs && _client.connected()) {
+        delay(1);
+        poll();
+    }
+    _stats.waitMs = millis() - start;
+    _stats.unacked = _inFlight;
+    return !_pingPending && _inFlight == 0;
+}
+
+bool MqttQos1Publisher::isPending(uint16_t packetId) {
+    if (packetId == 0) {
+        return false;
+    }
+    for (uint8_t i = 0; i < MQTT_QOS1_WINDOW; i++) {
+        if (_window[i].packetId == packetId) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void MqttQos1Publisher::feed(uint8_t b) {
+    switch (_rxState) {
+        case RX_HEADER:
+            _rxHeader = b;
+            _rxLength = 0;
+            _rxShift = 0;
+            _rxState = RX_LENGTH;
+            break;
+        
+        case RX_LENGTH:
+            _rxLength |= (uint32_t)(b & 0x7F) << _rxShift;
+            _rxShift += 7;
+            if ((b & 0x80) == 0) {
+                _rxPos = 0;
+                if (_rxLength == 0) {
+                    handlePacket();
+                    _rxState = RX_HEADER;
+                } else {
+                    _rxState = RX_BODY;
+                }
+            } else if (_rxShift > 21) {
+                _rxState = RX_HEADER;  // Malformed length - resynchronize
+            }
+            break;
+        
+        case RX_BODY:
+            if (_rxPos < sizeof(_rx)) {
+                _rx[_rxPos] = b;
+            }
+            _rxPos++;
+            if (_rxPos == _rxLength) {
+                handlePacket();
+                _rxState = RX_HEADER;
+            }
+            break;
+    }
+}
+
+void MqttQos1Publisher::handlePacket() {
+    uint8_t type = _rxHeader >> 4;
+    
+    if (type == MQTT_PACKET_PUBACK && _rxLength == 2) {
+        handleAck(((uint16_t)_rx[0] << 8) | _rx[1]);
+        return;
+    }
+    if (type == MQTT_PACKET_PINGRESP) {
+        _pingPending = false;
+        return;
+    }
+    
+    // Subscriptions are QoS 0 - a QoS 1/2 PUBLISH would carry a packet ID after the topic
+    if (type == MQTT_PACKET_PUBLISH && _handler && _rxLength <= sizeof(_rx) && _rxLength >= 2) {
+        uint16_t topicLength = ((uint16_t)_rx[0] << 8) | _rx[1];
+        size_t offset = 2 + topicLength + (((_rxHeader >> 1) & 0x03) > 0 ? 2 : 0);
+        if (offset > _rxLength) {
+            return;
+        }
+        char topic[MQTT_QOS1_RX_BUFFER_SIZE];
+        memcpy(topic, _rx + 2, topicLength);
+        topic[topicLength] = '\0';
+        _handler(topic, _rx + offset, _rxLength - offset);
+    }
+}
+
+void MqttQos1Publisher::handleAck(uint16_t packetId) {
+    for (uint8_t i = 0; i < MQTT_QOS1_WINDOW; i++) {
+        if (_window[i].packetId != packetId) {
+            continue;
+        }
+        uint32_t latencyUs = micros() - _window[i].sentUs;
+        _window[i].packetId = 0;
+        _inFlight--;
+        
+        if (_stats.acked == 0 || latencyUs < _stats.minAckUs) {
+            _stats.minAckUs = latencyUs;
+        }
+        if (latencyUs > _stats.maxAckUs) {
+            _stats.maxAckUs = latencyUs;
+        }
+        _stats.totalAckUs += latencyUs;
+        _stats.acked++;
+        LogBox::linef("PUBACK #%u: %.1f ms", packetId, latencyUs / 1000.0f);
+        return;
+    }
+    // Unknown ID: a late ack from a batch that was reset - ignore
+}
@@ -0,0 +1,103 @@
+#ifndef MQTT_QOS1_PUBLISHER_H
+#define MQTT_QOS1_PUBLISHER_H
+
+#include <Arduino.h>
+#include <Client.h>
+#include <functional>
+
+// ============================================
+// QOS 1 PIPELINE SETTINGS
+// ============================================
+#define MQTT_QOS1_WINDOW 8                 // PUBLISH packets awaiting PUBACK at once
+#define MQTT_QOS1_ACK_TIMEOUT_MS 2000      // Longest wait for a free window slot
+#define MQTT_QOS1_HEADER_BUFFER_SIZE 160   // Fixed header + topic + packet ID
+#define MQTT_QOS1_RX_BUFFER_SIZE 128       // Incoming packets kept (larger ones are skipped)
+
+// Acknowledgement counters for the current batch (since reset())
+struct MqttAckStats {
+    uint16_t sent;
+    uint16_t acked;
+    uint16_t unacked;      // Still outstanding when flush() gave up
+    uint32_t minAckUs;
+    uint32_t maxAckUs;
+    uint32_t totalAckUs;
+    uint32_t waitMs;       // Time flush() took (PUBACKs + PINGRESP)
+    
+    MqttAckStats() : sent(0), acked(0), unacked(0), minAckUs(0), maxAckUs(0), totalAckUs(0), waitMs(0) {}
+};
+
+/**
+ * MqttQos1Publisher - Pipelined QoS 1 PUBLISH on an open MQTT connection
+ *
+ * PubSubClient only publishes at QoS 0, so QoS 1 packets are written
+ * directly to the client socket it uses. Up to MQTT_QOS1_WINDOW packets
+ * are sent back-to-back without waiting; publish() only blocks when the
+ * window is full. PUBACKs are matched to their packet ID as they arrive
+ * and each one's round trip is logged.
+ *
+ * flush() is a delivery barrier for both QoS levels: it sends a PINGREQ
+ * and returns when the PINGRESP (and every outstanding PUBACK) is in. The
+ * broker handles packets in order, so the PINGRESP means everything
+ * written before it left the TCP send buffer and reached the broker.
+ *
+ * While this class reads the socket it also parses anything else the
+ * broker sends; PUBLISH packets (subscriptions) go to the message handler,
+ * the rest is ignored. Call reset() after every (re)connect.
+ */
+class MqttQos1Publisher {
+public:
+    typedef std::function<void(const char* topic, const uint8_t* payload, unsigned int length)> MessageHandler;
+    
+    MqttQos1Publisher(Client& client);
+    
+    // Forget outstanding packets and clear the batch counters
+    void reset();
+    
+    void setMessageHandler(MessageHandler handler);
+    
+    // Send one QoS 1 PUBLISH, returns its packet ID (0 on failure)
+    uint16_t publish(const char* topic, const uint8_t* payload, size_t length, bool retained);
+    
+    // Read whatever the broker has sent (non-blocking)
+    void poll();
+    
+    // PINGREQ/PINGRESP barrier: true once the broker has everything sent so
+    // far (and acked every QoS 1 packet), false if timeoutMs passed first
+    bool flush(uint32_t timeoutMs);
+    
+    // Packet still waiting for its PUBACK
+    bool isPending(uint16_t packetId);
+    uint8_t inFlight() { return _inFlight; }
+    
+    const MqttAckStats& getStats() { return _stats; }
+
+private:
+    struct InFlight {
+        uint16_t packetId;  // 0 = free slot
+        uint32_t sentUs;
+    };
+    
+    enum RxState { RX_HEADER, RX_LENGTH, RX_BODY };
+    
+    Client& _client;
+    MessageHandler _handler;
+    uint16_t _nextPacketId;
+    uint8_t _inFlight;
+    bool _pingPending;
+    InFlight _window[MQTT_QOS1_WINDOW];
+    MqttAckStats _stats;
+    
+    // Incoming packet parser (bytes may arrive split across polls)
+    RxState _rxState;
+    uint8_t _rxHeader;
+    uint32_t _rxLength;
+    uint8_t _rxShift;
+    uint32_t _rxPos;
+    uint8_t _rx[MQTT_QOS1_RX_BUFFER_SIZE];
+    
+    void feed(uint8_t b);
+    void handlePacket();
+    void handleAck(uint16_t packetId);
+};
+
+#endif // MQTT_QOS1_PUBLISHER_H
@@ -0,0 +1,374 @@
+#include "mqtt_tls_client.h"
+#include "logger.h"
+#include "mbedtls/error.h"
+#include "mbedtls/net_sockets.h"
+#include <esp_rom_crc.h>
+#include <stddef.h>
+
+#define MQTT_TLS_SESSION_MAGIC 0x534C5454UL  // "TTLS"
+#define MQTT_TLS_WRITE_TIMEOUT_MS 5000
+
+// Last negotiated session, offered again on the next connect (survives deep sleep)
+struct TlsSessionCache {
+    uint32_t magic;
+    uint32_t key;            // CRC32 of host name + port
+    uint32_t length;         // Serialized session bytes, 0 = none
+    uint32_t lastFullMs;
+    uint32_t lastResumedMs;
+    uint8_t data[MQTT_TLS_SESSION_RTC_BYTES];
+};
+static RTC_DATA_ATTR TlsSessionCache rtc_tlsSession;
+
+static void ensureSessionCache() {
+    if (rtc_tlsSession.magic != MQTT_TLS_SESSION_MAGIC) {
+        memset(&rtc_tlsSession, 0, offsetof(TlsSessionCache, data));
+        rtc_tlsSession.magic = MQTT_TLS_SESSION_MAGIC;
+    }
+}
+
+MqttTlsClient::MqttTlsClient(Client& transport)
+    : _transport(transport), _tls(false), _contextReady(false), _sessionUp(false), _peeked(-1),
+      _certVerified(false) {
+    mbedtls_ssl_init(&_ssl);
+    mbedtls_ssl_config_init(&_conf);
+    mbedtls_entropy_init(&_entropy);
+    mbedtls_ctr_drbg_init(&_drbg);
+    mbedtls_x509_crt_init(&_ca);
+}
+
+MqttTlsClient::~MqttTlsClient() {
+    stop();
+    mbedtls_ssl_free(&_ssl);
+    mbedtls_ssl_config_free(&_conf);
+    mbedtls_ctr_drbg_free(&_drbg);
+    mbedtls_entropy_free(&_entropy);
+    mbedtls_x509_crt_free(&_ca);
+}
+
+void MqttTlsClient::setTls(bool enabled, const char* hostname) {
+    if (enabled != _tls) {
+        stop();
+    }
+    _tls = enabled;
+    _hostname = hostname;
+}
+
+int MqttTlsClient::connect(IPAddress ip, uint16_t port) {
+    if (!_transport.connect(ip, port)) {
+        return 0;
+    }
+    return _tls ? handshake(port) : 1;
+}
+
+int MqttTlsClient::connect(const char* host, uint16_t port) {
+    if (!_transport.connect(host, port)) {
+        return 0;
+    }
+    return _tls ? handshake(port) : 1;
+}
+
+int MqttTlsClient::connect(IPAddress ip, uint16_t port, int32_t timeout) {
+    if (!_transport.connect(ip, port, timeout)) {
+        return 0;
+    }
+    return _tls ? handshake(port) : 1;
+}
+
+int MqttTlsClient::connect(const char* host, uint16_t port, int32_t timeout) {
+    if (!_transport.connect(host, port, timeout)) {
+        return 0;
+    }
+    return _tls ? handshake(port) : 1;
+}
+
+bool MqttTlsClient::setupContext() {
+    if (_contextReady) {
+        return true;
+    }
+    
+#if !defined(MQTT_TLS_CA_CERT) && !MQTT_TLS_INSECURE
+    // Fail closed: nothing to verify the broker against and no opt-out
+    LogBox::line("ERROR: mqtts:// needs MQTT_TLS_CA_CERT (or MQTT_TLS_INSECURE true) in board_config.h");
+    return false;
+#endif
+    
+    const char* personalization = "mqtt_tls";
+    int ret = mbedtls_ctr_drbg_seed(&_drbg, mbedtls_entropy_func, &_entropy,
+                                    (const unsigned char*)personalization, strlen(personalization));
+    if (ret == 0) {
+        ret = mbedtls_ssl_config_defaults(&_conf, MBEDTLS_SSL_IS_CLIENT, MBEDTLS_SSL_TRANSPORT_STREAM,
+                                          MBEDTLS_SSL_PRESET_DEFAULT);
+    }
+#ifdef MQTT_TLS_CA_CERT
+    if (ret == 0) {
+        ret = mbedtls_x509_crt_parse(&_ca, (const unsigned char*)MQTT_TLS_CA_CERT, strlen(MQTT_TLS_CA_CERT) + 1);
+    }
+    mbedtls_ssl_conf_ca_chain(&_conf, &_ca, nullptr);
+    mbedtls_ssl_conf_authmode(&_conf, MBEDTLS_SSL_VERIFY_REQUIRED);
+#else
+    // The chain is still parsed (verifyCertificate() clears the result) so
+    // full handshakes can be told apart from resumed ones
+    mbedtls_ssl_conf_authmode(&_conf, MBEDTLS_SSL_VERIFY_OPTIONAL);
+#endif
+    mbedtls_ssl_conf_rng(&_conf, mbedtls_ctr_drbg_random, &_drbg);
+    mbedtls_ssl_conf_verify(&_conf, verifyCertificate, this);
+#if defined(MBEDTLS_SSL_SESSION_TICKETS)
+    mbedtls_ssl_conf_session_tickets(&_conf, MBEDTLS_SSL_SESSION_TICKETS_ENABLED);
+#endif
+#if defined(MBEDTLS_SSL_PROTO_TLS1_3)
+    // TLS 1.3 tickets arrive after the handshake; stay on 1.2 so the
+    // session can be saved as soon as connect() returns
+    mbedtls_ssl_conf_max_tls_version(&_conf, MBEDTLS_SSL_VERSION_TLS1_2);
+#endif
+    if (ret == 0) {
+        ret = mbedtls_ssl_setup(&_ssl, &_conf);
+    }
+    
+    if (ret != 0) {
+        char error[80];
+        mbedtls_strerror(ret, error, sizeof(error));
+        LogBox::linef("ERROR: TLS setup failed: -0x%04X %s", (unsigned)-ret, error);
+        return false;
+    }
+#ifndef MQTT_TLS_CA_CERT
+    LogBox::line("TLS: broker certificate not verified (MQTT_TLS_INSECURE)");
+#endif
+    _contextReady = true;
+    return true;
+}
+
+int MqttTlsClient::handshake(uint16_t port) {
+    if (!setupContext()) {
+        _transport.stop();
+        return 0;
+    }
+    
+    mbedtls_ssl_session_reset(&_ssl);
+    mbedtls_ssl_set_hostname(&_ssl, _hostname.c_str());
+    mbedtls_ssl_set_bio(&_ssl, &_transport, bioSend, bioRecv, nullptr);
+    bool offered = restoreSession(port);
+    _certVerified = false;
+    _peeked = -1;
+    
+    unsigned long start = millis();
+    int ret;
+    while ((ret = mbedtls_ssl_handshake(&_ssl)) != 0) {
+        bool pending = ret == MBEDTLS_ERR_SSL_WANT_READ || ret == MBEDTLS_ERR_SSL_WANT_WRITE;
+        if (!pending || millis() - start >= MQTT_TLS_HANDSHAKE_TIMEOUT_MS) {
+            char error[80];
+            mbedtls_strerror(ret, error, sizeof(error));
+            LogBox::linef("ERROR: TLS handshake failed: -0x%04X %s", (unsigned)-ret, error);
+            rtc_tlsSession.length = 0;  // Start over with a full handshake
+            _transport.stop();
+            return 0;
+        }
+        delay(1);
+    }
+    uint32_t elapsed = millis() - start;
+    
+    // A resumed handshake skips the Certificate message, so the verify
+    // callback only runs on full handshakes
+    bool resumed = offered && !_certVerified;
+    _stats.handshakes++;
+    _stats.lastMs = elapsed;
+    _stats.lastResumed = resumed;
+    if (resumed) {
+        _stats.resumed++;
+        rtc_tlsSession.lastResumedMs = elapsed;
+    } else {
+        rtc_tlsSession.lastFullMs = elapsed;
+    }
+    _stats.lastFullMs = rtc_tlsSession.lastFullMs;
+    _stats.lastResumedMs = rtc_tlsSession.lastResumedMs;
+    
+    if (resumed && _stats.lastFullMs > 0) {
+        LogBox::linef("TLS handshake: %lu ms (resumed, last full: %lu ms)", (unsigned long)elapsed,
+                      (unsigned long)_stats.lastFullMs);
+    } else {
+        LogBox::linef("TLS handshake: %lu ms (%s)", (unsigned long)elapsed,
+                      resumed ? "resumed" : (offered ? "full - saved session not accepted" : "full"));
+    }
+    
+    _sessionUp = true;
+    saveSession(port);
+    return 1;
+}
+
+uint32_t MqttTlsClient::sessionKey(uint16_t port) {
+    uint32_t key = esp_rom_crc32_le(0, (const uint8_t*)_hostname.c_str(), _hostname.length());
+    return esp_rom_crc32_le(key, (const uint8_t*)&port, sizeof(port));
+}
+
+bool MqttTlsClient::restoreSession(uint16_t port) {
+    ensureSessionCache();
+    if (rtc_tlsSession.length == 0 || rtc_tlsSession.key != sessionKey(port)) {
+        return false;
+    }
+    
+    // load() also rejects sessions saved by a differently configured mbedtls
+    mbedtls_ssl_session session;
+    mbedtls_ssl_session_init(&session);
+    bool restored = mbedtls_ssl_session_load(&session, rtc_tlsSession.data, rtc_tlsSession.length) == 0 &&
+                    mbedtls_ssl_set_session(&_ssl, &session) == 0;
+    mbedtls_ssl_session_free(&session);
+    
+    if (!restored) {
+        rtc_tlsSession.length = 0;
+    }
+    return restored;
+}
+
+void MqttTlsClient::saveSession(uint16_t port) {
+    ensureSessionCache();
+    mbedtls_ssl_session session;
+    mbedtls_ssl_session_init(&session);
+    size_t length = 0;
+    int ret = mbedtls_ssl_get_session(&_ssl, &session);
+    if (ret == 0) {
+        ret = mbedtls_ssl_session_save(&session, rtc_tlsSession.data, sizeof(rtc_tlsSession.data), &length);
+    }
+    mbedtls_ssl_session_free(&session);
+    
+    if (ret == MBEDTLS_ERR_SSL_BUFFER_TOO_SMALL) {
+        LogBox::linef("TLS session not kept: %u bytes > MQTT_TLS_SESSION_RTC_BYTES", (unsigned)length);
+    } else if (ret == 0) {
+        LogBox::linef("TLS session saved: %u of %u bytes", (unsigned)length, (unsigned)MQTT_TLS_SESSION_RTC_BYTES);
+    }
+    rtc_tlsSession.key = sessionKey(port);
+    rtc_tlsSession.length = ret == 0 ? length : 0;
+}
+
+size_t MqttTlsClient::write(uint8_t b) {
+    return write(&b, 1);
+}
+
+size_t MqttTlsClient::write(const uint8_t* buf, size_t size) {
+    if (!_tls) {
+        return _transport.write(buf, size);
+    }
+    if (!_sessionUp) {
+        return 0;
+    }
+    
+    size_t sent = 0;
+    unsigned long start = millis();
+    while (sent < size) {
+        int ret = mbedtls_ssl_write(&_ssl, buf + sent, size - sent);
+        if (ret > 0) {
+            sent += ret;
+            continue;
+        }
+        if (ret != MBEDTLS_ERR_SSL_WANT_WRITE && ret != MBEDTLS_ERR_SSL_WANT_READ) {
+            _sessionUp = false;
+            break;
+        }
+        if (millis() - start >= MQTT_TLS_WRITE_TIMEOUT_MS) {
+            break;
+        }
+        delay(1);
+    }
+    return sent;
+}
+
+int MqttTlsClient::available() {
+    if (!_tls) {
+        return _transport.available();
+    }
+    if (!_sessionUp) {
+        return _peeked >= 0 ? 1 : 0;
+    }
+    
+    // Decrypt the next record when bytes arrived; a zero-length read
+    // processes it without consuming any plaintext
+    if (mbedtls_ssl_get_bytes_avail(&_ssl) == 0 && _transport.available() > 0) {
+        int ret = mbedtls_ssl_read(&_ssl, nullptr, 0);
+        if (ret < 0 && ret != MBEDTLS_ERR_SSL_WANT_READ && ret != MBEDTLS_ERR_SSL_WANT_WRITE) {
+            _sessionUp = false;  // Close notify or fatal alert
+        }
+    }
+    return (_peeked >= 0 ? 1 : 0) + (int)mbedtls_ssl_get_bytes_avail(&_ssl);
+}
+
+int MqttTlsClient::read() {
+    uint8_t b;
+    return read(&b, 1) == 1 ? b : -1;
+}
+
+int MqttTlsClient::read(uint8_t* buf, size_t size) {
+    if (!_tls) {
+        return _transport.read(buf, size);
+    }
+    if (size == 0) {
+        return 0;
+    }
+    
+    int count = 0;
+    if (_peeked >= 0) {
+        buf[count++] = (uint8_t)_peeked;
+        _peeked = -1;
+    }
+    if ((size_t)count < size && _sessionUp && available() > 0) {
+        int ret = mbedtls_ssl_read(&_ssl, buf + count, size - count);
+        if (ret > 0) {
+            count += ret;
+        }
+    }
+    return count > 0 ? count : -1;
+}
+
+int MqttTlsClient::peek() {
+    if (!_tls) {
+        return _transport.peek();
+    }
+    if (_peeked < 0) {
+        _peeked = read();
+    }
+    return _peeked;
+}
+
+void MqttTlsClient::flush() {
+    _transport.flush();
+}
+
+void MqttTlsClient::stop() {
+    if (_tls && _sessionUp) {
+        mbedtls_ssl_close_notify(&_ssl);  // Best effort, the socket closes anyway
+    }
+    _sessionUp = false;
+    _peeked = -1;
+    _transport.stop();
+}
+
+uint8_t MqttTlsClient::connected() {
+    if (!_tls) {
+        return _transport.connected();
+    }
+    return _sessionUp && _transport.connected();
+}
+
+int MqttTlsClient::bioSend(void* ctx, const unsigned char* buf, size_t len) {
+    Client* client = static_cast<Client*>(ctx);
+    size_t written = client->write(buf, len);
+    if (written > 0) {
+        return (int)written;
+    }
+    return client->connected() ? MBEDTLS_ERR_SSL_WANT_WRITE : MBEDTLS_ERR_NET_CONN_RESET;
+}
+
+int MqttTlsClient::bioRecv(void* ctx, unsigned char* buf, size_t len) {
+    Client* client = static_cast<Client*>(ctx);
+    int available = client->available();
+    if (available <= 0) {
+        return client->connected() ? MBEDTLS_ERR_SSL_WANT_READ : MBEDTLS_ERR_NET_CONN_RESET;
+    }
+    int count = client->read(buf, len < (size_t)available ? len : (size_t)available);
+    return count > 0 ? count : MBEDTLS_ERR_SSL_WANT_READ;
+}
+
+int MqttTlsClient::verifyCertificate(void* ctx, mbedtls_x509_crt* crt, int depth, uint32_t* flags) {
+    static_cast<MqttTlsClient*>(ctx)->_certVerified = true;
+#if !defined(MQTT_TLS_CA_CERT) && MQTT_TLS_INSECURE
+    *flags = 0;  // Opted in: encrypt without authenticating the broker
+#endif
+    return 0;
+}
@@ -0,0 +1,123 @@
+#ifndef MQTT_TLS_CLIENT_H
+#define MQTT_TLS_CLIENT_H
+
+#include <Arduino.h>
+#include <Client.h>
+#include "mbedtls/ssl.h"
+#include "mbedtls/entropy.h"
+#include "mbedtls/ctr_drbg.h"
+#include "mbedtls/x509_crt.h"
+
+// ============================================
+// TLS SETTINGS (mqtts:// broker URLs)
+// ============================================
+#define MQTT_TLS_PORT 8883                   // Default port for mqtts://
+#define MQTT_TLS_HANDSHAKE_TIMEOUT_MS 10000
+
+// PEM CA certificate for the broker. Define it in board_config.h; without
+// it mqtts:// connections are refused unless MQTT_TLS_INSECURE is true.
+// #define MQTT_TLS_CA_CERT "-----BEGIN CERTIFICATE-----\n...\n-----END CERTIFICATE-----\n"
+
+// Connect to mqtts:// brokers without MQTT_TLS_CA_CERT: encrypted, but the
+// broker is not authenticated, so anyone on the path can impersonate it.
+#ifndef MQTT_TLS_INSECURE
+#define MQTT_TLS_INSECURE false
+#endif
+
+// Serialized TLS session kept in RTC memory for resumption after deep
+// sleep: fixed fields, the session ticket and - with
+// MBEDTLS_SSL_KEEP_PEER_CERTIFICATE (on in ESP-IDF's default config) - the
+// broker's whole DER certificate, often over 1 KB on its own. The size of
+// every saved session is logged; sessions that do not fit are not kept.
+#ifndef MQTT_TLS_SESSION_RTC_BYTES
+#if defined(MBEDTLS_SSL_KEEP_PEER_CERTIFICATE)
+#define MQTT_TLS_SESSION_RTC_BYTES 2048
+#else
+#define MQTT_TLS_SESSION_RTC_BYTES 512
+#endif
+#endif
+
+// Handshake counters (since boot) and last handshake times (kept in RTC memory)
+struct MqttTlsStats {
+    uint32_t handshakes;
+    uint32_t resumed;         // Handshakes that reused the saved session
+    uint32_t lastMs;          // Most recent handshake
+    uint32_t lastFullMs;      // Most recent full handshake (0 = none yet)
+    uint32_t lastResumedMs;   // Most recent resumed handshake (0 = none yet)
+    bool lastResumed;
+    
+    MqttTlsStats() : handshakes(0), resumed(0), lastMs(0), lastFullMs(0), lastResumedMs(0), lastResumed(false) {}
+};
+
+/**
+ * MqttTlsClient - TLS 1.2 on top of a plain Client, with session resumption
+ *
+ * WiFiClientSecure runs the whole handshake inside connect() and offers no
+ * way to hand mbedtls a saved session first, so every wake would pay for a
+ * full handshake (certificate chain, key exchange - seconds of CPU). This
+ * client drives mbedtls itself over the transport socket:
+ * - After each handshake the session (ID or ticket, master secret) is
+ *   serialized into RTC memory
+ * - The next connect to the same host:port offers it back; if the broker
+ *   still knows it, the handshake skips the certificate and key exchange
+ * - A rejected session falls back to a full handshake automatically
+ *
+ * With setTls(false) every call goes straight to the transport, so
+ * PubSubClient and MqttQos1Publisher use this class for both mqtt:// and
+ * mqtts:// brokers.
+ */
+class MqttTlsClient : public Client {
+public:
+    MqttTlsClient(Client& transport);
+    ~MqttTlsClient();
+    
+    // hostname: SNI and certificate name, also identifies the saved session
+    void setTls(bool enabled, const char* hostname);
+    bool isTls() { return _tls; }
+    
+    int connect(IPAddress ip, uint16_t port) override;
+    int connect(const char* host, uint16_t port) override;
+    int connect(IPAddress ip, uint16_t port, int32_t timeout);
+    int connect(const char* host, uint16_t port, int32_t timeout);
+    size_t write(uint8_t b) override;
+    size_t write(const uint8_t* buf, size_t size) override;
+    int available() override;
+    int read() override;
+    int read(uint8_t* buf, size_t size) override;
+    int peek() override;
+    void flush() override;
+    void stop() override;
+    uint8_t connected() override;
+    operator bool() override { return connected(); }
+    
+    const MqttTlsStats& getStats() { return _stats; }
+
+private:
+    Client& _transport;
+    bool _tls;
+    String _hostname;
+    bool _contextReady;    // Config, RNG and CA set up (once)
+    bool _sessionUp;       // Handshake completed on the current connection
+    int _peeked;           // Byte read ahead by peek(), -1 if none
+    bool _certVerified;    // Certificate callback ran (full handshake)
+    MqttTlsStats _stats;
+    
+    mbedtls_ssl_context _ssl;
+    mbedtls_ssl_config _conf;
+    mbedtls_entropy_context _entropy;
+    mbedtls_ctr_drbg_context _drbg;
+    mbedtls_x509_crt _ca;
+    
+    bool setupContext();
+    int handshake(uint16_t port);
+    void saveSession(uint16_t port);
+    bool restoreSession(uint16_t port);
+    uint32_t sessionKey(uint16_t port);
+    
+    // mbedtls callbacks
+    static int bioSend(void* ctx, const unsigned char* buf, size_t len);
+    static int bioRecv(void* ctx, unsigned char* buf, size_t len);
+    static int verifyCertificate(void* ctx, mbedtls_x509_crt* crt, int depth, uint32_t* flags);
+};
+
+#endif // MQTT_TLS_CLIENT_H
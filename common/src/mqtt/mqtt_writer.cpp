@@ -0,0 +1,146 @@
+#include "mqtt_writer.h"
+#include <math.h>
+
+MqttWriter::MqttWriter(char* buffer, size_t size)
+    : _buffer(buffer), _size(size), _length(0), _required(0), _firstMember(true) {
+    if (_size > 0) {
+        _buffer[0] = '\0';
+    }
+}
+
+void MqttWriter::clear() {
+    _length = 0;
+    _required = 0;
+    _firstMember = true;
+    if (_size > 0) {
+        _buffer[0] = '\0';
+    }
+}
+
+void MqttWriter::append(char c) {
+    _required++;
+    if (_length + 1 < _size) {
+        _buffer[_length++] = c;
+        _buffer[_length] = '\0';
+    }
+}
+
+void MqttWriter::append(const char* text) {
+    while (*text) {
+        append(*text++);
+    }
+}
+
+void MqttWriter::appendUInt(unsigned long value) {
+    char digits[12];
+    int count = 0;
+    do {
+        digits[count++] = (char)('0' + value % 10);
+        value /= 10;
+    } while (value > 0);
+    
+    while (count > 0) {
+        append(digits[--count]);
+    }
+}
+
+void MqttWriter::appendInt(long value) {
+    if (value < 0) {
+        append('-');
+        appendUInt(0UL - (unsigned long)value);
+    } else {
+        appendUInt((unsigned long)value);
+    }
+}
+
+void MqttWriter::appendFloat(float value, uint8_t decimals) {
+    if (isnan(value) || isinf(value)) {
+        append("null");  // Not representable in JSON
+        return;
+    }
+    if (decimals > 6) {
+        decimals = 6;
+    }
+    
+    uint32_t scale = 1;
+    for (uint8_t i = 0; i < decimals; i++) {
+        scale *= 10;
+    }
+    
+    // Beyond 2^64 the scaled value has no uint64_t (the cast would be
+    // undefined): out of range like NaN
+    double magnitude = value < 0 ? -(double)value : (double)value;
+    double rounded = magnitude * scale + 0.5;
+    if (rounded >= 18446744073709551616.0) {
+        append("null");
+        return;
+    }
+    uint64_t scaled = (uint64_t)rounded;
+    if (value < 0 && scaled > 0) {
+        append('-');
+    }
+    
+    // Integer part, then zero-padded fraction
+    uint64_t integer = scaled / scale;
+    uint32_t fraction = (uint32_t)(scaled % scale);
+    char digits[21];
+    int count = 0;
+    do {
+        digits[count++] = (char)('0' + integer % 10);
+        integer /= 10;
+    } while (integer > 0);
+    while (count > 0) {
+        append(digits[--count]);
+    }
+    
+    if (decimals > 0) {
+        append('.');
+        for (uint32_t divisor = scale / 10; divisor > 0; divisor /= 10) {
+            append((char)('0' + (fraction / divisor) % 10));
+        }
+    }
+}
+
+void MqttWriter::appendEscaped(const char* text) {
+    static const char hex[] = "0123456789abcdef";
+    for (; *text; text++) {
+        char c = *text;
+        if (c == '"' || c == '\\') {
+            append('\\');
+            append(c);
+        } else if ((uint8_t)c < 0x20) {
+            append("\\u00");
+            append(hex[(c >> 4) & 0x0F]);
+            append(hex[c & 0x0F]);
+        } else {
+            append(c);
+        }
+    }
+}
+
+void MqttWriter::jsonKey(const char* key) {
+    if (!_firstMember) {
+        append(',');
+    }
+    _firstMember = false;
+    append('"');
+    append(key);
+    append("\":");
+}
+
+void MqttWriter::jsonString(const char* key, const char* value) {
+    jsonKey(key);
+    append('"');
+    appendEscaped(value);
+    append('"');
+}
+
+void MqttWriter::beginObject() {
+    append('{');
+    _firstMember = true;
+}
+
+void MqttWriter::endObject() {
+    append('}');
+    _firstMember = false;
+}
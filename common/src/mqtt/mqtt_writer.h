@@ -0,0 +1,67 @@
+#ifndef MQTT_WRITER_H
+#define MQTT_WRITER_H
+
+#include <Arduino.h>
+
+/**
+ * MqttWriter - Bounded text builder for MQTT topics and JSON payloads (no heap)
+ *
+ * Appends into a caller-owned buffer and always keeps it NUL-terminated.
+ * When the buffer is full further output is dropped and overflow() turns
+ * true, but requiredSize() keeps counting, so a caller can size a buffer
+ * with a first pass. Numbers are formatted in place without String or
+ * printf("%f").
+ *
+ * Use MqttBuffer<N> for inline (stack or member) storage:
+ *   MqttBuffer<MQTT_TOPIC_BUFFER_SIZE> topic;
+ *   topic.append(prefix);
+ *   topic.append("/loop_time/state");
+ */
+class MqttWriter {
+public:
+    MqttWriter(char* buffer, size_t size);
+    
+    void clear();
+    
+    // Raw text
+    void append(char c);
+    void append(const char* text);
+    void append(const String& text) { append(text.c_str()); }
+    
+    // Numbers
+    void appendInt(long value);
+    void appendUInt(unsigned long value);
+    void appendFloat(float value, uint8_t decimals);  // Fixed point, rounded half up; null if out of range
+    
+    // JSON helpers - jsonKey() writes the separating comma after the first member
+    void appendEscaped(const char* text);              // JSON string body (no quotes)
+    void jsonKey(const char* key);                     // ,"key":
+    void jsonString(const char* key, const char* value);
+    void beginObject();
+    void endObject();
+    
+    const char* c_str() const { return _buffer; }
+    size_t length() const { return _length; }
+    size_t requiredSize() const { return _required + 1; }  // Including terminator
+    bool overflow() const { return _required > _length; }
+
+private:
+    char* _buffer;
+    size_t _size;
+    size_t _length;    // Characters stored
+    size_t _required;  // Characters written (including dropped ones)
+    bool _firstMember;
+};
+
+template <size_t N>
+class MqttBuffer : public MqttWriter {
+public:
+    MqttBuffer() : MqttWriter(_storage, N) {}
+    MqttBuffer(const MqttBuffer&) = delete;
+    MqttBuffer& operator=(const MqttBuffer&) = delete;
+
+private:
+    char _storage[N];
+};
+
+#endif // MQTT_WRITER_H
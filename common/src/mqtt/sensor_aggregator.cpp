@@ -0,0 +1,153 @@
+#include "sensor_aggregator.h"
+#include "mqtt_writer.h"
+#include <math.h>
+
+#define AGGREGATE_STAT_COUNT 4
+
+// Derived sensors, indexed by the AggregateStat bit
+static const char* const kStatKeySuffix[AGGREGATE_STAT_COUNT] = { "_min", "_max", "_mean", "_count" };
+static const char* const kStatNameSuffix[AGGREGATE_STAT_COUNT] = { " Min", " Max", " Mean", " Samples" };
+
+struct AggregatorSlot {
+    int sensorId;
+    int statIds[AGGREGATE_STAT_COUNT];  // Derived sensor IDs, -1 if not published
+    RunningStats window;
+    SensorDescriptor descriptors[AGGREGATE_STAT_COUNT];  // Referenced by the registry
+    char keys[AGGREGATE_STAT_COUNT][SENSOR_KEY_SIZE];
+    char names[AGGREGATE_STAT_COUNT][SENSOR_NAME_SIZE];
+};
+
+static AggregatorSlot s_slots[SENSOR_AGGREGATOR_SLOTS];
+static int s_slotCount = 0;
+static uint8_t s_slotOf[SENSOR_REGISTRY_SIZE];  // Sensor ID -> slot + 1, 0 if not tracked
+
+void RunningStats::reset() {
+    count = 0;
+    mean = 0.0;
+    min = 0.0f;
+    max = 0.0f;
+    last = 0.0f;
+}
+
+void RunningStats::add(float value) {
+    count++;
+    if (count == 1) {
+        mean = value;
+        min = max = value;
+    } else {
+        mean += (value - mean) / count;
+        if (value < min) {
+            min = value;
+        }
+        if (value > max) {
+            max = value;
+        }
+    }
+    last = value;
+}
+
+static AggregatorSlot* slotOf(int sensorId) {
+    if (sensorId < 0 || sensorId >= SENSOR_REGISTRY_SIZE || s_slotOf[sensorId] == 0) {
+        return nullptr;
+    }
+    return &s_slots[s_slotOf[sensorId] - 1];
+}
+
+bool SensorAggregator::track(int sensorId, uint8_t stats) {
+    if (s_slotCount >= SENSOR_AGGREGATOR_SLOTS || sensorId < 0 || sensorId >= SensorRegistry::count() ||
+        slotOf(sensorId) != nullptr) {
+        return false;
+    }
+    const SensorDescriptor& sensor = SensorRegistry::get(sensorId);
+    if (sensor.format != SENSOR_NUMBER) {
+        return false;
+    }
+    
+    AggregatorSlot& slot = s_slots[s_slotCount];
+    int needed = 0;
+    for (int stat = 0; stat < AGGREGATE_STAT_COUNT; stat++) {
+        slot.statIds[stat] = -1;
+        if (!(stats & (1 << stat))) {
+            continue;
+        }
+        MqttWriter key(slot.keys[stat], SENSOR_KEY_SIZE);
+        key.append(sensor.key);
+        key.append(kStatKeySuffix[stat]);
+        MqttWriter name(slot.names[stat], SENSOR_NAME_SIZE);
+        name.append(sensor.name);
+        name.append(kStatNameSuffix[stat]);
+        if (key.overflow() || name.overflow() || SensorRegistry::find(slot.keys[stat]) >= 0) {
+            return false;
+        }
+        needed++;
+    }
+    // Check the space first - registered sensors cannot be removed again
+    if (SensorRegistry::count() + needed > SENSOR_REGISTRY_SIZE) {
+        return false;
+    }
+    
+    for (int stat = 0; stat < AGGREGATE_STAT_COUNT; stat++) {
+        if (!(stats & (1 << stat))) {
+            continue;
+        }
+        bool isCount = (1 << stat) == AGGREGATE_COUNT;
+        slot.descriptors[stat] = {
+            slot.keys[stat], slot.names[stat],
+            isCount ? "" : sensor.deviceClass,
+            isCount ? "samples" : sensor.unit,
+            isCount ? (uint8_t)0 : sensor.precision,
+            SENSOR_NUMBER,
+            NAN,  // Left out by flush() when the window is empty
+            isCount ? 0.0f : sensor.deadband,
+            sensor.maxSilenceSeconds,
+            false
+        };
+        slot.statIds[stat] = SensorRegistry::add(slot.descriptors[stat]);
+    }
+    slot.sensorId = sensorId;
+    slot.window.reset();
+    s_slotOf[sensorId] = ++s_slotCount;
+    return true;
+}
+
+void SensorAggregator::add(int sensorId, float value) {
+    AggregatorSlot* slot = slotOf(sensorId);
+    if (slot == nullptr || isnan(value) || value == SensorRegistry::get(sensorId).skipValue) {
+        return;
+    }
+    slot->window.add(value);
+}
+
+uint32_t SensorAggregator::flush(SensorValues& values) {
+    uint32_t flushed = 0;
+    for (int i = 0; i < s_slotCount; i++) {
+        AggregatorSlot& slot = s_slots[i];
+        const RunningStats& window = slot.window;
+        if (window.count == 0) {
+            // Nothing sampled - leave the sensor and its statistics out
+            values.setText(slot.sensorId, "");
+            for (int stat = 0; stat < AGGREGATE_STAT_COUNT; stat++) {
+                values.setText(slot.statIds[stat], "");
+            }
+            continue;
+        }
+        
+        const float statValues[AGGREGATE_STAT_COUNT] = { window.min, window.max, (float)window.mean, (float)window.count };
+        values.set(slot.sensorId, window.last);
+        for (int stat = 0; stat < AGGREGATE_STAT_COUNT; stat++) {
+            values.set(slot.statIds[stat], statValues[stat]);
+        }
+        flushed += window.count;
+        slot.window.reset();
+    }
+    return flushed;
+}
+
+uint32_t SensorAggregator::samples(int sensorId) {
+    AggregatorSlot* slot = slotOf(sensorId);
+    return slot != nullptr ? slot->window.count : 0;
+}
+
+int SensorAggregator::tracked() {
+    return s_slotCount;
+}
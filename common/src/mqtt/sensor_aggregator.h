@@ -0,0 +1,95 @@
+#ifndef SENSOR_AGGREGATOR_H
+#define SENSOR_AGGREGATOR_H
+
+#include <Arduino.h>
+#include "sensor_registry.h"
+
+// ============================================
+// AGGREGATION SETTINGS
+// ============================================
+#define SENSOR_AGGREGATOR_SLOTS 4     // Sensors that can be aggregated at once
+#define SENSOR_NAME_SIZE 48           // Derived name incl. suffix and terminator
+
+// Each slot registers up to four sensors (min, max, mean, count): keep
+// room for all of them next to the application sensor budget
+static_assert(SENSOR_REGISTRY_SIZE >= SENSOR_BUILTIN_COUNT + SENSOR_APP_BUDGET + SENSOR_AGGREGATOR_SLOTS * 4,
+              "SENSOR_REGISTRY_SIZE has no room for every aggregator stat");
+
+// Default publish interval of publishTelemetryWindow() (always-on mode)
+#ifndef SENSOR_WINDOW_SECONDS
+#define SENSOR_WINDOW_SECONDS 60
+#endif
+
+// Statistics published per window (the sensor itself carries the last sample)
+enum AggregateStat : uint8_t {
+    AGGREGATE_MIN   = 0x01,  // <key>_min
+    AGGREGATE_MAX   = 0x02,  // <key>_max
+    AGGREGATE_MEAN  = 0x04,  // <key>_mean
+    AGGREGATE_COUNT = 0x08,  // <key>_count
+    AGGREGATE_ALL   = 0x0F
+};
+
+/**
+ * RunningStats - Streaming min/max/mean/count/last of one window
+ *
+ * The mean is updated incrementally (Welford), so there is no running sum
+ * to overflow however many samples a window holds. It is kept as a double:
+ * in a float the step (value - mean) / count drops below half an ulp of the
+ * mean after a few thousand samples of a value like 101325 Pa, and the mean
+ * stops following the samples.
+ */
+struct RunningStats {
+    uint32_t count;
+    double mean;
+    float min;
+    float max;
+    float last;
+    
+    RunningStats() { reset(); }
+    
+    void reset();
+    void add(float value);
+};
+
+/**
+ * SensorAggregator - Windowed statistics for sensors sampled faster than they are published
+ *
+ * track() a registered sensor once in setup(); it registers the derived
+ * sensors (<key>_min, _max, _mean, _count) with the same device class,
+ * unit, precision and deadband. add() is O(1) and allocation-free, so a
+ * loop can sample at 10 Hz or more. flush() writes the window into a
+ * SensorValues table - the sensor's own value becomes the last sample -
+ * and starts the next window. A sensor without samples in the window is
+ * left out.
+ *
+ *   static const SensorDescriptor kSoilMoisture = { "soil_moisture", ... };
+ *   soilMoistureId = SensorRegistry::add(kSoilMoisture);
+ *   SensorAggregator::track(soilMoistureId);
+ *   ...
+ *   SensorAggregator::add(soilMoistureId, readSoilMoisture());  // Every sample
+ *
+ * Telemetry published from startup_helpers flushes into
+ * applicationSensorValues() automatically. add() and flush() must run on
+ * the same task (there is no lock).
+ */
+class SensorAggregator {
+public:
+    // Aggregate a registered sensor; false if no slot is free, the sensor is
+    // unknown or already tracked, or the derived sensors do not fit the registry
+    static bool track(int sensorId, uint8_t stats = AGGREGATE_ALL);
+    
+    // Add one sample (ignored for untracked sensors, NAN and the sensor's skip value)
+    static void add(int sensorId, float value);
+    
+    // Write every tracked sensor's window into values and reset the windows.
+    // Returns the number of samples flushed.
+    static uint32_t flush(SensorValues& values);
+    
+    // Samples in the current window of one sensor (0 if not tracked)
+    static uint32_t samples(int sensorId);
+    
+    // Sensors currently tracked
+    static int tracked();
+};
+
+#endif // SENSOR_AGGREGATOR_H
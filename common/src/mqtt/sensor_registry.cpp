@@ -0,0 +1,92 @@
+#include "sensor_registry.h"
+#include "mqtt_writer.h"
+
+// Built-in sensors, indexed by BuiltinSensor. The skip values match what
+// the telemetry producers report when a metric is not available.
+static const SensorDescriptor kBuiltinSensors[SENSOR_BUILTIN_COUNT] = {
+    // key                    name                   device class        unit         prec format          skip     deadband  silence attrs
+    { "battery_voltage",     "Battery Voltage",     "voltage",          "V",         2,  SENSOR_NUMBER,  0.0f,    0.05f,    0,      false },
+    { "battery_percentage",  "Battery Percentage",  "battery",          "%",         0,  SENSOR_NUMBER,  -1.0f,   0.0f,     0,      false },
+    { "loop_time",           "Loop Time",           "duration",         "s",         2,  SENSOR_NUMBER,  NAN,     0.25f,    0,      false },
+    { "wifi_signal",         "WiFi Signal",         "signal_strength",  "dBm",       0,  SENSOR_NUMBER,  NAN,     5.0f,     0,      false },
+    { "wifi_bssid",          "WiFi BSSID",          "",                 "",          0,  SENSOR_TEXT,    NAN,     0.0f,     21600,  false },
+    { "wifi_retries",        "WiFi Retries",        "",                 "",          0,  SENSOR_NUMBER,  255.0f,  0.0f,     0,      false },
+    { "loop_time_wifi",      "Loop Time - WiFi",    "duration",         "s",         2,  SENSOR_NUMBER,  0.0f,    0.25f,    0,      false },
+    { "loop_time_work",      "Loop Time - Work",    "duration",         "s",         2,  SENSOR_NUMBER,  0.0f,    0.25f,    0,      false },
+    { "loop_time_dns",       "Loop Time - DNS",     "duration",         "s",         3,  SENSOR_NUMBER,  NAN,     0.05f,    0,      false },
+    { "free_heap",           "Free Heap",           "",                 "bytes",     0,  SENSOR_NUMBER,  0.0f,    4096.0f,  0,      false },
+    { "nvs_writes",          "NVS Writes",          "",                 "writes",    0,  SENSOR_NUMBER,  0.0f,    0.0f,     0,      true },
+    { "mqtt_reconnects",     "MQTT Reconnects",     "",                 "",          0,  SENSOR_NUMBER,  -1.0f,   0.0f,     0,      false },
+    { "mqtt_tls_handshake",  "MQTT TLS Handshake",  "duration",         "ms",        0,  SENSOR_NUMBER,  NAN,     100.0f,   0,      false },
+    { "mqtt_flush_time",     "MQTT Flush Time",     "duration",         "ms",        0,  SENSOR_NUMBER,  -1.0f,   50.0f,    0,      false },
+    { "mqtt_backlog",        "MQTT Backlog",        "",                 "readings",  0,  SENSOR_NUMBER,  NAN,     0.0f,     0,      false },
+};
+
+static const SensorDescriptor* s_appSensors[SENSOR_REGISTRY_SIZE - SENSOR_BUILTIN_COUNT];
+static int s_appSensorCount = 0;
+
+int SensorRegistry::add(const SensorDescriptor& descriptor) {
+    if (s_appSensorCount >= SENSOR_REGISTRY_SIZE - SENSOR_BUILTIN_COUNT || strlen(descriptor.key) >= SENSOR_KEY_SIZE ||
+        find(descriptor.key) >= 0) {
+        return -1;
+    }
+    s_appSensors[s_appSensorCount++] = &descriptor;
+    return SENSOR_BUILTIN_COUNT + s_appSensorCount - 1;
+}
+
+int SensorRegistry::count() {
+    return SENSOR_BUILTIN_COUNT + s_appSensorCount;
+}
+
+const SensorDescriptor& SensorRegistry::get(int id) {
+    if (id < SENSOR_BUILTIN_COUNT) {
+        return kBuiltinSensors[id];
+    }
+    return *s_appSensors[id - SENSOR_BUILTIN_COUNT];
+}
+
+int SensorRegistry::find(const char* key) {
+    for (int id = 0; id < count(); id++) {
+        if (strcmp(get(id).key, key) == 0) {
+            return id;
+        }
+    }
+    return -1;
+}
+
+void SensorValues::clear() {
+    for (int id = 0; id < SENSOR_REGISTRY_SIZE; id++) {
+        _values[id][0] = '\0';
+    }
+}
+
+void SensorValues::set(int id, float value) {
+    if (id < 0 || id >= SensorRegistry::count()) {
+        return;
+    }
+    const SensorDescriptor& sensor = SensorRegistry::get(id);
+    if (value == sensor.skipValue) {
+        _values[id][0] = '\0';
+        return;
+    }
+    MqttWriter out(_values[id], SENSOR_VALUE_SIZE);
+    out.appendFloat(value, sensor.precision);
+}
+
+void SensorValues::setText(int id, const char* text) {
+    if (id < 0 || id >= SensorRegistry::count()) {
+        return;
+    }
+    MqttWriter out(_values[id], SENSOR_VALUE_SIZE);
+    out.append(text);
+}
+
+int SensorValues::count() const {
+    int count = 0;
+    for (int id = 0; id < SensorRegistry::count(); id++) {
+        if (has(id)) {
+            count++;
+        }
+    }
+    return count;
+}
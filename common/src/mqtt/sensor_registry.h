@@ -0,0 +1,109 @@
+#ifndef SENSOR_REGISTRY_H
+#define SENSOR_REGISTRY_H
+
+#include <Arduino.h>
+
+// ============================================
+// SENSOR REGISTRY SETTINGS
+// ============================================
+#define SENSOR_REGISTRY_SIZE 64   // Built-in + application sensors
+#define SENSOR_VALUE_SIZE 24      // One formatted value incl. terminator
+#define SENSOR_KEY_SIZE 40        // Longest key incl. terminator
+#define SENSOR_APP_BUDGET 20      // Application sensors a node is expected to register
+
+enum SensorFormat : uint8_t {
+    SENSOR_NUMBER,  // JSON number with the descriptor's precision
+    SENSOR_TEXT     // JSON string
+};
+
+/**
+ * SensorDescriptor - Everything the MQTT side needs to know about one metric
+ *
+ * Descriptors are static data; discovery, state publishing, the backlog
+ * queue and report-on-change all iterate the registry instead of naming
+ * sensors one by one. Example application sensor:
+ *
+ *   static const SensorDescriptor kSoilMoisture = {
+ *       "soil_moisture", "Soil Moisture", "moisture", "%", 0, SENSOR_NUMBER, -1.0f, 2.0f, 0, false
+ *   };
+ */
+struct SensorDescriptor {
+    const char* key;             // Topic segment and state field, e.g. "battery_voltage"
+    const char* name;            // Home Assistant entity name
+    const char* deviceClass;     // "" for none
+    const char* unit;            // "" for none
+    uint8_t precision;           // Decimals of a SENSOR_NUMBER
+    SensorFormat format;
+    float skipValue;             // set() with this value leaves the sensor out (NAN: never)
+    float deadband;              // Report on change threshold in unit (0: any change)
+    uint32_t maxSilenceSeconds;  // Heartbeat (0: MQTT_MAX_SILENCE_SECONDS)
+    bool withAttributes;         // TelemetryData::nvsWearJson attached as attributes
+};
+
+// Built-in sensors - their IDs come first, in publishing order
+enum BuiltinSensor : uint8_t {
+    SENSOR_BATTERY_VOLTAGE,
+    SENSOR_BATTERY_PERCENTAGE,
+    SENSOR_LOOP_TIME,
+    SENSOR_WIFI_SIGNAL,
+    SENSOR_WIFI_BSSID,
+    SENSOR_WIFI_RETRIES,
+    SENSOR_LOOP_TIME_WIFI,
+    SENSOR_LOOP_TIME_WORK,
+    SENSOR_LOOP_TIME_DNS,        // Set by MQTTManager
+    SENSOR_FREE_HEAP,
+    SENSOR_NVS_WRITES,
+    SENSOR_MQTT_RECONNECTS,
+    SENSOR_MQTT_TLS_HANDSHAKE,   // Set by MQTTManager (mqtts:// only)
+    SENSOR_MQTT_FLUSH_TIME,
+    SENSOR_MQTT_BACKLOG,         // Set by MQTTManager
+    SENSOR_BUILTIN_COUNT
+};
+
+// Room for the application's own sensors next to the built-ins (the
+// aggregator's derived sensors are checked in sensor_aggregator.h)
+static_assert(SENSOR_REGISTRY_SIZE >= SENSOR_BUILTIN_COUNT + SENSOR_APP_BUDGET,
+              "SENSOR_REGISTRY_SIZE too small for the application sensor budget");
+
+/**
+ * SensorRegistry - Sensor IDs: the built-ins, then application sensors
+ *
+ * Register application sensors once in setup(), before the first publish
+ * (the registry is not locked - the async MQTT task reads it). The sensor
+ * set is part of the discovery hash, so adding one republishes discovery.
+ */
+class SensorRegistry {
+public:
+    // Returns the new sensor's ID, or -1 if the registry is full, the key is
+    // taken or longer than SENSOR_KEY_SIZE - 1.
+    // The descriptor is referenced, not copied - it must be static.
+    static int add(const SensorDescriptor& descriptor);
+    
+    static int count();
+    static const SensorDescriptor& get(int id);
+    static int find(const char* key);  // -1 if unknown
+};
+
+/**
+ * SensorValues - One cycle's values, indexed by sensor ID (no heap)
+ *
+ * Values are formatted when they are set, so publishing only copies text.
+ * A sensor without a value (never set, or set to its skip value) is left
+ * out of discovery and state.
+ */
+struct SensorValues {
+    SensorValues() { clear(); }
+    
+    void clear();
+    void set(int id, float value);           // SENSOR_NUMBER (integers exact up to 2^24)
+    void setText(int id, const char* text);  // SENSOR_TEXT; "" leaves it out
+    
+    bool has(int id) const { return id >= 0 && id < SENSOR_REGISTRY_SIZE && _values[id][0] != '\0'; }
+    const char* get(int id) const { return _values[id]; }
+    int count() const;
+
+private:
+    char _values[SENSOR_REGISTRY_SIZE][SENSOR_VALUE_SIZE];
+};
+
+#endif // SENSOR_REGISTRY_H
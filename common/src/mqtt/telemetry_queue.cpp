@@ -0,0 +1,262 @@
+#include "telemetry_queue.h"
+#include "logger.h"
+#include <LittleFS.h>
+#include <stddef.h>
+
+#define TELEMETRY_QUEUE_MAGIC 0x51544C54UL  // "TLTQ"
+
+// Records are stored as [u16 length][bytes] in both the ring and the file
+struct QueueState {
+    uint32_t magic;
+    uint16_t head;          // Ring offset of the oldest record
+    uint16_t used;          // Ring bytes in use
+    uint16_t ringRecords;
+    uint16_t fileRecords;   // Unread records in the spill file
+    uint32_t fileOffset;    // Read position in the spill file
+    uint32_t fileSize;
+    uint16_t dropped;
+    uint8_t ring[TELEMETRY_QUEUE_RTC_BYTES];
+};
+
+static RTC_DATA_ATTR QueueState rtc_queue;
+static bool s_mounted = false;
+
+// Spill file reader kept open between peeks: the next record in index
+// order continues where the last one ended instead of reopening the file
+static File s_reader;
+static uint16_t s_readerIndex = 0;   // File record at s_readerOffset (0 = oldest unread)
+static uint32_t s_readerOffset = 0;
+
+static void ringRead(uint16_t offset, void* out, size_t length) {
+    uint8_t* dst = (uint8_t*)out;
+    for (size_t i = 0; i < length; i++) {
+        dst[i] = rtc_queue.ring[(offset + i) % TELEMETRY_QUEUE_RTC_BYTES];
+    }
+}
+
+static void ringWrite(uint16_t offset, const void* data, size_t length) {
+    const uint8_t* src = (const uint8_t*)data;
+    for (size_t i = 0; i < length; i++) {
+        rtc_queue.ring[(offset + i) % TELEMETRY_QUEUE_RTC_BYTES] = src[i];
+    }
+}
+
+void TelemetryQueue::ensureReady() {
+    if (rtc_queue.magic == TELEMETRY_QUEUE_MAGIC) {
+        return;
+    }
+    
+    // Cold boot: the ring is gone, but a spill file may still hold records
+    memset(&rtc_queue, 0, offsetof(QueueState, ring));
+    rtc_queue.magic = TELEMETRY_QUEUE_MAGIC;
+    
+    if (!mountFileSystem() || !LittleFS.exists(TELEMETRY_QUEUE_FILE)) {
+        return;
+    }
+    File file = LittleFS.open(TELEMETRY_QUEUE_FILE, FILE_READ);
+    if (!file) {
+        return;
+    }
+    uint16_t length;
+    while (file.read((uint8_t*)&length, sizeof(length)) == sizeof(length)) {
+        uint32_t next = file.position() + length;
+        if (next > file.size() || !file.seek(next)) {
+            break;  // Truncated tail (power loss during append)
+        }
+        rtc_queue.fileRecords++;
+        rtc_queue.fileSize = next;
+    }
+    file.close();
+    
+    if (rtc_queue.fileRecords > 0) {
+        LogBox::messagef("Queue", "%u queued reading(s) in %s", rtc_queue.fileRecords, TELEMETRY_QUEUE_FILE);
+    }
+}
+
+bool TelemetryQueue::mountFileSystem() {
+    if (!s_mounted) {
+        s_mounted = LittleFS.begin(true);  // Formats an unused partition
+        if (!s_mounted) {
+            LogBox::message("Queue", "LittleFS mount failed - spill disabled");
+        }
+    }
+    return s_mounted;
+}
+
+bool TelemetryQueue::push(const char* record, size_t length) {
+    ensureReady();
+    if (length == 0 || length > TELEMETRY_QUEUE_MAX_RECORD) {
+        rtc_queue.dropped++;
+        return false;
+    }
+    
+    // Keep FIFO order: once records spilled, new ones follow them
+    uint16_t length16 = (uint16_t)length;
+    size_t needed = sizeof(length16) + length;
+    if (rtc_queue.fileRecords == 0 && rtc_queue.used + needed <= TELEMETRY_QUEUE_RTC_BYTES) {
+        uint16_t tail = (rtc_queue.head + rtc_queue.used) % TELEMETRY_QUEUE_RTC_BYTES;
+        ringWrite(tail, &length16, sizeof(length16));
+        ringWrite((tail + sizeof(length16)) % TELEMETRY_QUEUE_RTC_BYTES, record, length);
+        rtc_queue.used += needed;
+        rtc_queue.ringRecords++;
+        return true;
+    }
+    
+    if (pushToFile(record, length)) {
+        return true;
+    }
+    rtc_queue.dropped++;
+    return false;
+}
+
+bool TelemetryQueue::pushToFile(const char* record, size_t length) {
+    if (rtc_queue.fileSize + sizeof(uint16_t) + length > TELEMETRY_QUEUE_FILE_MAX_BYTES || !mountFileSystem()) {
+        return false;
+    }
+    
+    closeReader();
+    File file = LittleFS.open(TELEMETRY_QUEUE_FILE, FILE_APPEND);
+    if (!file) {
+        return false;
+    }
+    uint16_t length16 = (uint16_t)length;
+    bool written = file.write((const uint8_t*)&length16, sizeof(length16)) == sizeof(length16) &&
+                   file.write((const uint8_t*)record, length) == length;
+    file.close();
+    
+    if (!written) {
+        return false;
+    }
+    rtc_queue.fileRecords++;
+    rtc_queue.fileSize += sizeof(length16) + length;
+    return true;
+}
+
+size_t TelemetryQueue::peek(uint16_t index, char* buffer, size_t size) {
+    ensureReady();
+    if (index < rtc_queue.ringRecords) {
+        uint16_t offset = rtc_queue.head;
+        uint16_t length;
+        ringRead(offset, &length, sizeof(length));
+        for (uint16_t i = 0; i < index; i++) {
+            offset = (offset + sizeof(length) + length) % TELEMETRY_QUEUE_RTC_BYTES;
+            ringRead(offset, &length, sizeof(length));
+        }
+        if (length > size) {
+            return 0;
+        }
+        ringRead((offset + sizeof(length)) % TELEMETRY_QUEUE_RTC_BYTES, buffer, length);
+        return length;
+    }
+    index -= rtc_queue.ringRecords;
+    if (index < rtc_queue.fileRecords) {
+        return peekFromFile(index, buffer, size);
+    }
+    return 0;
+}
+
+bool TelemetryQueue::positionReader(uint16_t index) {
+    if (!s_reader || index < s_readerIndex) {
+        closeReader();
+        if (!mountFileSystem()) {
+            return false;
+        }
+        s_reader = LittleFS.open(TELEMETRY_QUEUE_FILE, FILE_READ);
+        if (!s_reader || !s_reader.seek(rtc_queue.fileOffset)) {
+            closeReader();
+            return false;
+        }
+        s_readerIndex = 0;
+        s_readerOffset = rtc_queue.fileOffset;
+    }
+    
+    // Skip records by their length prefix
+    while (s_readerIndex < index) {
+        uint16_t length;
+        if (s_reader.read((uint8_t*)&length, sizeof(length)) != sizeof(length) ||
+            !s_reader.seek(s_readerOffset + sizeof(length) + length)) {
+            closeReader();
+            return false;
+        }
+        s_readerOffset += sizeof(length) + length;
+        s_readerIndex++;
+    }
+    return true;
+}
+
+size_t TelemetryQueue::peekFromFile(uint16_t index, char* buffer, size_t size) {
+    if (!positionReader(index)) {
+        return 0;
+    }
+    uint16_t length = 0;
+    if (s_reader.read((uint8_t*)&length, sizeof(length)) != sizeof(length) || length > size ||
+        s_reader.read((uint8_t*)buffer, length) != length) {
+        closeReader();
+        return 0;
+    }
+    s_readerOffset += sizeof(length) + length;
+    s_readerIndex++;
+    return length;
+}
+
+void TelemetryQueue::closeReader() {
+    if (s_reader) {
+        s_reader.close();
+    }
+    s_readerIndex = 0;
+    s_readerOffset = 0;
+}
+
+void TelemetryQueue::pop(uint16_t count) {
+    ensureReady();
+    while (count > 0 && rtc_queue.ringRecords > 0) {
+        uint16_t length;
+        ringRead(rtc_queue.head, &length, sizeof(length));
+        rtc_queue.head = (rtc_queue.head + sizeof(length) + length) % TELEMETRY_QUEUE_RTC_BYTES;
+        rtc_queue.used -= sizeof(length) + length;
+        rtc_queue.ringRecords--;
+        count--;
+    }
+    if (rtc_queue.ringRecords == 0) {
+        rtc_queue.head = 0;
+        rtc_queue.used = 0;
+    }
+    
+    if (count > 0 && rtc_queue.fileRecords > 0) {
+        popFromFile(count < rtc_queue.fileRecords ? count : rtc_queue.fileRecords);
+    }
+    closeReader();
+}
+
+void TelemetryQueue::popFromFile(uint16_t count) {
+    // A drain has usually just peeked up to here, so the reader already
+    // knows the new read position
+    if (count < rtc_queue.fileRecords && positionReader(count)) {
+        rtc_queue.fileOffset = s_readerOffset;
+        rtc_queue.fileRecords -= count;
+        return;
+    }
+    if (count < rtc_queue.fileRecords) {
+        LogBox::messagef("Queue", "%s unreadable - %u reading(s) dropped", TELEMETRY_QUEUE_FILE,
+                         rtc_queue.fileRecords - count);
+    }
+    
+    // Fully drained - the next spill starts a fresh file
+    closeReader();
+    if (mountFileSystem()) {
+        LittleFS.remove(TELEMETRY_QUEUE_FILE);
+    }
+    rtc_queue.fileRecords = 0;
+    rtc_queue.fileOffset = 0;
+    rtc_queue.fileSize = 0;
+}
+
+uint16_t TelemetryQueue::depth() {
+    ensureReady();
+    return rtc_queue.ringRecords + rtc_queue.fileRecords;
+}
+
+uint16_t TelemetryQueue::dropped() {
+    ensureReady();
+    return rtc_queue.dropped;
+}
@@ -0,0 +1,61 @@
+#ifndef TELEMETRY_QUEUE_H
+#define TELEMETRY_QUEUE_H
+
+#include <Arduino.h>
+
+// ============================================
+// STORE-AND-FORWARD SETTINGS
+// ============================================
+#define TELEMETRY_QUEUE_RTC_BYTES 2048                    // RTC slow memory ring (survives deep sleep)
+#define TELEMETRY_QUEUE_FILE "/telemetry_queue.bin"       // LittleFS spill segment
+#define TELEMETRY_QUEUE_FILE_MAX_BYTES (64 * 1024)        // Newer readings are dropped beyond this
+#define TELEMETRY_QUEUE_MAX_RECORD 5120                   // Largest reading accepted (larger than the ring: spilled)
+
+/**
+ * TelemetryQueue - Readings that could not be sent, kept until the broker is back
+ *
+ * Each reading is one opaque record (the JSON state object with its
+ * timestamp). Records go into a byte ring in RTC slow memory, so a battery
+ * node can queue through several sleep cycles without touching flash. When
+ * the ring is full they spill to an append-only LittleFS file, and once
+ * anything is in the file new records follow it so the order is kept.
+ *
+ * Draining is oldest first: peek() records by index and publish them,
+ * then pop() as many as the broker confirmed. Records that were not
+ * confirmed stay queued. Peeking through the spill file in index order is
+ * one pass: the file stays open between peeks and is closed by pop().
+ *
+ * RTC contents are lost on power loss/reset (the file is not); after a
+ * cold boot the file read position restarts at 0, so a partially drained
+ * file may resend some records.
+ */
+class TelemetryQueue {
+public:
+    // Append a record, false if it was dropped (too large or storage full)
+    static bool push(const char* record, size_t length);
+    
+    // Copy record index (0 = oldest) into buffer, returns its length
+    // (0 if there is no such record or it does not fit)
+    static size_t peek(uint16_t index, char* buffer, size_t size);
+    
+    // Remove the count oldest records and end the peek pass (pop(0) only
+    // closes the spill file)
+    static void pop(uint16_t count = 1);
+    
+    // Records waiting (RTC + file)
+    static uint16_t depth();
+    
+    // Records dropped since the last cold boot because storage was full
+    static uint16_t dropped();
+
+private:
+    static void ensureReady();
+    static bool mountFileSystem();
+    static bool pushToFile(const char* record, size_t length);
+    static bool positionReader(uint16_t index);
+    static size_t peekFromFile(uint16_t index, char* buffer, size_t size);
+    static void popFromFile(uint16_t count);
+    static void closeReader();
+};
+
+#endif // TELEMETRY_QUEUE_H
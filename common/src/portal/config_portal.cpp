@@ -1,9 +1,14 @@
 #include "config_portal.h"
 #include "config_portal_html.h"
 #include "config_portal_css.h"
+#include "config_schema.h"
 #include "logger.h"
 #include "package_config.h"
 #include "board_config.h"
+#include <memory>
+
+// Initial capacity for the config page (CSS + generated form)
+#define CONFIG_PAGE_RESERVE 8192
 
 // Helper function to generate HTML header with dynamic title
 static String getHtmlHeader() {
@@ -38,6 +43,10 @@ bool ConfigPortal::begin(int port) {
     _server->on("/reboot", HTTP_POST, [this]() { this->handleReboot(); });
     _server->on("/factory-reset", HTTP_POST, [this]() { this->handleFactoryReset(); });
     
+    // Bulk config API (fleet provisioning)
+    _server->on("/api/config", HTTP_GET, [this]() { this->handleApiConfigGet(); });
+    _server->on("/api/config", HTTP_PUT, [this]() { this->handleApiConfigPut(); });
+    
     // OTA routes
     _server->on("/ota", HTTP_GET, [this]() { this->handleOTAPage(); });
     _server->on("/ota/upload", HTTP_POST,
@@ -104,84 +113,58 @@ void ConfigPortal::handleRoot() {
 void ConfigPortal::handleSubmit() {
     LogBox::begin("Config Submission");
     
-    // Get WiFi credentials
-    String ssid = _server->arg("ssid");
-    String password = _server->arg("password");
-    
-    if (ssid.length() == 0) {
-        LogBox::line("ERROR: WiFi SSID is required");
-        LogBox::end();
-        _server->send(400, "text/html", generateErrorPage("WiFi SSID is required"));
-        return;
-    }
-    
-    // Get friendly name (optional)
-    String friendlyName = _server->arg("friendlyName");
-    
-    // Get static IP settings
-    bool useStaticIP = _server->hasArg("useStaticIP");
-    String staticIP = _server->arg("staticIP");
-    String gateway = _server->arg("gateway");
-    String subnet = _server->arg("subnet");
-    String primaryDNS = _server->arg("primaryDNS");
-    String secondaryDNS = _server->arg("secondaryDNS");
-    
-    // Validate static IP settings if enabled
-    if (useStaticIP) {
-        if (!validateIPv4Format(staticIP) || !validateIPv4Format(gateway) || 
-            !validateIPv4Format(subnet) || !validateIPv4Format(primaryDNS)) {
-            LogBox::line("ERROR: Invalid static IP configuration");
+    // Validate every field before staging anything
+    for (uint8_t i = 0; i < CONFIG_FIELD_COUNT; i++) {
+        const ConfigFieldInfo& field = kConfigFields[i];
+        if (field.type != CONFIG_TYPE_STRING || (field.flags & CONFIG_FIELD_HIDDEN) || !isFieldEnabled(i)) {
+            continue;
+        }
+        
+        String error;
+        if (!configValidateField(field, _server->arg(field.name).c_str(), error)) {
+            LogBox::line("ERROR: " + error);
             LogBox::end();
-            _server->send(400, "text/html", generateErrorPage("Invalid static IP configuration"));
+            _server->send(400, "text/html", generateErrorPage(error));
             return;
         }
     }
     
-    // Get MQTT settings (optional)
-    String mqttBroker = _server->arg("mqttBroker");
-    String mqttUsername = _server->arg("mqttUsername");
-    String mqttPassword = _server->arg("mqttPassword");
-    
-    // Get debug mode
-    bool debugMode = _server->hasArg("debugMode");
-    
-    // Save WiFi credentials
-    _configManager->setWiFiCredentials(ssid, password);
-    LogBox::line("WiFi SSID: " + ssid);
-    
-    // Save friendly name if provided
-    if (friendlyName.length() > 0) {
-        _configManager->setFriendlyName(friendlyName);
-        LogBox::line("Friendly name: " + friendlyName);
-    }
+    // Stage all settings and write them in a single NVS commit
+    _configManager->beginTransaction();
     
-    // Save static IP settings
-    _configManager->setUseStaticIP(useStaticIP);
-    if (useStaticIP) {
-        _configManager->setStaticIPConfig(staticIP, gateway, subnet, primaryDNS, secondaryDNS);
-        LogBox::line("Static IP: " + staticIP);
-    }
-    
-    // Save MQTT settings if provided
-    if (mqttBroker.length() > 0) {
-        _configManager->setMQTTConfig(mqttBroker, mqttUsername, mqttPassword);
-        LogBox::line("MQTT Broker: " + mqttBroker);
+    for (uint8_t i = 0; i < CONFIG_FIELD_COUNT; i++) {
+        const ConfigFieldInfo& field = kConfigFields[i];
+        if ((field.flags & CONFIG_FIELD_HIDDEN) || !isFieldEnabled(i)) {
+            continue;  // Fields of a disabled group keep their stored values
+        }
+        
+        if (field.type == CONFIG_TYPE_BOOL) {
+            _configManager->setField((ConfigFieldId)i, _server->hasArg(field.name));
+            continue;
+        }
+        
+        String value = _server->arg(field.name);
+        _configManager->setField((ConfigFieldId)i, value.c_str());
+        if (value.length() > 0 && !(field.flags & CONFIG_FIELD_SECRET)) {
+            LogBox::line(String(field.label) + ": " + value);
+        }
     }
     
-    // Save debug mode
-    _configManager->setDebugMode(debugMode);
-    
     // Mark as configured
     _configManager->setConfigured(true);
     
-    // Save configuration
-    if (!_configManager->saveConfig()) {
+    // Commit configuration
+    if (!_configManager->commitTransaction()) {
         LogBox::line("ERROR: Failed to save configuration");
         LogBox::end();
         _server->send(500, "text/html", generateErrorPage("Failed to save configuration"));
         return;
     }
     
+    const ConfigTransactionStats& saveStats = _configManager->getLastTransactionStats();
+    LogBox::linef("Changed %u setting(s): %u NVS write(s), %u bytes, %lu us",
+                  saveStats.fieldsChanged, saveStats.keysWritten, saveStats.bytesWritten,
+                  (unsigned long)saveStats.elapsedMicros);
     LogBox::line("Configuration saved successfully");
     LogBox::end();
     
@@ -189,6 +172,101 @@ void ConfigPortal::handleSubmit() {
     _server->send(200, "text/html", generateSuccessPage());
 }
 
+void ConfigPortal::handleApiConfigGet() {
+    // Secrets are never exported - a PUT without them keeps the stored values
+    size_t size = configJSONMaxSize();
+    std::unique_ptr<char[]> json(new char[size]);
+    if (configToJSON(_configManager->getConfig(), json.get(), size, false) == 0) {
+        sendJsonError(500, "Failed to serialize configuration");
+        return;
+    }
+    _server->send(200, "application/json", json.get());
+}
+
+void ConfigPortal::handleApiConfigPut() {
+    LogBox::begin("Config Import");
+    
+    // Apply the document to a copy of the current config, then validate the
+    // result as a whole so nothing is written unless every field is valid
+    String body = _server->arg("plain");
+    DeviceConfig imported = _configManager->getConfig();
+    uint32_t presentMask = 0;
+    String error;
+    
+    bool valid = configFromJSON(body.c_str(), body.length(), imported, presentMask, error);
+    for (uint8_t i = 0; valid && i < CONFIG_FIELD_COUNT; i++) {
+        const ConfigFieldInfo& field = kConfigFields[i];
+        if (field.type == CONFIG_TYPE_STRING && !(field.flags & CONFIG_FIELD_HIDDEN) &&
+            configFieldEnabled(imported, i)) {
+            valid = configValidateField(field, field.readString(imported), error);
+        }
+    }
+    if (!valid) {
+        LogBox::line("ERROR: " + error);
+        LogBox::end();
+        sendJsonError(400, error);
+        return;
+    }
+    
+    // Fields missing from the document (e.g. redacted secrets) keep their values
+    _configManager->beginTransaction();
+    for (uint8_t i = 0; i < CONFIG_FIELD_COUNT; i++) {
+        const ConfigFieldInfo& field = kConfigFields[i];
+        if (!(presentMask & (1UL << i)) || (field.flags & CONFIG_FIELD_HIDDEN)) {
+            continue;
+        }
+        if (field.type == CONFIG_TYPE_BOOL) {
+            _configManager->setField((ConfigFieldId)i, imported.*(field.boolMember));
+        } else {
+            _configManager->setField((ConfigFieldId)i, field.readString(imported));
+        }
+    }
+    _configManager->setConfigured(true);
+    
+    if (!_configManager->commitTransaction()) {
+        LogBox::line("ERROR: Failed to save configuration");
+        LogBox::end();
+        sendJsonError(500, "Failed to save configuration");
+        return;
+    }
+    
+    const ConfigTransactionStats& saveStats = _configManager->getLastTransactionStats();
+    LogBox::linef("Changed %u setting(s): %u NVS write(s), %u bytes, %lu us",
+                  saveStats.fieldsChanged, saveStats.keysWritten, saveStats.bytesWritten,
+                  (unsigned long)saveStats.elapsedMicros);
+    LogBox::end();
+    
+    // Re-applying an identical template is a no-op and does not reboot
+    if (saveStats.fieldsChanged > 0) {
+        _configReceived = true;
+    }
+    
+    char response[96];
+    snprintf(response, sizeof(response), "{\"changed\":%u,\"nvsWrites\":%u,\"bytes\":%u,\"reboot\":%s}",
+             saveStats.fieldsChanged, saveStats.keysWritten, saveStats.bytesWritten,
+             _configReceived ? "true" : "false");
+    _server->send(200, "application/json", response);
+}
+
+void ConfigPortal::sendJsonError(int code, const String& error) {
+    String escaped = error;
+    escaped.replace("\\", "\\\\");
+    escaped.replace("\"", "\\\"");
+    _server->send(code, "application/json", "{\"error\":\"" + escaped + "\"}");
+}
+
+bool ConfigPortal::isFieldEnabled(uint8_t index) {
+    // A TOGGLE checkbox earlier in the same section controls the rest of it
+    uint8_t section = kConfigFields[index].section;
+    for (uint8_t i = 0; i < index; i++) {
+        const ConfigFieldInfo& field = kConfigFields[i];
+        if (field.section == section && (field.flags & CONFIG_FIELD_TOGGLE)) {
+            return _server->hasArg(field.name);
+        }
+    }
+    return true;
+}
+
 void ConfigPortal::handleReboot() {
     _server->send(200, "text/html", "Rebooting...");
     delay(1000);
@@ -201,78 +279,23 @@ void ConfigPortal::handleNotFound() {
 
 String ConfigPortal::generateConfigPage() {
     String deviceID = _wifiManager->getDeviceIdentifier();
-    String currentSSID = _configManager->getWiFiSSID();
-    String currentPassword = _configManager->getWiFiPassword();
-    String currentFriendlyName = _configManager->getFriendlyName();
-    bool useStaticIP = _configManager->getUseStaticIP();
-    String staticIP = _configManager->getStaticIP();
-    String gateway = _configManager->getGateway();
-    String subnet = _configManager->getSubnet();
-    String primaryDNS = _configManager->getPrimaryDNS();
-    String secondaryDNS = _configManager->getSecondaryDNS();
-    String mqttBroker = _configManager->getMQTTBroker();
-    String mqttUsername = _configManager->getMQTTUsername();
-    String mqttPassword = _configManager->getMQTTPassword();
-    bool debugMode = _configManager->getDebugMode();
+    const DeviceConfig& config = _configManager->getConfig();
     
     String html = getHtmlHeader();
-    html += "<style>" + String(CONFIG_PORTAL_CSS) + "</style>";
+    html.reserve(CONFIG_PAGE_RESERVE);  // Fields are appended in place - no per-field temporaries
+    html += "<style>";
+    html += CONFIG_PORTAL_CSS;
+    html += "</style>";
     html += "</head><body>";
     html += "<div class='container'>";
     html += "<h1>" + String(PACKAGE_DISPLAY_NAME) + " Configuration</h1>";
     html += "<p class='device-id'>Device: " + deviceID + " (" + String(BOARD_NAME) + ")</p>";
     html += "<form method='POST' action='/submit'>";
     
-    // WiFi settings
-    html += "<div class='section'>";
-    html += "<h2>WiFi Settings</h2>";
-    html += "<label>WiFi SSID*</label>";
-    html += "<input type='text' name='ssid' value='" + currentSSID + "' required>";
-    html += "<label>WiFi Password</label>";
-    html += "<input type='password' name='password' value='" + currentPassword + "'>";
-    html += "</div>";
-    
-    // Device settings
-    html += "<div class='section'>";
-    html += "<h2>Device Settings</h2>";
-    html += "<label>Friendly Name</label>";
-    html += "<input type='text' name='friendlyName' value='" + currentFriendlyName + "' placeholder='my-device'>";
-    html += "</div>";
-    
-    // Static IP settings
-    html += "<div class='section'>";
-    html += "<h2>Network Settings</h2>";
-    html += "<label><input type='checkbox' name='useStaticIP' " + String(useStaticIP ? "checked" : "") + " onchange='toggleStaticIP(this)'> Use Static IP</label>";
-    html += "<div id='staticIPFields' style='display:" + String(useStaticIP ? "block" : "none") + "'>";
-    html += "<label>Static IP</label>";
-    html += "<input type='text' name='staticIP' value='" + staticIP + "' placeholder='192.168.1.100'>";
-    html += "<label>Gateway</label>";
-    html += "<input type='text' name='gateway' value='" + gateway + "' placeholder='192.168.1.1'>";
-    html += "<label>Subnet Mask</label>";
-    html += "<input type='text' name='subnet' value='" + subnet + "' placeholder='255.255.255.0'>";
-    html += "<label>Primary DNS</label>";
-    html += "<input type='text' name='primaryDNS' value='" + primaryDNS + "' placeholder='8.8.8.8'>";
-    html += "<label>Secondary DNS</label>";
-    html += "<input type='text' name='secondaryDNS' value='" + secondaryDNS + "' placeholder='8.8.4.4'>";
-    html += "</div>";
-    html += "</div>";
-    
-    // MQTT settings
-    html += "<div class='section'>";
-    html += "<h2>MQTT Settings (Optional)</h2>";
-    html += "<label>MQTT Broker</label>";
-    html += "<input type='text' name='mqttBroker' value='" + mqttBroker + "' placeholder='mqtt://192.168.1.10:1883'>";
-    html += "<label>MQTT Username</label>";
-    html += "<input type='text' name='mqttUsername' value='" + mqttUsername + "'>";
-    html += "<label>MQTT Password</label>";
-    html += "<input type='password' name='mqttPassword' value='" + mqttPassword + "'>";
-    html += "</div>";
-    
-    // Advanced settings
-    html += "<div class='section'>";
-    html += "<h2>Advanced</h2>";
-    html += "<label><input type='checkbox' name='debugMode' " + String(debugMode ? "checked" : "") + "> Enable Debug Logging</label>";
-    html += "</div>";
+    // Settings sections, generated from DEVICE_CONFIG_FIELDS
+    for (uint8_t section = CONFIG_SECTION_NONE + 1; section < CONFIG_SECTION_COUNT; section++) {
+        appendSection(html, config, section);
+    }
 
     html += "<button type='submit' class='btn-primary'>Save Configuration</button>";
     html += "</form>";
@@ -290,8 +313,8 @@ String ConfigPortal::generateConfigPage() {
 
     // JavaScript
     html += "<script>";
-    html += "function toggleStaticIP(cb) {";
-    html += "  document.getElementById('staticIPFields').style.display = cb.checked ? 'block' : 'none';";
+    html += "function toggleGroup(cb, id) {";
+    html += "  document.getElementById(id).style.display = cb.checked ? 'block' : 'none';";
     html += "}";
     html += "</script>";
     
@@ -299,6 +322,102 @@ String ConfigPortal::generateConfigPage() {
     return html;
 }
 
+// Append value with HTML attribute escaping
+static void appendEscaped(String& html, const char* value) {
+    for (const char* p = value; *p; p++) {
+        switch (*p) {
+            case '&': html += "&amp;"; break;
+            case '\'': html += "&#39;"; break;
+            case '"': html += "&quot;"; break;
+            case '<': html += "&lt;"; break;
+            default: html += *p; break;
+        }
+    }
+}
+
+void ConfigPortal::appendSection(String& html, const DeviceConfig& config, uint8_t section) {
+    bool open = false;
+    bool inGroup = false;
+    
+    for (uint8_t i = 0; i < CONFIG_FIELD_COUNT; i++) {
+        const ConfigFieldInfo& field = kConfigFields[i];
+        if (field.section != section || (field.flags & CONFIG_FIELD_HIDDEN)) {
+            continue;
+        }
+        
+        if (!open) {
+            html += "<div class='section'>";
+            html += "<h2>";
+            html += configSectionTitle(section);
+            html += "</h2>";
+            open = true;
+        }
+        
+        if (field.type == CONFIG_TYPE_BOOL) {
+            bool checked = config.*(field.boolMember);
+            html += "<label><input type='checkbox' name='";
+            html += field.name;
+            html += "'";
+            if (checked) {
+                html += " checked";
+            }
+            if (field.flags & CONFIG_FIELD_TOGGLE) {
+                html += " onchange='toggleGroup(this,\"group-";
+                html += field.name;
+                html += "\")'";
+            }
+            html += "> ";
+            html += field.label;
+            html += "</label>";
+            
+            if ((field.flags & CONFIG_FIELD_TOGGLE) && !inGroup) {
+                html += "<div id='group-";
+                html += field.name;
+                html += "' style='display:";
+                html += checked ? "block" : "none";
+                html += "'>";
+                inGroup = true;
+            }
+            continue;
+        }
+        
+        // Inside a toggle group "required" is enforced server-side only, the
+        // browser would otherwise block submitting with the group hidden
+        bool required = (field.flags & CONFIG_FIELD_REQUIRED) && !inGroup;
+        html += "<label>";
+        html += field.label;
+        if (required) {
+            html += "*";
+        }
+        html += "</label>";
+        html += "<input type='";
+        html += (field.flags & CONFIG_FIELD_SECRET) ? "password" : "text";
+        html += "' name='";
+        html += field.name;
+        html += "' value='";
+        appendEscaped(html, field.readString(config));
+        html += "' maxlength='";
+        html += field.maxLength;
+        html += "'";
+        if (field.placeholder[0] != '\0') {
+            html += " placeholder='";
+            html += field.placeholder;
+            html += "'";
+        }
+        if (required) {
+            html += " required";
+        }
+        html += ">";
+    }
+    
+    if (inGroup) {
+        html += "</div>";
+    }
+    if (open) {
+        html += "</div>";
+    }
+}
+
 String ConfigPortal::generateSuccessPage() {
     String html = getHtmlHeader();
     html += "<style>" + String(CONFIG_PORTAL_CSS) + "</style>";
@@ -475,10 +594,3 @@ void ConfigPortal::handleOTAFromURL() {
         // Device will remain running, user can try again via portal
     }
 }
-
-bool ConfigPortal::validateIPv4Format(const String& ip) {
-    if (ip.length() == 0) return false;
-    
-    IPAddress addr;
-    return addr.fromString(ip);
-}
@@ -5,6 +5,7 @@
 #include <WebServer.h>
 #include <Update.h>
 #include "config_manager.h"
+#include "config_schema.h"
 #include "wifi_manager.h"
 #include "power_manager.h"
 #include "mqtt_manager.h"
@@ -46,6 +47,8 @@ private:
     void handleSubmit();
     void handleReboot();
     void handleFactoryReset();
+    void handleApiConfigGet();   // GET /api/config - JSON export, secrets redacted
+    void handleApiConfigPut();   // PUT /api/config - validated, single-commit import
     void handleOTAPage();
     void handleOTAUpload();
     void handleOTAFromURL();
@@ -56,9 +59,15 @@ private:
     String generateSuccessPage();
     String generateErrorPage(const String& error);
     String generateOTAPage();
+    
+    // Render one settings section from the field table
+    void appendSection(String& html, const DeviceConfig& config, uint8_t section);
 
-    // Validation helpers
-    bool validateIPv4Format(const String& ip);
+    // {"error":"..."} response for the JSON API
+    void sendJsonError(int code, const String& error);
+    
+    // False for fields in a section whose TOGGLE checkbox was not submitted
+    bool isFieldEnabled(uint8_t index);
 };
 
 #endif // CONFIG_PORTAL_H
\ No newline at end of file
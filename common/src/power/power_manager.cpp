@@ -2,9 +2,9 @@
 #include <esp_sleep.h>
 #include <esp_system.h>
 #include <WiFi.h>
-#include <Preferences.h>
 #include <esp_task_wdt.h>
 #include "logger.h"
+#include "nvs_store.h"
 
 // Include board_config.h for hardware-specific settings
 #include "board_config.h"
@@ -13,8 +13,8 @@
 RTC_DATA_ATTR uint32_t rtc_boot_count = 0;
 RTC_DATA_ATTR bool rtc_was_running = false;
 
-// Preferences for persistent storage across full resets
-static Preferences prefs;
+// NVS for persistent storage across full resets (identical writes are skipped)
+static NvsStore prefs;
 
 // Default watchdog timeout if not defined in board_config.h
 #ifndef WATCHDOG_TIMEOUT_SECONDS
@@ -80,9 +80,9 @@ WakeupReason PowerManager::detectWakeupReason() {
             if (reset_reason == ESP_RST_POWERON) {
                 // Power-on reset - check if this might be reset button vs full power cycle
                 // Open preferences to check if device was running
-                prefs.begin("power_mgr", true);  // Read-only
+                // Opened read-write once; the flag is updated below either way
+                prefs.begin("power_mgr", false);
                 bool was_running = prefs.getBool("was_running", false);
-                prefs.end();
                 
                 LogBox::linef("Device was running flag: %s", was_running ? "true" : "false");
                 
@@ -92,7 +92,6 @@ WakeupReason PowerManager::detectWakeupReason() {
                     LogBox::end();
                     
                     // Clear the flag for next time
-                    prefs.begin("power_mgr", false);  // Read-write
                     prefs.putBool("was_running", false);
                     prefs.end();
                     
@@ -104,7 +103,6 @@ WakeupReason PowerManager::detectWakeupReason() {
                     LogBox::end();
                     
                     // Set flag so reset button can be detected on next boot
-                    prefs.begin("power_mgr", false);  // Read-write
                     prefs.putBool("was_running", true);
                     prefs.end();
                     
@@ -326,6 +324,9 @@ void PowerManager::enterDeepSleep(float durationSeconds, float loopTimeSeconds)
     #endif
     LogBox::end();
     
+    // Persist this wake's NVS wear counts (no-op when nothing was written)
+    NvsStore::flushWearCounters();
+    
     // Flush serial before sleeping
     Serial.flush();
     
@@ -378,12 +379,12 @@ float PowerManager::readBatteryVoltage() {
 }
 
 void PowerManager::markDeviceRunning() {
-    // Set flag in NVS to indicate device is running
+    // Set flag in NVS to indicate device is running (skipped if already set)
     prefs.begin("power_mgr", false);  // Read-write
-    bool was_already_set = prefs.getBool("was_running", false);
+    uint16_t writesBefore = prefs.getCounters().writes;
+    prefs.putBool("was_running", true);
     
-    if (!was_already_set) {
-        prefs.putBool("was_running", true);
+    if (prefs.getCounters().writes != writesBefore) {
         LogBox::message("Power Manager", "Device marked as running in NVS (one-time write)");
     }
     
@@ -1,6 +1,7 @@
 #include "startup_helpers.h"
 #include "logger.h"
 #include "board_config.h"
+#include "device_identity.h"
 
 bool checkButtonAtBoot() {
   pinMode(WAKE_BUTTON_PIN, INPUT_PULLUP);
@@ -18,6 +19,90 @@ void enterConfigMode(APModeController& apMode, const char* reason) {
   }
 }
 
+// Async MQTT task (MQTT_ASYNC), nullptr to publish on the calling task
+static MqttAsync* s_mqttAsync = nullptr;
+
+void setAsyncMQTT(MqttAsync* mqttAsync) {
+  s_mqttAsync = mqttAsync;
+}
+
+// Runs on the MQTT task
+static void onTelemetryPublished(uint32_t ticket, bool success, uint32_t latencyMs, void* context) {
+  MqttAsyncStats stats = static_cast<MqttAsync*>(context)->getStats();
+  LogBox::messagef("MQTT", "Telemetry #%lu %s after %lu ms (waited %lu ms, queue %u/%u, stack free %lu B)",
+                   (unsigned long)ticket, success ? "published" : "failed", (unsigned long)latencyMs,
+                   (unsigned long)stats.lastQueueMs, stats.depth, MQTT_ASYNC_QUEUE_DEPTH,
+                   (unsigned long)stats.stackFreeBytes);
+}
+
+// Configured and ready to publish. The async task only starts for a
+// configured manager and then owns it, so it is not asked again.
+static bool mqttReady(MQTTManager& mqttManager) {
+  return s_mqttAsync != nullptr || (mqttManager.begin() && mqttManager.isConfigured());
+}
+
+// Application sensor values, sent with every telemetry until changed
+static SensorValues s_applicationValues;
+
+SensorValues& applicationSensorValues() {
+  return s_applicationValues;
+}
+
+// Device info and the built-in sensors both publish paths share
+static void collectTelemetry(TelemetryData& telemetry, WiFiManager& wifiManager, MQTTManager& mqttManager,
+                             ConfigManager& configManager, PowerManager& powerManager) {
+  telemetry.deviceId = DeviceIdentity::getDeviceId();
+  telemetry.deviceName = configManager.getFriendlyName();
+  telemetry.modelName = BOARD_NAME;
+  telemetry.wakeReason = powerManager.getWakeupReason();
+  uint32_t samples = SensorAggregator::flush(s_applicationValues);  // Ends the aggregation window
+  if (SensorAggregator::tracked() > 0) {
+    LogBox::messagef("Telemetry", "Window: %lu sample(s) of %d aggregated sensor(s)",
+                     (unsigned long)samples, SensorAggregator::tracked());
+  }
+  telemetry.values = s_applicationValues;
+
+  float batteryVoltage = powerManager.readBatteryVoltage();
+  telemetry.values.set(SENSOR_BATTERY_VOLTAGE, batteryVoltage);
+  telemetry.values.set(SENSOR_BATTERY_PERCENTAGE, PowerManager::calculateBatteryPercentage(batteryVoltage));
+  telemetry.values.set(SENSOR_WIFI_SIGNAL, wifiManager.getRSSI());
+  telemetry.values.setText(SENSOR_WIFI_BSSID, WiFi.BSSIDstr().c_str());
+  telemetry.values.set(SENSOR_FREE_HEAP, ESP.getFreeHeap());
+  telemetry.values.set(SENSOR_NVS_WRITES, NvsStore::getTotalWrites());
+  char wearJson[NVS_WEAR_JSON_MAX_SIZE];
+  telemetry.nvsWearJson = NvsStore::getWearJSON(wearJson, sizeof(wearJson)) > 0 ? wearJson : "";
+  if (s_mqttAsync != nullptr) {
+    // The MQTT task owns the manager - use its snapshot
+    MqttAsyncStats stats = s_mqttAsync->getStats();
+    if (stats.persistentSession) {
+      telemetry.values.set(SENSOR_MQTT_RECONNECTS, stats.reconnects);
+    }
+    telemetry.values.set(SENSOR_MQTT_FLUSH_TIME, stats.lastFlushMs);
+    return;
+  }
+  if (mqttManager.isPersistentSession()) {
+    telemetry.values.set(SENSOR_MQTT_RECONNECTS, mqttManager.getSessionStats().reconnects);
+  }
+  telemetry.values.set(SENSOR_MQTT_FLUSH_TIME, mqttManager.getLastFlushMs());
+}
+
+static void publishTelemetry(MQTTManager& mqttManager, const TelemetryData& telemetry) {
+  if (s_mqttAsync != nullptr) {
+    // Returns at once - the MQTT task connects and publishes
+    if (s_mqttAsync->publishTelemetry(telemetry, onTelemetryPublished, s_mqttAsync) == 0) {
+      LogBox::message("MQTT", "ERROR: Async MQTT queue full or record too large - telemetry dropped");
+    }
+    return;
+  }
+
+  // Connects itself - if the broker is unreachable the reading is queued
+  // and sent with the next successful connection
+  mqttManager.publishAllTelemetry(telemetry);
+  if (!mqttManager.isPersistentSession()) {
+    mqttManager.disconnect();
+  }
+}
+
 bool connectAndPublish(WiFiManager& wifiManager, MQTTManager& mqttManager, 
                        ConfigManager& configManager, PowerManager& powerManager, 
                        float workTime) {
@@ -37,31 +122,22 @@ bool connectAndPublish(WiFiManager& wifiManager, MQTTManager& mqttManager,
   LogBox::messagef("WiFi", "RSSI: %d dBm", wifiManager.getRSSI());
 
   // Publish telemetry via MQTT (if configured)
-  if (mqttManager.begin() && mqttManager.isConfigured()) {
-    LogBox::message("MQTT", "Connecting to broker...");
-
-    if (mqttManager.connect()) {
-      LogBox::message("MQTT", "Publishing telemetry");
-
-      // Prepare telemetry data
-      TelemetryData telemetry;
-      telemetry.deviceId = wifiManager.getDeviceIdentifier();
-      telemetry.deviceName = configManager.getFriendlyName();
-      telemetry.modelName = BOARD_NAME;
-      telemetry.wakeReason = powerManager.getWakeupReason();
-      telemetry.batteryVoltage = powerManager.readBatteryVoltage();
-      telemetry.batteryPercentage = PowerManager::calculateBatteryPercentage(telemetry.batteryVoltage);
-      telemetry.wifiRSSI = wifiManager.getRSSI();
-      telemetry.wifiBSSID = WiFi.BSSIDstr();
-      telemetry.wifiRetryCount = retryCount;
-      telemetry.loopTimeTotal = millis() / 1000.0f;  // Convert to seconds
-      telemetry.loopTimeWiFi = wifiTime;
-      telemetry.loopTimeWork = workTime;  // Work time from loop()
-      telemetry.freeHeap = ESP.getFreeHeap();
-
-      mqttManager.publishAllTelemetry(telemetry);
-      mqttManager.disconnect();
+  if (mqttReady(mqttManager)) {
+    if (s_mqttAsync == nullptr && !mqttManager.isConnected()) {
+      LogBox::message("MQTT", "Connecting to broker...");
     }
+
+    LogBox::message("MQTT", "Publishing telemetry");
+
+    // Prepare telemetry data
+    TelemetryData telemetry;
+    collectTelemetry(telemetry, wifiManager, mqttManager, configManager, powerManager);
+    telemetry.values.set(SENSOR_WIFI_RETRIES, retryCount);
+    telemetry.values.set(SENSOR_LOOP_TIME, millis() / 1000.0f);  // Convert to seconds
+    telemetry.values.set(SENSOR_LOOP_TIME_WIFI, wifiTime);
+    telemetry.values.set(SENSOR_LOOP_TIME_WORK, workTime);  // Work time from loop()
+
+    publishTelemetry(mqttManager, telemetry);
   }
   
   return true;
@@ -86,35 +162,58 @@ void publishTelemetryAfterWork(WiFiManager& wifiManager, MQTTManager& mqttManage
   lastLoopStartTime = currentTime;
   
   // Publish telemetry via MQTT (if configured)
-  if (mqttManager.begin() && mqttManager.isConfigured()) {
-    LogBox::message("MQTT", "Connecting to broker...");
-
-    if (mqttManager.connect()) {
-      LogBox::message("MQTT", "Publishing telemetry with work time");
-
-      // Prepare telemetry data
-      TelemetryData telemetry;
-      telemetry.deviceId = wifiManager.getDeviceIdentifier();
-      telemetry.deviceName = configManager.getFriendlyName();
-      telemetry.modelName = BOARD_NAME;
-      telemetry.wakeReason = powerManager.getWakeupReason();
-      telemetry.batteryVoltage = powerManager.readBatteryVoltage();
-      telemetry.batteryPercentage = PowerManager::calculateBatteryPercentage(telemetry.batteryVoltage);
-      telemetry.wifiRSSI = wifiManager.getRSSI();
-      telemetry.wifiBSSID = WiFi.BSSIDstr();
-      telemetry.wifiRetryCount = 0;  // Not tracked on republish
-      telemetry.loopTimeTotal = actualLoopTime;  // Actual loop iteration time
-      telemetry.loopTimeWiFi = 0.0f;  // Already included in total
-      telemetry.loopTimeWork = workTime;
-      telemetry.freeHeap = ESP.getFreeHeap();
-
-      mqttManager.publishAllTelemetry(telemetry);
-      mqttManager.disconnect();
+  if (mqttReady(mqttManager)) {
+    if (s_mqttAsync == nullptr && !mqttManager.isConnected()) {
+      LogBox::message("MQTT", "Connecting to broker...");
     }
+
+    LogBox::message("MQTT", "Publishing telemetry with work time");
+
+    // Prepare telemetry data (WiFi time is already included in the total)
+    TelemetryData telemetry;
+    collectTelemetry(telemetry, wifiManager, mqttManager, configManager, powerManager);
+    telemetry.values.set(SENSOR_WIFI_RETRIES, 0);  // Not tracked on republish
+    telemetry.values.set(SENSOR_LOOP_TIME, actualLoopTime);  // Actual loop iteration time
+    telemetry.values.set(SENSOR_LOOP_TIME_WORK, workTime);
+
+    publishTelemetry(mqttManager, telemetry);
+  }
+}
+
+bool publishTelemetryWindow(WiFiManager& wifiManager, MQTTManager& mqttManager,
+                            ConfigManager& configManager, PowerManager& powerManager,
+                            float workTime, unsigned long windowMs) {
+  static unsigned long windowStartTime = millis();
+  static float windowWorkTime = 0.0f;
+  windowWorkTime += workTime;
+
+  if (millis() - windowStartTime < windowMs) {
+    return false;  // Keep sampling - SensorAggregator::add() collects the window
+  }
+  windowStartTime = millis();
+
+  publishTelemetryAfterWork(wifiManager, mqttManager, configManager, powerManager, windowWorkTime);
+  windowWorkTime = 0.0f;
+  return true;
+}
+
+void waitWithMQTTSession(MQTTManager& mqttManager, unsigned long durationMs) {
+  if (s_mqttAsync != nullptr) {
+    delay(durationMs);  // The MQTT task services the session
+    return;
+  }
+
+  unsigned long start = millis();
+  while (millis() - start < durationMs) {
+    mqttManager.loop();
+    delay(MQTT_SESSION_POLL_MS);
   }
 }
 
 void enterSleepMode(PowerManager& powerManager, ConfigManager& configManager, float sleepDuration) {
+  if (s_mqttAsync != nullptr && !s_mqttAsync->waitIdle()) {
+    LogBox::messagef("MQTT", "ERROR: %u queued message(s) not sent before sleep", s_mqttAsync->getStats().depth);
+  }
   LogBox::messagef("Power", "Entering deep sleep for %.0f seconds", sleepDuration);
   delay(1000); // Give time for message to be sent
   powerManager.enterDeepSleep(sleepDuration);
@@ -135,8 +234,15 @@ void initializeHardware(PowerManager& powerManager, ConfigManager& configManager
   LogBox::line("Starting power manager...");
   powerManager.begin(WAKE_BUTTON_PIN);
   LogBox::line("Starting config manager...");
-  configManager.begin();
+  // Timer wakes restore config from the RTC snapshot instead of NVS
+  configManager.begin(powerManager.getWakeupReason() == WAKEUP_TIMER);
+  DeviceIdentity::begin(&configManager);
+  LogBox::linef("Device ID: %s", DeviceIdentity::getDeviceId());
   LogBox::end();
+
+#ifdef CONFIG_HEAP_CHECK_CYCLES
+  configManager.runHeapCheck(CONFIG_HEAP_CHECK_CYCLES);
+#endif
 }
 
 void handleFirstBoot(APModeController& apMode) {
@@ -7,6 +7,11 @@
 #include "config_portal.h"
 #include "ap_mode_controller.h"
 #include "mqtt_manager.h"
+#include "mqtt_async.h"
+#include "sensor_aggregator.h"
+
+// Poll interval for waitWithMQTTSession()
+#define MQTT_SESSION_POLL_MS 100
 
 /**
  * @brief Check if user is holding button to force config mode
@@ -22,6 +27,24 @@ bool checkButtonAtBoot();
  */
 void enterConfigMode(APModeController& apMode, const char* reason);
 
+/**
+ * @brief Publish telemetry through the async MQTT task from now on
+ * Telemetry is then queued instead of published on the calling task, and
+ * waitWithMQTTSession()/enterSleepMode() leave the session to the task
+ * @param mqttAsync Started MqttAsync instance (nullptr to publish directly again)
+ */
+void setAsyncMQTT(MqttAsync* mqttAsync);
+
+/**
+ * @brief Values of application sensors for the next telemetry
+ * Register the sensor once in setup() with SensorRegistry::add(), then set
+ * its value here before publishTelemetryAfterWork(). A value is sent with
+ * every telemetry until it is changed or cleared; sensors tracked by
+ * SensorAggregator are written here when their window is flushed.
+ * @return Value table indexed by the IDs SensorRegistry::add() returned
+ */
+SensorValues& applicationSensorValues();
+
 /**
  * @brief Connect to WiFi and publish MQTT telemetry
  * @param wifiManager Reference to WiFi manager
@@ -48,6 +71,33 @@ void publishTelemetryAfterWork(WiFiManager& wifiManager, MQTTManager& mqttManage
                                ConfigManager& configManager, PowerManager& powerManager,
                                float workTime);
 
+/**
+ * @brief Publish telemetry once per aggregation window (always-on sampling)
+ * Call every loop iteration instead of publishTelemetryAfterWork() when the
+ * loop samples faster than it should publish: samples go to
+ * SensorAggregator::add(), and once windowMs has passed since the last
+ * publish the window is flushed as min/max/mean/count/last and published
+ * @param wifiManager Reference to WiFi manager
+ * @param mqttManager Reference to MQTT manager
+ * @param configManager Reference to config manager
+ * @param powerManager Reference to power manager
+ * @param workTime Work time of this iteration in seconds (summed over the window)
+ * @param windowMs Publish interval in milliseconds
+ * @return true if telemetry was published
+ */
+bool publishTelemetryWindow(WiFiManager& wifiManager, MQTTManager& mqttManager,
+                            ConfigManager& configManager, PowerManager& powerManager,
+                            float workTime, unsigned long windowMs = SENSOR_WINDOW_SECONDS * 1000UL);
+
+/**
+ * @brief Wait while servicing a persistent MQTT session (always-on mode)
+ * Replaces delay() between loop iterations so keepalives, incoming packets
+ * and reconnects are handled during the wait
+ * @param mqttManager Reference to MQTT manager
+ * @param durationMs How long to wait in milliseconds
+ */
+void waitWithMQTTSession(MQTTManager& mqttManager, unsigned long durationMs);
+
 /**
  * @brief Enter deep sleep mode to save power
  * @param powerManager Reference to power manager
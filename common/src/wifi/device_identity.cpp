@@ -0,0 +1,76 @@
+#include "device_identity.h"
+#include <WiFi.h>
+
+struct IdentityCache {
+    bool macReady;
+    bool nameReady;
+    char friendlyName[FRIENDLY_NAME_MAX_LENGTH + 1];  // Raw name the IDs were built from
+    char macSuffix[7];
+    char mqttClientId[16];
+    char deviceId[DEVICE_ID_MAX_SIZE];
+    char topicPrefix[DEVICE_TOPIC_PREFIX_SIZE];
+};
+
+static IdentityCache s_identity;
+static ConfigManager* s_configManager = nullptr;
+
+void DeviceIdentity::begin(ConfigManager* configManager) {
+    if (configManager == s_configManager && s_identity.nameReady) {
+        return;
+    }
+    s_configManager = configManager;
+    s_identity.nameReady = false;
+    ensureCurrent();
+}
+
+void DeviceIdentity::ensureCurrent() {
+    if (!s_identity.macReady) {
+        // Use MAC address last 6 digits as unique identifier
+        uint8_t mac[6];
+        WiFi.macAddress(mac);
+        snprintf(s_identity.macSuffix, sizeof(s_identity.macSuffix), "%02X%02X%02X", mac[3], mac[4], mac[5]);
+        snprintf(s_identity.mqttClientId, sizeof(s_identity.mqttClientId), "esp32-%lx",
+                 (unsigned long)(uint32_t)ESP.getEfuseMac());
+        s_identity.macReady = true;
+    }
+
+    const char* friendlyName = s_configManager ? s_configManager->getFriendlyName() : "";
+    if (s_identity.nameReady && strcmp(friendlyName, s_identity.friendlyName) == 0) {
+        return;
+    }
+
+    strncpy(s_identity.friendlyName, friendlyName, sizeof(s_identity.friendlyName) - 1);
+    s_identity.friendlyName[sizeof(s_identity.friendlyName) - 1] = '\0';
+
+    // Fallback to MAC-based identifier if the name sanitizes to nothing
+    if (!ConfigManager::sanitizeFriendlyName(friendlyName, s_identity.deviceId, sizeof(s_identity.deviceId))) {
+        strcpy(s_identity.deviceId, s_identity.mqttClientId);
+    }
+    snprintf(s_identity.topicPrefix, sizeof(s_identity.topicPrefix), "homeassistant/sensor/%s", s_identity.deviceId);
+    s_identity.nameReady = true;
+}
+
+const char* DeviceIdentity::getMacSuffix() {
+    ensureCurrent();
+    return s_identity.macSuffix;
+}
+
+const char* DeviceIdentity::getDeviceId() {
+    ensureCurrent();
+    return s_identity.deviceId;
+}
+
+const char* DeviceIdentity::getHostname() {
+    ensureCurrent();
+    return s_identity.deviceId;
+}
+
+const char* DeviceIdentity::getMqttClientId() {
+    ensureCurrent();
+    return s_identity.mqttClientId;
+}
+
+const char* DeviceIdentity::getTopicPrefix() {
+    ensureCurrent();
+    return s_identity.topicPrefix;
+}
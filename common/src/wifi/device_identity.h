@@ -0,0 +1,42 @@
+#ifndef DEVICE_IDENTITY_H
+#define DEVICE_IDENTITY_H
+
+#include <Arduino.h>
+#include "config_manager.h"
+
+// Buffer sizes (including terminator)
+#define DEVICE_ID_MAX_SIZE 25       // Sanitized friendly name or "esp32-<efuse hex>"
+#define DEVICE_TOPIC_PREFIX_SIZE 48 // "homeassistant/sensor/<device id>"
+
+/**
+ * DeviceIdentity - Device naming computed once and held in static storage
+ *
+ * Everything that names the device on the network is derived from the MAC
+ * and the configured friendly name:
+ * - MAC suffix     "AABBCC" (AP name)
+ * - Device ID      sanitized friendly name, else "esp32-<efuse hex>"
+ *                  (Home Assistant identifiers and topics)
+ * - Hostname       same as the device ID
+ * - MQTT client ID "esp32-<efuse hex>" (stable across renames)
+ * - Topic prefix   "homeassistant/sensor/<device id>"
+ *
+ * The MAC parts are read once. The name parts are rebuilt only when the
+ * friendly name in ConfigManager differs from the one they were built
+ * from (a string compare per lookup, no NVS access or allocation).
+ */
+class DeviceIdentity {
+public:
+    // Use configManager's friendly name (without it the MAC-based ID is used)
+    static void begin(ConfigManager* configManager);
+
+    static const char* getMacSuffix();
+    static const char* getDeviceId();
+    static const char* getHostname();
+    static const char* getMqttClientId();
+    static const char* getTopicPrefix();
+
+private:
+    static void ensureCurrent();
+};
+
+#endif // DEVICE_IDENTITY_H
@@ -1,4 +1,5 @@
 #include "wifi_manager.h"
+#include "device_identity.h"
 #include "logger.h"
 
 WiFiManager::WiFiManager(ConfigManager* configManager) 
@@ -18,30 +19,14 @@ WiFiManager::~WiFiManager() {
 }
 
 String WiFiManager::generateDeviceID() {
-    // Use MAC address last 6 digits as unique identifier
-    uint8_t mac[6];
-    WiFi.macAddress(mac);
-    char deviceID[8];
-    snprintf(deviceID, sizeof(deviceID), "%02X%02X%02X", mac[3], mac[4], mac[5]);
-    return String(deviceID);
+    return String(DeviceIdentity::getMacSuffix());
 }
 
 String WiFiManager::getDeviceIdentifier() {
-    // Try to get friendly name from config
     if (_configManager) {
-        String friendlyName = _configManager->getFriendlyName();
-        
-        // Validate the friendly name using sanitization
-        String sanitized;
-        if (friendlyName.length() > 0 && 
-            ConfigManager::sanitizeFriendlyName(friendlyName, sanitized) && 
-            sanitized.length() > 0) {
-            return sanitized;
-        }
+        DeviceIdentity::begin(_configManager);  // No-op once bound
     }
-    
-    // Fallback to MAC-based identifier
-    return "esp32-" + String((uint32_t)ESP.getEfuseMac(), HEX);
+    return String(DeviceIdentity::getDeviceId());
 }
 
 bool WiFiManager::startAccessPoint() {
@@ -110,8 +95,11 @@ bool WiFiManager::connectToWiFi(const String& ssid, const String& password, uint
     WiFi.mode(WIFI_STA);
     
     // Set hostname for network identification (uses friendly name if set)
-    String hostname = getDeviceIdentifier();
-    WiFi.setHostname(hostname.c_str());
+    if (_configManager) {
+        DeviceIdentity::begin(_configManager);
+    }
+    const char* hostname = DeviceIdentity::getHostname();
+    WiFi.setHostname(hostname);
     
     // Enable persistent credentials and auto-reconnect for faster connections
     WiFi.persistent(true);
@@ -0,0 +1,75 @@
+#!/usr/bin/env bash
+# Export / import device configuration through the config portal JSON API
+# Usage:
+#   provision_config.sh get <host>                          # Print config (secrets redacted)
+#   provision_config.sh put <template.json> <host>[=name]... # Apply template to one or more devices
+#
+# A template is a JSON object with any subset of the config fields, e.g.
+#   {"ssid":"MyWiFi","password":"secret","mqttBroker":"mqtt://10.0.0.2:1883"}
+# Fields left out keep their stored values. "host=name" additionally sets
+# friendlyName for that device (requires jq).
+# Devices reboot after an import that changed something; re-applying an
+# identical template is a no-op.
+set -euo pipefail
+
+usage() {
+  echo "Usage: $0 get <host>"
+  echo "       $0 put <template.json> <host>[=friendlyName]..."
+  exit 2
+}
+
+# Ensure curl exists
+if ! command -v curl >/dev/null 2>&1; then
+  echo "curl is required but not installed. Please install curl."
+  exit 1
+fi
+
+COMMAND=${1:-}
+shift || true
+
+case "$COMMAND" in
+  get)
+    [ $# -eq 1 ] || usage
+    curl -sS --fail-with-body "http://$1/api/config"
+    echo
+    ;;
+  put)
+    [ $# -ge 2 ] || usage
+    TEMPLATE=$1
+    shift
+    if [ ! -f "$TEMPLATE" ]; then
+      echo "Template not found: $TEMPLATE"
+      exit 1
+    fi
+
+    FAILED=0
+    for target in "$@"; do
+      host=${target%%=*}
+      body=$(cat "$TEMPLATE")
+      if [ "$target" != "$host" ]; then
+        if ! command -v jq >/dev/null 2>&1; then
+          echo "jq is required for host=name overrides. Please install jq."
+          exit 1
+        fi
+        body=$(jq -c --arg name "${target#*=}" '.friendlyName = $name' <<< "$body")
+      fi
+
+      printf '%s: ' "$host"
+      if curl -sS --fail-with-body -X PUT -H "Content-Type: application/json" \
+           --data-binary "$body" "http://$host/api/config"; then
+        echo
+      else
+        echo
+        FAILED=$((FAILED + 1))
+      fi
+    done
+
+    if [ "$FAILED" -gt 0 ]; then
+      echo "$FAILED device(s) failed"
+      exit 1
+    fi
+    ;;
+  *)
+    usage
+    ;;
+esac
@@ -0,0 +1,150 @@
+// NVS cost of the configuration paths: first boot, portal submit, timer
+// wake, channel-lock save and factory reset, each measured in its own
+// emulated boot on the NVS emulator. Prints one row per scenario; flash
+// time and wear come from the emulator's model (nvs_emulator.h), host time
+// is what the firmware code itself took on this machine.
+#include <chrono>
+#include "host_test.h"
+#include "config_manager.h"
+#include "config_portal.h"
+#include "wifi_manager.h"
+
+static const uint8_t kOtherBssid[6] = {0x02, 0x11, 0x22, 0x33, 0x44, 0x66};
+
+static const std::map<std::string, std::string> kPortalForm = {
+    {"ssid", "HomeNetwork"},
+    {"password", "correct horse battery"},
+    {"friendlyName", "Garden Sensor"},
+    {"mqttBroker", "mqtt://10.0.0.2:1883"},
+    {"mqttUsername", "sensor"},
+    {"mqttPassword", "secret"},
+};
+
+// Measures one step of a boot and prints its row
+class Measurement {
+public:
+    explicit Measurement(const char* name) : _name(name) {
+        NvsFlash::instance().resetStats();
+        _start = std::chrono::steady_clock::now();
+    }
+    
+    ~Measurement() {
+        auto elapsed = std::chrono::steady_clock::now() - _start;
+        const NvsFlashStats& s = NvsFlash::instance().stats();
+        printf("%-22s %5u %5u %6u %7u %8u %6u %10llu %8lld\n", _name, s.opens, s.reads, s.writes, s.skippedWrites,
+               s.entriesWritten, s.pageErases, (unsigned long long)s.flashMicros,
+               (long long)std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count());
+        host::record((std::string(_name) + ".opens").c_str(), s.opens);
+        host::record((std::string(_name) + ".writes").c_str(), s.writes);
+        host::record((std::string(_name) + ".flashUs").c_str(), (double)s.flashMicros);
+    }
+
+private:
+    const char* _name;
+    std::chrono::steady_clock::time_point _start;
+};
+
+int main() {
+    int failures = 0;
+    host::eraseFlash();
+    
+    printf("%-22s %5s %5s %6s %7s %8s %6s %10s %8s\n", "scenario", "opens", "reads", "writes", "skipped",
+           "entries", "erases", "flash us", "host us");
+    
+    // First boot: erased flash, nothing configured yet
+    failures += host::boot(host::POWER_ON, [] {
+        ConfigManager config;
+        {
+            Measurement m("first boot");
+            config.begin(false);
+        }
+        CHECK(!config.isConfigured());
+    });
+    
+    // Portal submit: every form field saved in one transaction
+    failures += host::boot(host::POWER_ON, [] {
+        ConfigManager config;
+        config.begin(false);
+        WiFiManager wifi(&config);
+        ConfigPortal portal(&config, &wifi);
+        portal.begin();
+        HostResponse response;
+        {
+            Measurement m("portal submit");
+            response = WebServer::current()->request(HTTP_POST, "/submit", kPortalForm);
+        }
+        CHECK_EQ(response.code, 200);
+        CHECK(config.isConfigured());
+        CHECK(strcmp(config.getWiFiSSID(), "HomeNetwork") == 0);
+    });
+    
+    // Configured cold boot, then deep sleep: leaves the RTC snapshot
+    failures += host::boot(host::POWER_ON, [] {
+        ConfigManager config;
+        {
+            Measurement m("configured boot");
+            config.begin(false);
+        }
+        CHECK(config.isConfigured());
+        esp_deep_sleep_start();
+    });
+    host::sleep(300);
+    
+    // Timer wake: configuration and channel lock as the wake path reads them
+    failures += host::boot(host::TIMER_WAKE, [] {
+        ConfigManager config;
+        {
+            Measurement m("timer wake");
+            config.begin(true);
+            config.hasWiFiChannelLock();
+        }
+        CHECK(config.isConfigured());
+        CHECK(strcmp(config.getMQTTBroker(), "mqtt://10.0.0.2:1883") == 0);
+        esp_deep_sleep_start();
+    });
+    host::sleep(300);
+    
+    // Channel-lock save after a connect: a new AP, then the same AP again
+    failures += host::boot(host::TIMER_WAKE, [] {
+        ConfigManager config;
+        config.begin(true);
+        {
+            Measurement m("channel lock (new AP)");
+            config.setWiFiChannelLock(6, kOtherBssid);
+        }
+        {
+            Measurement m("channel lock (same)");
+            config.setWiFiChannelLock(6, kOtherBssid);
+        }
+        CHECK(config.hasWiFiChannelLock());
+        CHECK_EQ(config.getWiFiChannel(), 6);
+        esp_deep_sleep_start();
+    });
+    host::sleep(300);
+    
+    // Factory reset from the portal
+    failures += host::boot(host::BUTTON_WAKE, [] {
+        ConfigManager config;
+        config.begin(false);
+        WiFiManager wifi(&config);
+        ConfigPortal portal(&config, &wifi);
+        portal.begin();
+        HostResponse response;
+        {
+            Measurement m("factory reset");
+            response = WebServer::current()->request(HTTP_POST, "/factory-reset");
+        }
+        CHECK_EQ(response.code, 200);
+        CHECK(!config.isConfigured());
+        CHECK(!config.hasWiFiChannelLock());
+    });
+    
+    // Timer wakes and an unchanged channel lock must not open NVS at all
+    CHECK_EQ(host::recorded("timer wake.opens"), 0);
+    CHECK_EQ(host::recorded("channel lock (same).opens"), 0);
+    CHECK_EQ(host::recorded("channel lock (same).writes"), 0);
+    
+    printf("sector erases per page: max %u, min %u\n", NvsFlash::instance().maxPageErases(),
+           NvsFlash::instance().minPageErases());
+    return host::result(failures);
+}
@@ -0,0 +1,248 @@
+// Heap fragmentation of config load/save cycles. While a measurement runs,
+// operator new/delete allocate from a small first-fit arena (address
+// ordered, coalescing - close to the behaviour that fragments a long
+// running ESP32 heap) and ESP.getFreeHeap()/getMaxAllocHeap() report that
+// arena. Prints free heap and largest free block before and after
+// CYCLES load/save cycles for:
+// - String config: the baseline DeviceConfig with Arduino String members,
+//   reassigned from freshly read values every cycle
+// - ConfigManager: loadConfig() + saveConfig() of the inline FixedString
+//   DeviceConfig, each save a real record write to the NVS emulator
+// The FixedString path must leave the heap exactly as it found it.
+#include <cstdlib>
+#include <new>
+#include "host_test.h"
+#include "config_manager.h"
+
+#define CYCLES 10000
+#define ARENA_SIZE (48 * 1024)
+#define ARENA_ALIGN 16
+
+// ============================================
+// FIRST-FIT ARENA
+// ============================================
+// Blocks are laid out back to back: a 16-byte header (payload size, free
+// flag) followed by the payload. Allocation takes the first free block
+// that fits and splits it; free merges with the following free blocks and
+// the scan merges runs of free blocks it walks over.
+struct BlockHeader {
+    size_t size;  // Payload bytes
+    size_t free;
+};
+
+alignas(ARENA_ALIGN) static uint8_t s_arena[ARENA_SIZE];
+static bool s_arenaActive = false;
+static bool s_arenaReady = false;
+
+static BlockHeader* blockAt(size_t offset) {
+    return (BlockHeader*)(s_arena + offset);
+}
+
+static void arenaReset() {
+    BlockHeader* first = blockAt(0);
+    first->size = ARENA_SIZE - sizeof(BlockHeader);
+    first->free = 1;
+    s_arenaReady = true;
+}
+
+static bool inArena(void* p) {
+    return p >= (void*)s_arena && p < (void*)(s_arena + ARENA_SIZE);
+}
+
+// Merge free neighbours following block at offset
+static void coalesce(size_t offset) {
+    BlockHeader* block = blockAt(offset);
+    size_t next = offset + sizeof(BlockHeader) + block->size;
+    while (next < ARENA_SIZE && blockAt(next)->free) {
+        block->size += sizeof(BlockHeader) + blockAt(next)->size;
+        next = offset + sizeof(BlockHeader) + block->size;
+    }
+}
+
+static void* arenaAlloc(size_t size) {
+    size = (size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+    for (size_t offset = 0; offset < ARENA_SIZE; offset += sizeof(BlockHeader) + blockAt(offset)->size) {
+        BlockHeader* block = blockAt(offset);
+        if (!block->free) {
+            continue;
+        }
+        coalesce(offset);
+        if (block->size < size) {
+            continue;
+        }
+        if (block->size >= size + sizeof(BlockHeader) + ARENA_ALIGN) {
+            BlockHeader* rest = blockAt(offset + sizeof(BlockHeader) + size);
+            rest->size = block->size - size - sizeof(BlockHeader);
+            rest->free = 1;
+            block->size = size;
+        }
+        block->free = 0;
+        return block + 1;
+    }
+    throw std::bad_alloc();
+}
+
+static void arenaFree(void* p) {
+    BlockHeader* block = (BlockHeader*)p - 1;
+    block->free = 1;
+    coalesce((uint8_t*)block - s_arena);
+}
+
+struct ArenaStats {
+    size_t free;
+    size_t largest;
+};
+
+static ArenaStats arenaStats() {
+    ArenaStats stats = {0, 0};
+    for (size_t offset = 0; offset < ARENA_SIZE; offset += sizeof(BlockHeader) + blockAt(offset)->size) {
+        BlockHeader* block = blockAt(offset);
+        if (block->free) {
+            coalesce(offset);
+            stats.free += block->size;
+            stats.largest = block->size > stats.largest ? block->size : stats.largest;
+        }
+    }
+    return stats;
+}
+
+void* operator new(size_t size) {
+    if (s_arenaActive) {
+        return arenaAlloc(size);
+    }
+    void* p = malloc(size ? size : 1);
+    if (p == nullptr) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void operator delete(void* p) noexcept {
+    if (p == nullptr) {
+        return;
+    }
+    if (inArena(p)) {
+        arenaFree(p);
+    } else {
+        free(p);
+    }
+}
+
+void operator delete(void* p, size_t) noexcept {
+    operator delete(p);
+}
+
+// The firmware reads the arena through the usual ESP heap getters
+uint32_t EspClass::getFreeHeap() {
+    return s_arenaReady ? (uint32_t)arenaStats().free : 0;
+}
+
+uint32_t EspClass::getMaxAllocHeap() {
+    return s_arenaReady ? (uint32_t)arenaStats().largest : 0;
+}
+
+// ============================================
+// CYCLES
+// ============================================
+
+// DeviceConfig before FixedString: every member owns a heap buffer
+struct StringDeviceConfig {
+    String wifiSSID;
+    String wifiPassword;
+    String staticIP;
+    String gateway;
+    String subnet;
+    String primaryDNS;
+    String secondaryDNS;
+    String friendlyName;
+    String mqttBroker;
+    String mqttUsername;
+    String mqttPassword;
+    bool useStaticIP = false;
+    bool isConfigured = false;
+    bool debugMode = false;
+};
+
+static const char* kFriendlyNames[] = {"Garden Sensor", "Greenhouse North Wall", "Shed"};
+static const char* kBrokers[] = {"mqtt://10.0.0.2:1883", "mqtts://broker.example.internal:8883"};
+
+// Runs cycles with the arena active and records the figures. "Before" is
+// taken after the first cycle, once the long-lived objects exist.
+static void measure(const char* name, const std::function<void(uint32_t)>& cycle) {
+    arenaReset();
+    s_arenaActive = true;
+    cycle(0);
+    uint32_t freeBefore = ESP.getFreeHeap();
+    uint32_t largestBefore = ESP.getMaxAllocHeap();
+    for (uint32_t i = 1; i < CYCLES; i++) {
+        cycle(i);
+    }
+    uint32_t freeAfter = ESP.getFreeHeap();
+    uint32_t largestAfter = ESP.getMaxAllocHeap();
+    s_arenaActive = false;
+    
+    printf("%-14s free %6u -> %6u   largest block %6u -> %6u\n", name, freeBefore, freeAfter, largestBefore,
+           largestAfter);
+    host::record((std::string(name) + ".freeBefore").c_str(), freeBefore);
+    host::record((std::string(name) + ".freeAfter").c_str(), freeAfter);
+    host::record((std::string(name) + ".largestBefore").c_str(), largestBefore);
+    host::record((std::string(name) + ".largestAfter").c_str(), largestAfter);
+}
+
+int main() {
+    int failures = 0;
+    host::eraseFlash();
+    
+    failures += host::boot(host::POWER_ON, [] {
+        ConfigManager config;
+        config.begin(false);
+        config.beginTransaction();
+        config.setWiFiCredentials("HomeNetwork", "correct horse battery");
+        config.setMQTTConfig(kBrokers[0], "sensor", "secret");
+        config.setConfigured(true);
+        CHECK(config.commitTransaction());
+    });
+    
+    printf("%u load/save cycles, %u byte first-fit heap\n", CYCLES, ARENA_SIZE);
+    
+    // Baseline: the long-lived config is reassigned between short-lived
+    // allocations of other code (here: the values as read from NVS)
+    failures += host::boot(host::POWER_ON, [] {
+        StringDeviceConfig* config = nullptr;
+        measure("String config", [&config](uint32_t i) {
+            if (config == nullptr) {
+                config = new StringDeviceConfig();
+            }
+            String name = kFriendlyNames[i % 3];
+            String broker = kBrokers[i % 2];
+            String password = i % 2 ? "correct horse battery" : "correct horse battery staple";
+            config->wifiSSID = "HomeNetwork";
+            config->wifiPassword = password;
+            config->friendlyName = name;
+            config->mqttBroker = broker;
+            config->mqttUsername = "sensor";
+            config->isConfigured = true;
+            StringDeviceConfig copy = *config;  // saveConfig(config)
+            (void)copy;
+        });
+    });
+    
+    // Current: loadConfig()/saveConfig() through the NVS record
+    failures += host::boot(host::POWER_ON, [] {
+        ConfigManager config;
+        config.begin(false);
+        measure("ConfigManager", [&config](uint32_t i) {
+            DeviceConfig copy;
+            CHECK(config.loadConfig(copy));
+            CHECK(copy.friendlyName.assign(kFriendlyNames[i % 3]));
+            CHECK(copy.mqttBroker.assign(kBrokers[i % 2]));
+            CHECK(config.saveConfig(copy));
+        });
+        CHECK(strcmp(config.getFriendlyName(), kFriendlyNames[(CYCLES - 1) % 3]) == 0);
+        CHECK(NvsFlash::instance().stats().writes >= CYCLES - 1);  // Every save reached flash
+    });
+    
+    CHECK_EQ(host::recorded("ConfigManager.freeAfter"), host::recorded("ConfigManager.freeBefore"));
+    CHECK_EQ(host::recorded("ConfigManager.largestAfter"), host::recorded("ConfigManager.largestBefore"));
+    return host::result(failures);
+}
@@ -0,0 +1,148 @@
+// Timer-wake configuration load, before and after the single config record:
+// - per-key: the baseline loadConfig() pattern (one NVS lookup per
+//   setting, replayed against the legacy keys older firmware wrote)
+// - record: ConfigManager::begin() reading the CRC-checked blob
+// - snapshot: ConfigManager::begin(true) on a timer wake (RTC copy, no NVS)
+// Also checks the one-time migration from the legacy keys. NVS counts and
+// flash time come from the emulator; host us is the average per load.
+#include <chrono>
+#include "host_test.h"
+#include "config_manager.h"
+
+#define LOAD_ITERATIONS 500
+
+// Legacy per-key values as the baseline saveConfig() stored them
+static const char* legacyString(const char* key) {
+    if (strcmp(key, PREF_WIFI_SSID) == 0) return "HomeNetwork";
+    if (strcmp(key, PREF_WIFI_PASS) == 0) return "correct horse battery";
+    if (strcmp(key, PREF_FRIENDLY_NAME) == 0) return "Garden Sensor";
+    if (strcmp(key, PREF_MQTT_BROKER) == 0) return "mqtt://10.0.0.2:1883";
+    if (strcmp(key, PREF_MQTT_USER) == 0) return "sensor";
+    if (strcmp(key, PREF_MQTT_PASS) == 0) return "secret";
+    return "";
+}
+
+static void writeLegacyKeys() {
+    Preferences preferences;
+    preferences.begin(PREF_NAMESPACE, false);
+    for (uint8_t i = 0; i < CONFIG_FIELD_COUNT; i++) {
+        const ConfigFieldInfo& field = kConfigFields[i];
+        if (field.type == CONFIG_TYPE_BOOL) {
+            preferences.putBool(field.legacyKey, strcmp(field.legacyKey, PREF_CONFIGURED) == 0);
+        } else {
+            preferences.putString(field.legacyKey, legacyString(field.legacyKey));
+        }
+    }
+    preferences.end();
+}
+
+// Baseline ConfigManager::begin() + loadConfig(): open, then every key
+static bool loadPerKey(DeviceConfig& config) {
+    Preferences preferences;
+    if (!preferences.begin(PREF_NAMESPACE, false)) {
+        return false;
+    }
+    config.isConfigured = preferences.getBool(PREF_CONFIGURED, false);
+    if (!config.isConfigured) {
+        return false;
+    }
+    for (uint8_t i = 0; i < CONFIG_FIELD_COUNT; i++) {
+        const ConfigFieldInfo& field = kConfigFields[i];
+        if (field.type == CONFIG_TYPE_BOOL) {
+            config.*(field.boolMember) = preferences.getBool(field.legacyKey, false);
+        } else {
+            String value = preferences.getString(field.legacyKey, "");
+            field.writeString(config, value.c_str(), value.length());
+        }
+    }
+    return config.wifiSSID.length() > 0;
+}
+
+// Runs load once for the NVS counts, then LOAD_ITERATIONS times for the
+// host time, and prints the row
+static void measure(const char* name, const std::function<bool()>& load) {
+    NvsFlash::instance().resetStats();
+    CHECK(load());
+    NvsFlashStats s = NvsFlash::instance().stats();
+    
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < LOAD_ITERATIONS; i++) {
+        load();
+    }
+    double hostUs = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() /
+                    LOAD_ITERATIONS;
+    
+    printf("%-10s %5u %5u %7u %10llu %8.2f\n", name, s.opens, s.reads, s.entriesRead,
+           (unsigned long long)s.flashMicros, hostUs);
+    host::record((std::string(name) + ".opens").c_str(), s.opens);
+    host::record((std::string(name) + ".reads").c_str(), s.reads);
+    host::record((std::string(name) + ".flashUs").c_str(), (double)s.flashMicros);
+}
+
+int main() {
+    int failures = 0;
+    host::eraseFlash();
+    
+    printf("%-10s %5s %5s %7s %10s %8s\n", "load", "opens", "reads", "entries", "flash us", "host us");
+    
+    // Device configured by older firmware
+    failures += host::boot(host::POWER_ON, [] {
+        writeLegacyKeys();
+    });
+    
+    // Before: timer wake with the per-key layout
+    failures += host::boot(host::TIMER_WAKE, [] {
+        measure("per-key", [] {
+            DeviceConfig config;
+            return loadPerKey(config);
+        });
+    });
+    
+    // First boot of the new firmware: legacy keys become the record
+    failures += host::boot(host::POWER_ON, [] {
+        ConfigManager config;
+        CHECK(config.begin(false));
+        CHECK(config.getStats().migrated);
+        CHECK(config.isConfigured());
+        CHECK(strcmp(config.getWiFiSSID(), "HomeNetwork") == 0);
+        CHECK(strcmp(config.getWiFiPassword(), "correct horse battery") == 0);
+        CHECK(strcmp(config.getFriendlyName(), "Garden Sensor") == 0);
+        CHECK(strcmp(config.getMQTTBroker(), "mqtt://10.0.0.2:1883") == 0);
+        CHECK(strcmp(config.getMQTTPassword(), "secret") == 0);
+        CHECK(!config.getUseStaticIP());
+        
+        Preferences preferences;
+        preferences.begin(PREF_NAMESPACE, true);
+        for (uint8_t i = 0; i < CONFIG_FIELD_COUNT; i++) {
+            CHECK(!preferences.isKey(kConfigFields[i].legacyKey));
+        }
+        CHECK(preferences.isKey(PREF_CONFIG_RECORD));
+    });
+    
+    // After: record from NVS (cold boot), then the RTC snapshot (timer wake)
+    failures += host::boot(host::POWER_ON, [] {
+        measure("record", [] {
+            ConfigManager config;
+            bool loaded = config.begin(false) && config.isConfigured();
+            CHECK(!config.getStats().migrated);
+            return loaded;
+        });
+        esp_deep_sleep_start();
+    });
+    host::sleep(300);
+    failures += host::boot(host::TIMER_WAKE, [] {
+        measure("snapshot", [] {
+            ConfigManager config;
+            bool loaded = config.begin(true) && config.isConfigured();
+            CHECK(config.getStats().fromSnapshot);
+            return loaded && strcmp(config.getMQTTUsername(), "sensor") == 0;
+        });
+    });
+    
+    CHECK_EQ(host::recorded("record.opens"), 1);
+    CHECK(host::recorded("record.reads") < host::recorded("per-key.reads"));
+    CHECK(host::recorded("record.flashUs") < host::recorded("per-key.flashUs"));
+    CHECK_EQ(host::recorded("snapshot.opens"), 0);
+    CHECK_EQ(host::recorded("snapshot.reads"), 0);
+    return host::result(failures);
+}
@@ -0,0 +1,38 @@
+// Checks for the host tests. A failed check prints its location and counts
+// against the current emulated boot (host::boot() returns the count), or
+// against the test process when used outside of a boot.
+#pragma once
+
+#include <cstdio>
+#include "host_platform.h"
+#include "nvs_emulator.h"
+
+#define CHECK(condition)                                                         \
+    do {                                                                         \
+        if (!(condition)) {                                                      \
+            printf("FAIL %s:%d: %s\n", __FILE__, __LINE__, #condition);          \
+            host::fail();                                                        \
+        }                                                                        \
+    } while (0)
+
+#define CHECK_EQ(actual, expected)                                               \
+    do {                                                                         \
+        double a_ = (double)(actual);                                            \
+        double e_ = (double)(expected);                                          \
+        if (a_ != e_) {                                                          \
+            printf("FAIL %s:%d: %s == %s (%g != %g)\n", __FILE__, __LINE__,      \
+                   #actual, #expected, a_, e_);                                  \
+            host::fail();                                                        \
+        }                                                                        \
+    } while (0)
+
+namespace host {
+
+// Failed checks of the whole test: boots plus checks in the test process
+inline int result(int bootFailures) {
+    int total = bootFailures + failures();
+    printf("%s\n", total == 0 ? "PASS" : "FAILED");
+    return total == 0 ? 0 : 1;
+}
+
+}  // namespace host
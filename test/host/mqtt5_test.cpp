@@ -0,0 +1,134 @@
+// Mqtt5Client against the loopback broker: topic aliases handed out up to
+// the broker's Topic Alias Maximum and remapped least recently used first,
+// the broker's Server Keep Alive replacing the requested keepalive, and
+// the bytes a telemetry cycle costs over MQTT 5 next to MQTT 3.1.1
+// (Mqtt5Stats::v311Bytes) for the modes the developer guide lists.
+#include "mqtt_test.h"
+#include "mqtt5_client.h"
+
+static bool connectClient(Mqtt5Client& client) {
+    return client.connect(HostNetwork::brokerAddress, 1883, "mqtt5-test", "", "");
+}
+
+static bool publishText(Mqtt5Client& client, const char* topic) {
+    return client.publish(topic, (const uint8_t*)"1", 1, false);
+}
+
+// Second cycle of a session with a changed reading, as MQTT 5 and 3.1.1 bytes
+static void measureCycle(const char* name, bool persistent, bool combined) {
+    ConfigManager config;
+    config.begin(false);
+    MQTTManager mqtt(&config);
+    mqtt.setProtocolV5(true);
+    mqtt.setPersistentSession(persistent);
+    mqtt.setCombinedState(combined);
+    CHECK(mqtt.begin());
+    TelemetryData data;
+    mqtt_test::sampleTelemetry(data);
+    CHECK(mqtt.publishAllTelemetry(data));  // Discovery and the first state
+    if (!persistent) {
+        mqtt.disconnect();
+    }
+    Mqtt5Stats before = persistent ? mqtt.getMqtt5Stats() : Mqtt5Stats();
+    
+    mqtt_test::sampleTelemetry(data, 3.71f);
+    data.values.set(SENSOR_WIFI_SIGNAL, -70);
+    CHECK(mqtt.publishAllTelemetry(data));
+    const Mqtt5Stats& after = mqtt.getMqtt5Stats();
+    uint32_t mqtt5 = after.txBytes - before.txBytes;
+    uint32_t v311 = after.v311Bytes - before.v311Bytes;
+    printf("%-22s MQTT 5 %4u bytes, 3.1.1 %4u bytes\n", name, mqtt5, v311);
+    if (persistent) {
+        CHECK(mqtt5 < v311);  // Aliases pay off once the topics are mapped
+    }
+}
+
+int main() {
+    int failures = 0;
+    failures += mqtt_test::configure();
+    
+    // Three aliases: a, b, c mapped; a reused; d takes b's alias (least
+    // recently used); b comes back on a's
+    failures += host::boot(host::POWER_ON, [] {
+        LoopbackBroker& broker = LoopbackBroker::instance();
+        broker.aliasMax = 3;
+        WiFiClient socket;
+        Mqtt5Client client(socket);
+        CHECK(connectClient(client));
+        CHECK_EQ(client.getStats().aliasMax, 3);
+        const char* topics[] = {"t/a", "t/b", "t/c", "t/a", "t/d", "t/c", "t/b", "t/d"};
+        for (const char* topic : topics) {
+            CHECK(publishText(client, topic));
+        }
+        
+        std::vector<BrokerPacket> sent = broker.published("t/");
+        CHECK_EQ(sent.size(), 8);
+        if (sent.size() != 8) {
+            return;
+        }
+        const uint16_t aliases[] = {1, 2, 3, 1, 2, 3, 1, 2};
+        const bool aliasOnly[] = {false, false, false, true, false, true, false, true};
+        for (int i = 0; i < 8; i++) {
+            CHECK(sent[i].topic == topics[i]);  // As the broker resolved it
+            CHECK_EQ(sent[i].alias, aliases[i]);
+            CHECK_EQ(sent[i].aliasOnly, aliasOnly[i]);
+        }
+        CHECK_EQ(client.getStats().aliasHits, 3);
+        client.disconnect();
+        
+        // A broker that grants none: full topics, no alias property
+        broker.aliasMax = 0;
+        CHECK(connectClient(client));
+        broker.clearRecords();
+        CHECK(publishText(client, "t/a"));
+        CHECK(publishText(client, "t/a"));
+        for (const BrokerPacket& p : broker.published("t/")) {
+            CHECK_EQ(p.alias, 0);
+            CHECK(!p.aliasOnly);
+        }
+        client.disconnect();
+    });
+    
+    // Server Keep Alive: the client pings on the broker's interval, and
+    // asks for its own again on the next connection
+    failures += host::boot(host::POWER_ON, [] {
+        LoopbackBroker& broker = LoopbackBroker::instance();
+        broker.serverKeepAlive = 4;
+        WiFiClient socket;
+        Mqtt5Client client(socket);
+        client.setKeepAlive(60);
+        CHECK(connectClient(client));
+        CHECK_EQ(client.getStats().keepAlive, 4);
+        CHECK_EQ(broker.count(MQTT_PKT_CONNECT), 1);
+        
+        delay(4000);
+        CHECK(client.loop());
+        CHECK_EQ(broker.count(MQTT_PKT_PINGREQ), 1);
+        client.disconnect();
+        
+        broker.serverKeepAlive = 0;
+        broker.clearRecords();
+        CHECK(connectClient(client));
+        CHECK_EQ(client.getStats().keepAlive, 60);
+        for (const BrokerPacket& p : broker.packets()) {
+            if (p.type == MQTT_PKT_CONNECT) {
+                CHECK_EQ(p.keepAlive, 60);
+            }
+        }
+        delay(4000);
+        CHECK(client.loop());
+        CHECK_EQ(broker.count(MQTT_PKT_PINGREQ), 0);
+        client.disconnect();
+    });
+    
+    failures += host::boot(host::POWER_ON, [] {
+        measureCycle("always-on, per-sensor", true, false);
+    });
+    failures += host::boot(host::POWER_ON, [] {
+        measureCycle("always-on, combined", true, true);
+    });
+    failures += host::boot(host::POWER_ON, [] {
+        measureCycle("single wake, combined", false, true);
+    });
+    return host::result(failures);
+}
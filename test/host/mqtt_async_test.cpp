@@ -0,0 +1,145 @@
+// MqttAsync against the loopback broker: telemetry queued as a record must
+// publish the same state as the reading it was taken from, also with every
+// registry slot and the wear table full, and the manager's state reaches
+// the loop task through the getStats() snapshot. Prints the queue's size.
+#include <chrono>
+#include <thread>
+#include "mqtt_test.h"
+#include "mqtt_async.h"
+
+// Completion in real time - the task is a thread, emulated delays do not wait for it
+static bool waitComplete(MqttAsync& async, uint32_t ticket) {
+    for (int i = 0; i < 500 && !async.isComplete(ticket); i++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    return async.isComplete(ticket);
+}
+
+static void checkState(const TelemetryData& data) {
+    std::string topic = "homeassistant/sensor/" + std::string(data.deviceId.c_str()) + "/state";
+    std::vector<BrokerPacket> state = LoopbackBroker::instance().published(topic);
+    CHECK_EQ(state.size(), 1);
+    if (state.size() != 1) {
+        return;
+    }
+    bool ok = false;
+    std::map<std::string, std::string> members = mqtt_test::parseObject(state[0].payload, ok);
+    CHECK(ok);
+    for (int id = 0; id < SensorRegistry::count(); id++) {
+        if (data.values.has(id)) {
+            CHECK(members[SensorRegistry::get(id).key] == data.values.get(id));
+        }
+    }
+    CHECK(members["nvs_writes_attrs"] == data.nvsWearJson.c_str());
+}
+
+int main() {
+    int failures = 0;
+    failures += mqtt_test::configure();
+    
+    failures += host::boot(host::POWER_ON, [] {
+        ConfigManager config;
+        config.begin(false);
+        MQTTManager mqtt(&config);
+        CHECK(mqtt.begin());
+        MqttAsync async(&mqtt);
+        CHECK(async.begin());
+        printf("MqttAsync %u bytes with %d slots of %u (one TelemetryData: %u bytes)\n", (unsigned)sizeof(MqttAsync),
+               MQTT_ASYNC_QUEUE_DEPTH, (unsigned)MQTT_ASYNC_RECORD_SIZE, (unsigned)sizeof(TelemetryData));
+        
+        // The record rebuilds the reading: same state, same device
+        TelemetryData data;
+        mqtt_test::sampleTelemetry(data);
+        uint32_t ticket = async.publishTelemetry(data);
+        CHECK(ticket != 0);
+        CHECK(waitComplete(async, ticket));
+        checkState(data);
+        int named = 0;
+        for (const BrokerPacket& p : LoopbackBroker::instance().published("homeassistant/")) {
+            named += p.payload.find("\"name\":\"Garden Sensor\"") != std::string::npos ? 1 : 0;
+        }
+        CHECK(named > 0);  // The device block carries the identity
+        
+        // Snapshot of the manager, taken by the task
+        MqttAsyncStats stats = async.getStats();
+        CHECK_EQ(stats.failed, 0);
+        CHECK(!stats.persistentSession);
+        CHECK(stats.lastFlushMs >= 0 && stats.lastFlushMs < MQTT_FLUSH_TIMEOUT_MS);
+        printf("MQTT task stack: %u of %u bytes left after discovery and state\n", stats.stackFreeBytes,
+               MQTT_ASYNC_STACK_SIZE);
+        CHECK(stats.stackFreeBytes > 0);
+        
+        // A second reading with other values and no wear JSON
+        LoopbackBroker::instance().clearRecords();
+        mqtt_test::sampleTelemetry(data, 3.71f);
+        data.values.set(SENSOR_WIFI_SIGNAL, -70);
+        data.nvsWearJson = "";
+        ticket = async.publishTelemetry(data);
+        CHECK(waitComplete(async, ticket));
+        checkState(data);
+        
+        // Every registry slot filled with the longest key and value, and
+        // the largest wear JSON getWearJSON() can produce: queued whole
+        static char keys[SENSOR_REGISTRY_SIZE][SENSOR_KEY_SIZE + 1];
+        static char names[SENSOR_REGISTRY_SIZE][16];
+        static SensorDescriptor labels[SENSOR_REGISTRY_SIZE];
+        mqtt_test::sampleTelemetry(data);
+        memset(keys[0], 'k', SENSOR_KEY_SIZE);  // One character too long
+        labels[0] = {keys[0], "Too long", "", "", 0, SENSOR_TEXT, NAN, 0.0f, 0, false};
+        CHECK_EQ(SensorRegistry::add(labels[0]), -1);
+        for (int i = 0; SensorRegistry::count() < SENSOR_REGISTRY_SIZE; i++) {
+            snprintf(keys[i], sizeof(keys[i]), "label_%02d_%s", i, std::string(SENSOR_KEY_SIZE - 10, 'k').c_str());
+            snprintf(names[i], sizeof(names[i]), "Label %d", i);
+            labels[i] = {keys[i], names[i], "", "", 0, SENSOR_TEXT, NAN, 0.0f, 0, false};
+            CHECK(SensorRegistry::add(labels[i]) >= 0);
+        }
+        std::string longest(SENSOR_VALUE_SIZE - 1, 'a');
+        for (int id = 0; id < SensorRegistry::count(); id++) {
+            if (SensorRegistry::get(id).format == SENSOR_TEXT) {
+                data.values.setText(id, longest.c_str());
+            } else if (id != SENSOR_LOOP_TIME_DNS && id != SENSOR_MQTT_BACKLOG) {  // Set by the manager
+                data.values.set(id, -1234567.0f + id);
+            }
+        }
+        std::string wear = "{\"" + std::string(NVS_WEAR_JSON_MAX_SIZE - 7, 'k') + "\":1}";
+        CHECK_EQ(wear.size(), NVS_WEAR_JSON_MAX_SIZE - 1);
+        data.nvsWearJson = wear.c_str();
+        LoopbackBroker::instance().clearRecords();
+        ticket = async.publishTelemetry(data);
+        CHECK(ticket != 0);
+        CHECK(waitComplete(async, ticket));
+        CHECK_EQ(async.getStats().rejected, 0);
+        CHECK_EQ(async.getStats().failed, 0);
+        checkState(data);
+        
+        // More than a record holds: rejected, not cut
+        data.nvsWearJson = std::string(MQTT_ASYNC_RECORD_SIZE, 'x').c_str();
+        CHECK_EQ(async.publishTelemetry(data), 0);
+        CHECK_EQ(async.getStats().rejected, 1);
+        esp_deep_sleep_start();  // Ends the boot while the task still has its MqttAsync
+    });
+    
+    // Persistent session: the reconnect count comes from the snapshot
+    failures += host::boot(host::POWER_ON, [] {
+        ConfigManager config;
+        config.begin(false);
+        MQTTManager mqtt(&config);
+        mqtt.setPersistentSession(true);
+        CHECK(mqtt.begin());
+        MqttAsync async(&mqtt);
+        CHECK(async.begin());
+        CHECK(async.getStats().persistentSession);  // Taken by begin()
+        
+        TelemetryData data;
+        mqtt_test::sampleTelemetry(data);
+        CHECK(waitComplete(async, async.publishTelemetry(data)));
+        CHECK_EQ(async.getStats().reconnects, 0);
+        LoopbackBroker::instance().dropConnection();
+        CHECK(waitComplete(async, async.publishTelemetry(data)));
+        MqttAsyncStats stats = async.getStats();
+        CHECK_EQ(stats.failed, 0);
+        CHECK_EQ(stats.reconnects, 1);
+        esp_deep_sleep_start();
+    });
+    return host::result(failures);
+}
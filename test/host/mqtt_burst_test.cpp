@@ -0,0 +1,99 @@
+// Burst mode against the loopback broker: an accepted CONNACK without the
+// PINGRESP is not a delivered cycle (reading queued, discovery and the
+// reported values not stored), and the writes, bytes and time of a cycle
+// with and without the burst at a simulated round trip.
+#include "mqtt_test.h"
+#include "telemetry_queue.h"
+
+#define RTT_MS 30
+
+// Second cycle with a changed reading; prints writes, bytes and time
+static void measureCycle(const char* name, bool burst, bool combined) {
+    ConfigManager config;
+    config.begin(false);
+    MQTTManager mqtt(&config);
+    mqtt.setBurst(burst);
+    mqtt.setCombinedState(combined);
+    CHECK(mqtt.begin());
+    TelemetryData data;
+    mqtt_test::sampleTelemetry(data);
+    CHECK(mqtt.publishAllTelemetry(data));  // Discovery and the first state
+    
+    LoopbackBroker& broker = LoopbackBroker::instance();
+    broker.clearRecords();
+    broker.ackDelayMs = RTT_MS;
+    mqtt_test::sampleTelemetry(data, 3.71f);
+    data.values.set(SENSOR_WIFI_SIGNAL, -70);
+    unsigned long start = millis();
+    CHECK(mqtt.publishAllTelemetry(data));
+    unsigned long elapsed = millis() - start;
+    printf("%-22s %2u write(s), %4u bytes, %3lu ms\n", name, broker.clientWrites(), broker.clientBytes(), elapsed);
+    host::record((std::string(name) + " writes").c_str(), broker.clientWrites());
+    host::record((std::string(name) + " bytes").c_str(), broker.clientBytes());
+    host::record((std::string(name) + " ms").c_str(), elapsed);
+}
+
+int main() {
+    int failures = 0;
+    failures += mqtt_test::configure();
+    
+    // CONNACK accepted, PINGRESP never comes: nothing counts as delivered
+    failures += host::boot(host::POWER_ON, [] {
+        ConfigManager config;
+        config.begin(false);
+        MQTTManager mqtt(&config);
+        mqtt.setBurst(true);
+        mqtt.setCombinedState(false);
+        CHECK(mqtt.begin());
+        TelemetryData data;
+        mqtt_test::sampleTelemetry(data);
+        std::string configs = "homeassistant/sensor/" + std::string(data.deviceId.c_str()) + "/";
+        LoopbackBroker& broker = LoopbackBroker::instance();
+        
+        broker.respondPing = false;
+        CHECK(!mqtt.publishAllTelemetry(data));
+        CHECK(mqtt.getLastError().startsWith("Burst not confirmed"));  // Closed after the DISCONNECT
+        CHECK_EQ(TelemetryQueue::depth(), 1);
+        
+        // The backlog takes the normal path; discovery and every state go
+        // out again because neither was stored
+        broker.respondPing = true;
+        broker.clearRecords();
+        CHECK(mqtt.publishAllTelemetry(data));
+        int discovery = 0;
+        int states = 0;
+        for (const BrokerPacket& p : broker.published(configs)) {
+            discovery += p.topic.find("/config") != std::string::npos ? 1 : 0;
+            states += p.topic.find("/state") != std::string::npos ? 1 : 0;
+        }
+        CHECK(discovery > 0);
+        CHECK_EQ(states, discovery);
+        CHECK_EQ(TelemetryQueue::depth(), 0);
+        
+        // Confirmed burst: stored, so the same reading sends nothing new
+        CHECK(mqtt.publishAllTelemetry(data));
+        broker.clearRecords();
+        CHECK(mqtt.publishAllTelemetry(data));
+        CHECK_EQ(broker.published(configs).size(), 0);
+        CHECK(mqtt.getBurstStats().flushMs < MQTT_BURST_TIMEOUT_MS);
+    });
+    
+    failures += host::boot(host::POWER_ON, [] {
+        measureCycle("combined", false, true);
+    });
+    failures += host::boot(host::POWER_ON, [] {
+        measureCycle("combined, burst", true, true);
+    });
+    failures += host::boot(host::POWER_ON, [] {
+        measureCycle("per-sensor", false, false);
+    });
+    failures += host::boot(host::POWER_ON, [] {
+        measureCycle("per-sensor, burst", true, false);
+    });
+    
+    CHECK_EQ(host::recorded("combined, burst writes"), 1);
+    CHECK_EQ(host::recorded("per-sensor, burst writes"), 1);
+    CHECK_EQ(host::recorded("combined ms") - host::recorded("combined, burst ms"), RTT_MS);  // One round trip
+    CHECK_EQ(host::recorded("combined, burst bytes"), host::recorded("combined bytes"));
+    return host::result(failures);
+}
@@ -0,0 +1,184 @@
+// Home Assistant discovery against the loopback broker: per-sensor configs
+// and the device-based message must announce the same sensors with the
+// same unique IDs and state templates, and the device message must be
+// valid JSON however large it grows. Prints packets and bytes (whole MQTT
+// packets) of the discovery messages for both modes, then checks discovery
+// change detection across wakes.
+#include "mqtt_test.h"
+
+static bool endsWith(const std::string& text, const char* suffix) {
+    size_t length = strlen(suffix);
+    return text.size() >= length && text.compare(text.size() - length, length, suffix) == 0;
+}
+
+// One cold-boot publishAllTelemetry() with the given discovery mode;
+// returns the discovery messages and records their packets and bytes
+static std::vector<BrokerPacket> publishCycle(const char* name, bool deviceDiscovery, TelemetryData& data) {
+    ConfigManager config;
+    config.begin(false);
+    MQTTManager mqtt(&config);
+    mqtt.setDeviceDiscovery(deviceDiscovery);
+    CHECK(mqtt.begin());
+    
+    mqtt_test::sampleTelemetry(data);
+    LoopbackBroker::instance().reset();
+    CHECK(mqtt.publishAllTelemetry(data));
+    
+    std::vector<BrokerPacket> discovery;
+    for (const BrokerPacket& p : LoopbackBroker::instance().published("homeassistant/")) {
+        if (endsWith(p.topic, "/config")) {
+            CHECK(p.retain);
+            discovery.push_back(p);
+        }
+    }
+    printf("%-11s %3u packets %6u bytes\n", name, (unsigned)discovery.size(), mqtt_test::totalSize(discovery));
+    host::record((std::string(name) + ".packets").c_str(), discovery.size());
+    host::record((std::string(name) + ".bytes").c_str(), mqtt_test::totalSize(discovery));
+    return discovery;
+}
+
+// Discovery messages of one publishAllTelemetry() on a fresh broker record
+static int discoveryMessages(MQTTManager& mqtt, const TelemetryData& data) {
+    LoopbackBroker::instance().clearRecords();
+    CHECK(mqtt.publishAllTelemetry(data));
+    int count = 0;
+    for (const BrokerPacket& p : LoopbackBroker::instance().published("homeassistant/")) {
+        count += endsWith(p.topic, "/config") ? 1 : 0;
+    }
+    return count;
+}
+
+// A cold boot's cycle: the discovery messages it sent
+static int coldBootDiscovery(const char* friendlyName, bool extraSensor) {
+    static const SensorDescriptor kSoilMoisture = {
+        "soil_moisture", "Soil Moisture", "moisture", "%", 0, SENSOR_NUMBER, -1.0f, 2.0f, 0, false
+    };
+    ConfigManager config;
+    config.begin(false);
+    MQTTManager mqtt(&config);
+    CHECK(mqtt.begin());
+    TelemetryData data;
+    mqtt_test::sampleTelemetry(data);
+    data.deviceName = friendlyName;
+    if (extraSensor) {
+        data.values.set(SensorRegistry::add(kSoilMoisture), 41);
+    }
+    return discoveryMessages(mqtt, data);
+}
+
+// What Home Assistant needs from every sensor config, either mode
+static void checkSensorConfig(const std::map<std::string, std::string>& config, const std::string& deviceId,
+                              const std::string& key) {
+    auto member = [&config](const char* name) {
+        auto it = config.find(name);
+        return it == config.end() ? std::string() : it->second;
+    };
+    CHECK(member("unique_id") == deviceId + "_" + key);
+    CHECK(member("value_template") == "{{value_json." + key + "}}");
+    CHECK(!member("name").empty());
+}
+
+int main() {
+    int failures = 0;
+    failures += mqtt_test::configure();
+    
+    // Per-sensor: one config per sensor, the first with the full device block
+    failures += host::boot(host::POWER_ON, [] {
+        TelemetryData data;
+        std::vector<BrokerPacket> discovery = publishCycle("per-sensor", false, data);
+        std::string deviceId = data.deviceId.c_str();
+        std::string prefix = "homeassistant/sensor/" + deviceId + "/";
+        int sensors = 0;
+        for (const BrokerPacket& p : discovery) {
+            CHECK(p.topic.compare(0, prefix.size(), prefix) == 0);
+            std::string key = p.topic.substr(prefix.size(), p.topic.size() - prefix.size() - strlen("/config"));
+            bool ok = false;
+            std::map<std::string, std::string> config = mqtt_test::parseObject(p.payload, ok);
+            CHECK(ok);
+            CHECK(SensorRegistry::find(key.c_str()) >= 0);
+            CHECK(config["state_topic"] == prefix + "state");
+            checkSensorConfig(config, deviceId, key);
+            sensors++;
+        }
+        host::record("per-sensor.sensors", sensors);
+    });
+    
+    // Device-based: one message, the device block and state topic once
+    failures += host::boot(host::POWER_ON, [] {
+        TelemetryData data;
+        std::vector<BrokerPacket> discovery = publishCycle("device", true, data);
+        CHECK_EQ(discovery.size(), 1);
+        if (discovery.size() != 1) {
+            return;
+        }
+        std::string deviceId = data.deviceId.c_str();
+        CHECK(discovery[0].topic == "homeassistant/device/" + deviceId + "/config");
+        
+        bool ok = false;
+        std::map<std::string, std::string> message = mqtt_test::parseObject(discovery[0].payload, ok);
+        CHECK(ok);
+        CHECK(message["state_topic"] == "homeassistant/sensor/" + deviceId + "/state");
+        std::map<std::string, std::string> device = mqtt_test::parseObject(message["device"], ok);
+        CHECK(ok);
+        CHECK(device["name"] == "Garden Sensor");
+        CHECK(device.count("sw_version") == 1);
+        
+        std::map<std::string, std::string> components = mqtt_test::parseObject(message["components"], ok);
+        CHECK(ok);
+        for (const auto& component : components) {
+            std::string key = component.first.substr(deviceId.size() + 1);
+            CHECK(component.first.compare(0, deviceId.size() + 1, deviceId + "_") == 0);
+            CHECK(SensorRegistry::find(key.c_str()) >= 0);
+            std::map<std::string, std::string> config = mqtt_test::parseObject(component.second, ok);
+            CHECK(ok);
+            CHECK(config["platform"] == "sensor");
+            CHECK(config.count("state_topic") == 0);  // Inherited from the message
+            checkSensorConfig(config, deviceId, key);
+        }
+        host::record("device.sensors", components.size());
+    });
+    
+    // Change detection: unchanged discovery is skipped on every wake type
+    // (hash in RTC memory, then NVS) and sent again when its content
+    // changes or Home Assistant comes back online
+    failures += host::boot(host::POWER_ON, [] {
+        CHECK_EQ(coldBootDiscovery("Garden Sensor", false), 11);
+        esp_deep_sleep_start();
+    });
+    host::sleep(300);
+    failures += host::boot(host::TIMER_WAKE, [] {
+        NvsFlash::instance().resetStats();
+        CHECK_EQ(coldBootDiscovery("Garden Sensor", false), 0);
+        CHECK_EQ(NvsFlash::instance().stats().writes, 0);
+    });
+    failures += host::boot(host::POWER_ON, [] {
+        CHECK_EQ(coldBootDiscovery("Garden Sensor", false), 0);
+    });
+    failures += host::boot(host::POWER_ON, [] {
+        CHECK_EQ(coldBootDiscovery("Garden Sensor South", false), 11);
+    });
+    failures += host::boot(host::POWER_ON, [] {
+        CHECK_EQ(coldBootDiscovery("Garden Sensor South", true), 12);
+    });
+    failures += host::boot(host::POWER_ON, [] {
+        ConfigManager config;
+        config.begin(false);
+        MQTTManager mqtt(&config);
+        mqtt.setPersistentSession(true);
+        CHECK(mqtt.begin());
+        TelemetryData data;
+        mqtt_test::sampleTelemetry(data);
+        data.deviceName = "Garden Sensor South";
+        CHECK_EQ(discoveryMessages(mqtt, data), 11);  // The extra sensor is gone again
+        CHECK_EQ(discoveryMessages(mqtt, data), 0);
+        LoopbackBroker::instance().inject(MQTT_HA_STATUS_TOPIC, "online");
+        mqtt.loop();
+        CHECK_EQ(discoveryMessages(mqtt, data), 11);
+        CHECK_EQ(discoveryMessages(mqtt, data), 0);
+    });
+    
+    // Same sensors either way, in a fraction of the bytes
+    CHECK_EQ(host::recorded("device.sensors"), host::recorded("per-sensor.sensors"));
+    CHECK(host::recorded("device.bytes") < host::recorded("per-sensor.bytes"));
+    return host::result(failures);
+}
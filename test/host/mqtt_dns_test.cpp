@@ -0,0 +1,88 @@
+// Broker address cache against the loopback broker and HostNetwork's DNS:
+// a timer wake connects by the cached address, a failed connect or a lost
+// persistent session drops it, and a broker that moved is found again by
+// resolving the host name (HostNetwork::dnsLookups counts the lookups).
+#include "mqtt_test.h"
+
+static const IPAddress kMovedAddress(10, 0, 0, 3);
+
+static void beginManager(MQTTManager& mqtt, bool persistent) {
+    mqtt.setPersistentSession(persistent);
+    CHECK(mqtt.begin());
+}
+
+int main() {
+    int failures = 0;
+    failures += mqtt_test::configure("mqtt://broker.home.lan:1883");
+    
+    // Cold boot resolves and caches the address
+    failures += host::boot(host::POWER_ON, [] {
+        ConfigManager config;
+        config.begin(false);
+        MQTTManager mqtt(&config);
+        beginManager(mqtt, false);
+        CHECK(mqtt.connect());
+        CHECK_EQ(HostNetwork::dnsLookups, 1);
+        mqtt.disconnect();
+        esp_deep_sleep_start();
+    });
+    host::sleep(300);
+    
+    // Timer wake: cached; then a failed connect drops the cache, and the
+    // next connect of the same wake resolves again
+    failures += host::boot(host::TIMER_WAKE, [] {
+        ConfigManager config;
+        config.begin(true);
+        MQTTManager mqtt(&config);
+        beginManager(mqtt, false);
+        CHECK(mqtt.connect());
+        CHECK_EQ(HostNetwork::dnsLookups, 0);
+        mqtt.disconnect();
+        
+        LoopbackBroker::instance().online = false;
+        CHECK(!mqtt.connect());
+        CHECK_EQ(HostNetwork::dnsLookups, 1);  // Cached address failed, resolved once
+        LoopbackBroker::instance().online = true;
+        HostNetwork::dnsLookups = 0;
+        CHECK(mqtt.connect());
+        CHECK_EQ(HostNetwork::dnsLookups, 1);
+        mqtt.disconnect();
+        esp_deep_sleep_start();
+    });
+    host::sleep(300);
+    
+    // Persistent session, resolved at power on: the broker moves while
+    // connected. After the drop the address is resolved again instead of
+    // retrying the cached one until the TTL runs out.
+    failures += host::boot(host::POWER_ON, [] {
+        ConfigManager config;
+        config.begin(false);
+        MQTTManager mqtt(&config);
+        beginManager(mqtt, true);
+        CHECK(mqtt.connect());
+        CHECK_EQ(HostNetwork::dnsLookups, 1);
+        
+        HostNetwork::brokerAddress = kMovedAddress;
+        LoopbackBroker::instance().dropConnection();
+        mqtt.loop();
+        CHECK(mqtt.isConnected());
+        CHECK_EQ(HostNetwork::dnsLookups, 2);
+        CHECK_EQ(mqtt.getSessionStats().drops, 1);
+        CHECK_EQ(mqtt.getSessionStats().reconnects, 1);
+        esp_deep_sleep_start();
+    });
+    host::sleep(300);
+    
+    // The new address is what the next wake finds in the cache
+    failures += host::boot(host::TIMER_WAKE, [] {
+        HostNetwork::brokerAddress = kMovedAddress;
+        ConfigManager config;
+        config.begin(true);
+        MQTTManager mqtt(&config);
+        beginManager(mqtt, false);
+        CHECK(mqtt.connect());
+        CHECK_EQ(HostNetwork::dnsLookups, 0);
+        mqtt.disconnect();
+    });
+    return host::result(failures);
+}
@@ -0,0 +1,106 @@
+// QoS 1 delivery against the loopback broker: pipelined publishes with
+// PUBACK tracking, an unacknowledged state queued for the backlog, and
+// drained backlog records popped only once acknowledged. Answers are
+// delayed in emulated time, so the round trips cost no real time.
+#include "mqtt_test.h"
+#include "telemetry_queue.h"
+
+#define RTT_MS 20
+
+static void setupQoS1(MQTTManager& mqtt) {
+    mqtt.setQoS1(true);
+    CHECK(mqtt.begin());
+}
+
+int main() {
+    int failures = 0;
+    failures += mqtt_test::configure();
+    
+    // Pipelining: the whole cycle waits about one round trip for its acks
+    failures += host::boot(host::POWER_ON, [] {
+        ConfigManager config;
+        config.begin(false);
+        MQTTManager mqtt(&config);
+        setupQoS1(mqtt);
+        TelemetryData data;
+        mqtt_test::sampleTelemetry(data);
+        LoopbackBroker& broker = LoopbackBroker::instance();
+        broker.ackDelayMs = RTT_MS;
+        CHECK(mqtt.publishAllTelemetry(data));
+        
+        const MqttAckStats& stats = mqtt.getAckStats();
+        int qos1 = 0;
+        for (const BrokerPacket& p : broker.published()) {
+            qos1 += p.qos == 1 ? 1 : 0;
+        }
+        printf("%u QoS 1 messages, %u acked, flush waited %lu ms (sequential: %u ms)\n", stats.sent, stats.acked,
+               (unsigned long)stats.waitMs, stats.sent * RTT_MS);
+        CHECK_EQ(qos1, stats.sent);
+        CHECK_EQ(stats.acked, stats.sent);
+        CHECK_EQ(stats.unacked, 0);
+        CHECK(stats.sent > MQTT_QOS1_WINDOW);  // The window had to slide
+        CHECK(stats.waitMs <= 2 * RTT_MS);
+        CHECK_EQ(TelemetryQueue::depth(), 0);
+        host::record("sent", stats.sent);
+        host::record("waitMs", stats.waitMs);
+    });
+    
+    // No PUBACK for the state: flush times out, the reading is queued
+    failures += host::boot(host::POWER_ON, [] {
+        ConfigManager config;
+        config.begin(false);
+        MQTTManager mqtt(&config);
+        setupQoS1(mqtt);
+        TelemetryData data;
+        mqtt_test::sampleTelemetry(data);
+        LoopbackBroker::instance().dropAcks = true;
+        CHECK(mqtt.publishAllTelemetry(data));
+        CHECK_EQ(mqtt.getAckStats().acked, 0);
+        CHECK_EQ(mqtt.getLastFlushMs(), MQTT_FLUSH_TIMEOUT_MS);
+        CHECK_EQ(TelemetryQueue::depth(), 1);
+        esp_deep_sleep_start();
+    });
+    host::sleep(300);
+    
+    // Backlog: three more readings queued while the broker is away, then
+    // only the first two drained records are acknowledged
+    failures += host::boot(host::TIMER_WAKE, [] {
+        ConfigManager config;
+        config.begin(true);
+        MQTTManager mqtt(&config);
+        setupQoS1(mqtt);
+        TelemetryData data;
+        mqtt_test::sampleTelemetry(data);
+        LoopbackBroker& broker = LoopbackBroker::instance();
+        std::string backlog = "homeassistant/sensor/" + std::string(data.deviceId.c_str()) + "/backlog";
+        
+        broker.online = false;
+        for (int i = 0; i < 3; i++) {
+            data.values.set(SENSOR_BATTERY_VOLTAGE, 3.8f - 0.1f * i);
+            CHECK(!mqtt.publishAllTelemetry(data));
+        }
+        CHECK_EQ(TelemetryQueue::depth(), 4);
+        
+        broker.online = true;
+        broker.ackLimit = 2;
+        CHECK(mqtt.publishAllTelemetry(data));
+        CHECK_EQ(broker.published(backlog).size(), 4);
+        CHECK_EQ(mqtt.getAckStats().acked, 2);
+        // Records 3 and 4 stay queued, the unacknowledged state joins them
+        CHECK_EQ(TelemetryQueue::depth(), 3);
+        
+        broker.ackLimit = -1;
+        broker.clearRecords();
+        CHECK(mqtt.publishAllTelemetry(data));
+        std::vector<BrokerPacket> resent = broker.published(backlog);
+        CHECK_EQ(resent.size(), 3);
+        CHECK_EQ(TelemetryQueue::depth(), 0);
+        if (resent.size() == 3) {
+            CHECK(resent[0].payload.find("\"battery_voltage\":3.70") != std::string::npos);
+            CHECK(resent[1].payload.find("\"battery_voltage\":3.60") != std::string::npos);
+        }
+    });
+    
+    CHECK(host::recorded("waitMs") < host::recorded("sent") * RTT_MS);
+    return host::result(failures);
+}
@@ -0,0 +1,145 @@
+// Report on change against the loopback broker: a state whose publish
+// fails or whose QoS 0 flush is not confirmed is not recorded as sent and
+// goes out again, and the bytes per wake of 48 timer wakes with a jittery
+// reading, with and without report on change, for both state layouts.
+#include "mqtt_test.h"
+#include "telemetry_queue.h"
+
+#define WAKES 48
+#define WAKE_SECONDS 300
+
+static std::string stateTopic(const TelemetryData& data, const char* key) {
+    return "homeassistant/sensor/" + std::string(data.deviceId.c_str()) + "/" + key + "/state";
+}
+
+static int countStates(const TelemetryData& data) {
+    int states = 0;
+    std::string prefix = "homeassistant/sensor/" + std::string(data.deviceId.c_str()) + "/";
+    for (const BrokerPacket& p : LoopbackBroker::instance().published(prefix)) {
+        states += p.topic.size() > 6 && p.topic.compare(p.topic.size() - 6, 6, "/state") == 0 ? 1 : 0;
+    }
+    return states;
+}
+
+static void beginManager(MQTTManager& mqtt, bool combined, bool reportOnChange) {
+    mqtt.setCombinedState(combined);
+    mqtt.setReportOnChange(reportOnChange);
+    CHECK(mqtt.begin());
+}
+
+// A battery device between wakes: slow discharge, noisy RSSI and timings
+static void jitteryReading(TelemetryData& data, int wake) {
+    uint32_t seed = 2166136261u ^ (uint32_t)wake;
+    auto noise = [&seed](float range) {
+        seed = seed * 1664525u + 1013904223u;
+        return ((seed >> 8) / 16777216.0f * 2.0f - 1.0f) * range;
+    };
+    mqtt_test::sampleTelemetry(data, 3.92f - 0.0008f * wake + noise(0.01f));
+    data.values.set(SENSOR_WIFI_SIGNAL, (int)lroundf(-61 + noise(4.0f)));
+    data.values.set(SENSOR_LOOP_TIME, 1.84f + noise(0.15f));
+    data.values.set(SENSOR_LOOP_TIME_WIFI, 1.12f + noise(0.2f));
+    data.values.set(SENSOR_FREE_HEAP, (int)(180000 + noise(3000.0f)));
+    data.values.set(SENSOR_MQTT_FLUSH_TIME, (int)(21 + noise(15.0f)));
+}
+
+// WAKES timer wakes after a cold boot; records the average bytes and
+// state publishes of a wake
+static void simulateWakes(const char* name, bool combined, bool reportOnChange) {
+    int failures = host::boot(host::POWER_ON, [=] {
+        ConfigManager config;
+        config.begin(false);
+        MQTTManager mqtt(&config);
+        beginManager(mqtt, combined, reportOnChange);
+        TelemetryData data;
+        jitteryReading(data, 0);
+        CHECK(mqtt.publishAllTelemetry(data));
+        esp_deep_sleep_start();
+    });
+    uint32_t bytes = 0;
+    uint32_t states = 0;
+    for (int wake = 1; wake <= WAKES; wake++) {
+        host::sleep(WAKE_SECONDS);
+        failures += host::boot(host::TIMER_WAKE, [=] {
+            ConfigManager config;
+            config.begin(true);
+            MQTTManager mqtt(&config);
+            beginManager(mqtt, combined, reportOnChange);
+            TelemetryData data;
+            jitteryReading(data, wake);
+            LoopbackBroker::instance().clearRecords();
+            CHECK(mqtt.publishAllTelemetry(data));
+            host::record("bytes", LoopbackBroker::instance().clientBytes());
+            host::record("states", countStates(data));
+            esp_deep_sleep_start();
+        });
+        bytes += (uint32_t)host::recorded("bytes");
+        states += (uint32_t)host::recorded("states");
+    }
+    CHECK_EQ(failures, 0);
+    printf("%-30s %4u bytes per wake, %3u state publishes in %d wakes\n", name, bytes / WAKES, states, WAKES);
+    host::record(name, bytes / WAKES);
+}
+
+int main() {
+    int failures = 0;
+    failures += mqtt_test::configure();
+    
+    // A state whose write fails is not recorded: only it goes out again
+    failures += host::boot(host::POWER_ON, [] {
+        ConfigManager config;
+        config.begin(false);
+        MQTTManager mqtt(&config);
+        beginManager(mqtt, false, true);
+        TelemetryData data;
+        mqtt_test::sampleTelemetry(data);
+        LoopbackBroker& broker = LoopbackBroker::instance();
+        std::string signal = stateTopic(data, "wifi_signal");
+        
+        broker.failTopic = signal;
+        CHECK(mqtt.publishAllTelemetry(data));
+        CHECK_EQ(broker.published(signal).size(), 0);
+        CHECK(countStates(data) > 1);
+        
+        broker.failTopic.clear();
+        broker.clearRecords();
+        CHECK(mqtt.publishAllTelemetry(data));
+        CHECK_EQ(countStates(data), 1);
+        CHECK_EQ(broker.published(signal).size(), 1);
+    });
+    
+    // QoS 0 flush not confirmed: the reading is queued and nothing is
+    // recorded as sent, so the next cycle sends the same values again
+    failures += host::boot(host::POWER_ON, [] {
+        ConfigManager config;
+        config.begin(false);
+        MQTTManager mqtt(&config);
+        beginManager(mqtt, false, true);
+        TelemetryData data;
+        mqtt_test::sampleTelemetry(data);
+        LoopbackBroker& broker = LoopbackBroker::instance();
+        std::string voltage = stateTopic(data, "battery_voltage");
+        
+        broker.respondPing = false;
+        CHECK(mqtt.publishAllTelemetry(data));
+        CHECK_EQ(TelemetryQueue::depth(), 1);
+        
+        broker.respondPing = true;
+        broker.clearRecords();
+        CHECK(mqtt.publishAllTelemetry(data));
+        CHECK_EQ(broker.published(voltage).size(), 1);
+        CHECK_EQ(TelemetryQueue::depth(), 0);
+        
+        // Confirmed this time
+        broker.clearRecords();
+        CHECK(mqtt.publishAllTelemetry(data));
+        CHECK_EQ(broker.published(voltage).size(), 0);
+    });
+    
+    simulateWakes("per-sensor, every value", false, false);
+    simulateWakes("per-sensor, report on change", false, true);
+    simulateWakes("combined, every wake", true, false);
+    simulateWakes("combined, report on change", true, true);
+    CHECK(host::recorded("per-sensor, report on change") < host::recorded("per-sensor, every value"));
+    CHECK(host::recorded("combined, report on change") < host::recorded("combined, every wake"));
+    return host::result(failures);
+}
@@ -0,0 +1,112 @@
+// State publishing against the loopback broker: the combined state object
+// must parse back to exactly the values the cycle set (numbers, escaped
+// text, the nvs_writes attributes object), and its wire cost is compared
+// with the per-sensor state topics for the same reading. Prints packets and
+// bytes (whole MQTT packets) of the state messages for both modes.
+#include "mqtt_test.h"
+
+// Application TEXT sensor whose value needs JSON escaping
+static const SensorDescriptor kNote = {"note", "Note", "", "", 0, SENSOR_TEXT, NAN, 0.0f, 0, false};
+static const char* kNoteValue = "say \"hi\" \\ tab\there";
+
+// One cold-boot publishAllTelemetry() with the given state mode; records
+// the state messages' packet count and bytes under name
+static void publishCycle(const char* name, bool combined) {
+    int noteId = SensorRegistry::add(kNote);
+    CHECK(noteId >= 0);
+    ConfigManager config;
+    config.begin(false);
+    MQTTManager mqtt(&config);
+    mqtt.setCombinedState(combined);
+    CHECK(mqtt.begin());
+    
+    TelemetryData data;
+    mqtt_test::sampleTelemetry(data);
+    data.values.setText(noteId, kNoteValue);
+    LoopbackBroker::instance().reset();
+    CHECK(mqtt.publishAllTelemetry(data));
+    
+    std::string prefix = std::string("homeassistant/sensor/") + data.deviceId.c_str() + "/";
+    std::vector<BrokerPacket> state;
+    for (const BrokerPacket& p : LoopbackBroker::instance().published(prefix)) {
+        const std::string& topic = p.topic;
+        bool isState = topic.size() >= 6 && topic.compare(topic.size() - 6, 6, "/state") == 0;
+        bool isAttributes = topic.size() >= 11 && topic.compare(topic.size() - 11, 11, "/attributes") == 0;
+        if (isState || isAttributes) {
+            state.push_back(p);
+        }
+    }
+    
+    printf("%-10s %3u packets %6u bytes\n", name, (unsigned)state.size(), mqtt_test::totalSize(state));
+    host::record((std::string(name) + ".packets").c_str(), state.size());
+    host::record((std::string(name) + ".bytes").c_str(), mqtt_test::totalSize(state));
+    
+    if (!combined) {
+        // Every value on its own retained topic, verbatim
+        for (const BrokerPacket& p : state) {
+            if (p.topic == prefix + "note/state") {
+                CHECK(p.payload == kNoteValue);
+            }
+            CHECK(p.retain);
+        }
+        return;
+    }
+    
+    CHECK_EQ(state.size(), 1);
+    if (state.size() != 1) {
+        return;
+    }
+    CHECK(state[0].topic == prefix + "state");
+    CHECK(state[0].retain);
+    bool ok = false;
+    std::map<std::string, std::string> members = mqtt_test::parseObject(state[0].payload, ok);
+    CHECK(ok);
+    
+    // Every set value is a member with the formatted value; nothing else
+    // except the attributes object and the manager's own sensors
+    for (int id = 0; id < SensorRegistry::count(); id++) {
+        const SensorDescriptor& sensor = SensorRegistry::get(id);
+        if (!data.values.has(id)) {
+            continue;
+        }
+        auto member = members.find(sensor.key);
+        CHECK(member != members.end());
+        if (member == members.end()) {
+            continue;
+        }
+        CHECK(member->second == data.values.get(id));
+        if (sensor.format == SENSOR_NUMBER) {
+            char* end = nullptr;
+            strtod(member->second.c_str(), &end);
+            CHECK(end != nullptr && *end == '\0');  // A bare JSON number
+        }
+    }
+    CHECK(members["note"] == kNoteValue);
+    CHECK(members["wifi_bssid"] == "02:11:22:33:44:55");
+    CHECK(members["battery_voltage"] == "3.92");
+    CHECK(members["nvs_writes_attrs"] == data.nvsWearJson.c_str());
+    bool attrsOk = false;
+    std::map<std::string, std::string> attrs = mqtt_test::parseObject(members["nvs_writes_attrs"], attrsOk);
+    CHECK(attrsOk);
+    CHECK(attrs["cfg_record"] == "3");
+    for (const auto& member : members) {
+        int id = SensorRegistry::find(member.first.c_str());
+        CHECK(id >= 0 || member.first == "nvs_writes_attrs");
+    }
+}
+
+int main() {
+    int failures = 0;
+    failures += mqtt_test::configure();
+    
+    failures += host::boot(host::POWER_ON, [] {
+        publishCycle("combined", true);
+    });
+    failures += host::boot(host::POWER_ON, [] {
+        publishCycle("per-sensor", false);
+    });
+    
+    CHECK_EQ(host::recorded("combined.packets"), 1);
+    CHECK(host::recorded("combined.bytes") < host::recorded("per-sensor.bytes"));
+    return host::result(failures);
+}
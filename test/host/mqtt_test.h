@@ -0,0 +1,159 @@
+// Shared setup for the MQTT host tests: a configured device, a typical
+// telemetry reading and a small JSON reader for what the broker received.
+#pragma once
+
+#include <map>
+#include <string>
+#include "host_test.h"
+#include "loopback_broker.h"
+#include "config_manager.h"
+#include "mqtt_manager.h"
+
+namespace mqtt_test {
+
+// Erase flash and store WiFi credentials and the broker in one boot
+inline int configure(const char* broker = "mqtt://10.0.0.2:1883") {
+    host::eraseFlash();
+    return host::boot(host::POWER_ON, [broker] {
+        ConfigManager config;
+        config.begin(false);
+        config.beginTransaction();
+        config.setWiFiCredentials("HomeNetwork", "correct horse battery");
+        config.setFriendlyName("Garden Sensor");
+        config.setMQTTConfig(broker, "sensor", "secret");
+        config.setConfigured(true);
+        CHECK(config.commitTransaction());
+    });
+}
+
+// The built-in sensors of a battery wake, as startup_helpers collects them
+inline void sampleTelemetry(TelemetryData& data, float batteryVoltage = 3.92f) {
+    data.deviceId = DeviceIdentity::getDeviceId();
+    data.deviceName = "Garden Sensor";
+    data.modelName = "ESP32 Dev";
+    data.wakeReason = WAKEUP_TIMER;
+    data.values.set(SENSOR_BATTERY_VOLTAGE, batteryVoltage);
+    data.values.set(SENSOR_BATTERY_PERCENTAGE, 78);
+    data.values.set(SENSOR_LOOP_TIME, 1.84f);
+    data.values.set(SENSOR_WIFI_SIGNAL, -61);
+    data.values.setText(SENSOR_WIFI_BSSID, "02:11:22:33:44:55");
+    data.values.set(SENSOR_LOOP_TIME_WIFI, 1.12f);
+    data.values.set(SENSOR_FREE_HEAP, 180000);
+    data.values.set(SENSOR_NVS_WRITES, 12);
+    data.values.set(SENSOR_MQTT_FLUSH_TIME, 21);
+    data.nvsWearJson = "{\"cfg_record\":3,\"wifi_ch\":2,\"counters\":7}";
+}
+
+// Bytes of the packets in a list (whole MQTT packets, headers included)
+inline uint32_t totalSize(const std::vector<BrokerPacket>& packets) {
+    uint32_t total = 0;
+    for (const BrokerPacket& p : packets) {
+        total += p.size;
+    }
+    return total;
+}
+
+// Members of a JSON object: strings unescaped, numbers and nested
+// objects/arrays as their raw text. ok is false on malformed input.
+inline std::map<std::string, std::string> parseObject(const std::string& json, bool& ok) {
+    std::map<std::string, std::string> members;
+    size_t pos = 0;
+    ok = false;
+    auto skipSpace = [&] {
+        while (pos < json.size() && isspace((unsigned char)json[pos])) {
+            pos++;
+        }
+    };
+    auto readString = [&](std::string& out) {
+        if (pos >= json.size() || json[pos] != '"') {
+            return false;
+        }
+        for (pos++; pos < json.size() && json[pos] != '"'; pos++) {
+            char c = json[pos];
+            if (c == '\\') {
+                if (++pos >= json.size()) {
+                    return false;
+                }
+                c = json[pos];
+                if (c == 'u') {
+                    if (pos + 4 >= json.size()) {
+                        return false;
+                    }
+                    c = (char)strtol(json.substr(pos + 1, 4).c_str(), nullptr, 16);
+                    pos += 4;
+                } else if (c == 'n') {
+                    c = '\n';
+                } else if (c == 't') {
+                    c = '\t';
+                }
+            }
+            out += c;
+        }
+        return pos++ < json.size();
+    };
+    auto readRaw = [&](std::string& out) {
+        int depth = 0;
+        bool inString = false;
+        size_t start = pos;
+        for (; pos < json.size(); pos++) {
+            char c = json[pos];
+            if (inString) {
+                if (c == '\\') {
+                    pos++;
+                } else if (c == '"') {
+                    inString = false;
+                }
+            } else if (c == '"') {
+                inString = true;
+            } else if (c == '{' || c == '[') {
+                depth++;
+            } else if (c == '}' || c == ']') {
+                if (depth == 0) {
+                    break;
+                }
+                depth--;
+            } else if (c == ',' && depth == 0) {
+                break;
+            }
+        }
+        out = json.substr(start, pos - start);
+        return !out.empty() && depth == 0 && !inString;
+    };
+    
+    skipSpace();
+    if (pos >= json.size() || json[pos++] != '{') {
+        return members;
+    }
+    skipSpace();
+    if (pos < json.size() && json[pos] == '}') {
+        ok = ++pos == json.size();
+        return members;
+    }
+    while (pos < json.size()) {
+        std::string key;
+        std::string value;
+        skipSpace();
+        if (!readString(key)) {
+            return members;
+        }
+        skipSpace();
+        if (pos >= json.size() || json[pos++] != ':') {
+            return members;
+        }
+        skipSpace();
+        if (!(json[pos] == '"' ? readString(value) : readRaw(value))) {
+            return members;
+        }
+        members[key] = value;
+        skipSpace();
+        if (pos < json.size() && json[pos] == ',') {
+            pos++;
+            continue;
+        }
+        ok = pos < json.size() && json[pos] == '}' && pos + 1 == json.size();
+        return members;
+    }
+    return members;
+}
+
+}  // namespace mqtt_test
@@ -0,0 +1,109 @@
+// MqttTlsClient over the mbedtls stand-in (HostTls). Built twice: as
+// mqtt_tls_test with the firmware defaults - no MQTT_TLS_CA_CERT, so
+// mqtts:// must be refused before any handshake - and as
+// mqtt_tls_insecure_test with MQTT_TLS_INSECURE, where the session is kept
+// in RTC memory, resumed on the next wake, and dropped when it does not fit,
+// and the MqttAsync task stack left after a TLS connect is reported.
+#include "mqtt_test.h"
+#include "telemetry_queue.h"
+#include "mqtt_async.h"
+#include <chrono>
+#include <thread>
+
+int main() {
+    int failures = 0;
+    failures += mqtt_test::configure("mqtts://broker.home.lan");
+
+#if !MQTT_TLS_INSECURE
+    // Fail closed: no connection, no handshake, the reading is queued
+    failures += host::boot(host::POWER_ON, [] {
+        ConfigManager config;
+        config.begin(false);
+        MQTTManager mqtt(&config);
+        CHECK(mqtt.begin());
+        CHECK(!mqtt.connect());
+        CHECK_EQ(HostTls::handshakes, 0);
+        CHECK_EQ(HostTls::verifyFailures, 0);
+        TelemetryData data;
+        mqtt_test::sampleTelemetry(data);
+        CHECK(!mqtt.publishAllTelemetry(data));
+        CHECK_EQ(LoopbackBroker::instance().published().size(), 0);
+        CHECK_EQ(TelemetryQueue::depth(), 1);
+    });
+#else
+    // Full handshake, session saved
+    failures += host::boot(host::POWER_ON, [] {
+        ConfigManager config;
+        config.begin(false);
+        MQTTManager mqtt(&config);
+        CHECK(mqtt.begin());
+        TelemetryData data;
+        mqtt_test::sampleTelemetry(data);
+        CHECK(mqtt.publishAllTelemetry(data));
+        CHECK_EQ(HostTls::handshakes, 1);
+        CHECK(!mqtt.getTlsStats().lastResumed);
+        esp_deep_sleep_start();
+    });
+    host::sleep(300);
+    
+    // Timer wake: the saved session is resumed; this one does not fit
+    failures += host::boot(host::TIMER_WAKE, [] {
+        ConfigManager config;
+        config.begin(true);
+        MQTTManager mqtt(&config);
+        CHECK(mqtt.begin());
+        TelemetryData data;
+        mqtt_test::sampleTelemetry(data);
+        CHECK(mqtt.publishAllTelemetry(data));
+        CHECK_EQ(HostTls::resumed, 1);
+        CHECK(mqtt.getTlsStats().lastResumed);
+        
+        HostTls::resumeSessions = false;
+        HostTls::sessionBytes = MQTT_TLS_SESSION_RTC_BYTES + 1;
+        CHECK(mqtt.publishAllTelemetry(data));
+        CHECK(!mqtt.getTlsStats().lastResumed);
+        esp_deep_sleep_start();
+    });
+    host::sleep(300);
+    
+    // Nothing was kept, so nothing is offered
+    failures += host::boot(host::TIMER_WAKE, [] {
+        ConfigManager config;
+        config.begin(true);
+        MQTTManager mqtt(&config);
+        CHECK(mqtt.begin());
+        CHECK(mqtt.connect());
+        CHECK_EQ(HostTls::resumed, 0);
+        CHECK_EQ(HostTls::handshakes, 1);
+        mqtt.disconnect();
+        esp_deep_sleep_start();
+    });
+    host::sleep(300);
+    
+    // The handshake on the async task: its stack with TLS compiled in
+    failures += host::boot(host::TIMER_WAKE, [] {
+        ConfigManager config;
+        config.begin(true);
+        MQTTManager mqtt(&config);
+        CHECK(mqtt.begin());
+        MqttAsync async(&mqtt);
+        CHECK(async.begin());
+        TelemetryData data;
+        mqtt_test::sampleTelemetry(data);
+        uint32_t ticket = async.publishTelemetry(data);
+        for (int i = 0; i < 500 && !async.isComplete(ticket); i++) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        CHECK(async.isComplete(ticket));
+        CHECK(async.waitIdle());
+        MqttAsyncStats stats = async.getStats();
+        CHECK_EQ(stats.failed, 0);
+        CHECK(HostTls::handshakes + HostTls::resumed > 0);
+        printf("MQTT task stack with TLS: %u of %u bytes left (mbedtls stand-in)\n", stats.stackFreeBytes,
+               MQTT_ASYNC_STACK_SIZE);
+        CHECK(stats.stackFreeBytes > 0);
+        esp_deep_sleep_start();
+    });
+#endif
+    return host::result(failures);
+}
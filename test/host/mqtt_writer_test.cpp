@@ -0,0 +1,149 @@
+// MqttWriter (bounded builder: numbers, JSON escaping, overflow and the
+// sizing pass) and the heap use of a telemetry cycle. While a cycle runs,
+// operator new counts the allocations the firmware makes; the stand-ins'
+// own ones (loopback socket, PubSubClient) are not counted (host::StandIn).
+// A cycle without discovery must not allocate at all, device discovery
+// exactly once (its exactly-sized payload buffer).
+#include <cstdlib>
+#include <new>
+#include "mqtt_test.h"
+
+static bool s_counting = false;
+static int s_allocations = 0;
+
+void* operator new(size_t size) {
+    if (s_counting && host::StandIn::depth == 0) {
+        s_allocations++;
+    }
+    void* p = malloc(size ? size : 1);
+    if (p == nullptr) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void operator delete(void* p) noexcept {
+    free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+    free(p);
+}
+
+// Firmware allocations of one publishAllTelemetry()
+static int cycleAllocations(MQTTManager& mqtt, const TelemetryData& data) {
+    s_allocations = 0;
+    s_counting = true;
+    bool published = mqtt.publishAllTelemetry(data);
+    s_counting = false;
+    CHECK(published);
+    return s_allocations;
+}
+
+// Discovery, then a cycle with changed values, in the given modes
+static void measure(const char* name, bool combined, bool deviceDiscovery, bool qos1) {
+    ConfigManager config;
+    config.begin(false);
+    MQTTManager mqtt(&config);
+    mqtt.setCombinedState(combined);
+    mqtt.setDeviceDiscovery(deviceDiscovery);
+    mqtt.setQoS1(qos1);
+    CHECK(mqtt.begin());
+    TelemetryData data;
+    mqtt_test::sampleTelemetry(data);
+    int discovery = cycleAllocations(mqtt, data);
+    mqtt_test::sampleTelemetry(data, 3.71f);
+    data.values.set(SENSOR_WIFI_SIGNAL, -70);
+    int telemetry = cycleAllocations(mqtt, data);
+    printf("%-22s discovery cycle %2d allocations, telemetry cycle %2d\n", name, discovery, telemetry);
+    CHECK_EQ(discovery, deviceDiscovery ? 1 : 0);
+    CHECK_EQ(telemetry, 0);
+}
+
+int main() {
+    int failures = 0;
+    
+    // Numbers are formatted in place
+    {
+        MqttBuffer<64> out;
+        out.appendInt(-61);
+        out.append(' ');
+        out.appendUInt(4294967295UL);
+        out.append(' ');
+        out.appendFloat(3.92f, 2);
+        out.append(' ');
+        out.appendFloat(1.25f, 1);
+        out.append(' ');
+        out.appendFloat(180000.0f, 0);
+        CHECK(strcmp(out.c_str(), "-61 4294967295 3.92 1.3 180000") == 0);
+    }
+    
+    // Floats beyond a uint64_t once scaled are null, like NaN and infinity
+    {
+        MqttBuffer<64> out;
+        out.appendFloat(1e20f, 0);
+        out.append(' ');
+        out.appendFloat(-1e20f, 2);
+        out.append(' ');
+        out.appendFloat(1e14f, 6);
+        out.append(' ');
+        out.appendFloat(NAN, 2);
+        out.append(' ');
+        out.appendFloat(1e18f, 0);
+        CHECK(strcmp(out.c_str(), "null null null null 999999984306749440") == 0);
+    }
+    
+    // JSON members: comma after the first, strings escaped
+    {
+        MqttBuffer<128> out;
+        out.beginObject();
+        out.jsonString("text", "a\"b\\c\x01");
+        out.jsonKey("n");
+        out.appendInt(7);
+        out.endObject();
+        CHECK(strcmp(out.c_str(), "{\"text\":\"a\\\"b\\\\c\\u0001\",\"n\":7}") == 0);
+        bool ok = false;
+        std::map<std::string, std::string> members = mqtt_test::parseObject(out.c_str(), ok);
+        CHECK(ok);
+        CHECK(members["text"] == "a\"b\\c\x01");
+    }
+    
+    // Overflow: output is cut and terminated, requiredSize() keeps counting
+    {
+        MqttBuffer<8> out;
+        out.append("homeassistant");
+        CHECK(out.overflow());
+        CHECK_EQ(out.length(), 7);
+        CHECK(strcmp(out.c_str(), "homeass") == 0);
+        CHECK_EQ(out.requiredSize(), 14);
+        out.clear();
+        out.append("ok");
+        CHECK(!out.overflow());
+        CHECK(strcmp(out.c_str(), "ok") == 0);
+    }
+    
+    // Sizing pass without a buffer
+    {
+        MqttWriter sizing(nullptr, 0);
+        sizing.beginObject();
+        sizing.jsonString("key", "value");
+        sizing.endObject();
+        CHECK_EQ(sizing.requiredSize(), strlen("{\"key\":\"value\"}") + 1);
+    }
+    
+    // Heap use of whole cycles, every boot starting without discovery
+    failures += mqtt_test::configure();
+    failures += host::boot(host::POWER_ON, [] {
+        measure("combined", true, false, false);
+    });
+    failures += host::boot(host::POWER_ON, [] {
+        measure("per-sensor", false, false, false);
+    });
+    failures += host::boot(host::POWER_ON, [] {
+        measure("combined, device disc.", true, true, false);
+    });
+    failures += host::boot(host::POWER_ON, [] {
+        measure("combined, QoS 1", true, false, true);
+    });
+    return host::result(failures);
+}
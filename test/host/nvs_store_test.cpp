@@ -0,0 +1,117 @@
+// NvsStore: write-if-changed, the entry cost model against the NVS
+// emulator, and the wear counter table (eviction, flush policy, bounded
+// JSON).
+#include "host_test.h"
+#include "nvs_store.h"
+
+static const char* kKeys[] = {"key_a", "key_b", "key_c", "key_d", "key_e", "key_f", "key_g", "key_h", "key_i"};
+
+int main() {
+    int failures = 0;
+    host::eraseFlash();
+    
+    // Write-if-changed and the entry cost model
+    failures += host::boot(host::POWER_ON, [] {
+        NvsStore store;
+        CHECK(store.begin("test", false));
+        uint8_t blob[100];
+        memset(blob, 0x42, sizeof(blob));
+        
+        NvsFlash::instance().resetStats();
+        store.putBytes("blob", blob, sizeof(blob));
+        CHECK_EQ(store.getCounters().entriesWritten, NvsFlash::instance().stats().entriesWritten);
+        CHECK_EQ(NvsStore::entrySpan(sizeof(blob)), 6);  // Header, 4 data entries, index
+        
+        NvsFlash::instance().resetStats();
+        store.putUChar("u8", 7);
+        CHECK_EQ(NvsFlash::instance().stats().entriesWritten, NvsStore::entrySpan(0));
+        
+        NvsFlash::instance().resetStats();
+        store.putUChar("u8", 7);
+        store.putBytes("blob", blob, 32);  // Different length: written
+        store.putBytes("blob", blob, 32);  // Same value: skipped
+        CHECK_EQ(store.getCounters().skippedWrites, 2);
+        CHECK_EQ(NvsFlash::instance().stats().writes, 1);
+        store.end();
+    });
+    
+    // Counting alone never touches NVS; a flush writes the table once
+    failures += host::boot(host::POWER_ON, [] {
+        NvsStore store;
+        store.begin("test", false);
+        uint32_t before = NvsStore::getTotalWrites();
+        NvsFlash::instance().resetStats();
+        for (uint8_t i = 0; i < 20; i++) {
+            store.putUChar("counter", i);
+        }
+        CHECK_EQ(NvsFlash::instance().stats().writes, 20);
+        CHECK_EQ(NvsStore::getTotalWrites(), before + 20);
+        
+        NvsStore::flushWearCounters();  // First flush also creates the nvs_wear namespace
+        store.putUChar("counter", 99);
+        NvsFlash::instance().resetStats();
+        NvsStore::flushWearCounters();
+        CHECK_EQ(NvsFlash::instance().stats().writes, 1);
+        CHECK(NvsFlash::instance().stats().entriesWritten <= 7);
+        NvsStore::flushWearCounters();  // Nothing new counted
+        CHECK_EQ(NvsFlash::instance().stats().writes, 1);
+        host::record("total", NvsStore::getTotalWrites());
+        store.end();
+    });
+    
+    // Power-on: RTC copy gone, the flushed table is reloaded
+    failures += host::boot(host::POWER_ON, [] {
+        CHECK_EQ(NvsStore::getTotalWrites(), host::recorded("total"));
+        char json[NVS_WEAR_JSON_MAX_SIZE];
+        CHECK(NvsStore::getWearJSON(json, sizeof(json)) > 0);
+        CHECK(strstr(json, "\"counter\":21") != nullptr);
+        CHECK(strstr(json, "\"counters\":2") != nullptr);
+    });
+    
+    // Full table: the least written key is folded into "other", the total
+    // stays exact and the JSON stays within NVS_WEAR_JSON_MAX_SIZE
+    failures += host::boot(host::POWER_ON, [] {
+        NvsStore store;
+        store.begin("test", false);
+        uint32_t before = NvsStore::getTotalWrites();
+        for (const char* key : kKeys) {
+            store.putUChar(key, 1);
+            store.putUChar(key, 2);
+        }
+        for (uint8_t i = 0; i < 3; i++) {
+            store.putUChar("key_i", 10 + i);
+        }
+        CHECK_EQ(NvsStore::getTotalWrites(), before + 2 * 9 + 3);
+        
+        char json[NVS_WEAR_JSON_MAX_SIZE];
+        size_t length = NvsStore::getWearJSON(json, sizeof(json));
+        CHECK(length > 0 && length < sizeof(json));
+        CHECK(strstr(json, "\"key_i\":5") != nullptr);
+        CHECK(strstr(json, "\"other\":") != nullptr);
+        CHECK_EQ(json[length - 1], '}');
+        
+        char small[16];
+        CHECK_EQ(NvsStore::getWearJSON(small, sizeof(small)), 0);
+        store.end();
+    });
+    
+    // Worst case for the JSON size: NVS_WEAR_MAX_KEYS keys of 15
+    // characters with five-digit counts, plus "other"
+    failures += host::boot(host::POWER_ON, [] {
+        NvsStore store;
+        store.begin("test", false);
+        char key[16];
+        for (uint8_t k = 0; k <= NVS_WEAR_MAX_KEYS; k++) {
+            snprintf(key, sizeof(key), "long_key_name_%u", k);
+            for (uint32_t i = 0; i < 10000 + k; i++) {
+                store.putUChar(key, (uint8_t)(i & 1));
+            }
+        }
+        char json[NVS_WEAR_JSON_MAX_SIZE];
+        CHECK(NvsStore::getWearJSON(json, sizeof(json)) > 0);
+        CHECK(strstr(json, "\"long_key_name_8\":10008") != nullptr);
+        store.end();
+    });
+    
+    return host::result(failures);
+}
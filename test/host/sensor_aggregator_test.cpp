@@ -0,0 +1,73 @@
+// SensorAggregator: the RunningStats mean over long windows of a large
+// value (barometric pressure at 10 Hz) against the exact mean, next to
+// what the same Welford update gives in a float, and a flushed window.
+#include <cmath>
+#include "host_test.h"
+#include "sensor_aggregator.h"
+
+#define SAMPLE_HZ 10
+
+// Pressure around 101325 Pa: a slow weather drift plus sensor noise
+static float pressureSample(uint32_t i, uint32_t& seed) {
+    seed = seed * 1664525u + 1013904223u;
+    float noise = ((seed >> 8) / 16777216.0f * 2.0f - 1.0f) * 8.0f;
+    return 101325.0f + 120.0f * (float)sin(i / (SAMPLE_HZ * 3600.0 * 6.0)) + noise;
+}
+
+// Mean error of one window in Pa, and of the old float mean
+static void measureWindow(const char* name, uint32_t seconds, double maxError) {
+    RunningStats stats;
+    float floatMean = 0.0f;
+    long double sum = 0.0L;
+    uint32_t seed = 1;
+    uint32_t samples = seconds * SAMPLE_HZ;
+    for (uint32_t i = 0; i < samples; i++) {
+        float value = pressureSample(i, seed);
+        stats.add(value);
+        floatMean = i == 0 ? value : floatMean + (value - floatMean) / (float)(i + 1);
+        sum += value;
+    }
+    double exact = (double)(sum / samples);
+    double error = fabs(stats.mean - exact);
+    printf("%-14s %7u samples: mean off by %.2g Pa (float: %.3f Pa)\n", name, samples, error,
+           fabs((double)floatMean - exact));
+    CHECK_EQ(stats.count, samples);
+    CHECK(error < maxError);
+}
+
+int main() {
+    int failures = 0;
+    host::eraseFlash();
+    
+    measureWindow("one minute", 60, 0.001);
+    measureWindow("one hour", 3600, 0.001);
+    measureWindow("one day", 86400, 0.001);
+    
+    // A flushed window: last sample, statistics, then an empty window
+    failures += host::boot(host::POWER_ON, [] {
+        static const SensorDescriptor kPressure = {
+            "pressure", "Pressure", "atmospheric_pressure", "Pa", 1, SENSOR_NUMBER, NAN, 5.0f, 0, false
+        };
+        int id = SensorRegistry::add(kPressure);
+        CHECK(SensorAggregator::track(id));
+        const float samples[] = {101320.0f, 101330.5f, NAN, 101325.5f};
+        for (float sample : samples) {
+            SensorAggregator::add(id, sample);
+        }
+        CHECK_EQ(SensorAggregator::samples(id), 3);
+        
+        SensorValues values;
+        CHECK_EQ(SensorAggregator::flush(values), 3);
+        CHECK(strcmp(values.get(id), "101325.5") == 0);
+        CHECK(strcmp(values.get(SensorRegistry::find("pressure_min")), "101320.0") == 0);
+        CHECK(strcmp(values.get(SensorRegistry::find("pressure_max")), "101330.5") == 0);
+        CHECK(strcmp(values.get(SensorRegistry::find("pressure_mean")), "101325.3") == 0);
+        CHECK(strcmp(values.get(SensorRegistry::find("pressure_count")), "3") == 0);
+        
+        SensorValues empty;
+        CHECK_EQ(SensorAggregator::flush(empty), 0);
+        CHECK(!empty.has(id));
+        CHECK(!empty.has(SensorRegistry::find("pressure_mean")));
+    });
+    return host::result(failures);
+}
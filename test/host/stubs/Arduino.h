@@ -0,0 +1,238 @@
+// Host stand-in for the ESP32 Arduino core: just enough of String, Print,
+// timing and the ESP object to compile common/src on Linux.
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdarg>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <string>
+
+// RTC slow memory: collected in one linker section so the boot emulator
+// (host_test.cpp) can keep it across simulated deep sleep and clear it on
+// power-on, like the chip does
+#define RTC_DATA_ATTR __attribute__((section("rtc_data"), used))
+#define RTC_NOINIT_ATTR RTC_DATA_ATTR
+#define IRAM_ATTR
+#define PROGMEM
+#define F(x) x
+
+#define HEX 16
+#define DEC 10
+#define HIGH 1
+#define LOW 0
+#define INPUT 0
+#define OUTPUT 1
+#define INPUT_PULLUP 2
+#define U_FLASH 0
+
+#define ESP_ARDUINO_VERSION_VAL(major, minor, patch) ((major) * 10000 + (minor) * 100 + (patch))
+#define ESP_ARDUINO_VERSION ESP_ARDUINO_VERSION_VAL(3, 3, 2)
+
+typedef bool boolean;
+typedef uint8_t byte;
+
+class String {
+public:
+    String() {}
+    String(const char* value) : _s(value ? value : "") {}
+    String(const std::string& value) : _s(value) {}
+    String(char value) : _s(1, value) {}
+    String(int value, unsigned char base = 10) { setNumber(value, base); }
+    String(unsigned int value, unsigned char base = 10) { setNumber(value, base); }
+    String(long value, unsigned char base = 10) { setNumber(value, base); }
+    String(unsigned long value, unsigned char base = 10) { setNumber(value, base); }
+    String(unsigned char value, unsigned char base = 10) { setNumber(value, base); }
+    String(float value, unsigned int decimals = 2) { setFloat(value, decimals); }
+    String(double value, unsigned int decimals = 2) { setFloat(value, decimals); }
+    
+    unsigned int length() const { return _s.size(); }
+    const char* c_str() const { return _s.c_str(); }
+    bool reserve(unsigned int size) { _s.reserve(size); return true; }
+    bool isEmpty() const { return _s.empty(); }
+    
+    String& operator+=(const String& other) { _s += other._s; return *this; }
+    String& operator+=(const char* other) { _s += other; return *this; }
+    String& operator+=(char c) { _s += c; return *this; }
+    String& operator+=(int value) { _s += std::to_string(value); return *this; }
+    String& operator+=(unsigned int value) { _s += std::to_string(value); return *this; }
+    String& operator+=(long value) { _s += std::to_string(value); return *this; }
+    String& operator+=(unsigned long value) { _s += std::to_string(value); return *this; }
+    bool concat(const char* value, unsigned int length) { _s.append(value, length); return true; }
+    bool concat(const String& value) { _s += value._s; return true; }
+    bool concat(const char* value) { _s += value; return true; }
+    bool concat(char value) { _s += value; return true; }
+    
+    bool operator==(const String& other) const { return _s == other._s; }
+    bool operator==(const char* other) const { return _s == other; }
+    bool operator!=(const String& other) const { return _s != other._s; }
+    bool operator!=(const char* other) const { return _s != other; }
+    bool equals(const String& other) const { return _s == other._s; }
+    char operator[](unsigned int index) const { return _s[index]; }
+    char& operator[](unsigned int index) { return _s[index]; }
+    char charAt(unsigned int index) const { return _s[index]; }
+    
+    String substring(unsigned int from) const { return from >= _s.size() ? String() : String(_s.substr(from)); }
+    String substring(unsigned int from, unsigned int to) const {
+        if (from > to) std::swap(from, to);
+        return from >= _s.size() ? String() : String(_s.substr(from, to - from));
+    }
+    int indexOf(char c, unsigned int from = 0) const { return position(_s.find(c, from)); }
+    int indexOf(const String& text, unsigned int from = 0) const { return position(_s.find(text._s, from)); }
+    int lastIndexOf(char c) const { return position(_s.rfind(c)); }
+    bool startsWith(const String& prefix) const { return _s.compare(0, prefix._s.size(), prefix._s) == 0; }
+    bool endsWith(const String& suffix) const {
+        return _s.size() >= suffix._s.size() && _s.compare(_s.size() - suffix._s.size(), suffix._s.size(), suffix._s) == 0;
+    }
+    long toInt() const { return atol(_s.c_str()); }
+    float toFloat() const { return (float)atof(_s.c_str()); }
+    void replace(const String& from, const String& to) {
+        for (size_t pos = 0; (pos = _s.find(from._s, pos)) != std::string::npos; pos += to._s.size()) {
+            _s.replace(pos, from._s.size(), to._s);
+        }
+    }
+    void trim() {
+        _s.erase(_s.find_last_not_of(" \t\r\n") + 1);
+        _s.erase(0, std::min(_s.find_first_not_of(" \t\r\n"), _s.size()));
+    }
+    void toLowerCase() { for (char& c : _s) c = (char)tolower((unsigned char)c); }
+    void getBytes(unsigned char* buffer, unsigned int size) const { toCharArray((char*)buffer, size); }
+    void toCharArray(char* buffer, unsigned int size) const {
+        if (size == 0) return;
+        strncpy(buffer, _s.c_str(), size - 1);
+        buffer[size - 1] = '\0';
+    }
+    explicit operator bool() const { return true; }
+
+private:
+    std::string _s;
+    
+    static int position(size_t pos) { return pos == std::string::npos ? -1 : (int)pos; }
+    void setNumber(unsigned long value, unsigned char base) { setNumber((unsigned long long)value, base, false); }
+    void setNumber(unsigned int value, unsigned char base) { setNumber((unsigned long long)value, base, false); }
+    void setNumber(unsigned char value, unsigned char base) { setNumber((unsigned long long)value, base, false); }
+    void setNumber(long value, unsigned char base) {
+        setNumber((unsigned long long)(value < 0 ? -(long long)value : value), base, value < 0);
+    }
+    void setNumber(int value, unsigned char base) { setNumber((long)value, base); }
+    void setNumber(unsigned long long value, unsigned char base, bool negative) {
+        char buffer[70];
+        char* p = buffer + sizeof(buffer);
+        *--p = '\0';
+        do {
+            *--p = "0123456789abcdefghijklmnopqrstuvwxyz"[value % base];
+            value /= base;
+        } while (value != 0);
+        if (negative) *--p = '-';
+        _s = p;
+    }
+    void setFloat(double value, unsigned int decimals) {
+        char buffer[64];
+        snprintf(buffer, sizeof(buffer), "%.*f", decimals, value);
+        _s = buffer;
+    }
+};
+
+inline String operator+(const String& a, const String& b) { String r(a); r += b; return r; }
+inline String operator+(const String& a, const char* b) { String r(a); r += b; return r; }
+inline String operator+(const char* a, const String& b) { String r(a); r += b; return r; }
+inline String operator+(const String& a, char b) { String r(a); r += b; return r; }
+inline String operator+(const String& a, int b) { String r(a); r += b; return r; }
+
+// Timing: millis()/micros() restart at every emulated boot; delay() advances
+// them without sleeping so timeouts cost no wall-clock time
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+void yield();
+
+void pinMode(int pin, int mode);
+void digitalWrite(int pin, int value);
+int digitalRead(int pin);
+int analogRead(int pin);
+enum { ADC_11db };
+void analogSetAttenuation(int attenuation);
+
+long random(long max);
+long random(long min, long max);
+uint32_t esp_random();
+
+void disableCore0WDT();
+void enableCore0WDT();
+
+class Print {
+public:
+    virtual ~Print() {}
+    virtual size_t write(uint8_t c) = 0;
+    virtual size_t write(const uint8_t* buffer, size_t size) {
+        size_t n = 0;
+        while (size-- && write(*buffer++)) n++;
+        return n;
+    }
+    size_t write(const char* s) { return write((const uint8_t*)s, strlen(s)); }
+    size_t print(const String& s) { return write((const uint8_t*)s.c_str(), s.length()); }
+    size_t print(const char* s) { return write(s); }
+    size_t print(char c) { return write((uint8_t)c); }
+    size_t print(int value) { return print(String(value)); }
+    size_t print(unsigned int value) { return print(String(value)); }
+    size_t print(long value) { return print(String(value)); }
+    size_t print(unsigned long value) { return print(String(value)); }
+    size_t print(double value, int decimals = 2) { return print(String(value, decimals)); }
+    size_t println() { return print("\n"); }
+    size_t println(const String& s) { return print(s) + println(); }
+    size_t println(const char* s) { return print(s) + println(); }
+    size_t println(int value) { return print(value) + println(); }
+    size_t printf(const char* format, ...) __attribute__((format(printf, 2, 3)));
+};
+
+class Stream : public Print {
+public:
+    virtual int available() = 0;
+    virtual int read() = 0;
+    virtual int peek() = 0;
+    virtual void flush() {}
+    size_t readBytes(uint8_t* buffer, size_t length) {
+        size_t n = 0;
+        for (int c; n < length && (c = read()) >= 0; n++) buffer[n] = (uint8_t)c;
+        return n;
+    }
+    size_t readBytes(char* buffer, size_t length) { return readBytes((uint8_t*)buffer, length); }
+};
+
+// Serial goes to stdout; set HOST_QUIET=1 to drop the firmware's log output
+class HardwareSerial : public Stream {
+public:
+    size_t write(uint8_t c) override;
+    size_t write(const uint8_t* buffer, size_t size) override;
+    using Print::write;
+    int available() override { return 0; }
+    int read() override { return -1; }
+    int peek() override { return -1; }
+    void flush() override { fflush(stdout); }
+    void begin(unsigned long) {}
+    operator bool() const { return true; }
+};
+extern HardwareSerial Serial;
+
+class EspClass {
+public:
+    uint32_t getFreeHeap();
+    uint32_t getMaxAllocHeap();
+    uint32_t getMinFreeHeap();
+    uint32_t getHeapSize();
+    uint64_t getEfuseMac();
+    uint32_t getCpuFreqMHz();
+    void restart();
+};
+extern EspClass ESP;
+
+#include "IPAddress.h"
+#include "freertos_stubs.h"
+
+using std::max;
+using std::min;
@@ -0,0 +1,21 @@
+#pragma once
+
+#include "WiFiClient.h"
+
+#define HTTP_CODE_OK 200
+#define HTTPC_STRICT_FOLLOW_REDIRECTS 1
+
+// No HTTP on the host - every request fails
+class HTTPClient {
+public:
+    bool begin(const String& url);
+    bool begin(WiFiClient& client, const String& url);
+    bool connected();
+    int GET();
+    int getSize();
+    WiFiClient* getStreamPtr();
+    String errorToString(int error);
+    void setTimeout(uint32_t timeout);
+    void setFollowRedirects(int mode);
+    void end();
+};
@@ -0,0 +1,16 @@
+#pragma once
+
+#include <functional>
+#include "HTTPClient.h"
+
+enum HTTPUpdateResult { HTTP_UPDATE_FAILED, HTTP_UPDATE_NO_UPDATES, HTTP_UPDATE_OK };
+
+class HTTPUpdate {
+public:
+    HTTPUpdateResult update(WiFiClient& client, const String& url);
+    int getLastError();
+    String getLastErrorString();
+    void rebootOnUpdate(bool reboot);
+    void onProgress(std::function<void(int, int)> callback);
+};
+extern HTTPUpdate httpUpdate;
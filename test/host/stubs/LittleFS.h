@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstdio>
+#include "Arduino.h"
+
+#define FILE_READ "r"
+#define FILE_WRITE "w"
+#define FILE_APPEND "a"
+
+// Files live in <state dir>/littlefs (see host_test.h) and persist across
+// emulated boots like the flash partition
+class File {
+public:
+    File() {}
+    explicit File(FILE* file) : _file(file) {}
+    operator bool() const { return _file != nullptr; }
+    size_t write(const uint8_t* buffer, size_t size) { return _file ? fwrite(buffer, 1, size, _file) : 0; }
+    size_t read(uint8_t* buffer, size_t size) { return _file ? fread(buffer, 1, size, _file) : 0; }
+    bool seek(uint32_t position) { return _file && fseek(_file, position, SEEK_SET) == 0; }
+    size_t position() { return _file ? (size_t)ftell(_file) : 0; }
+    size_t size();
+    int available() { return (int)(size() - position()); }
+    void close() {
+        if (_file) fclose(_file);
+        _file = nullptr;
+    }
+
+private:
+    FILE* _file = nullptr;
+};
+
+class LittleFSFS {
+public:
+    bool begin(bool formatOnFail = false, const char* basePath = "/littlefs", uint8_t maxOpenFiles = 10,
+               const char* partitionLabel = "spiffs");
+    void end() {}
+    File open(const char* path, const char* mode = FILE_READ);
+    bool exists(const char* path);
+    bool remove(const char* path);
+    size_t totalBytes() { return 192 * 1024; }
+    size_t usedBytes();
+    
+    // Calls of open() since the start of the boot (each costs a directory lookup on flash)
+    uint32_t opens = 0;
+};
+extern LittleFSFS LittleFS;
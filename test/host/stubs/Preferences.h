@@ -0,0 +1,62 @@
+#pragma once
+
+#include "Arduino.h"
+
+// Arduino Preferences on top of the NVS emulator (nvs_emulator.h). Return
+// values and failure cases follow arduino-esp32 3.x: a read-only begin() of
+// a missing namespace fails, getBytes()/getString() into a buffer that is
+// too small return 0, a getter of the wrong type returns the default.
+class Preferences {
+public:
+    Preferences() {}
+    ~Preferences() { end(); }
+    
+    bool begin(const char* name, bool readOnly = false, const char* partitionLabel = nullptr);
+    void end();
+    
+    bool clear();
+    bool remove(const char* key);
+    
+    size_t putChar(const char* key, int8_t value);
+    size_t putUChar(const char* key, uint8_t value);
+    size_t putShort(const char* key, int16_t value);
+    size_t putUShort(const char* key, uint16_t value);
+    size_t putInt(const char* key, int32_t value);
+    size_t putUInt(const char* key, uint32_t value);
+    size_t putLong(const char* key, int32_t value);
+    size_t putULong(const char* key, uint32_t value);
+    size_t putLong64(const char* key, int64_t value);
+    size_t putULong64(const char* key, uint64_t value);
+    size_t putFloat(const char* key, float value);
+    size_t putBool(const char* key, bool value);
+    size_t putString(const char* key, const char* value);
+    size_t putString(const char* key, const String& value) { return putString(key, value.c_str()); }
+    size_t putBytes(const char* key, const void* value, size_t length);
+    
+    bool isKey(const char* key);
+    int8_t getChar(const char* key, int8_t defaultValue = 0);
+    uint8_t getUChar(const char* key, uint8_t defaultValue = 0);
+    int16_t getShort(const char* key, int16_t defaultValue = 0);
+    uint16_t getUShort(const char* key, uint16_t defaultValue = 0);
+    int32_t getInt(const char* key, int32_t defaultValue = 0);
+    uint32_t getUInt(const char* key, uint32_t defaultValue = 0);
+    int32_t getLong(const char* key, int32_t defaultValue = 0);
+    uint32_t getULong(const char* key, uint32_t defaultValue = 0);
+    int64_t getLong64(const char* key, int64_t defaultValue = 0);
+    uint64_t getULong64(const char* key, uint64_t defaultValue = 0);
+    float getFloat(const char* key, float defaultValue = NAN);
+    bool getBool(const char* key, bool defaultValue = false);
+    size_t getString(const char* key, char* value, size_t maxLength);
+    String getString(const char* key, String defaultValue = String());
+    size_t getBytesLength(const char* key);
+    size_t getBytes(const char* key, void* buffer, size_t maxLength);
+    size_t freeEntries();
+
+private:
+    bool _started = false;
+    bool _readOnly = false;
+    uint8_t _namespace = 0;
+    
+    size_t put(const char* key, uint8_t type, const void* value, size_t length);
+    bool get(const char* key, uint8_t type, void* value, size_t length);
+};
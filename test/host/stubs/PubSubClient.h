@@ -0,0 +1,65 @@
+#pragma once
+
+#include <functional>
+#include "Arduino.h"
+#include "Client.h"
+
+// PubSubClient 2.8 subset: MQTT 3.1.1, QoS 0 publish, blocking connect,
+// keepalive pings and callbacks from loop(). Speaks the real protocol over
+// the Client, so the loopback broker sees what the library would send.
+#define MQTT_MAX_HEADER_SIZE 5
+
+#define MQTT_CONNECTION_TIMEOUT -4
+#define MQTT_CONNECTION_LOST -3
+#define MQTT_CONNECT_FAILED -2
+#define MQTT_DISCONNECTED -1
+#define MQTT_CONNECTED 0
+#define MQTT_CONNECT_BAD_PROTOCOL 1
+#define MQTT_CONNECT_BAD_CLIENT_ID 2
+#define MQTT_CONNECT_UNAVAILABLE 3
+#define MQTT_CONNECT_BAD_CREDENTIALS 4
+#define MQTT_CONNECT_UNAUTHORIZED 5
+
+#define MQTT_CALLBACK_SIGNATURE std::function<void(char*, uint8_t*, unsigned int)> callback
+
+class PubSubClient {
+public:
+    PubSubClient(Client& client) : _client(&client) {}
+    
+    PubSubClient& setServer(IPAddress ip, uint16_t port);
+    PubSubClient& setServer(const char* domain, uint16_t port);
+    PubSubClient& setCallback(MQTT_CALLBACK_SIGNATURE);
+    PubSubClient& setKeepAlive(uint16_t keepAlive);
+    PubSubClient& setSocketTimeout(uint16_t timeout);
+    bool setBufferSize(uint16_t size);
+    uint16_t getBufferSize() { return _bufferSize; }
+    
+    bool connect(const char* id);
+    bool connect(const char* id, const char* user, const char* pass);
+    void disconnect();
+    bool publish(const char* topic, const char* payload);
+    bool publish(const char* topic, const char* payload, bool retained);
+    bool publish(const char* topic, const uint8_t* payload, unsigned int length, bool retained = false);
+    bool subscribe(const char* topic, uint8_t qos = 0);
+    bool loop();
+    bool connected();
+    int state() { return _state; }
+
+private:
+    Client* _client;
+    IPAddress _ip;
+    String _domain;
+    uint16_t _port = 1883;
+    uint16_t _keepAlive = 15;
+    uint16_t _socketTimeout = 15;
+    uint16_t _bufferSize = 256;
+    uint16_t _nextMsgId = 1;
+    int _state = MQTT_DISCONNECTED;
+    bool _pingOutstanding = false;
+    unsigned long _lastOutActivity = 0;
+    unsigned long _lastInActivity = 0;
+    std::function<void(char*, uint8_t*, unsigned int)> _callback;
+    
+    bool write(uint8_t header, const std::string& body);
+    bool readPacket(uint8_t& header, std::string& body);
+};
@@ -0,0 +1,21 @@
+#pragma once
+
+#include "Arduino.h"
+
+#define UPDATE_SIZE_UNKNOWN 0xFFFFFFFF
+
+// Accepts and discards firmware images
+class UpdateClass {
+public:
+    bool begin(size_t size = UPDATE_SIZE_UNKNOWN, int command = U_FLASH);
+    size_t write(uint8_t* data, size_t length);
+    size_t writeStream(Stream& stream);
+    bool end(bool evenIfRemaining = false);
+    bool hasError();
+    bool isFinished();
+    void abort();
+    uint8_t getError();
+    String errorString();
+    void printError(Print& out);
+};
+extern UpdateClass Update;
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <functional>
+#include <map>
+#include <vector>
+#include "Arduino.h"
+#include "WiFi.h"
+
+enum HTTPMethod { HTTP_ANY, HTTP_GET, HTTP_POST, HTTP_PUT, HTTP_DELETE, HTTP_PATCH };
+enum HTTPUploadStatus { UPLOAD_FILE_START, UPLOAD_FILE_WRITE, UPLOAD_FILE_END, UPLOAD_FILE_ABORTED };
+
+struct HTTPUpload {
+    HTTPUploadStatus status;
+    String filename;
+    size_t totalSize;
+    size_t currentSize;
+    uint8_t buf[1436];
+};
+
+// Response of WebServer::request()
+struct HostResponse {
+    int code = 0;
+    String contentType;
+    String body;
+};
+
+// No sockets: tests call request() on the server the firmware created
+// (WebServer::current()) and get the handler's response back
+class WebServer {
+public:
+    typedef std::function<void(void)> THandlerFunction;
+    
+    WebServer(int port = 80);
+    ~WebServer();
+    static WebServer* current();
+    
+    void begin() {}
+    void stop() {}
+    void handleClient() {}
+    void on(const String& uri, THandlerFunction handler) { on(uri, HTTP_ANY, handler); }
+    void on(const String& uri, HTTPMethod method, THandlerFunction handler);
+    void on(const String& uri, HTTPMethod method, THandlerFunction handler, THandlerFunction upload);
+    void onNotFound(THandlerFunction handler) { _notFound = handler; }
+    
+    // Run the handler for one request; args are form fields, "plain" the body
+    HostResponse request(HTTPMethod method, const String& uri, const std::map<std::string, std::string>& args = {});
+    
+    String arg(const String& name);
+    bool hasArg(const String& name);
+    HTTPMethod method() { return _method; }
+    String uri() { return _uri; }
+    HTTPUpload& upload() { return _upload; }
+    
+    void send(int code, const char* contentType = nullptr, const String& content = String());
+    void send(int code, const String& contentType, const String& content) { send(code, contentType.c_str(), content); }
+    void sendHeader(const String&, const String&, bool = false) {}
+
+private:
+    struct Route {
+        String uri;
+        HTTPMethod method;
+        THandlerFunction handler;
+    };
+    std::vector<Route> _routes;
+    THandlerFunction _notFound;
+    std::map<std::string, std::string> _args;
+    HTTPMethod _method = HTTP_GET;
+    String _uri;
+    HTTPUpload _upload = {};
+    HostResponse _response;
+};
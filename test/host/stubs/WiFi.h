@@ -0,0 +1,47 @@
+#pragma once
+
+#include "Arduino.h"
+#include "WiFiClient.h"
+
+typedef enum {
+    WL_IDLE_STATUS = 0,
+    WL_NO_SSID_AVAIL,
+    WL_SCAN_COMPLETED,
+    WL_CONNECTED,
+    WL_CONNECT_FAILED,
+    WL_CONNECTION_LOST,
+    WL_DISCONNECTED,
+} wl_status_t;
+
+typedef enum { WIFI_OFF = 0, WIFI_STA, WIFI_AP, WIFI_AP_STA } wifi_mode_t;
+
+// Station that joins instantly; HostNetwork (loopback_broker.h) controls
+// the link state and DNS answers
+class WiFiClass {
+public:
+    bool mode(wifi_mode_t mode);
+    wifi_mode_t getMode();
+    bool softAP(const char* ssid, const char* password = nullptr);
+    IPAddress softAPIP();
+    bool softAPdisconnect(bool wifiOff = false);
+    wl_status_t begin(const char* ssid, const char* password = nullptr, int32_t channel = 0,
+                      const uint8_t* bssid = nullptr, bool connect = true);
+    bool disconnect(bool wifiOff = false, bool eraseAp = false);
+    wl_status_t status();
+    bool isConnected() { return status() == WL_CONNECTED; }
+    bool config(IPAddress local, IPAddress gateway, IPAddress subnet, IPAddress dns1 = IPAddress(),
+                IPAddress dns2 = IPAddress());
+    bool setHostname(const char* hostname);
+    void persistent(bool persistent);
+    bool setAutoReconnect(bool autoReconnect);
+    bool setSleep(bool enabled);
+    IPAddress localIP();
+    int8_t RSSI();
+    int32_t channel();
+    uint8_t* BSSID();
+    String BSSIDstr();
+    String macAddress();
+    uint8_t* macAddress(uint8_t* mac);
+    int hostByName(const char* host, IPAddress& address);
+};
+extern WiFiClass WiFi;
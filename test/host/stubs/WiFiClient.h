@@ -0,0 +1,25 @@
+#pragma once
+
+#include "Client.h"
+
+// TCP socket to the in-process LoopbackBroker (loopback_broker.h)
+class WiFiClient : public Client {
+public:
+    int connect(IPAddress ip, uint16_t port) override;
+    int connect(const char* host, uint16_t port) override;
+    using Client::connect;
+    size_t write(uint8_t b) override { return write(&b, 1); }
+    size_t write(const uint8_t* buffer, size_t size) override;
+    int available() override;
+    int read() override;
+    int read(uint8_t* buffer, size_t size) override;
+    int peek() override;
+    void stop() override;
+    uint8_t connected() override;
+    operator bool() override { return connected(); }
+    int setNoDelay(bool) { return 0; }
+    void setTimeout(uint32_t) {}
+
+private:
+    uint32_t _connection = 0;  // LoopbackBroker connection number, 0 = closed
+};
@@ -0,0 +1,474 @@
+// Arduino core, ESP-IDF and library functions the firmware calls, for the
+// host build. Timing and boots are in host_platform.cpp.
+#include "Arduino.h"
+#include "HTTPUpdate.h"
+#include "LittleFS.h"
+#include "Update.h"
+#include "WebServer.h"
+#include "WiFi.h"
+#include "esp_rom_crc.h"
+#include "esp_task_wdt.h"
+#include "host_platform.h"
+#include "loopback_broker.h"
+#include <condition_variable>
+#include <mutex>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// ---- Serial: firmware log output is dropped unless HOST_VERBOSE is set ----
+
+HardwareSerial Serial;
+
+static bool verbose() {
+    static int value = -1;
+    if (value < 0) {
+        const char* env = getenv("HOST_VERBOSE");
+        value = env != nullptr && env[0] != '\0' && env[0] != '0';
+    }
+    return value;
+}
+
+size_t HardwareSerial::write(uint8_t c) {
+    if (verbose()) {
+        fputc(c, stdout);
+    }
+    return 1;
+}
+
+size_t HardwareSerial::write(const uint8_t* buffer, size_t size) {
+    if (verbose()) {
+        fwrite(buffer, 1, size, stdout);
+    }
+    return size;
+}
+
+size_t Print::printf(const char* format, ...) {
+    char stackBuffer[256];
+    va_list args;
+    va_start(args, format);
+    int length = vsnprintf(stackBuffer, sizeof(stackBuffer), format, args);
+    va_end(args);
+    if (length < 0) {
+        return 0;
+    }
+    if ((size_t)length < sizeof(stackBuffer)) {
+        return write((const uint8_t*)stackBuffer, length);
+    }
+    std::string buffer(length + 1, '\0');
+    va_start(args, format);
+    vsnprintf(&buffer[0], buffer.size(), format, args);
+    va_end(args);
+    return write((const uint8_t*)buffer.data(), length);
+}
+
+// ---- ESP object: heap figures of a typical ESP32 after WiFi start (weak, a
+// test can model its own heap) ----
+
+EspClass ESP;
+
+__attribute__((weak)) uint32_t EspClass::getFreeHeap() { return 180000; }
+__attribute__((weak)) uint32_t EspClass::getMaxAllocHeap() { return 110000; }
+__attribute__((weak)) uint32_t EspClass::getMinFreeHeap() { return 170000; }
+__attribute__((weak)) uint32_t EspClass::getHeapSize() { return 300000; }
+uint64_t EspClass::getEfuseMac() { return 0x0000A1B2C3D4E5F6ULL; }
+uint32_t EspClass::getCpuFreqMHz() { return 240; }
+
+// ---- GPIO, ADC, random ----
+
+static int s_pins[64];
+
+void pinMode(int, int) {}
+void digitalWrite(int pin, int value) { s_pins[pin & 63] = value; }
+int digitalRead(int pin) { return pin == 0 ? HIGH : s_pins[pin & 63]; }  // Button not pressed
+int analogRead(int) { return 2048; }
+void analogSetAttenuation(int) {}
+long random(long max) { return max > 0 ? rand() % max : 0; }
+long random(long min, long max) { return max > min ? min + rand() % (max - min) : min; }
+uint32_t esp_random() { return ((uint32_t)rand() << 16) ^ (uint32_t)rand(); }
+void disableCore0WDT() {}
+void enableCore0WDT() {}
+
+uint32_t esp_rom_crc32_le(uint32_t crc, const uint8_t* buffer, uint32_t length) {
+    crc = ~crc;
+    while (length--) {
+        crc ^= *buffer++;
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc >> 1) ^ (0xEDB88320UL & (0 - (crc & 1)));
+        }
+    }
+    return ~crc;
+}
+
+int esp_task_wdt_init(const esp_task_wdt_config_t*) { return 0; }
+int esp_task_wdt_reconfigure(const esp_task_wdt_config_t*) { return 0; }
+int esp_task_wdt_add(void*) { return 0; }
+int esp_task_wdt_delete(void*) { return 0; }
+int esp_task_wdt_reset() { return 0; }
+
+// ---- IPAddress ----
+
+bool IPAddress::fromString(const char* text) {
+    unsigned a, b, c, d;
+    char extra;
+    if (sscanf(text, "%u.%u.%u.%u%c", &a, &b, &c, &d, &extra) != 4 || a > 255 || b > 255 || c > 255 || d > 255) {
+        return false;
+    }
+    *this = IPAddress(a, b, c, d);
+    return true;
+}
+
+bool IPAddress::fromString(const String& text) {
+    return fromString(text.c_str());
+}
+
+String IPAddress::toString() const {
+    char text[16];
+    snprintf(text, sizeof(text), "%u.%u.%u.%u", _bytes[0], _bytes[1], _bytes[2], _bytes[3]);
+    return String(text);
+}
+
+// ---- WiFi: joins at once; HostNetwork decides link state and DNS ----
+
+WiFiClass WiFi;
+static wifi_mode_t s_wifiMode = WIFI_OFF;
+static uint8_t s_bssid[6] = {0x02, 0x11, 0x22, 0x33, 0x44, 0x55};
+
+bool WiFiClass::mode(wifi_mode_t mode) { s_wifiMode = mode; return true; }
+wifi_mode_t WiFiClass::getMode() { return s_wifiMode; }
+bool WiFiClass::softAP(const char*, const char*) { return true; }
+IPAddress WiFiClass::softAPIP() { return IPAddress(192, 168, 4, 1); }
+bool WiFiClass::softAPdisconnect(bool) { return true; }
+
+wl_status_t WiFiClass::begin(const char*, const char*, int32_t, const uint8_t*, bool) {
+    return status();
+}
+
+bool WiFiClass::disconnect(bool, bool) { return true; }
+wl_status_t WiFiClass::status() { return HostNetwork::wifiConnected ? WL_CONNECTED : WL_DISCONNECTED; }
+bool WiFiClass::config(IPAddress, IPAddress, IPAddress, IPAddress, IPAddress) { return true; }
+bool WiFiClass::setHostname(const char*) { return true; }
+void WiFiClass::persistent(bool) {}
+bool WiFiClass::setAutoReconnect(bool) { return true; }
+bool WiFiClass::setSleep(bool) { return true; }
+IPAddress WiFiClass::localIP() { return HostNetwork::wifiConnected ? IPAddress(10, 0, 0, 50) : IPAddress(); }
+int8_t WiFiClass::RSSI() { return -55; }
+int32_t WiFiClass::channel() { return 6; }
+uint8_t* WiFiClass::BSSID() { return s_bssid; }
+String WiFiClass::BSSIDstr() { return String("02:11:22:33:44:55"); }
+String WiFiClass::macAddress() { return String("24:6F:28:A1:B2:C3"); }
+
+uint8_t* WiFiClass::macAddress(uint8_t* mac) {
+    static const uint8_t address[6] = {0x24, 0x6F, 0x28, 0xA1, 0xB2, 0xC3};
+    memcpy(mac, address, sizeof(address));
+    return mac;
+}
+
+int WiFiClass::hostByName(const char* host, IPAddress& address) {
+    HostNetwork::dnsLookups++;
+    delay(HostNetwork::dnsDelayMs);
+    if (!HostNetwork::wifiConnected || !HostNetwork::dnsWorks) {
+        return 0;
+    }
+    if (address.fromString(host)) {
+        return 1;
+    }
+    address = HostNetwork::brokerAddress;
+    return 1;
+}
+
+// ---- WiFiClient: connections to the loopback broker ----
+
+int WiFiClient::connect(IPAddress ip, uint16_t port) {
+    host::StandIn standIn;
+    stop();
+    _connection = LoopbackBroker::instance().open(ip, port);
+    return _connection != 0;
+}
+
+int WiFiClient::connect(const char* host, uint16_t port) {
+    host::StandIn standIn;
+    IPAddress address;
+    if (!WiFi.hostByName(host, address)) {
+        return 0;
+    }
+    return connect(address, port);
+}
+
+size_t WiFiClient::write(const uint8_t* buffer, size_t size) {
+    host::StandIn standIn;
+    return LoopbackBroker::instance().receive(_connection, buffer, size);
+}
+
+int WiFiClient::available() {
+    host::StandIn standIn;
+    return LoopbackBroker::instance().available(_connection);
+}
+
+int WiFiClient::read() {
+    uint8_t b;
+    return read(&b, 1) == 1 ? b : -1;
+}
+
+int WiFiClient::read(uint8_t* buffer, size_t size) {
+    host::StandIn standIn;
+    return LoopbackBroker::instance().read(_connection, buffer, size);
+}
+
+int WiFiClient::peek() {
+    host::StandIn standIn;
+    return LoopbackBroker::instance().peek(_connection);
+}
+
+void WiFiClient::stop() {
+    host::StandIn standIn;
+    if (_connection != 0) {
+        LoopbackBroker::instance().close(_connection);
+        _connection = 0;
+    }
+}
+
+uint8_t WiFiClient::connected() {
+    host::StandIn standIn;
+    return LoopbackBroker::instance().connected(_connection);
+}
+
+// ---- HTTP, OTA: no network on the host, every download fails ----
+
+bool HTTPClient::begin(const String&) { return true; }
+bool HTTPClient::begin(WiFiClient&, const String&) { return true; }
+bool HTTPClient::connected() { return false; }
+int HTTPClient::GET() { return -1; }  // HTTPC_ERROR_CONNECTION_REFUSED
+int HTTPClient::getSize() { return -1; }
+WiFiClient* HTTPClient::getStreamPtr() { return nullptr; }
+String HTTPClient::errorToString(int) { return String("connection refused"); }
+void HTTPClient::setTimeout(uint32_t) {}
+void HTTPClient::setFollowRedirects(int) {}
+void HTTPClient::end() {}
+
+HTTPUpdate httpUpdate;
+HTTPUpdateResult HTTPUpdate::update(WiFiClient&, const String&) { return HTTP_UPDATE_FAILED; }
+int HTTPUpdate::getLastError() { return -1; }
+String HTTPUpdate::getLastErrorString() { return String("no network on host"); }
+void HTTPUpdate::rebootOnUpdate(bool) {}
+void HTTPUpdate::onProgress(std::function<void(int, int)>) {}
+
+UpdateClass Update;
+static bool s_updateRunning = false;
+bool UpdateClass::begin(size_t, int) { s_updateRunning = true; return true; }
+size_t UpdateClass::write(uint8_t*, size_t length) { return s_updateRunning ? length : 0; }
+
+size_t UpdateClass::writeStream(Stream& stream) {
+    size_t total = 0;
+    while (stream.read() >= 0) {
+        total++;
+    }
+    return total;
+}
+
+bool UpdateClass::end(bool) { bool ok = s_updateRunning; s_updateRunning = false; return ok; }
+bool UpdateClass::hasError() { return false; }
+bool UpdateClass::isFinished() { return !s_updateRunning; }
+void UpdateClass::abort() { s_updateRunning = false; }
+uint8_t UpdateClass::getError() { return 0; }
+String UpdateClass::errorString() { return String("No Error"); }
+void UpdateClass::printError(Print& out) { out.println("No Error"); }
+
+// ---- WebServer: handlers run from request() ----
+
+static WebServer* s_currentServer = nullptr;
+
+WebServer::WebServer(int) { s_currentServer = this; }
+
+WebServer::~WebServer() {
+    if (s_currentServer == this) {
+        s_currentServer = nullptr;
+    }
+}
+
+WebServer* WebServer::current() { return s_currentServer; }
+
+void WebServer::on(const String& uri, HTTPMethod method, THandlerFunction handler) {
+    _routes.push_back({uri, method, handler});
+}
+
+void WebServer::on(const String& uri, HTTPMethod method, THandlerFunction handler, THandlerFunction) {
+    on(uri, method, handler);
+}
+
+HostResponse WebServer::request(HTTPMethod method, const String& uri, const std::map<std::string, std::string>& args) {
+    _method = method;
+    _uri = uri;
+    _args = args;
+    _response = HostResponse();
+    for (const Route& route : _routes) {
+        if (route.uri == uri && (route.method == HTTP_ANY || route.method == method)) {
+            route.handler();
+            return _response;
+        }
+    }
+    if (_notFound) {
+        _notFound();
+    }
+    return _response;
+}
+
+String WebServer::arg(const String& name) {
+    auto it = _args.find(name.c_str());
+    return it != _args.end() ? String(it->second) : String();
+}
+
+bool WebServer::hasArg(const String& name) { return _args.count(name.c_str()) > 0; }
+
+void WebServer::send(int code, const char* contentType, const String& content) {
+    _response.code = code;
+    _response.contentType = contentType ? contentType : "";
+    _response.body = content;
+}
+
+// ---- LittleFS: files under <state dir>/littlefs ----
+
+LittleFSFS LittleFS;
+
+static std::string fsPath(const char* path) {
+    host::StandIn standIn;
+    return host::statePath("littlefs") + path;
+}
+
+size_t File::size() {
+    if (_file == nullptr) {
+        return 0;
+    }
+    struct stat info;
+    fflush(_file);
+    return fstat(fileno(_file), &info) == 0 ? (size_t)info.st_size : 0;
+}
+
+bool LittleFSFS::begin(bool, const char*, uint8_t, const char*) {
+    return true;
+}
+
+File LittleFSFS::open(const char* path, const char* mode) {
+    opens++;
+    const char* fileMode = strcmp(mode, FILE_WRITE) == 0 ? "wb" : strcmp(mode, FILE_APPEND) == 0 ? "ab" : "rb";
+    return File(fopen(fsPath(path).c_str(), fileMode));
+}
+
+bool LittleFSFS::exists(const char* path) { return access(fsPath(path).c_str(), F_OK) == 0; }
+bool LittleFSFS::remove(const char* path) { return unlink(fsPath(path).c_str()) == 0; }
+
+size_t LittleFSFS::usedBytes() {
+    host::StandIn standIn;
+    std::string command = "du -sb '" + host::statePath("littlefs") + "' 2>/dev/null";
+    FILE* pipe = popen(command.c_str(), "r");
+    size_t used = 0;
+    if (pipe != nullptr) {
+        unsigned long value = 0;
+        if (fscanf(pipe, "%lu", &value) == 1) {
+            used = value;
+        }
+        pclose(pipe);
+    }
+    return used;
+}
+
+// ---- FreeRTOS tasks as threads ----
+
+// Task stacks are painted so the high water mark can be measured. The
+// thread gets HOST_STACK_SLACK more than asked for: x86-64 frames are not
+// ESP32 frames, so the figure is a host measurement, not a limit.
+#define HOST_STACK_SLACK (256 * 1024)
+#define HOST_STACK_PAINT 0xA5
+
+struct HostTask {
+    std::mutex mutex;
+    std::condition_variable wake;
+    uint32_t notifications = 0;
+    uint32_t stackDepth = 0;
+    uint8_t* stack = nullptr;
+    size_t stackSize = 0;
+    size_t entryUsed = 0;  // Thread start-up (descriptor, TLS) - not the task's
+    TaskFunction_t function = nullptr;
+    void* parameter = nullptr;
+};
+
+static thread_local HostTask* s_currentTask = nullptr;
+
+static void* runTask(void* arg) {
+    HostTask* task = static_cast<HostTask*>(arg);
+    uint8_t marker;
+    task->entryUsed = (size_t)(task->stack + task->stackSize - &marker);
+    s_currentTask = task;
+    task->function(task->parameter);
+    return nullptr;
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t function, const char*, uint32_t stackDepth, void* parameter,
+                                   UBaseType_t, TaskHandle_t* handle, BaseType_t) {
+    HostTask* task = new HostTask();
+    task->stackDepth = stackDepth;
+    task->function = function;
+    task->parameter = parameter;
+    task->stackSize = (stackDepth + HOST_STACK_SLACK + 4095) & ~(size_t)4095;
+    task->stack = static_cast<uint8_t*>(aligned_alloc(4096, task->stackSize));
+    memset(task->stack, HOST_STACK_PAINT, task->stackSize);
+    if (handle != nullptr) {
+        *handle = task;
+    }
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setstack(&attr, task->stack, task->stackSize);
+    pthread_t thread;
+    bool started = pthread_create(&thread, &attr, runTask, task) == 0;
+    pthread_attr_destroy(&attr);
+    if (!started) {
+        return pdFAIL;
+    }
+    pthread_detach(thread);
+    return pdPASS;
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task) {
+    std::lock_guard<std::mutex> lock(task->mutex);
+    task->notifications++;
+    task->wake.notify_one();
+    return pdPASS;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clearOnExit, TickType_t ticksToWait) {
+    HostTask* task = s_currentTask;
+    if (task == nullptr) {
+        delay(ticksToWait);
+        return 0;
+    }
+    std::unique_lock<std::mutex> lock(task->mutex);
+    if (task->notifications == 0) {
+        // Real time, short: the emulated clock only moves with delay()
+        task->wake.wait_for(lock, std::chrono::milliseconds(ticksToWait > 10 ? 10 : ticksToWait));
+        if (task->notifications == 0) {
+            lock.unlock();
+            delay(ticksToWait);
+            return 0;
+        }
+    }
+    uint32_t value = task->notifications;
+    task->notifications = clearOnExit ? 0 : value - 1;
+    return value;
+}
+
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t task) {
+    HostTask* target = task != nullptr ? task : s_currentTask;
+    if (target == nullptr) {
+        return 0;
+    }
+    size_t untouched = 0;
+    while (untouched < target->stackSize && target->stack[untouched] == HOST_STACK_PAINT) {
+        untouched++;
+    }
+    size_t used = target->stackSize - untouched - target->entryUsed;
+    return used >= target->stackDepth ? 0 : (UBaseType_t)(target->stackDepth - used);
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle() { return s_currentTask; }
+void vTaskDelay(TickType_t ticks) { delay(ticks); }
+void vTaskDelete(TaskHandle_t) {}
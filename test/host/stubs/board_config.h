@@ -0,0 +1,8 @@
+// Board configuration for the host build (no hardware behind any of it)
+#pragma once
+
+#define BOARD_NAME "Host"
+#define HAS_BUTTON true
+#define WAKE_BUTTON_PIN 0
+#define LED_PIN 2
+#define WATCHDOG_TIMEOUT_SECONDS 30
@@ -0,0 +1,15 @@
+#pragma once
+
+#include <cstdint>
+
+typedef struct {
+    uint32_t timeout_ms;
+    uint32_t idle_core_mask;
+    bool trigger_panic;
+} esp_task_wdt_config_t;
+
+int esp_task_wdt_init(const esp_task_wdt_config_t* config);
+int esp_task_wdt_reconfigure(const esp_task_wdt_config_t* config);
+int esp_task_wdt_add(void* task);
+int esp_task_wdt_delete(void* task);
+int esp_task_wdt_reset();
@@ -0,0 +1,253 @@
+#include "host_platform.h"
+#include "Arduino.h"
+#include "nvs_emulator.h"
+#include <cerrno>
+#include <map>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+// RTC_DATA_ATTR variables (Arduino.h), bounds provided by the linker
+extern "C" uint8_t __start_rtc_data[];
+extern "C" uint8_t __stop_rtc_data[];
+static RTC_DATA_ATTR uint32_t s_rtcAnchor;  // The section exists even if no firmware RTC variable is linked
+
+#define HOST_EPOCH 1760601600UL  // 2025-10-16 08:00 UTC - time() at the first boot
+
+static host::BootKind s_bootKind = host::POWER_ON;
+static bool s_inBoot = false;
+static int s_failures = 0;
+static uint32_t s_sleptSeconds = 0;
+
+// millis(): real time since the boot started plus everything delay() skipped
+static struct timespec s_bootStart;
+static uint64_t s_skippedUs = 0;
+
+static uint64_t elapsedUs() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)(now.tv_sec - s_bootStart.tv_sec) * 1000000ULL +
+           (int64_t)(now.tv_nsec - s_bootStart.tv_nsec) / 1000 + s_skippedUs;
+}
+
+unsigned long millis() {
+    return (unsigned long)(elapsedUs() / 1000);
+}
+
+unsigned long micros() {
+    return (unsigned long)elapsedUs();
+}
+
+void delay(unsigned long ms) {
+    // Emulated time jumps ahead; give other threads (MQTT task) a moment
+    __atomic_add_fetch(&s_skippedUs, (uint64_t)ms * 1000, __ATOMIC_RELAXED);
+    usleep(ms > 0 ? 50 : 0);
+}
+
+void delayMicroseconds(unsigned int us) {
+    __atomic_add_fetch(&s_skippedUs, (uint64_t)us, __ATOMIC_RELAXED);
+}
+
+void yield() {
+    usleep(0);
+}
+
+extern "C" time_t __real_time(time_t* t);
+extern "C" time_t __wrap_time(time_t* t) {
+    time_t now = (time_t)(HOST_EPOCH + s_sleptSeconds + millis() / 1000);
+    if (t != nullptr) {
+        *t = now;
+    }
+    return now;
+}
+
+static void resetClock() {
+    clock_gettime(CLOCK_MONOTONIC, &s_bootStart);
+    s_skippedUs = 0;
+}
+
+namespace host {
+
+thread_local int StandIn::depth = 0;
+
+const std::string& stateDir() {
+    static std::string dir;
+    if (dir.empty()) {
+        char path[] = "/tmp/esp32-host-XXXXXX";
+        if (mkdtemp(path) == nullptr) {
+            perror("mkdtemp");
+            abort();
+        }
+        dir = path;
+        mkdir((dir + "/littlefs").c_str(), 0755);
+        // Boots leave with _exit(), so only the test process removes it
+        atexit([] {
+            std::string command = "rm -rf '" + dir + "'";
+            if (system(command.c_str()) != 0) {
+                perror(dir.c_str());
+            }
+        });
+    }
+    return dir;
+}
+
+std::string statePath(const char* name) {
+    return stateDir() + "/" + name;
+}
+
+void eraseFlash() {
+    NvsFlash::instance().format();
+    unlink(statePath("rtc.bin").c_str());
+    unlink(statePath("results.txt").c_str());
+    std::string command = "rm -rf '" + statePath("littlefs") + "' && mkdir -p '" + statePath("littlefs") + "'";
+    if (system(command.c_str()) != 0) {
+        perror("littlefs");
+    }
+}
+
+static void restoreRtc() {
+    size_t size = __stop_rtc_data - __start_rtc_data;
+    FILE* file = fopen(statePath("rtc.bin").c_str(), "rb");
+    if (file == nullptr) {
+        return;  // Never slept - RTC memory holds its initial values
+    }
+    std::string saved(size, '\0');
+    if (fread(&saved[0], 1, size, file) == size) {
+        memcpy(__start_rtc_data, saved.data(), size);
+    }
+    fclose(file);
+}
+
+static void saveRtc() {
+    FILE* file = fopen(statePath("rtc.bin").c_str(), "wb");
+    if (file != nullptr) {
+        fwrite(__start_rtc_data, 1, __stop_rtc_data - __start_rtc_data, file);
+        fclose(file);
+    }
+}
+
+int boot(BootKind kind, const std::function<void()>& body) {
+    stateDir();
+    NvsFlash::instance().invalidate();
+    fflush(stdout);
+    fflush(stderr);
+    
+    pid_t child = fork();
+    if (child < 0) {
+        perror("fork");
+        return 1;
+    }
+    if (child == 0) {
+        s_inBoot = true;
+        s_bootKind = kind;
+        s_failures = 0;
+        if (kind == POWER_ON) {
+            unlink(statePath("rtc.bin").c_str());
+        } else {
+            restoreRtc();
+        }
+        resetClock();
+        NvsFlash::instance().resetStats();
+        body();
+        endBoot();
+    }
+    
+    int status = 0;
+    while (waitpid(child, &status, 0) < 0 && errno == EINTR) {
+    }
+    NvsFlash::instance().invalidate();
+    if (WIFSIGNALED(status)) {
+        fprintf(stderr, "emulated boot crashed (signal %d)\n", WTERMSIG(status));
+        return 100 + WTERMSIG(status);
+    }
+    return WEXITSTATUS(status);
+}
+
+void endBoot() {
+    if (!s_inBoot) {
+        fprintf(stderr, "endBoot() outside of host::boot()\n");
+        abort();
+    }
+    saveRtc();
+    NvsFlash::instance().sync();
+    fflush(stdout);
+    fflush(stderr);
+    _exit(s_failures > 99 ? 99 : s_failures);
+}
+
+void sleep(uint32_t seconds) {
+    s_sleptSeconds += seconds;
+}
+
+BootKind bootKind() {
+    return s_bootKind;
+}
+
+void fail() {
+    s_failures++;
+}
+
+int failures() {
+    return s_failures;
+}
+
+void record(const char* name, double value) {
+    FILE* file = fopen(statePath("results.txt").c_str(), "a");
+    if (file != nullptr) {
+        fprintf(file, "%.17g %s\n", value, name);  // Names may contain spaces
+        fclose(file);
+    }
+}
+
+double recorded(const char* name, double fallback) {
+    FILE* file = fopen(statePath("results.txt").c_str(), "r");
+    if (file == nullptr) {
+        return fallback;
+    }
+    double result = fallback;
+    char key[128];
+    double value;
+    while (fscanf(file, "%lg %127[^\n]", &value, key) == 2) {
+        if (strcmp(key, name) == 0) {
+            result = value;
+        }
+    }
+    fclose(file);
+    return result;
+}
+
+}  // namespace host
+
+// The wake cause and reset reason follow the kind of boot
+esp_sleep_wakeup_cause_t esp_sleep_get_wakeup_cause() {
+    switch (s_bootKind) {
+        case host::TIMER_WAKE: return ESP_SLEEP_WAKEUP_TIMER;
+        case host::BUTTON_WAKE: return ESP_SLEEP_WAKEUP_EXT0;
+        default: return ESP_SLEEP_WAKEUP_UNDEFINED;
+    }
+}
+
+esp_reset_reason_t esp_reset_reason() {
+    switch (s_bootKind) {
+        case host::POWER_ON: return ESP_RST_POWERON;
+        case host::SOFTWARE_RESET: return ESP_RST_SW;
+        default: return ESP_RST_DEEPSLEEP;
+    }
+}
+
+int esp_sleep_enable_ext0_wakeup(gpio_num_t, int) {
+    return 0;
+}
+
+int esp_sleep_enable_timer_wakeup(uint64_t) {
+    return 0;
+}
+
+void esp_deep_sleep_start() {
+    host::endBoot();
+}
+
+void EspClass::restart() {
+    host::endBoot();
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include "esp_sleep.h"
+#include "esp_system.h"
+
+// ============================================
+// EMULATED BOOTS
+// ============================================
+// Every boot runs in a forked child process, so the firmware's globals
+// start from their initial values each time, like DRAM after a reset. The
+// RTC_DATA_ATTR section is written to <state dir>/rtc.bin when the boot
+// ends and restored on the next wake (deep sleep keeps RTC memory, power-on
+// clears it). NVS (nvs.bin) and LittleFS (littlefs/) live in the state
+// directory as well.
+//
+// A boot ends when the function returns, on ESP.restart() or on
+// esp_deep_sleep_start(). boot() returns the number of failed CHECKs of
+// that boot (or 100 + signal if the child crashed).
+namespace host {
+
+enum BootKind {
+    POWER_ON,         // RTC memory cleared
+    TIMER_WAKE,       // Deep sleep timer
+    BUTTON_WAKE,      // Deep sleep EXT0 (wake button)
+    SOFTWARE_RESET,   // ESP.restart(): RTC memory kept, no wake cause
+};
+
+// Fresh state directory for this process (erased flash, no RTC memory)
+const std::string& stateDir();
+std::string statePath(const char* name);
+
+// Wipe NVS, LittleFS and RTC memory (like esptool erase_flash)
+void eraseFlash();
+
+int boot(BootKind kind, const std::function<void()>& body);
+
+// Seconds of deep sleep between boots (advances time())
+void sleep(uint32_t seconds);
+
+// Inside a boot: how the current boot started, end it like the chip would
+BootKind bootKind();
+[[noreturn]] void endBoot();
+
+// Failed checks of the current boot (host_test.h)
+void fail();
+int failures();
+
+// Values a boot hands back to the test process (last one wins)
+void record(const char* name, double value);
+double recorded(const char* name, double fallback = -1);
+
+// Open while a stand-in (loopback socket, PubSubClient) does its own work.
+// Its std::string/std::vector use is not the firmware's heap use, so tests
+// that count allocations skip the ones made while depth > 0.
+struct StandIn {
+    StandIn() { depth++; }
+    ~StandIn() { depth--; }
+    static thread_local int depth;
+};
+
+}  // namespace host
@@ -0,0 +1,438 @@
+#include "loopback_broker.h"
+#include "Arduino.h"
+
+bool HostNetwork::wifiConnected = true;
+bool HostNetwork::dnsWorks = true;
+IPAddress HostNetwork::brokerAddress(10, 0, 0, 2);
+uint32_t HostNetwork::dnsDelayMs = 20;
+uint32_t HostNetwork::dnsLookups = 0;
+
+void HostNetwork::reset() {
+    wifiConnected = true;
+    dnsWorks = true;
+    brokerAddress = IPAddress(10, 0, 0, 2);
+    dnsDelayMs = 20;
+    dnsLookups = 0;
+}
+
+static std::string encodeLength(uint32_t length) {
+    std::string out;
+    do {
+        uint8_t digit = length % 128;
+        length /= 128;
+        out += (char)(length > 0 ? (digit | 0x80) : digit);
+    } while (length > 0);
+    return out;
+}
+
+static std::string packet(uint8_t header, const std::string& body) {
+    return std::string(1, (char)header) + encodeLength((uint32_t)body.size()) + body;
+}
+
+static std::string u16(uint16_t value) {
+    return std::string{(char)(value >> 8), (char)(value & 0xFF)};
+}
+
+// Cursor over a packet body; reads past the end return zeros and set bad
+struct BodyReader {
+    const std::string& body;
+    size_t pos = 0;
+    bool bad = false;
+    
+    explicit BodyReader(const std::string& text) : body(text) {}
+    bool more() const { return pos < body.size(); }
+    uint8_t byte() {
+        if (pos >= body.size()) {
+            bad = true;
+            return 0;
+        }
+        return (uint8_t)body[pos++];
+    }
+    uint16_t word() {
+        uint16_t high = byte();
+        return (uint16_t)((high << 8) | byte());
+    }
+    uint32_t varint() {
+        uint32_t value = 0;
+        for (int shift = 0; shift <= 21; shift += 7) {
+            uint8_t b = byte();
+            value |= (uint32_t)(b & 0x7F) << shift;
+            if (!(b & 0x80)) {
+                break;
+            }
+        }
+        return value;
+    }
+    std::string string() {
+        uint16_t length = word();
+        if (pos + length > body.size()) {
+            bad = true;
+            return std::string();
+        }
+        std::string text = body.substr(pos, length);
+        pos += length;
+        return text;
+    }
+    std::string rest() {
+        std::string text = pos < body.size() ? body.substr(pos) : std::string();
+        pos = body.size();
+        return text;
+    }
+    // MQTT 5 properties; returns the Topic Alias (0 if none)
+    uint16_t properties() {
+        uint32_t length = varint();
+        size_t end = pos + length;
+        uint16_t alias = 0;
+        while (pos < end && !bad) {
+            uint8_t id = byte();
+            switch (id) {
+                case 0x23: alias = word(); break;
+                case 0x01: case 0x17: case 0x19: case 0x24: case 0x25: case 0x28: case 0x29: case 0x2A:
+                    byte();
+                    break;
+                case 0x13: case 0x21: case 0x22: word(); break;
+                case 0x02: case 0x11: case 0x18: case 0x27: word(); word(); break;
+                case 0x0B: varint(); break;
+                case 0x26: string(); string(); break;
+                default: string(); break;  // The remaining identifiers are strings/binary data
+            }
+        }
+        pos = end;
+        return alias;
+    }
+};
+
+// Topic of a whole PUBLISH packet written at once, empty for anything else
+static std::string publishTopic(const uint8_t* data, size_t length) {
+    if (length < 2 || (data[0] >> 4) != MQTT_PKT_PUBLISH) {
+        return std::string();
+    }
+    size_t pos = 1;
+    while (pos < length && (data[pos] & 0x80)) {
+        pos++;
+    }
+    pos++;
+    if (pos + 2 > length) {
+        return std::string();
+    }
+    size_t topicLength = ((size_t)data[pos] << 8) | data[pos + 1];
+    pos += 2;
+    return pos + topicLength <= length ? std::string((const char*)data + pos, topicLength) : std::string();
+}
+
+LoopbackBroker& LoopbackBroker::instance() {
+    static LoopbackBroker broker;
+    return broker;
+}
+
+void LoopbackBroker::reset() {
+    std::lock_guard<std::recursive_mutex> lock(_mutex);
+    ackDelayMs = 0;
+    dropAcks = false;
+    ackLimit = -1;
+    connackCode = 0;
+    respondPing = true;
+    keepSessions = true;
+    aliasMax = 10;
+    serverKeepAlive = 0;
+    online = true;
+    failTopic.clear();
+    _connection = Connection();
+    _sessions.clear();
+    clearRecords();
+}
+
+void LoopbackBroker::clearRecords() {
+    std::lock_guard<std::recursive_mutex> lock(_mutex);
+    _packets.clear();
+    _connections = 0;
+    _writes = 0;
+    _bytes = 0;
+}
+
+void LoopbackBroker::dropConnection() {
+    std::lock_guard<std::recursive_mutex> lock(_mutex);
+    _connection.open = false;
+    _connection.outgoing.clear();
+    _connection.readable.clear();
+}
+
+std::vector<BrokerPacket> LoopbackBroker::packets() {
+    std::lock_guard<std::recursive_mutex> lock(_mutex);
+    return _packets;
+}
+
+std::vector<BrokerPacket> LoopbackBroker::published(const std::string& topicPrefix) {
+    std::lock_guard<std::recursive_mutex> lock(_mutex);
+    std::vector<BrokerPacket> result;
+    for (const BrokerPacket& p : _packets) {
+        if (p.type == MQTT_PKT_PUBLISH && p.topic.compare(0, topicPrefix.size(), topicPrefix) == 0) {
+            result.push_back(p);
+        }
+    }
+    return result;
+}
+
+int LoopbackBroker::count(uint8_t type) {
+    std::lock_guard<std::recursive_mutex> lock(_mutex);
+    int n = 0;
+    for (const BrokerPacket& p : _packets) {
+        n += p.type == type;
+    }
+    return n;
+}
+
+uint32_t LoopbackBroker::connections() {
+    return _connections;
+}
+
+uint32_t LoopbackBroker::clientWrites() {
+    return _writes;
+}
+
+uint32_t LoopbackBroker::clientBytes() {
+    return _bytes;
+}
+
+void LoopbackBroker::inject(const std::string& topic, const std::string& payload) {
+    std::lock_guard<std::recursive_mutex> lock(_mutex);
+    if (!_connection.open) {
+        return;
+    }
+    std::string body = u16((uint16_t)topic.size()) + topic;
+    if (_connection.protocol == 5) {
+        body += '\0';  // No properties
+    }
+    _connection.readable += packet(MQTT_PKT_PUBLISH << 4, body + payload);
+}
+
+LoopbackBroker::Connection* LoopbackBroker::find(uint32_t id) {
+    return id != 0 && _connection.id == id ? &_connection : nullptr;
+}
+
+uint32_t LoopbackBroker::open(IPAddress address, uint16_t port) {
+    std::lock_guard<std::recursive_mutex> lock(_mutex);
+    if (!online || !HostNetwork::wifiConnected || address != HostNetwork::brokerAddress) {
+        return 0;
+    }
+    _connection = Connection();
+    _connection.id = _nextId++;
+    _connection.open = true;
+    _connections++;
+    return _connection.id;
+}
+
+size_t LoopbackBroker::receive(uint32_t id, const uint8_t* data, size_t length) {
+    std::lock_guard<std::recursive_mutex> lock(_mutex);
+    Connection* connection = find(id);
+    if (connection == nullptr || !connection->open) {
+        return 0;
+    }
+    if (!failTopic.empty() && publishTopic(data, length) == failTopic) {
+        return 0;  // Send error - nothing taken, the stream stays intact
+    }
+    _writes++;
+    _bytes += length;
+    connection->rx.append((const char*)data, length);
+    parse(*connection);
+    return length;
+}
+
+void LoopbackBroker::parse(Connection& connection) {
+    while (connection.open && connection.rx.size() >= 2) {
+        uint32_t remaining = 0;
+        size_t pos = 1;
+        bool complete = false;
+        for (int shift = 0; shift <= 21 && pos < connection.rx.size(); shift += 7) {
+            uint8_t b = (uint8_t)connection.rx[pos++];
+            remaining |= (uint32_t)(b & 0x7F) << shift;
+            if (!(b & 0x80)) {
+                complete = true;
+                break;
+            }
+        }
+        if (!complete || connection.rx.size() < pos + remaining) {
+            return;  // Rest of the packet still to come
+        }
+        uint8_t header = (uint8_t)connection.rx[0];
+        std::string body = connection.rx.substr(pos, remaining);
+        connection.rx.erase(0, pos + remaining);
+        if (!connection.refused) {
+            handle(connection, header, body, (uint32_t)(pos + remaining));
+        }
+    }
+}
+
+void LoopbackBroker::handle(Connection& connection, uint8_t header, const std::string& body, uint32_t size) {
+    BrokerPacket p;
+    p.type = header >> 4;
+    p.size = size;
+    p.connection = connection.id;
+    BodyReader in(body);
+    
+    switch (p.type) {
+        case MQTT_PKT_CONNECT: {
+            in.string();  // "MQTT"
+            p.protocol = in.byte();
+            uint8_t flags = in.byte();
+            p.keepAlive = in.word();
+            if (p.protocol == 5) {
+                in.properties();
+            }
+            p.cleanSession = flags & 0x02;
+            p.clientId = in.string();
+            if (flags & 0x04) {
+                if (p.protocol == 5) {
+                    in.properties();
+                }
+                in.string();
+                in.string();
+            }
+            if (flags & 0x80) {
+                p.username = in.string();
+            }
+            connection.protocol = p.protocol;
+            
+            bool sessionPresent = false;
+            if (p.cleanSession || !keepSessions) {
+                _sessions.erase(p.clientId);
+            } else {
+                sessionPresent = _sessions.count(p.clientId) > 0;
+                _sessions.insert(p.clientId);
+            }
+            std::string ack{(char)(sessionPresent && connackCode == 0 ? 1 : 0), (char)connackCode};
+            if (p.protocol == 5) {
+                std::string properties = std::string(1, (char)0x22) + u16(aliasMax);
+                if (serverKeepAlive != 0) {
+                    properties += std::string(1, (char)0x13) + u16(serverKeepAlive);
+                }
+                ack += encodeLength((uint32_t)properties.size()) + properties;
+            }
+            send(connection, packet(MQTT_PKT_CONNACK << 4, ack));
+            if (connackCode != 0) {
+                connection.refused = true;  // Everything after the CONNECT is dropped
+            }
+            break;
+        }
+        
+        case MQTT_PKT_PUBLISH: {
+            p.qos = (header >> 1) & 3;
+            p.retain = header & 1;
+            p.dup = header & 8;
+            p.topic = in.string();
+            if (p.qos > 0) {
+                p.packetId = in.word();
+            }
+            if (connection.protocol == 5) {
+                p.alias = in.properties();
+                if (p.topic.empty() && p.alias != 0) {
+                    p.aliasOnly = true;
+                    p.topic = connection.aliases.count(p.alias) ? connection.aliases[p.alias] : "<unknown alias>";
+                } else if (p.alias != 0) {
+                    connection.aliases[p.alias] = p.topic;
+                }
+            }
+            p.payload = in.rest();
+            if (p.qos == 1 && !dropAcks && (ackLimit < 0 || connection.acksSent < ackLimit)) {
+                connection.acksSent++;
+                send(connection, packet(MQTT_PKT_PUBACK << 4, u16(p.packetId)));
+            }
+            break;
+        }
+        
+        case MQTT_PKT_SUBSCRIBE: {
+            p.packetId = in.word();
+            if (connection.protocol == 5) {
+                in.properties();
+            }
+            p.topic = in.string();
+            p.qos = in.byte() & 3;
+            std::string ack = u16(p.packetId);
+            if (connection.protocol == 5) {
+                ack += '\0';
+            }
+            ack += (char)p.qos;
+            send(connection, packet(MQTT_PKT_SUBACK << 4, ack));
+            break;
+        }
+        
+        case MQTT_PKT_PINGREQ:
+            if (respondPing) {
+                send(connection, packet(MQTT_PKT_PINGRESP << 4, std::string()));
+            }
+            break;
+        
+        case MQTT_PKT_DISCONNECT:
+            connection.open = false;  // Answers already queued are still delivered
+            break;
+    }
+    _packets.push_back(p);
+}
+
+void LoopbackBroker::send(Connection& connection, const std::string& bytes) {
+    connection.outgoing.push_back({millis() + ackDelayMs, bytes});
+}
+
+void LoopbackBroker::deliver(Connection& connection) {
+    unsigned long now = millis();
+    size_t due = 0;
+    while (due < connection.outgoing.size() && (long)(now - connection.outgoing[due].dueMs) >= 0) {
+        connection.readable += connection.outgoing[due].bytes;
+        due++;
+    }
+    connection.outgoing.erase(connection.outgoing.begin(), connection.outgoing.begin() + due);
+}
+
+int LoopbackBroker::available(uint32_t id) {
+    std::lock_guard<std::recursive_mutex> lock(_mutex);
+    Connection* connection = find(id);
+    if (connection == nullptr) {
+        return 0;
+    }
+    deliver(*connection);
+    return (int)connection->readable.size();
+}
+
+int LoopbackBroker::read(uint32_t id, uint8_t* buffer, size_t length) {
+    std::lock_guard<std::recursive_mutex> lock(_mutex);
+    Connection* connection = find(id);
+    if (connection == nullptr) {
+        return -1;
+    }
+    deliver(*connection);
+    size_t count = std::min(length, connection->readable.size());
+    if (count == 0) {
+        return -1;
+    }
+    memcpy(buffer, connection->readable.data(), count);
+    connection->readable.erase(0, count);
+    return (int)count;
+}
+
+int LoopbackBroker::peek(uint32_t id) {
+    std::lock_guard<std::recursive_mutex> lock(_mutex);
+    Connection* connection = find(id);
+    if (connection == nullptr) {
+        return -1;
+    }
+    deliver(*connection);
+    return connection->readable.empty() ? -1 : (uint8_t)connection->readable[0];
+}
+
+bool LoopbackBroker::connected(uint32_t id) {
+    std::lock_guard<std::recursive_mutex> lock(_mutex);
+    Connection* connection = find(id);
+    if (connection == nullptr) {
+        return false;
+    }
+    // Like a socket: still "connected" while unread data is left
+    return connection->open || !connection->readable.empty() || !connection->outgoing.empty();
+}
+
+void LoopbackBroker::close(uint32_t id) {
+    std::lock_guard<std::recursive_mutex> lock(_mutex);
+    Connection* connection = find(id);
+    if (connection != nullptr) {
+        *connection = Connection();
+    }
+}
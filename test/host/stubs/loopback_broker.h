@@ -0,0 +1,137 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+#include "IPAddress.h"
+
+// ============================================
+// LOOPBACK BROKER
+// ============================================
+// In-process MQTT 3.1.1 / 5 broker behind WiFiClient: every connection to
+// HostNetwork::brokerAddress lands here. It parses what the firmware
+// writes, records every packet and answers CONNECT, PUBLISH (QoS 1),
+// SUBSCRIBE and PINGREQ like a broker would, optionally late, wrong or not
+// at all. Answers are delivered ackDelayMs after the request (emulated
+// millis()), so tests can check timeouts without waiting for them.
+
+// MQTT control packet types (high nibble of the first byte)
+enum MqttPacketType : uint8_t {
+    MQTT_PKT_CONNECT = 1,
+    MQTT_PKT_CONNACK = 2,
+    MQTT_PKT_PUBLISH = 3,
+    MQTT_PKT_PUBACK = 4,
+    MQTT_PKT_SUBSCRIBE = 8,
+    MQTT_PKT_SUBACK = 9,
+    MQTT_PKT_PINGREQ = 12,
+    MQTT_PKT_PINGRESP = 13,
+    MQTT_PKT_DISCONNECT = 14,
+};
+
+// A packet the firmware sent
+struct BrokerPacket {
+    uint8_t type = 0;
+    uint8_t qos = 0;
+    bool retain = false;
+    bool dup = false;
+    uint16_t packetId = 0;
+    std::string topic;        // PUBLISH (MQTT 5 aliases resolved), first SUBSCRIBE filter
+    uint16_t alias = 0;       // MQTT 5 Topic Alias property, 0 = none
+    bool aliasOnly = false;   // MQTT 5: sent with an empty topic name
+    std::string payload;
+    uint32_t size = 0;        // Whole packet in bytes
+    uint32_t connection = 0;
+    // CONNECT
+    uint8_t protocol = 0;     // 4 = 3.1.1, 5 = MQTT 5
+    bool cleanSession = true;
+    uint16_t keepAlive = 0;
+    std::string clientId;
+    std::string username;
+};
+
+class LoopbackBroker {
+public:
+    static LoopbackBroker& instance();
+    
+    // Behaviour (reset() restores these defaults)
+    uint32_t ackDelayMs = 0;        // Delay of every answer
+    bool dropAcks = false;          // Never send PUBACK
+    int32_t ackLimit = -1;          // PUBACKs per connection, then none (-1: no limit)
+    uint8_t connackCode = 0;        // Non-zero: refuse the CONNECT and close
+    bool respondPing = true;        // Answer PINGREQ
+    bool keepSessions = true;       // Keep sessions of clients connecting without clean session
+    uint16_t aliasMax = 10;         // MQTT 5 Topic Alias Maximum in the CONNACK
+    uint16_t serverKeepAlive = 0;   // MQTT 5 Server Keep Alive in the CONNACK, 0 = not sent
+    bool online = true;             // Accept connections
+    std::string failTopic;          // A PUBLISH write to this topic fails; the connection stays open
+    
+    void reset();                   // Defaults, no connections, no records, no sessions
+    void clearRecords();            // Forget packets and counters only
+    void dropConnection();          // Close the open connection from the broker side
+    
+    // Records
+    std::vector<BrokerPacket> packets();
+    std::vector<BrokerPacket> published(const std::string& topicPrefix = "");
+    int count(uint8_t type);
+    uint32_t connections();         // TCP connections accepted
+    uint32_t clientWrites();        // write() calls by the firmware
+    uint32_t clientBytes();         // Bytes written by the firmware
+    
+    // Send a PUBLISH (QoS 0) to the connected client
+    void inject(const std::string& topic, const std::string& payload);
+    
+    // Socket side, used by WiFiClient
+    uint32_t open(IPAddress address, uint16_t port);
+    size_t receive(uint32_t connection, const uint8_t* data, size_t length);
+    int available(uint32_t connection);
+    int read(uint32_t connection, uint8_t* buffer, size_t length);
+    int peek(uint32_t connection);
+    bool connected(uint32_t connection);
+    void close(uint32_t connection);
+
+private:
+    struct Outgoing {
+        unsigned long dueMs;
+        std::string bytes;
+    };
+    struct Connection {
+        uint32_t id = 0;
+        bool open = false;
+        bool refused = false;            // CONNECT refused: ignore the rest
+        uint8_t protocol = 4;
+        std::string rx;                  // Received, not parsed yet
+        std::string readable;            // Delivered to the client, not read yet
+        int32_t acksSent = 0;
+        std::vector<Outgoing> outgoing;  // Answers not due yet
+        std::map<uint16_t, std::string> aliases;
+    };
+    
+    LoopbackBroker() {}
+    void parse(Connection& connection);
+    void handle(Connection& connection, uint8_t header, const std::string& body, uint32_t size);
+    void send(Connection& connection, const std::string& bytes);
+    void deliver(Connection& connection);
+    Connection* find(uint32_t id);
+    
+    std::recursive_mutex _mutex;
+    Connection _connection;              // One client at a time
+    uint32_t _nextId = 1;
+    std::vector<BrokerPacket> _packets;
+    std::set<std::string> _sessions;     // Client IDs with a kept session
+    uint32_t _connections = 0;
+    uint32_t _writes = 0;
+    uint32_t _bytes = 0;
+};
+
+// WiFi link and DNS seen by the firmware
+struct HostNetwork {
+    static bool wifiConnected;          // WiFi.status()
+    static bool dnsWorks;               // WiFi.hostByName() succeeds
+    static IPAddress brokerAddress;     // DNS answer; the only address the broker listens on
+    static uint32_t dnsDelayMs;         // Emulated time per lookup
+    static uint32_t dnsLookups;
+    static void reset();
+};
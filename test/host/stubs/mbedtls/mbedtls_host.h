@@ -0,0 +1,131 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Stand-in for mbedtls: no cryptography, records go over the transport in
+// plain text (the loopback broker speaks plain MQTT either way). What the
+// TLS client depends on is modelled: certificate verification with the
+// configured authmode and CA, and session save/load/resumption.
+// HostTls (below) sets what the "server" does.
+
+#define MBEDTLS_SSL_SESSION_TICKETS
+#define MBEDTLS_SSL_PROTO_TLS1_3
+#define MBEDTLS_SSL_KEEP_PEER_CERTIFICATE  // ESP-IDF default
+
+#define MBEDTLS_ERR_NET_CONN_RESET -0x0050
+#define MBEDTLS_ERR_SSL_BUFFER_TOO_SMALL -0x6A00
+#define MBEDTLS_ERR_SSL_WANT_READ -0x6900
+#define MBEDTLS_ERR_SSL_WANT_WRITE -0x6880
+#define MBEDTLS_ERR_SSL_BAD_INPUT_DATA -0x7100
+#define MBEDTLS_ERR_SSL_HANDSHAKE_FAILURE -0x7080
+#define MBEDTLS_ERR_X509_CERT_VERIFY_FAILED -0x2700
+#define MBEDTLS_X509_BADCERT_NOT_TRUSTED 0x08
+
+#define MBEDTLS_SSL_IS_CLIENT 0
+#define MBEDTLS_SSL_TRANSPORT_STREAM 0
+#define MBEDTLS_SSL_PRESET_DEFAULT 0
+#define MBEDTLS_SSL_VERIFY_NONE 0
+#define MBEDTLS_SSL_VERIFY_OPTIONAL 1
+#define MBEDTLS_SSL_VERIFY_REQUIRED 2
+#define MBEDTLS_SSL_SESSION_TICKETS_ENABLED 1
+
+typedef enum { MBEDTLS_SSL_VERSION_UNKNOWN, MBEDTLS_SSL_VERSION_TLS1_2 = 0x0303, MBEDTLS_SSL_VERSION_TLS1_3 = 0x0304 } mbedtls_ssl_protocol_version;
+
+typedef int (*mbedtls_ssl_send_t)(void* ctx, const unsigned char* buf, size_t len);
+typedef int (*mbedtls_ssl_recv_t)(void* ctx, unsigned char* buf, size_t len);
+typedef int (*mbedtls_ssl_recv_timeout_t)(void* ctx, unsigned char* buf, size_t len, uint32_t timeout);
+
+struct mbedtls_x509_crt {
+    bool parsed;
+};
+
+struct mbedtls_entropy_context {
+    int unused;
+};
+
+struct mbedtls_ctr_drbg_context {
+    bool seeded;
+};
+
+struct mbedtls_ssl_session {
+    uint32_t id;  // 0 = empty
+    uint32_t serializedSize;
+};
+
+struct mbedtls_ssl_config {
+    int authmode;
+    mbedtls_x509_crt* ca;
+    int (*verify)(void*, mbedtls_x509_crt*, int, uint32_t*);
+    void* verifyContext;
+    bool defaults;
+};
+
+struct mbedtls_ssl_context {
+    const mbedtls_ssl_config* conf;
+    void* bio;
+    mbedtls_ssl_send_t send;
+    mbedtls_ssl_recv_t recv;
+    bool handshakeDone;
+    mbedtls_ssl_session offered;
+    mbedtls_ssl_session session;
+    unsigned char pending[512];  // Received plaintext not read yet
+    size_t pendingStart;
+    size_t pendingEnd;
+};
+
+// What the other end of every handshake does
+struct HostTls {
+    static bool certificateTrusted;      // Server chain verifies against the configured CA
+    static bool resumeSessions;          // Server accepts an offered session
+    static uint32_t sessionBytes;        // Serialized session size (incl. the kept peer certificate)
+    static uint32_t handshakes;          // Completed handshakes
+    static uint32_t resumed;
+    static uint32_t verifyFailures;      // Handshakes aborted by certificate verification
+    static void reset();
+};
+
+void mbedtls_ssl_init(mbedtls_ssl_context* ssl);
+void mbedtls_ssl_free(mbedtls_ssl_context* ssl);
+void mbedtls_ssl_config_init(mbedtls_ssl_config* conf);
+void mbedtls_ssl_config_free(mbedtls_ssl_config* conf);
+int mbedtls_ssl_config_defaults(mbedtls_ssl_config* conf, int endpoint, int transport, int preset);
+void mbedtls_ssl_conf_authmode(mbedtls_ssl_config* conf, int authmode);
+void mbedtls_ssl_conf_ca_chain(mbedtls_ssl_config* conf, mbedtls_x509_crt* ca, void* crl);
+void mbedtls_ssl_conf_rng(mbedtls_ssl_config* conf, int (*rng)(void*, unsigned char*, size_t), void* context);
+void mbedtls_ssl_conf_verify(mbedtls_ssl_config* conf, int (*verify)(void*, mbedtls_x509_crt*, int, uint32_t*),
+                             void* context);
+void mbedtls_ssl_conf_session_tickets(mbedtls_ssl_config* conf, int useTickets);
+void mbedtls_ssl_conf_max_tls_version(mbedtls_ssl_config* conf, mbedtls_ssl_protocol_version version);
+int mbedtls_ssl_setup(mbedtls_ssl_context* ssl, const mbedtls_ssl_config* conf);
+int mbedtls_ssl_session_reset(mbedtls_ssl_context* ssl);
+int mbedtls_ssl_set_hostname(mbedtls_ssl_context* ssl, const char* hostname);
+void mbedtls_ssl_set_bio(mbedtls_ssl_context* ssl, void* bio, mbedtls_ssl_send_t send, mbedtls_ssl_recv_t recv,
+                         mbedtls_ssl_recv_timeout_t recvTimeout);
+int mbedtls_ssl_handshake(mbedtls_ssl_context* ssl);
+int mbedtls_ssl_write(mbedtls_ssl_context* ssl, const unsigned char* buf, size_t len);
+int mbedtls_ssl_read(mbedtls_ssl_context* ssl, unsigned char* buf, size_t len);
+size_t mbedtls_ssl_get_bytes_avail(const mbedtls_ssl_context* ssl);
+int mbedtls_ssl_close_notify(mbedtls_ssl_context* ssl);
+
+void mbedtls_ssl_session_init(mbedtls_ssl_session* session);
+void mbedtls_ssl_session_free(mbedtls_ssl_session* session);
+int mbedtls_ssl_get_session(const mbedtls_ssl_context* ssl, mbedtls_ssl_session* session);
+int mbedtls_ssl_set_session(mbedtls_ssl_context* ssl, const mbedtls_ssl_session* session);
+int mbedtls_ssl_session_save(const mbedtls_ssl_session* session, unsigned char* buf, size_t bufLen, size_t* olen);
+int mbedtls_ssl_session_load(mbedtls_ssl_session* session, const unsigned char* buf, size_t len);
+
+void mbedtls_entropy_init(mbedtls_entropy_context* ctx);
+void mbedtls_entropy_free(mbedtls_entropy_context* ctx);
+int mbedtls_entropy_func(void* data, unsigned char* output, size_t len);
+void mbedtls_ctr_drbg_init(mbedtls_ctr_drbg_context* ctx);
+void mbedtls_ctr_drbg_free(mbedtls_ctr_drbg_context* ctx);
+int mbedtls_ctr_drbg_seed(mbedtls_ctr_drbg_context* ctx, int (*entropy)(void*, unsigned char*, size_t),
+                          void* entropyContext, const unsigned char* custom, size_t len);
+int mbedtls_ctr_drbg_random(void* ctx, unsigned char* output, size_t len);
+
+void mbedtls_x509_crt_init(mbedtls_x509_crt* crt);
+void mbedtls_x509_crt_free(mbedtls_x509_crt* crt);
+int mbedtls_x509_crt_parse(mbedtls_x509_crt* chain, const unsigned char* buf, size_t len);
+
+void mbedtls_strerror(int errnum, char* buffer, size_t bufferLen);
@@ -0,0 +1,270 @@
+#include "mbedtls/mbedtls_host.h"
+#include <cstdio>
+#include <cstring>
+
+#define SESSION_MAGIC 0x53455353UL  // Serialized session header
+
+bool HostTls::certificateTrusted = true;
+bool HostTls::resumeSessions = true;
+uint32_t HostTls::sessionBytes = 160;
+uint32_t HostTls::handshakes = 0;
+uint32_t HostTls::resumed = 0;
+uint32_t HostTls::verifyFailures = 0;
+
+static uint32_t s_nextSessionId = 1;
+
+void HostTls::reset() {
+    certificateTrusted = true;
+    resumeSessions = true;
+    sessionBytes = 160;
+    handshakes = 0;
+    resumed = 0;
+    verifyFailures = 0;
+}
+
+void mbedtls_ssl_init(mbedtls_ssl_context* ssl) {
+    memset(ssl, 0, sizeof(*ssl));
+}
+
+void mbedtls_ssl_free(mbedtls_ssl_context* ssl) {
+    memset(ssl, 0, sizeof(*ssl));
+}
+
+void mbedtls_ssl_config_init(mbedtls_ssl_config* conf) {
+    memset(conf, 0, sizeof(*conf));
+}
+
+void mbedtls_ssl_config_free(mbedtls_ssl_config* conf) {
+    memset(conf, 0, sizeof(*conf));
+}
+
+int mbedtls_ssl_config_defaults(mbedtls_ssl_config* conf, int, int, int) {
+    conf->defaults = true;
+    conf->authmode = MBEDTLS_SSL_VERIFY_REQUIRED;  // Client default, as in mbedtls
+    return 0;
+}
+
+void mbedtls_ssl_conf_authmode(mbedtls_ssl_config* conf, int authmode) {
+    conf->authmode = authmode;
+}
+
+void mbedtls_ssl_conf_ca_chain(mbedtls_ssl_config* conf, mbedtls_x509_crt* ca, void*) {
+    conf->ca = ca;
+}
+
+void mbedtls_ssl_conf_rng(mbedtls_ssl_config*, int (*)(void*, unsigned char*, size_t), void*) {}
+
+void mbedtls_ssl_conf_verify(mbedtls_ssl_config* conf, int (*verify)(void*, mbedtls_x509_crt*, int, uint32_t*),
+                             void* context) {
+    conf->verify = verify;
+    conf->verifyContext = context;
+}
+
+void mbedtls_ssl_conf_session_tickets(mbedtls_ssl_config*, int) {}
+
+void mbedtls_ssl_conf_max_tls_version(mbedtls_ssl_config*, mbedtls_ssl_protocol_version) {}
+
+int mbedtls_ssl_setup(mbedtls_ssl_context* ssl, const mbedtls_ssl_config* conf) {
+    if (!conf->defaults) {
+        return MBEDTLS_ERR_SSL_BAD_INPUT_DATA;
+    }
+    ssl->conf = conf;
+    return 0;
+}
+
+int mbedtls_ssl_session_reset(mbedtls_ssl_context* ssl) {
+    ssl->handshakeDone = false;
+    ssl->offered = mbedtls_ssl_session();
+    ssl->session = mbedtls_ssl_session();
+    ssl->pendingStart = ssl->pendingEnd = 0;
+    return 0;
+}
+
+int mbedtls_ssl_set_hostname(mbedtls_ssl_context*, const char*) {
+    return 0;
+}
+
+void mbedtls_ssl_set_bio(mbedtls_ssl_context* ssl, void* bio, mbedtls_ssl_send_t send, mbedtls_ssl_recv_t recv,
+                         mbedtls_ssl_recv_timeout_t) {
+    ssl->bio = bio;
+    ssl->send = send;
+    ssl->recv = recv;
+}
+
+int mbedtls_ssl_handshake(mbedtls_ssl_context* ssl) {
+    if (ssl->conf == nullptr) {
+        return MBEDTLS_ERR_SSL_BAD_INPUT_DATA;
+    }
+    if (ssl->offered.id != 0 && HostTls::resumeSessions) {
+        // Abbreviated handshake: no Certificate message, no verification
+        ssl->session = ssl->offered;
+        HostTls::resumed++;
+    } else {
+        const mbedtls_ssl_config* conf = ssl->conf;
+        uint32_t flags = conf->ca != nullptr && conf->ca->parsed && HostTls::certificateTrusted
+                             ? 0
+                             : MBEDTLS_X509_BADCERT_NOT_TRUSTED;
+        if (conf->verify != nullptr) {
+            mbedtls_x509_crt peer = {true};
+            int ret = conf->verify(conf->verifyContext, &peer, 0, &flags);
+            if (ret != 0) {
+                HostTls::verifyFailures++;
+                return ret;
+            }
+        }
+        if (flags != 0 && conf->authmode == MBEDTLS_SSL_VERIFY_REQUIRED) {
+            HostTls::verifyFailures++;
+            return MBEDTLS_ERR_X509_CERT_VERIFY_FAILED;
+        }
+        ssl->session.id = s_nextSessionId++;
+        ssl->session.serializedSize = HostTls::sessionBytes;
+    }
+    ssl->handshakeDone = true;
+    HostTls::handshakes++;
+    return 0;
+}
+
+int mbedtls_ssl_write(mbedtls_ssl_context* ssl, const unsigned char* buf, size_t len) {
+    if (!ssl->handshakeDone) {
+        return MBEDTLS_ERR_SSL_BAD_INPUT_DATA;
+    }
+    return ssl->send(ssl->bio, buf, len);
+}
+
+int mbedtls_ssl_read(mbedtls_ssl_context* ssl, unsigned char* buf, size_t len) {
+    if (!ssl->handshakeDone) {
+        return MBEDTLS_ERR_SSL_BAD_INPUT_DATA;
+    }
+    if (ssl->pendingStart == ssl->pendingEnd) {
+        int ret = ssl->recv(ssl->bio, ssl->pending, sizeof(ssl->pending));
+        if (ret < 0) {
+            return ret;
+        }
+        ssl->pendingStart = 0;
+        ssl->pendingEnd = (size_t)ret;
+    }
+    size_t count = ssl->pendingEnd - ssl->pendingStart;
+    if (count > len) {
+        count = len;
+    }
+    if (count > 0) {
+        memcpy(buf, ssl->pending + ssl->pendingStart, count);
+        ssl->pendingStart += count;
+    }
+    return (int)count;
+}
+
+size_t mbedtls_ssl_get_bytes_avail(const mbedtls_ssl_context* ssl) {
+    return ssl->pendingEnd - ssl->pendingStart;
+}
+
+int mbedtls_ssl_close_notify(mbedtls_ssl_context* ssl) {
+    ssl->handshakeDone = false;
+    return 0;
+}
+
+void mbedtls_ssl_session_init(mbedtls_ssl_session* session) {
+    *session = mbedtls_ssl_session();
+}
+
+void mbedtls_ssl_session_free(mbedtls_ssl_session* session) {
+    *session = mbedtls_ssl_session();
+}
+
+int mbedtls_ssl_get_session(const mbedtls_ssl_context* ssl, mbedtls_ssl_session* session) {
+    if (!ssl->handshakeDone || ssl->session.id == 0) {
+        return MBEDTLS_ERR_SSL_BAD_INPUT_DATA;
+    }
+    *session = ssl->session;
+    return 0;
+}
+
+int mbedtls_ssl_set_session(mbedtls_ssl_context* ssl, const mbedtls_ssl_session* session) {
+    if (session->id == 0) {
+        return MBEDTLS_ERR_SSL_BAD_INPUT_DATA;
+    }
+    ssl->offered = *session;
+    return 0;
+}
+
+// Serialized form: magic, id, then padding up to the modelled size
+int mbedtls_ssl_session_save(const mbedtls_ssl_session* session, unsigned char* buf, size_t bufLen, size_t* olen) {
+    size_t size = session->serializedSize < 12 ? 12 : session->serializedSize;
+    *olen = size;
+    if (bufLen < size) {
+        return MBEDTLS_ERR_SSL_BUFFER_TOO_SMALL;
+    }
+    uint32_t header[3] = {SESSION_MAGIC, session->id, (uint32_t)size};
+    memset(buf, 0, size);
+    memcpy(buf, header, sizeof(header));
+    return 0;
+}
+
+int mbedtls_ssl_session_load(mbedtls_ssl_session* session, const unsigned char* buf, size_t len) {
+    uint32_t header[3];
+    if (len < sizeof(header)) {
+        return MBEDTLS_ERR_SSL_BAD_INPUT_DATA;
+    }
+    memcpy(header, buf, sizeof(header));
+    if (header[0] != SESSION_MAGIC || header[2] != len) {
+        return MBEDTLS_ERR_SSL_BAD_INPUT_DATA;
+    }
+    session->id = header[1];
+    session->serializedSize = header[2];
+    return 0;
+}
+
+void mbedtls_entropy_init(mbedtls_entropy_context*) {}
+
+void mbedtls_entropy_free(mbedtls_entropy_context*) {}
+
+int mbedtls_entropy_func(void*, unsigned char* output, size_t len) {
+    memset(output, 0x5A, len);
+    return 0;
+}
+
+void mbedtls_ctr_drbg_init(mbedtls_ctr_drbg_context* ctx) {
+    ctx->seeded = false;
+}
+
+void mbedtls_ctr_drbg_free(mbedtls_ctr_drbg_context* ctx) {
+    ctx->seeded = false;
+}
+
+int mbedtls_ctr_drbg_seed(mbedtls_ctr_drbg_context* ctx, int (*)(void*, unsigned char*, size_t), void*,
+                          const unsigned char*, size_t) {
+    ctx->seeded = true;
+    return 0;
+}
+
+int mbedtls_ctr_drbg_random(void*, unsigned char* output, size_t len) {
+    memset(output, 0xA5, len);
+    return 0;
+}
+
+void mbedtls_x509_crt_init(mbedtls_x509_crt* crt) {
+    crt->parsed = false;
+}
+
+void mbedtls_x509_crt_free(mbedtls_x509_crt* crt) {
+    crt->parsed = false;
+}
+
+int mbedtls_x509_crt_parse(mbedtls_x509_crt* chain, const unsigned char* buf, size_t len) {
+    if (len == 0 || strstr((const char*)buf, "-----BEGIN CERTIFICATE-----") == nullptr) {
+        return -0x2180;  // MBEDTLS_ERR_X509_INVALID_FORMAT
+    }
+    chain->parsed = true;
+    return 0;
+}
+
+void mbedtls_strerror(int errnum, char* buffer, size_t bufferLen) {
+    const char* text = "unknown error";
+    switch (errnum) {
+        case MBEDTLS_ERR_X509_CERT_VERIFY_FAILED: text = "X509 - Certificate verification failed"; break;
+        case MBEDTLS_ERR_SSL_BUFFER_TOO_SMALL: text = "SSL - Buffer too small"; break;
+        case MBEDTLS_ERR_NET_CONN_RESET: text = "NET - Connection was reset by peer"; break;
+        case MBEDTLS_ERR_SSL_BAD_INPUT_DATA: text = "SSL - Bad input parameters to function"; break;
+    }
+    snprintf(buffer, bufferLen, "%s", text);
+}
@@ -0,0 +1,595 @@
+#include "nvs_emulator.h"
+#include "host_platform.h"
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+
+// Page and entry states as stored in flash (bits are only ever cleared
+// until the page is erased)
+static const uint32_t PAGE_EMPTY = 0xFFFFFFFF;
+static const uint32_t PAGE_ACTIVE = 0xFFFFFFFE;
+static const uint32_t PAGE_FULL = 0xFFFFFFFC;
+static const uint32_t PAGE_FREEING = 0xFFFFFFF8;
+
+static const uint8_t ENTRY_EMPTY = 3;
+static const uint8_t ENTRY_WRITTEN = 2;
+static const uint8_t ENTRY_ERASED = 0;
+
+static const size_t PAGE_HEADER_SIZE = 32;
+static const size_t PAGE_BITMAP_SIZE = 32;
+static const uint8_t NAMESPACE_INDEX = 0;  // Namespace names are items of namespace 0
+static const uint8_t CHUNK_ANY = 0xFF;
+
+// Entry header fields
+static const size_t ENTRY_NS = 0;
+static const size_t ENTRY_TYPE = 1;
+static const size_t ENTRY_SPAN = 2;
+static const size_t ENTRY_CHUNK = 3;
+static const size_t ENTRY_KEY = 8;
+static const size_t ENTRY_KEY_SIZE = 16;
+static const size_t ENTRY_DATA = 24;
+
+static uint8_t s_image[NVS_EMU_PAGES][NVS_EMU_PAGE_SIZE];
+static uint32_t s_pageErases[NVS_EMU_PAGES];  // Lifetime erase count per sector (kept beside the image)
+
+static uint32_t pageState(int page) {
+    uint32_t state;
+    memcpy(&state, s_image[page], sizeof(state));
+    return state;
+}
+
+static uint32_t pageSequence(int page) {
+    uint32_t sequence;
+    memcpy(&sequence, s_image[page] + 4, sizeof(sequence));
+    return sequence;
+}
+
+static uint8_t* entryAt(int page, int entry) {
+    return s_image[page] + PAGE_HEADER_SIZE + PAGE_BITMAP_SIZE + entry * NVS_EMU_ENTRY_SIZE;
+}
+
+static uint8_t entryState(int page, int entry) {
+    const uint8_t* bitmap = s_image[page] + PAGE_HEADER_SIZE;
+    return (bitmap[entry / 4] >> ((entry % 4) * 2)) & 3;
+}
+
+static void setEntryState(int page, int entry, uint8_t state) {
+    uint8_t* bitmap = s_image[page] + PAGE_HEADER_SIZE;
+    int shift = (entry % 4) * 2;
+    bitmap[entry / 4] = (uint8_t)((bitmap[entry / 4] & ~(3 << shift)) | (state << shift));
+}
+
+static int usedEntries(int page) {
+    int used = 0;
+    while (used < NVS_EMU_PAGE_ENTRIES && entryState(page, used) != ENTRY_EMPTY) {
+        used++;
+    }
+    return used;
+}
+
+static int erasedEntries(int page) {
+    int erased = 0;
+    for (int i = 0; i < NVS_EMU_PAGE_ENTRIES; i++) {
+        erased += entryState(page, i) == ENTRY_ERASED;
+    }
+    return erased;
+}
+
+static bool isDataPage(int page) {
+    uint32_t state = pageState(page);
+    return state == PAGE_ACTIVE || state == PAGE_FULL;
+}
+
+static int activePage() {
+    for (int page = 0; page < NVS_EMU_PAGES; page++) {
+        if (pageState(page) == PAGE_ACTIVE) {
+            return page;
+        }
+    }
+    return -1;
+}
+
+static bool keyMatches(const uint8_t* header, uint8_t ns, const char* key, uint8_t type, uint8_t chunk) {
+    return header[ENTRY_NS] == ns && header[ENTRY_TYPE] == type &&
+           (chunk == CHUNK_ANY || header[ENTRY_CHUNK] == chunk) &&
+           strncmp((const char*)header + ENTRY_KEY, key, ENTRY_KEY_SIZE) == 0;
+}
+
+static int dataSpan(size_t length) {
+    return (int)((length + NVS_EMU_ENTRY_SIZE - 1) / NVS_EMU_ENTRY_SIZE);
+}
+
+static bool isVariableLength(uint8_t type) {
+    return type == NVS_TYPE_STR || type == NVS_TYPE_BLOB_DATA;
+}
+
+static size_t primitiveSize(uint8_t type) {
+    return type & 0x0F;
+}
+
+static void buildHeader(uint8_t* header, uint8_t ns, const char* key, uint8_t type, uint8_t span, uint8_t chunk) {
+    memset(header, 0xFF, NVS_EMU_ENTRY_SIZE);
+    header[ENTRY_NS] = ns;
+    header[ENTRY_TYPE] = type;
+    header[ENTRY_SPAN] = span;
+    header[ENTRY_CHUNK] = chunk;
+    memset(header + 4, 0, 4);  // Header CRC - not checked by the emulator
+    memset(header + ENTRY_KEY, 0, ENTRY_KEY_SIZE);
+    strncpy((char*)header + ENTRY_KEY, key, ENTRY_KEY_SIZE - 1);
+}
+
+NvsFlash& NvsFlash::instance() {
+    static NvsFlash flash;
+    return flash;
+}
+
+void NvsFlash::load() {
+    if (_loaded) {
+        return;
+    }
+    _loaded = true;
+    _dirty = false;
+    memset(s_image, 0xFF, sizeof(s_image));
+    memset(s_pageErases, 0, sizeof(s_pageErases));
+    
+    FILE* file = fopen(host::statePath("nvs.bin").c_str(), "rb");
+    if (file == nullptr) {
+        return;  // Erased partition
+    }
+    if (fread(s_image, 1, sizeof(s_image), file) != sizeof(s_image) ||
+        fread(s_pageErases, 1, sizeof(s_pageErases), file) != sizeof(s_pageErases)) {
+        memset(s_image, 0xFF, sizeof(s_image));
+        memset(s_pageErases, 0, sizeof(s_pageErases));
+    }
+    fclose(file);
+}
+
+void NvsFlash::commitState() {
+    _dirty = true;
+}
+
+void NvsFlash::sync() {
+    if (!_loaded || !_dirty) {
+        return;
+    }
+    FILE* file = fopen(host::statePath("nvs.bin").c_str(), "wb");
+    if (file == nullptr) {
+        perror("nvs.bin");
+        return;
+    }
+    fwrite(s_image, 1, sizeof(s_image), file);
+    fwrite(s_pageErases, 1, sizeof(s_pageErases), file);
+    fclose(file);
+    _dirty = false;
+}
+
+void NvsFlash::invalidate() {
+    sync();
+    _loaded = false;
+}
+
+void NvsFlash::format() {
+    _loaded = true;
+    memset(s_image, 0xFF, sizeof(s_image));
+    memset(s_pageErases, 0, sizeof(s_pageErases));
+    _dirty = true;
+    sync();
+}
+
+bool NvsFlash::locate(uint8_t ns, const char* key, uint8_t type, Location& location) {
+    load();
+    uint8_t chunk = CHUNK_ANY;
+    if (type == NVS_TYPE_BLOB_DATA) {
+        // Data chunk of the current blob version, named by its index entry
+        Location index;
+        if (!locate(ns, key, NVS_TYPE_BLOB_IDX, index)) {
+            return false;
+        }
+        chunk = entryAt(index.page, index.entry)[ENTRY_DATA + 5];
+    }
+    
+    // Oldest page first; a key has at most one live item of a type
+    for (int page = 0; page < NVS_EMU_PAGES; page++) {
+        if (!isDataPage(page)) {
+            continue;
+        }
+        for (int entry = 0; entry < NVS_EMU_PAGE_ENTRIES;) {
+            uint8_t state = entryState(page, entry);
+            if (state == ENTRY_EMPTY) {
+                break;  // Append-only: nothing after the first empty entry
+            }
+            const uint8_t* header = entryAt(page, entry);
+            int span = header[ENTRY_SPAN] > 0 ? header[ENTRY_SPAN] : 1;
+            if (state == ENTRY_WRITTEN && keyMatches(header, ns, key, type, chunk)) {
+                location = {page, entry};
+                return true;
+            }
+            entry += span;
+        }
+    }
+    return false;
+}
+
+bool NvsFlash::requestPage() {
+    int empty = 0;
+    int freePage = -1;
+    uint32_t sequence = 0;
+    for (int page = 0; page < NVS_EMU_PAGES; page++) {
+        if (pageState(page) == PAGE_EMPTY) {
+            empty++;
+            if (freePage < 0) {
+                freePage = page;
+            }
+        } else if (isDataPage(page) && pageSequence(page) >= sequence) {
+            sequence = pageSequence(page) + 1;
+        }
+    }
+    if (freePage < 0) {
+        return false;
+    }
+    
+    int victim = -1;
+    if (empty == 1) {
+        // Only the reserve page is left: reclaim the page with the most
+        // erased entries by moving its live items into the reserve
+        int mostErased = 0;
+        for (int page = 0; page < NVS_EMU_PAGES; page++) {
+            int erased = pageState(page) == PAGE_FULL ? erasedEntries(page) : 0;
+            if (erased > mostErased) {
+                mostErased = erased;
+                victim = page;
+            }
+        }
+        if (victim < 0) {
+            return false;  // Nothing to reclaim - the partition is full
+        }
+    }
+    
+    uint32_t state = PAGE_ACTIVE;
+    memcpy(s_image[freePage], &state, sizeof(state));
+    memcpy(s_image[freePage] + 4, &sequence, sizeof(sequence));
+    _stats.flashMicros += NVS_EMU_STATE_US;
+    
+    if (victim >= 0) {
+        state = PAGE_FREEING;
+        memcpy(s_image[victim], &state, sizeof(state));
+        _stats.flashMicros += NVS_EMU_STATE_US;
+        int target = 0;
+        for (int entry = 0; entry < NVS_EMU_PAGE_ENTRIES; entry++) {
+            if (entryState(victim, entry) != ENTRY_WRITTEN) {
+                continue;
+            }
+            memcpy(entryAt(freePage, target), entryAt(victim, entry), NVS_EMU_ENTRY_SIZE);
+            setEntryState(freePage, target++, ENTRY_WRITTEN);
+            _stats.entriesRead++;
+            _stats.entriesWritten++;
+            _stats.flashMicros += NVS_EMU_READ_US_PER_ENTRY + NVS_EMU_PROGRAM_US_PER_ENTRY + NVS_EMU_STATE_US;
+        }
+        memset(s_image[victim], 0xFF, NVS_EMU_PAGE_SIZE);
+        s_pageErases[victim]++;
+        _stats.pageErases++;
+        _stats.flashMicros += NVS_EMU_ERASE_US;
+    }
+    commitState();
+    return true;
+}
+
+bool NvsFlash::append(const uint8_t* entries, int span, Location* where) {
+    if (span > NVS_EMU_PAGE_ENTRIES) {
+        return false;
+    }
+    for (int attempt = 0; attempt <= NVS_EMU_PAGES; attempt++) {
+        int page = activePage();
+        if (page >= 0 && NVS_EMU_PAGE_ENTRIES - usedEntries(page) >= span) {
+            int first = usedEntries(page);
+            for (int i = 0; i < span; i++) {
+                memcpy(entryAt(page, first + i), entries + i * NVS_EMU_ENTRY_SIZE, NVS_EMU_ENTRY_SIZE);
+                setEntryState(page, first + i, ENTRY_WRITTEN);
+            }
+            _stats.entriesWritten += span;
+            _stats.flashMicros += span * NVS_EMU_PROGRAM_US_PER_ENTRY + NVS_EMU_STATE_US;
+            if (where) {
+                *where = {page, first};
+            }
+            commitState();
+            return true;
+        }
+        if (page >= 0) {
+            uint32_t full = PAGE_FULL;
+            memcpy(s_image[page], &full, sizeof(full));
+            _stats.flashMicros += NVS_EMU_STATE_US;
+        }
+        if (!requestPage()) {
+            return false;
+        }
+    }
+    return false;
+}
+
+void NvsFlash::eraseItem(const Location& location) {
+    int span = entryAt(location.page, location.entry)[ENTRY_SPAN];
+    for (int i = 0; i < span; i++) {
+        setEntryState(location.page, location.entry + i, ENTRY_ERASED);
+    }
+    _stats.entriesErased += span;
+    _stats.flashMicros += NVS_EMU_STATE_US;
+    commitState();
+}
+
+bool NvsFlash::open(const char* name, bool readOnly, uint8_t& index) {
+    load();
+    _stats.opens++;
+    if (strlen(name) >= ENTRY_KEY_SIZE) {
+        return false;
+    }
+    
+    // The namespace table is cached in RAM by IDF - no flash read
+    uint8_t highest = 0;
+    for (int page = 0; page < NVS_EMU_PAGES; page++) {
+        if (!isDataPage(page)) {
+            continue;
+        }
+        for (int entry = 0; entry < NVS_EMU_PAGE_ENTRIES;) {
+            if (entryState(page, entry) == ENTRY_EMPTY) {
+                break;
+            }
+            const uint8_t* header = entryAt(page, entry);
+            if (entryState(page, entry) == ENTRY_WRITTEN && header[ENTRY_NS] == NAMESPACE_INDEX) {
+                if (header[ENTRY_DATA] > highest) {
+                    highest = header[ENTRY_DATA];
+                }
+                if (strncmp((const char*)header + ENTRY_KEY, name, ENTRY_KEY_SIZE) == 0) {
+                    index = header[ENTRY_DATA];
+                    return true;
+                }
+            }
+            entry += header[ENTRY_SPAN] > 0 ? header[ENTRY_SPAN] : 1;
+        }
+    }
+    if (readOnly || highest == 0xFE) {
+        return false;
+    }
+    
+    uint8_t header[NVS_EMU_ENTRY_SIZE];
+    buildHeader(header, NAMESPACE_INDEX, name, NVS_TYPE_U8, 1, CHUNK_ANY);
+    header[ENTRY_DATA] = highest + 1;
+    if (!append(header, 1)) {
+        return false;
+    }
+    _stats.writes++;
+    index = highest + 1;
+    return true;
+}
+
+bool NvsFlash::find(uint8_t ns, const char* key, uint8_t* type, size_t* length) {
+    _stats.reads++;
+    static const uint8_t kTypes[] = {NVS_TYPE_U8, NVS_TYPE_I8, NVS_TYPE_U16, NVS_TYPE_I16, NVS_TYPE_U32,
+                                     NVS_TYPE_I32, NVS_TYPE_U64, NVS_TYPE_I64, NVS_TYPE_STR, NVS_TYPE_BLOB_IDX};
+    for (uint8_t candidate : kTypes) {
+        Location location;
+        if (!locate(ns, key, candidate, location)) {
+            continue;
+        }
+        const uint8_t* header = entryAt(location.page, location.entry);
+        _stats.entriesRead++;
+        _stats.flashMicros += NVS_EMU_READ_US_PER_ENTRY;
+        if (type) {
+            *type = candidate == NVS_TYPE_BLOB_IDX ? NVS_TYPE_BLOB_DATA : candidate;
+        }
+        if (length) {
+            uint32_t size = 0;
+            if (candidate == NVS_TYPE_STR) {
+                size = header[ENTRY_DATA] | (header[ENTRY_DATA + 1] << 8);
+            } else if (candidate == NVS_TYPE_BLOB_IDX) {
+                memcpy(&size, header + ENTRY_DATA, sizeof(size));
+            } else {
+                size = primitiveSize(candidate);
+            }
+            *length = size;
+        }
+        return true;
+    }
+    return false;
+}
+
+bool NvsFlash::read(uint8_t ns, const char* key, uint8_t type, void* buffer, size_t length) {
+    _stats.reads++;
+    Location location;
+    if (!locate(ns, key, type, location)) {
+        return false;
+    }
+    const uint8_t* header = entryAt(location.page, location.entry);
+    if (!isVariableLength(type)) {
+        if (length != primitiveSize(type)) {
+            return false;
+        }
+        memcpy(buffer, header + ENTRY_DATA, length);
+        _stats.entriesRead++;
+        _stats.flashMicros += NVS_EMU_READ_US_PER_ENTRY;
+        return true;
+    }
+    
+    size_t size = header[ENTRY_DATA] | (header[ENTRY_DATA + 1] << 8);
+    if (length < size) {
+        return false;
+    }
+    memcpy(buffer, header + NVS_EMU_ENTRY_SIZE, size);
+    int span = header[ENTRY_SPAN] + (type == NVS_TYPE_BLOB_DATA ? 1 : 0);  // + blob index
+    _stats.entriesRead += span;
+    _stats.flashMicros += span * NVS_EMU_READ_US_PER_ENTRY;
+    return true;
+}
+
+bool NvsFlash::sameValue(const Location& location, uint8_t type, const void* value, size_t length) {
+    const uint8_t* header = entryAt(location.page, location.entry);
+    _stats.entriesRead++;
+    _stats.flashMicros += NVS_EMU_READ_US_PER_ENTRY;
+    if (!isVariableLength(type)) {
+        return memcmp(header + ENTRY_DATA, value, length) == 0;
+    }
+    size_t size = header[ENTRY_DATA] | (header[ENTRY_DATA + 1] << 8);
+    if (size != length) {
+        return false;
+    }
+    _stats.entriesRead += dataSpan(size);
+    _stats.flashMicros += dataSpan(size) * NVS_EMU_READ_US_PER_ENTRY;
+    return memcmp(header + NVS_EMU_ENTRY_SIZE, value, length) == 0;
+}
+
+bool NvsFlash::write(uint8_t ns, const char* key, uint8_t type, const void* value, size_t length) {
+    load();
+    if (strlen(key) >= ENTRY_KEY_SIZE || (isVariableLength(type) && length > MAX_ITEM_SIZE)) {
+        return false;
+    }
+    
+    uint8_t itemType = type == NVS_TYPE_BLOB_DATA ? NVS_TYPE_BLOB_IDX : type;
+    Location old;
+    bool exists = locate(ns, key, itemType, old);
+    Location oldData;
+    if (exists && type == NVS_TYPE_BLOB_DATA) {
+        exists = locate(ns, key, NVS_TYPE_BLOB_DATA, oldData);
+    }
+    if (exists && sameValue(type == NVS_TYPE_BLOB_DATA ? oldData : old, type, value, length)) {
+        _stats.skippedWrites++;
+        return true;
+    }
+    
+    uint8_t oldChunk = exists && type == NVS_TYPE_BLOB_DATA ? entryAt(old.page, old.entry)[ENTRY_DATA + 5] : 0;
+    uint8_t entries[NVS_EMU_PAGE_ENTRIES * NVS_EMU_ENTRY_SIZE];
+    Location written;
+    if (!isVariableLength(type)) {
+        buildHeader(entries, ns, key, type, 1, CHUNK_ANY);
+        memcpy(entries + ENTRY_DATA, value, length);
+        if (!append(entries, 1, &written)) {
+            return false;
+        }
+    } else {
+        // Strings and blob chunks: header + data entries. A new blob version
+        // alternates its chunk index so the old one stays valid until the
+        // new index entry is written.
+        uint8_t chunk = CHUNK_ANY;
+        if (type == NVS_TYPE_BLOB_DATA) {
+            chunk = exists ? (uint8_t)(oldChunk ^ 0x80) : 0;
+        }
+        int span = 1 + dataSpan(length);
+        buildHeader(entries, ns, key, type, (uint8_t)span, chunk);
+        entries[ENTRY_DATA] = length & 0xFF;
+        entries[ENTRY_DATA + 1] = (length >> 8) & 0xFF;
+        memset(entries + NVS_EMU_ENTRY_SIZE, 0xFF, (span - 1) * NVS_EMU_ENTRY_SIZE);
+        memcpy(entries + NVS_EMU_ENTRY_SIZE, value, length);
+        if (!append(entries, span, &written)) {
+            return false;
+        }
+        if (type == NVS_TYPE_BLOB_DATA) {
+            uint32_t size = (uint32_t)length;
+            buildHeader(entries, ns, key, NVS_TYPE_BLOB_IDX, 1, CHUNK_ANY);
+            memcpy(entries + ENTRY_DATA, &size, sizeof(size));
+            entries[ENTRY_DATA + 4] = 1;      // Chunk count
+            entries[ENTRY_DATA + 5] = chunk;  // Chunk start
+            if (!append(entries, 1, &written)) {
+                return false;
+            }
+        }
+    }
+    
+    // The new item is complete - drop the old one. Garbage collection may
+    // have moved it, so it is found again rather than by its old location.
+    if (exists) {
+        eraseStale(ns, key, itemType, CHUNK_ANY, written);
+        if (type == NVS_TYPE_BLOB_DATA) {
+            eraseStale(ns, key, NVS_TYPE_BLOB_DATA, oldChunk, {-1, -1});
+        }
+    }
+    _stats.writes++;
+    return true;
+}
+
+void NvsFlash::eraseStale(uint8_t ns, const char* key, uint8_t type, uint8_t chunk, const Location& keep) {
+    for (int page = 0; page < NVS_EMU_PAGES; page++) {
+        if (!isDataPage(page)) {
+            continue;
+        }
+        for (int entry = 0; entry < NVS_EMU_PAGE_ENTRIES;) {
+            uint8_t state = entryState(page, entry);
+            if (state == ENTRY_EMPTY) {
+                break;
+            }
+            const uint8_t* header = entryAt(page, entry);
+            int span = header[ENTRY_SPAN] > 0 ? header[ENTRY_SPAN] : 1;
+            if (state == ENTRY_WRITTEN && keyMatches(header, ns, key, type, chunk) &&
+                !(page == keep.page && entry == keep.entry)) {
+                eraseItem({page, entry});
+            }
+            entry += span;
+        }
+    }
+}
+
+bool NvsFlash::erase(uint8_t ns, const char* key) {
+    Location location;
+    bool found = false;
+    while (locate(ns, key, NVS_TYPE_BLOB_DATA, location)) {
+        eraseItem(location);
+        found = true;
+    }
+    static const uint8_t kTypes[] = {NVS_TYPE_U8, NVS_TYPE_I8, NVS_TYPE_U16, NVS_TYPE_I16, NVS_TYPE_U32,
+                                     NVS_TYPE_I32, NVS_TYPE_U64, NVS_TYPE_I64, NVS_TYPE_STR, NVS_TYPE_BLOB_IDX};
+    for (uint8_t type : kTypes) {
+        while (locate(ns, key, type, location)) {
+            eraseItem(location);
+            found = true;
+        }
+    }
+    if (found) {
+        _stats.erases++;
+    }
+    return found;
+}
+
+bool NvsFlash::eraseAll(uint8_t ns) {
+    load();
+    bool found = false;
+    for (int page = 0; page < NVS_EMU_PAGES; page++) {
+        if (!isDataPage(page)) {
+            continue;
+        }
+        for (int entry = 0; entry < NVS_EMU_PAGE_ENTRIES;) {
+            uint8_t state = entryState(page, entry);
+            if (state == ENTRY_EMPTY) {
+                break;
+            }
+            const uint8_t* header = entryAt(page, entry);
+            int span = header[ENTRY_SPAN] > 0 ? header[ENTRY_SPAN] : 1;
+            if (state == ENTRY_WRITTEN && header[ENTRY_NS] == ns) {
+                eraseItem({page, entry});
+                found = true;
+            }
+            entry += span;
+        }
+    }
+    if (found) {
+        _stats.erases++;
+    }
+    return true;
+}
+
+size_t NvsFlash::freeEntries() {
+    load();
+    size_t free = 0;
+    for (int page = 0; page < NVS_EMU_PAGES; page++) {
+        for (int entry = 0; entry < NVS_EMU_PAGE_ENTRIES; entry++) {
+            free += entryState(page, entry) == ENTRY_EMPTY;
+        }
+    }
+    return free;
+}
+
+uint32_t NvsFlash::maxPageErases() {
+    load();
+    return *std::max_element(s_pageErases, s_pageErases + NVS_EMU_PAGES);
+}
+
+uint32_t NvsFlash::minPageErases() {
+    load();
+    return *std::min_element(s_pageErases, s_pageErases + NVS_EMU_PAGES);
+}
@@ -0,0 +1,117 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// ============================================
+// NVS FLASH EMULATOR
+// ============================================
+// The ESP-IDF NVS layout, kept in a file (<state dir>/nvs.bin) so it
+// survives emulated reboots:
+// - NVS_EMU_PAGES pages of 4 KB: 32-byte page header, 32-byte entry state
+//   bitmap, 126 entries of 32 bytes
+// - Every item starts with a header entry (namespace, type, span, key); a
+//   string or blob adds its data in whole entries, a blob also an index
+//   entry (blob format v2)
+// - Writes append to the active page and mark the old item's entries
+//   erased; writing the value already stored is skipped (like
+//   Storage::writeItem)
+// - When the active page is full the next empty page is used. One page is
+//   kept free: when only that one is left, garbage collection copies the
+//   live entries of the page with the most erased entries into it and
+//   erases that page (a 4 KB sector erase)
+//
+// Flash time is modelled from typical SPI NOR timings of ESP32 module
+// flash (page program ~0.7 ms per 256 bytes, sector erase ~45 ms); it is a
+// model for comparing access patterns, not a measurement.
+#define NVS_EMU_PAGES 5                 // Default 0x5000 "nvs" partition
+#define NVS_EMU_PAGE_SIZE 4096
+#define NVS_EMU_ENTRY_SIZE 32
+#define NVS_EMU_PAGE_ENTRIES 126
+#define NVS_EMU_READ_US_PER_ENTRY 2     // 32 bytes through the flash cache
+#define NVS_EMU_PROGRAM_US_PER_ENTRY 88 // 32 of 256 bytes at ~0.7 ms per page program
+#define NVS_EMU_STATE_US 20             // Entry/page state bit update (4-byte program)
+#define NVS_EMU_ERASE_US 45000          // 4 KB sector erase
+
+// Item types (nvs_types.h)
+enum NvsItemType : uint8_t {
+    NVS_TYPE_U8 = 0x01,
+    NVS_TYPE_I8 = 0x11,
+    NVS_TYPE_U16 = 0x02,
+    NVS_TYPE_I16 = 0x12,
+    NVS_TYPE_U32 = 0x04,
+    NVS_TYPE_I32 = 0x14,
+    NVS_TYPE_U64 = 0x08,
+    NVS_TYPE_I64 = 0x18,
+    NVS_TYPE_STR = 0x21,
+    NVS_TYPE_BLOB_DATA = 0x42,
+    NVS_TYPE_BLOB_IDX = 0x48,
+};
+
+// Counters since the last resetStats() (every emulated boot starts at zero)
+struct NvsFlashStats {
+    uint32_t opens;           // nvs_open (Preferences::begin)
+    uint32_t reads;           // Item lookups (get, isKey, getBytesLength)
+    uint32_t writes;          // set calls that programmed flash
+    uint32_t skippedWrites;   // set calls with the value already stored
+    uint32_t erases;          // erase_key / erase_all calls that changed flash
+    uint32_t entriesRead;
+    uint32_t entriesWritten;  // Entries programmed, including GC copies
+    uint32_t entriesErased;   // Entries marked erased
+    uint32_t pageErases;      // Sector erases by garbage collection
+    uint64_t flashMicros;     // Modelled flash time of all of the above
+};
+
+class NvsFlash {
+public:
+    static NvsFlash& instance();
+    
+    // Namespace index for name; creates it unless readOnly. False if it
+    // does not exist (read-only) or there is no space.
+    bool open(const char* name, bool readOnly, uint8_t& index);
+    
+    // Item of this namespace/key. length: value bytes (strings include the
+    // terminator). Returns false if missing or of another type.
+    bool find(uint8_t ns, const char* key, uint8_t* type = nullptr, size_t* length = nullptr);
+    bool read(uint8_t ns, const char* key, uint8_t type, void* buffer, size_t length);
+    bool write(uint8_t ns, const char* key, uint8_t type, const void* value, size_t length);
+    bool erase(uint8_t ns, const char* key);
+    bool eraseAll(uint8_t ns);
+    size_t freeEntries();
+    
+    const NvsFlashStats& stats() const { return _stats; }
+    void resetStats() { _stats = NvsFlashStats(); }
+    
+    // Lifetime sector erases of the most and least erased page (wear leveling)
+    uint32_t maxPageErases();
+    uint32_t minPageErases();
+    
+    // Image file handling: sync() writes pending changes, invalidate()
+    // drops the in-memory copy so the next call reloads the file, format()
+    // erases the partition (and its wear history)
+    void sync();
+    void invalidate();
+    void format();
+    
+    // Largest value that fits a single page (strings and blob chunks)
+    static const size_t MAX_ITEM_SIZE = (NVS_EMU_PAGE_ENTRIES - 1) * NVS_EMU_ENTRY_SIZE;
+
+private:
+    NvsFlash() {}
+    void load();
+    void commitState();
+    struct Location {
+        int page;
+        int entry;
+    };
+    bool locate(uint8_t ns, const char* key, uint8_t type, Location& location);
+    bool append(const uint8_t* entries, int span, Location* where = nullptr);
+    bool requestPage();
+    void eraseItem(const Location& location);
+    void eraseStale(uint8_t ns, const char* key, uint8_t type, uint8_t chunk, const Location& keep);
+    bool sameValue(const Location& location, uint8_t type, const void* value, size_t length);
+    
+    bool _loaded = false;
+    bool _dirty = false;
+    NvsFlashStats _stats = {};
+};
@@ -0,0 +1,147 @@
+#include "Preferences.h"
+#include "nvs_emulator.h"
+
+bool Preferences::begin(const char* name, bool readOnly, const char*) {
+    if (_started) {
+        return false;
+    }
+    _readOnly = readOnly;
+    _started = NvsFlash::instance().open(name, readOnly, _namespace);
+    return _started;
+}
+
+void Preferences::end() {
+    _started = false;
+}
+
+bool Preferences::clear() {
+    if (!_started || _readOnly) {
+        return false;
+    }
+    return NvsFlash::instance().eraseAll(_namespace);
+}
+
+bool Preferences::remove(const char* key) {
+    if (!_started || key == nullptr || _readOnly) {
+        return false;
+    }
+    return NvsFlash::instance().erase(_namespace, key);
+}
+
+size_t Preferences::put(const char* key, uint8_t type, const void* value, size_t length) {
+    if (!_started || key == nullptr || _readOnly) {
+        return 0;
+    }
+    return NvsFlash::instance().write(_namespace, key, type, value, length) ? length : 0;
+}
+
+bool Preferences::get(const char* key, uint8_t type, void* value, size_t length) {
+    if (!_started || key == nullptr) {
+        return false;
+    }
+    return NvsFlash::instance().read(_namespace, key, type, value, length);
+}
+
+size_t Preferences::putChar(const char* key, int8_t value) { return put(key, NVS_TYPE_I8, &value, 1); }
+size_t Preferences::putUChar(const char* key, uint8_t value) { return put(key, NVS_TYPE_U8, &value, 1); }
+size_t Preferences::putShort(const char* key, int16_t value) { return put(key, NVS_TYPE_I16, &value, 2); }
+size_t Preferences::putUShort(const char* key, uint16_t value) { return put(key, NVS_TYPE_U16, &value, 2); }
+size_t Preferences::putInt(const char* key, int32_t value) { return put(key, NVS_TYPE_I32, &value, 4); }
+size_t Preferences::putUInt(const char* key, uint32_t value) { return put(key, NVS_TYPE_U32, &value, 4); }
+size_t Preferences::putLong(const char* key, int32_t value) { return put(key, NVS_TYPE_I32, &value, 4); }
+size_t Preferences::putULong(const char* key, uint32_t value) { return put(key, NVS_TYPE_U32, &value, 4); }
+size_t Preferences::putLong64(const char* key, int64_t value) { return put(key, NVS_TYPE_I64, &value, 8); }
+size_t Preferences::putULong64(const char* key, uint64_t value) { return put(key, NVS_TYPE_U64, &value, 8); }
+size_t Preferences::putFloat(const char* key, float value) { return putBytes(key, &value, sizeof(value)); }
+size_t Preferences::putBool(const char* key, bool value) { return putUChar(key, value ? 1 : 0); }
+
+size_t Preferences::putString(const char* key, const char* value) {
+    if (value == nullptr) {
+        return 0;
+    }
+    // Stored with the terminator, put returns the text length
+    return put(key, NVS_TYPE_STR, value, strlen(value) + 1) ? strlen(value) : 0;
+}
+
+size_t Preferences::putBytes(const char* key, const void* value, size_t length) {
+    if (value == nullptr || length == 0) {
+        return 0;
+    }
+    return put(key, NVS_TYPE_BLOB_DATA, value, length);
+}
+
+bool Preferences::isKey(const char* key) {
+    return _started && key != nullptr && NvsFlash::instance().find(_namespace, key);
+}
+
+#define PREFS_GETTER(name, type, nvsType)                      \
+    type Preferences::name(const char* key, type defaultValue) { \
+        type value;                                              \
+        return get(key, nvsType, &value, sizeof(value)) ? value : defaultValue; \
+    }
+
+PREFS_GETTER(getChar, int8_t, NVS_TYPE_I8)
+PREFS_GETTER(getUChar, uint8_t, NVS_TYPE_U8)
+PREFS_GETTER(getShort, int16_t, NVS_TYPE_I16)
+PREFS_GETTER(getUShort, uint16_t, NVS_TYPE_U16)
+PREFS_GETTER(getInt, int32_t, NVS_TYPE_I32)
+PREFS_GETTER(getUInt, uint32_t, NVS_TYPE_U32)
+PREFS_GETTER(getLong, int32_t, NVS_TYPE_I32)
+PREFS_GETTER(getULong, uint32_t, NVS_TYPE_U32)
+PREFS_GETTER(getLong64, int64_t, NVS_TYPE_I64)
+PREFS_GETTER(getULong64, uint64_t, NVS_TYPE_U64)
+
+float Preferences::getFloat(const char* key, float defaultValue) {
+    float value;
+    return getBytes(key, &value, sizeof(value)) == sizeof(value) ? value : defaultValue;
+}
+
+bool Preferences::getBool(const char* key, bool defaultValue) {
+    return getUChar(key, defaultValue ? 1 : 0) == 1;
+}
+
+size_t Preferences::getString(const char* key, char* value, size_t maxLength) {
+    uint8_t type;
+    size_t length = 0;
+    if (!_started || key == nullptr || value == nullptr || maxLength == 0 ||
+        !NvsFlash::instance().find(_namespace, key, &type, &length) || type != NVS_TYPE_STR || length > maxLength) {
+        return 0;
+    }
+    return get(key, NVS_TYPE_STR, value, maxLength) ? length : 0;
+}
+
+String Preferences::getString(const char* key, String defaultValue) {
+    uint8_t type;
+    size_t length = 0;
+    if (!_started || key == nullptr || !NvsFlash::instance().find(_namespace, key, &type, &length) ||
+        type != NVS_TYPE_STR) {
+        return defaultValue;
+    }
+    std::string value(length, '\0');
+    if (!get(key, NVS_TYPE_STR, &value[0], length)) {
+        return defaultValue;
+    }
+    return String(value.c_str());
+}
+
+size_t Preferences::getBytesLength(const char* key) {
+    uint8_t type;
+    size_t length = 0;
+    if (!_started || key == nullptr || !NvsFlash::instance().find(_namespace, key, &type, &length) ||
+        type != NVS_TYPE_BLOB_DATA) {
+        return 0;
+    }
+    return length;
+}
+
+size_t Preferences::getBytes(const char* key, void* buffer, size_t maxLength) {
+    size_t length = getBytesLength(key);
+    if (length == 0 || buffer == nullptr || maxLength == 0 || length > maxLength) {
+        return 0;
+    }
+    return get(key, NVS_TYPE_BLOB_DATA, buffer, length) ? length : 0;
+}
+
+size_t Preferences::freeEntries() {
+    return NvsFlash::instance().freeEntries();
+}
@@ -0,0 +1,241 @@
+#include "PubSubClient.h"
+#include "host_platform.h"
+
+static std::string encodeString(const char* text) {
+    size_t length = strlen(text);
+    return std::string{(char)(length >> 8), (char)(length & 0xFF)} + text;
+}
+
+PubSubClient& PubSubClient::setServer(IPAddress ip, uint16_t port) {
+    _ip = ip;
+    _domain = String();
+    _port = port;
+    return *this;
+}
+
+PubSubClient& PubSubClient::setServer(const char* domain, uint16_t port) {
+    _domain = domain;
+    _port = port;
+    return *this;
+}
+
+PubSubClient& PubSubClient::setCallback(MQTT_CALLBACK_SIGNATURE) {
+    _callback = callback;
+    return *this;
+}
+
+PubSubClient& PubSubClient::setKeepAlive(uint16_t keepAlive) {
+    _keepAlive = keepAlive;
+    return *this;
+}
+
+PubSubClient& PubSubClient::setSocketTimeout(uint16_t timeout) {
+    _socketTimeout = timeout;
+    return *this;
+}
+
+bool PubSubClient::setBufferSize(uint16_t size) {
+    if (size == 0) {
+        return false;
+    }
+    _bufferSize = size;
+    return true;
+}
+
+bool PubSubClient::write(uint8_t header, const std::string& body) {
+    std::string packet(1, (char)header);
+    uint32_t length = (uint32_t)body.size();
+    do {
+        uint8_t digit = length % 128;
+        length /= 128;
+        packet += (char)(length > 0 ? (digit | 0x80) : digit);
+    } while (length > 0);
+    packet += body;
+    if (packet.size() > _bufferSize) {
+        return false;  // Does not fit the library's buffer
+    }
+    _lastOutActivity = millis();
+    return _client->write((const uint8_t*)packet.data(), packet.size()) == packet.size();
+}
+
+// Whole packet or false after the socket timeout
+bool PubSubClient::readPacket(uint8_t& header, std::string& body) {
+    unsigned long start = millis();
+    auto next = [&](uint8_t& b) {
+        while (_client->available() <= 0) {
+            if (!_client->connected() || millis() - start >= _socketTimeout * 1000UL) {
+                return false;
+            }
+            delay(1);
+        }
+        b = (uint8_t)_client->read();
+        return true;
+    };
+    uint8_t b;
+    if (!next(header)) {
+        return false;
+    }
+    uint32_t length = 0;
+    for (int shift = 0;; shift += 7) {
+        if (!next(b)) {
+            return false;
+        }
+        length |= (uint32_t)(b & 0x7F) << shift;
+        if (!(b & 0x80)) {
+            break;
+        }
+    }
+    body.clear();
+    while (body.size() < length) {
+        if (!next(b)) {
+            return false;
+        }
+        body += (char)b;
+    }
+    _lastInActivity = millis();
+    return true;
+}
+
+bool PubSubClient::connect(const char* id) {
+    return connect(id, nullptr, nullptr);
+}
+
+bool PubSubClient::connect(const char* id, const char* user, const char* pass) {
+    host::StandIn standIn;
+    if (connected()) {
+        return true;
+    }
+    int result = _domain.length() > 0 ? _client->connect(_domain.c_str(), _port) : _client->connect(_ip, _port);
+    if (!result) {
+        _state = MQTT_CONNECT_FAILED;
+        return false;
+    }
+    _nextMsgId = 1;
+    uint8_t flags = 0x02;  // Clean session
+    if (user != nullptr) {
+        flags |= 0x80;
+        if (pass != nullptr) {
+            flags |= 0x40;
+        }
+    }
+    std::string body = encodeString("MQTT") + (char)4 + (char)flags + (char)(_keepAlive >> 8) +
+                       (char)(_keepAlive & 0xFF) + encodeString(id);
+    if (user != nullptr) {
+        body += encodeString(user);
+        if (pass != nullptr) {
+            body += encodeString(pass);
+        }
+    }
+    if (!write(0x10, body)) {
+        _state = MQTT_CONNECTION_LOST;
+        _client->stop();
+        return false;
+    }
+    
+    uint8_t header;
+    std::string ack;
+    if (!readPacket(header, ack)) {
+        _state = MQTT_CONNECTION_TIMEOUT;
+        _client->stop();
+        return false;
+    }
+    if ((header >> 4) == 2 && ack.size() >= 2 && ack[1] == 0) {
+        _lastInActivity = _lastOutActivity = millis();
+        _pingOutstanding = false;
+        _state = MQTT_CONNECTED;
+        return true;
+    }
+    _state = ack.size() >= 2 ? (uint8_t)ack[1] : MQTT_CONNECT_FAILED;
+    _client->stop();
+    return false;
+}
+
+void PubSubClient::disconnect() {
+    host::StandIn standIn;
+    const uint8_t packet[2] = {0xE0, 0};
+    _client->write(packet, sizeof(packet));
+    _state = MQTT_DISCONNECTED;
+    _client->flush();
+    _client->stop();
+    _lastInActivity = _lastOutActivity = millis();
+}
+
+bool PubSubClient::publish(const char* topic, const char* payload) {
+    return publish(topic, (const uint8_t*)payload, strlen(payload), false);
+}
+
+bool PubSubClient::publish(const char* topic, const char* payload, bool retained) {
+    return publish(topic, (const uint8_t*)payload, strlen(payload), retained);
+}
+
+bool PubSubClient::publish(const char* topic, const uint8_t* payload, unsigned int length, bool retained) {
+    host::StandIn standIn;
+    if (!connected()) {
+        return false;
+    }
+    return write(0x30 | (retained ? 1 : 0), encodeString(topic) + std::string((const char*)payload, length));
+}
+
+bool PubSubClient::subscribe(const char* topic, uint8_t qos) {
+    host::StandIn standIn;
+    if (!connected()) {
+        return false;
+    }
+    uint16_t id = _nextMsgId++;
+    if (_nextMsgId == 0) {
+        _nextMsgId = 1;
+    }
+    return write(0x82, std::string{(char)(id >> 8), (char)(id & 0xFF)} + encodeString(topic) + (char)qos);
+}
+
+bool PubSubClient::loop() {
+    host::StandIn standIn;
+    if (!connected()) {
+        return false;
+    }
+    unsigned long now = millis();
+    unsigned long keepAliveMs = _keepAlive * 1000UL;
+    if (now - _lastInActivity > keepAliveMs || now - _lastOutActivity > keepAliveMs) {
+        if (_pingOutstanding) {
+            _state = MQTT_CONNECTION_TIMEOUT;
+            _client->stop();
+            return false;
+        }
+        write(0xC0, std::string());
+        _lastInActivity = now;
+        _pingOutstanding = true;
+    }
+    while (_client->available() > 0) {
+        uint8_t header;
+        std::string body;
+        if (!readPacket(header, body)) {
+            break;
+        }
+        uint8_t type = header >> 4;
+        if (type == 3 && _callback && body.size() >= 2) {
+            size_t topicLength = ((uint8_t)body[0] << 8) | (uint8_t)body[1];
+            size_t offset = 2 + topicLength + (((header >> 1) & 3) > 0 ? 2 : 0);
+            std::string topic = body.substr(2, topicLength);
+            std::string payload = offset <= body.size() ? body.substr(offset) : std::string();
+            _callback(&topic[0], (uint8_t*)&payload[0], (unsigned int)payload.size());
+        } else if (type == 12) {
+            write(0xD0, std::string());
+        } else if (type == 13) {
+            _pingOutstanding = false;
+        }
+    }
+    return true;
+}
+
+bool PubSubClient::connected() {
+    host::StandIn standIn;
+    if (_client->connected()) {
+        return _state == MQTT_CONNECTED;
+    }
+    if (_state == MQTT_CONNECTED) {
+        _state = MQTT_CONNECTION_LOST;
+        _client->flush();
+        _client->stop();
+    }
+    return false;
+}
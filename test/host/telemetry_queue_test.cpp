@@ -0,0 +1,141 @@
+// TelemetryQueue: RTC ring, spill to LittleFS, peek by index and pop in
+// FIFO order across both, the one-pass file drain (LittleFS opens), and
+// MQTTManager keeping drained readings queued until the flush barrier
+// confirms them.
+#include <LittleFS.h>
+#include "mqtt_test.h"
+#include "telemetry_queue.h"
+
+#define RECORD_SIZE 200   // ~10 fit the RTC ring, the rest spill
+
+static std::string makeRecord(int sequence) {
+    char head[32];
+    snprintf(head, sizeof(head), "{\"seq\":%d,\"pad\":\"", sequence);
+    std::string record = head;
+    record.append(RECORD_SIZE - record.size() - 2, 'x');
+    return record + "\"}";
+}
+
+static int sequenceOf(const std::string& record) {
+    return atoi(record.c_str() + strlen("{\"seq\":"));
+}
+
+static int peekSequence(uint16_t index) {
+    char buffer[TELEMETRY_QUEUE_MAX_RECORD];
+    size_t length = TelemetryQueue::peek(index, buffer, sizeof(buffer));
+    return length > 0 ? sequenceOf(std::string(buffer, length)) : -1;
+}
+
+int main() {
+    int failures = 0;
+    host::eraseFlash();
+    
+    // 30 records: the ring takes the first ones, the rest go to the file
+    failures += host::boot(host::POWER_ON, [] {
+        for (int i = 0; i < 30; i++) {
+            std::string record = makeRecord(i);
+            CHECK(TelemetryQueue::push(record.c_str(), record.size()));
+        }
+        CHECK_EQ(TelemetryQueue::depth(), 30);
+        CHECK(LittleFS.exists(TELEMETRY_QUEUE_FILE));
+        esp_deep_sleep_start();
+    });
+    host::sleep(300);
+    
+    // Peek by index across ring and file, in order, with one file open
+    failures += host::boot(host::TIMER_WAKE, [] {
+        CHECK_EQ(TelemetryQueue::depth(), 30);
+        for (int i = 0; i < 30; i++) {
+            CHECK_EQ(peekSequence(i), i);
+        }
+        CHECK_EQ(peekSequence(30), -1);
+        char small[16];
+        CHECK_EQ(TelemetryQueue::peek(0, small, sizeof(small)), 0);  // Does not fit
+        
+        // A drain: peek the first 25, pop them - the file is opened once
+        // and the pop reuses the reader's position
+        LittleFS.opens = 0;
+        for (int i = 0; i < 25; i++) {
+            CHECK_EQ(peekSequence(i), i);
+        }
+        TelemetryQueue::pop(25);
+        CHECK_EQ(LittleFS.opens, 1);
+        CHECK_EQ(TelemetryQueue::depth(), 5);
+        CHECK_EQ(peekSequence(0), 25);
+        CHECK_EQ(peekSequence(4), 29);
+        
+        // Earlier index after a later one: the file is reopened
+        CHECK_EQ(peekSequence(1), 26);
+        TelemetryQueue::pop(1);
+        CHECK_EQ(peekSequence(0), 26);
+        esp_deep_sleep_start();
+    });
+    host::sleep(300);
+    
+    // New records follow the file while it is not empty; draining it
+    // completely removes it
+    failures += host::boot(host::TIMER_WAKE, [] {
+        std::string record = makeRecord(30);
+        CHECK(TelemetryQueue::push(record.c_str(), record.size()));
+        CHECK_EQ(TelemetryQueue::depth(), 5);
+        CHECK_EQ(peekSequence(4), 30);
+        TelemetryQueue::pop(5);
+        CHECK_EQ(TelemetryQueue::depth(), 0);
+        CHECK(!LittleFS.exists(TELEMETRY_QUEUE_FILE));
+        record = makeRecord(31);
+        CHECK(TelemetryQueue::push(record.c_str(), record.size()));
+        CHECK(!LittleFS.exists(TELEMETRY_QUEUE_FILE));  // Back in the ring
+        TelemetryQueue::pop();
+    });
+    
+    // Cold boot: the ring is gone, the file is counted again
+    failures += host::boot(host::POWER_ON, [] {
+        for (int i = 0; i < 15; i++) {
+            std::string record = makeRecord(100 + i);
+            TelemetryQueue::push(record.c_str(), record.size());
+        }
+    });
+    failures += host::boot(host::POWER_ON, [] {
+        int depth = TelemetryQueue::depth();
+        CHECK(depth > 0 && depth < 15);
+        CHECK_EQ(peekSequence(0), 100 + 15 - depth);
+        TelemetryQueue::pop(depth);
+    });
+    
+    // MQTTManager: readings queued while the broker is down are sent to the
+    // backlog topic, and only popped once the flush barrier confirms them
+    failures += mqtt_test::configure();
+    failures += host::boot(host::POWER_ON, [] {
+        ConfigManager config;
+        config.begin(false);
+        MQTTManager mqtt(&config);
+        CHECK(mqtt.begin());
+        TelemetryData data;
+        mqtt_test::sampleTelemetry(data);
+        LoopbackBroker& broker = LoopbackBroker::instance();
+        std::string backlog = "homeassistant/sensor/" + std::string(data.deviceId.c_str()) + "/backlog";
+        
+        broker.online = false;
+        for (int i = 0; i < 3; i++) {
+            CHECK(!mqtt.publishAllTelemetry(data));
+        }
+        CHECK_EQ(TelemetryQueue::depth(), 3);
+        
+        // Back, but the PINGRESP never comes: sent, not confirmed, kept -
+        // and the unconfirmed live reading joins them
+        broker.online = true;
+        broker.respondPing = false;
+        CHECK(mqtt.publishAllTelemetry(data));
+        CHECK_EQ(broker.published(backlog).size(), 3);
+        CHECK_EQ(TelemetryQueue::depth(), 4);
+        
+        // Confirmed: popped
+        broker.clearRecords();
+        broker.respondPing = true;
+        CHECK(mqtt.publishAllTelemetry(data));
+        CHECK_EQ(broker.published(backlog).size(), 4);
+        CHECK_EQ(TelemetryQueue::depth(), 0);
+    });
+    
+    return host::result(failures);
+}